@@ -303,7 +303,7 @@ void* encrypt_blocks(void* arg) {
     __m128i keystream;
     __m128i input_block;
 
-    for(int i = 0; i < data->num_blocks; i++) {
+    for(size_t i = 0; i < data->num_blocks; i++) {
         size_t block_idx = data->start_block + i;
 
         // Prepare counter block
@@ -371,10 +371,10 @@ void AES_Encrypt_Block_CTR(uint8_t* counter_block, uint8_t* input,
 }
 
 void AES_Encrypt_Serial_CTR(uint8_t* input, const uint8_t* roundKey, 
-                           uint8_t* output, int num_blocks, ctr_block_t* initial_ctr) {
+                           uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr) {
     uint8_t counter_block[16];
     
-    for(int i = 0; i < num_blocks; i++) {
+    for(size_t i = 0; i < num_blocks; i++) {
         setup_counter_block(initial_ctr, counter_block, i);
         AES_Encrypt_Block_CTR(counter_block, input + (i * 16), 
                              roundKey, output + (i * 16));
@@ -12,7 +12,7 @@
 #define Nr 10
 #define MB_TO_TEST 1024
 #define BLOCK_SIZE 16
-#define NUM_BLOCKS ((MB_TO_TEST * 1024 * 1024) / BLOCK_SIZE)
+#define NUM_BLOCKS (((size_t)MB_TO_TEST * 1024 * 1024) / BLOCK_SIZE)
 
 typedef uint8_t state_t[4][4];
 typedef struct {
@@ -350,11 +350,11 @@ void AES_Encrypt_Block_NI(__m128i* plain, __m128i* key_schedule, __m128i* cipher
 }
 
 void AES_Encrypt_Serial_CTR(uint8_t* input, const uint8_t* roundKey, uint8_t* output, 
-                          int num_blocks, ctr_block_t* initial_ctr) {
+                          size_t num_blocks, ctr_block_t* initial_ctr) {
     uint8_t counter_block[16];
     uint8_t keystream[16];
     
-    for(int i = 0; i < num_blocks; i++) {
+    for(size_t i = 0; i < num_blocks; i++) {
         // Prepare counter block for this block
         prepare_ctr_block(initial_ctr, counter_block, i);
         
@@ -381,13 +381,13 @@ inline __m512i m128i_to_m512i(__m128i src) {
 
 // AES-NI parallel encryption
 void AES_Encrypt_AESNI_CTR(uint8_t* input, __m128i* key_schedule, uint8_t* output, 
-                          int num_blocks, ctr_block_t* initial_ctr) {
+                          size_t num_blocks, ctr_block_t* initial_ctr) {
     uint8_t counter_block[16];
     __m512i counter_block_vec;
     __m512i keystream;
     __m512i input_block;
     
-    for(int i = 0; i < num_blocks; i+=4) {
+    for(size_t i = 0; i < num_blocks; i+=4) {
         __m128i temp_sub_counter_block;
         // Prepare counter block
         prepare_ctr_block(initial_ctr, counter_block, i+0);
@@ -455,7 +455,7 @@ int main() {
     }
     
     // Initialize input
-    for(int i = 0; i < NUM_BLOCKS * 16; i++) {
+    for(size_t i = 0; i < NUM_BLOCKS * 16; i++) {
         input[i] = i & 0xFF;
     }
     
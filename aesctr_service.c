@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "aes.h"
+#include "service.h"
+#include "affinity.h"
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s -s <socket path> -k <id>:<32 hex key> [-k ...] [-t <workers>] [-v]\n"
+            "Serves AES-128-CTR to local processes over a Unix socket until SIGINT or SIGTERM.\n"
+            "Payloads travel through memory shared with each client (see src/service.h).\n"
+            "-k: key ids run from 0 to %d. -v: print request and batch counts on exit.\n",
+            prog, AES_SERVICE_MAX_KEYS - 1);
+}
+
+int main(int argc, char** argv) {
+    aes_service_key_t keys[AES_SERVICE_MAX_KEYS];
+    aes_service_opts_t opts = { .keys = keys };
+    const char* path = NULL;
+    int verbose = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:k:t:vh")) != -1) {
+        switch (opt) {
+            case 's':
+                path = optarg;
+                break;
+            case 'k': {
+                char* hex = strchr(optarg, ':');
+                uint64_t id;
+                if (hex) {
+                    *hex++ = '\0';
+                }
+                if (opts.num_keys == AES_SERVICE_MAX_KEYS || !hex || parse_u64(optarg, 10, &id) < 0 ||
+                    id >= AES_SERVICE_MAX_KEYS || parse_hex(hex, keys[opts.num_keys].key, 16) < 0) {
+                    fprintf(stderr, "key must be <id>:<32 hex digits>, id below %d, at most %d keys\n",
+                            AES_SERVICE_MAX_KEYS, AES_SERVICE_MAX_KEYS);
+                    return 2;
+                }
+                keys[opts.num_keys++].key_id = (uint32_t)id;
+                break;
+            }
+            case 't': {
+                uint64_t workers;
+                if (parse_u64(optarg, 10, &workers) < 0 || workers > AES_MAX_THREADS) {
+                    fprintf(stderr, "workers must be 0 to %d\n", AES_MAX_THREADS);
+                    return 2;
+                }
+                opts.workers = (int)workers;
+                break;
+            }
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if (!path || opts.num_keys == 0 || optind != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Block the stop signals before any thread starts, then wait for one here
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, NULL);
+
+    aes_service_t* svc = aes_service_start(path, &opts);
+    if (!svc) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], path, strerror(errno));
+        return 1;
+    }
+    memset(keys, 0, sizeof(keys));
+
+    int sig;
+    sigwait(&stop, &sig);
+
+    aes_service_stats_t stats;
+    aes_service_get_stats(svc, &stats);
+    aes_service_stop(svc);
+    if (verbose) {
+        fprintf(stderr, "%llu clients, %llu requests in %llu batches (max %llu), %llu bytes\n",
+                (unsigned long long)stats.clients, (unsigned long long)stats.requests,
+                (unsigned long long)stats.batches, (unsigned long long)stats.max_batch,
+                (unsigned long long)stats.bytes);
+    }
+    return 0;
+}
@@ -12,10 +12,14 @@
 #define Nb 4
 #define Nk 4
 #define Nr 10
+#ifndef MB_TO_TEST
 #define MB_TO_TEST 1024
+#endif
 #define BLOCK_SIZE 16
-#define NUM_BLOCKS ((MB_TO_TEST * 1024 * 1024) / BLOCK_SIZE)
+#define NUM_BLOCKS (((size_t)MB_TO_TEST * 1024 * 1024) / BLOCK_SIZE)
+#ifndef NUM_THREADS
 #define NUM_THREADS 8
+#endif
 
 typedef uint8_t state_t[4][4];
 typedef struct {
@@ -36,7 +40,13 @@ extern const uint8_t mul3[256];
 
 void prepare_ctr_block(ctr_block_t* base_ctr, uint8_t* counter_block, uint64_t block_idx);
 void setup_counter_block(uint8_t* counter_block, const uint8_t* nonce, uint64_t counter_value);
+// Counter block of `base` advanced by `blocks`, for handing sub-ranges to kernels; out may be base
+void ctr_block_advance(const ctr_block_t* base, ctr_block_t* out, uint64_t blocks);
 int compare_buffers(uint8_t* buf1, uint8_t* buf2, size_t size);
+// Parses exactly len bytes from 2 * len hex digits; -1 on anything else
+int parse_hex(const char* hex, uint8_t* out, size_t len);
+// Parses a whole unsigned number in base (0 for C prefixes); -1 on trailing text or overflow
+int parse_u64(const char* str, int base, uint64_t* out);
 
 //----------------------------------serial----------------------------------
 
@@ -45,7 +55,10 @@ void aes_keyexpansion_serial(uint8_t* key, uint8_t* roundKey);
  * input: the address of input blocks
  * roundKey
  */
-void aesctr_enc_serial(uint8_t* input, const uint8_t* roundKey, uint8_t* output, int num_blocks, ctr_block_t* initial_ctr);
+void aesctr_enc_serial(uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr);
+
+// The kernel behind aesctr_enc_serial, without stats
+void aesctr_kernel_serial(uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr);
 
 void aes_enc1block_serial(uint8_t* input, const uint8_t* roundKey, uint8_t* output);
 void aesctr_enc1block_serial(uint8_t* counter, uint8_t* input, const uint8_t* roundKey, uint8_t* output);
@@ -2,6 +2,7 @@
 #define AES_PTHREAD_H
 
 #include "aes.h"
+#include "perfmon.h"
 
 // Structure to pass data to threads
 typedef struct {
@@ -11,6 +12,9 @@ typedef struct {
     ctr_block_t* initial_counter;  // Initial counter value for this thread
     size_t start_block;
     size_t num_blocks;
+    int thread_idx;                // for pinning, see affinity.h
+    aes_perf_job_t* perf;          // NULL unless instrumentation is on
+    int streaming;                 // non-temporal stores, decided once per job (store.h)
 } thread_data_t;
 
 void aesctr_enc_pthread(uint8_t* input, uint8_t* roundKey, uint8_t* output, size_t total_blocks, ctr_block_t* initial_ctr);
@@ -1,7 +1,13 @@
+// Built without -maes so callers can dispatch at runtime
+#pragma GCC target("sse4.1,aes")
+
 #include <wmmintrin.h>  // AES-NI intrinsics
+#include <smmintrin.h>
 #include <cpuid.h>      // for checking AES-NI support
 
 #include "aesni.h"
+#include "stats.h"
+#include "store.h"
 
 static __m128i AES_128_key_expansion_assist(__m128i temp1, __m128i temp2) {
     __m128i temp3;
@@ -72,31 +78,150 @@ void aes_keyexpansion_aesni(uint8_t* userkey, __m128i* key_schedule) {
     key_schedule[10] = temp1;
 }
 
-// AES-NI parallel encryption
-void aesctr_enc_aesni(uint8_t* input, __m128i* key_schedule, uint8_t* output, 
-                          int num_blocks, ctr_block_t* initial_ctr) {
-    uint8_t counter_block[16];
-    __m128i counter_block_vec;
-    __m128i keystream;
-    __m128i input_block;
-    
-    for(int i = 0; i < num_blocks; i++) {
-        // Prepare counter block
-        prepare_ctr_block(initial_ctr, counter_block, i);
-        
-        // Load counter block into vector
-        counter_block_vec = _mm_loadu_si128((__m128i*)counter_block);
-        
-        // Encrypt counter block using AES-NI
-        counter_block_vec = _mm_xor_si128(counter_block_vec, key_schedule[0]);
+#define AESNI_LANES 8
+
+// One AES round on all eight in-flight blocks
+#define AESENC8(op, key) do { \
+        b0 = op(b0, key); b1 = op(b1, key); b2 = op(b2, key); b3 = op(b3, key); \
+        b4 = op(b4, key); b5 = op(b5, key); b6 = op(b6, key); b7 = op(b7, key); \
+    } while (0)
+
+// Streaming stores need 16-byte aligned output; the compiler drops the untaken branch
+#define XOR_STORE(k, b) do { \
+        __m128i out_ = _mm_xor_si128(_mm_loadu_si128((__m128i*)(input + (i + k) * 16)), b); \
+        if (stream) _mm_stream_si128((__m128i*)(output + (i + k) * 16), out_); \
+        else _mm_storeu_si128((__m128i*)(output + (i + k) * 16), out_); \
+    } while (0)
+
+// Input prefetch distance for the streaming variant, past what the hardware prefetcher covers
+#define PREFETCH_BYTES 1024
+
+static inline __m128i counter_vec(uint64_t nonce, uint64_t counter_value) {
+    return _mm_set_epi64x(__builtin_bswap64(counter_value), nonce);
+}
+
+// AES-NI CTR, eight independent blocks per iteration to cover the aesenc latency
+static inline __attribute__((always_inline))
+void aesni_ctr(uint8_t* input, __m128i* key_schedule, uint8_t* output,
+               size_t num_blocks, ctr_block_t* initial_ctr, const int stream) {
+    uint64_t nonce;
+    uint64_t counter_value = 0;
+    __m128i ks[11];
+    size_t i = 0;
+
+    memcpy(&nonce, initial_ctr->nonce, 8);
+    for(int j = 0; j < 8; j++) {
+        counter_value = (counter_value << 8) | initial_ctr->counter[j];
+    }
+    for(int j = 0; j < 11; j++) {
+        ks[j] = _mm_loadu_si128(&key_schedule[j]);
+    }
+
+    for(; i + AESNI_LANES <= num_blocks; i += AESNI_LANES) {
+        if (stream) {
+            _mm_prefetch((const char*)(input + i * 16 + PREFETCH_BYTES), _MM_HINT_NTA);
+            _mm_prefetch((const char*)(input + i * 16 + PREFETCH_BYTES + 64), _MM_HINT_NTA);
+        }
+
+        __m128i b0 = _mm_xor_si128(counter_vec(nonce, counter_value + i + 0), ks[0]);
+        __m128i b1 = _mm_xor_si128(counter_vec(nonce, counter_value + i + 1), ks[0]);
+        __m128i b2 = _mm_xor_si128(counter_vec(nonce, counter_value + i + 2), ks[0]);
+        __m128i b3 = _mm_xor_si128(counter_vec(nonce, counter_value + i + 3), ks[0]);
+        __m128i b4 = _mm_xor_si128(counter_vec(nonce, counter_value + i + 4), ks[0]);
+        __m128i b5 = _mm_xor_si128(counter_vec(nonce, counter_value + i + 5), ks[0]);
+        __m128i b6 = _mm_xor_si128(counter_vec(nonce, counter_value + i + 6), ks[0]);
+        __m128i b7 = _mm_xor_si128(counter_vec(nonce, counter_value + i + 7), ks[0]);
+
+        for(int j = 1; j < 10; j++) {
+            AESENC8(_mm_aesenc_si128, ks[j]);
+        }
+        AESENC8(_mm_aesenclast_si128, ks[10]);
+
+        XOR_STORE(0, b0); XOR_STORE(1, b1); XOR_STORE(2, b2); XOR_STORE(3, b3);
+        XOR_STORE(4, b4); XOR_STORE(5, b5); XOR_STORE(6, b6); XOR_STORE(7, b7);
+    }
+
+    // Remaining blocks one at a time
+    for(; i < num_blocks; i++) {
+        __m128i b = _mm_xor_si128(counter_vec(nonce, counter_value + i), ks[0]);
+        for(int j = 1; j < 10; j++) {
+            b = _mm_aesenc_si128(b, ks[j]);
+        }
+        b = _mm_aesenclast_si128(b, ks[10]);
+        XOR_STORE(0, b);
+    }
+
+    // Streaming stores are weakly ordered; make them visible before the caller signals completion
+    if (stream) {
+        _mm_sfence();
+    }
+}
+
+void aesctr_kernel_aesni(uint8_t* input, __m128i* key_schedule, uint8_t* output,
+                         size_t num_blocks, ctr_block_t* initial_ctr) {
+    aesni_ctr(input, key_schedule, output, num_blocks, initial_ctr, 0);
+}
+
+void aesctr_kernel_aesni_nt(uint8_t* input, __m128i* key_schedule, uint8_t* output,
+                            size_t num_blocks, ctr_block_t* initial_ctr) {
+    if ((uintptr_t)output & 15) {
+        aesni_ctr(input, key_schedule, output, num_blocks, initial_ctr, 0);
+    } else {
+        aesni_ctr(input, key_schedule, output, num_blocks, initial_ctr, 1);
+    }
+}
+
+// Independent blocks, eight in flight; input and output may be the same buffer
+void aes_ecb_kernel_aesni(const uint8_t* input, __m128i* key_schedule, uint8_t* output, size_t num_blocks) {
+    __m128i ks[11];
+    size_t i = 0;
+
+    for(int j = 0; j < 11; j++) {
+        ks[j] = _mm_loadu_si128(&key_schedule[j]);
+    }
+
+    for(; i + AESNI_LANES <= num_blocks; i += AESNI_LANES) {
+        const __m128i* in = (const __m128i*)(input + i * 16);
+        __m128i b0 = _mm_xor_si128(_mm_loadu_si128(in + 0), ks[0]);
+        __m128i b1 = _mm_xor_si128(_mm_loadu_si128(in + 1), ks[0]);
+        __m128i b2 = _mm_xor_si128(_mm_loadu_si128(in + 2), ks[0]);
+        __m128i b3 = _mm_xor_si128(_mm_loadu_si128(in + 3), ks[0]);
+        __m128i b4 = _mm_xor_si128(_mm_loadu_si128(in + 4), ks[0]);
+        __m128i b5 = _mm_xor_si128(_mm_loadu_si128(in + 5), ks[0]);
+        __m128i b6 = _mm_xor_si128(_mm_loadu_si128(in + 6), ks[0]);
+        __m128i b7 = _mm_xor_si128(_mm_loadu_si128(in + 7), ks[0]);
+
         for(int j = 1; j < 10; j++) {
-            counter_block_vec = _mm_aesenc_si128(counter_block_vec, key_schedule[j]);
+            AESENC8(_mm_aesenc_si128, ks[j]);
         }
-        keystream = _mm_aesenclast_si128(counter_block_vec, key_schedule[10]);
-        
-        // XOR with input
-        input_block = _mm_loadu_si128((__m128i*)(input + i * 16));
-        _mm_storeu_si128((__m128i*)(output + i * 16), 
-                        _mm_xor_si128(input_block, keystream));
+        AESENC8(_mm_aesenclast_si128, ks[10]);
+
+        __m128i* out = (__m128i*)(output + i * 16);
+        _mm_storeu_si128(out + 0, b0); _mm_storeu_si128(out + 1, b1);
+        _mm_storeu_si128(out + 2, b2); _mm_storeu_si128(out + 3, b3);
+        _mm_storeu_si128(out + 4, b4); _mm_storeu_si128(out + 5, b5);
+        _mm_storeu_si128(out + 6, b6); _mm_storeu_si128(out + 7, b7);
+    }
+
+    for(; i < num_blocks; i++) {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(input + i * 16)), ks[0]);
+        for(int j = 1; j < 10; j++) {
+            b = _mm_aesenc_si128(b, ks[j]);
+        }
+        _mm_storeu_si128((__m128i*)(output + i * 16), _mm_aesenclast_si128(b, ks[10]));
+    }
+}
+
+// AES-NI parallel encryption
+void aesctr_enc_aesni(uint8_t* input, __m128i* key_schedule, uint8_t* output, 
+                          size_t num_blocks, ctr_block_t* initial_ctr) {
+    uint64_t start_ns = aes_stats_now_ns();
+
+    if (aes_streaming_stores(input, output, num_blocks * BLOCK_SIZE)) {
+        aesctr_kernel_aesni_nt(input, key_schedule, output, num_blocks, initial_ctr);
+    } else {
+        aesctr_kernel_aesni(input, key_schedule, output, num_blocks, initial_ctr);
     }
+
+    aes_stats_record(AES_BACKEND_AESNI, (uint64_t)num_blocks * BLOCK_SIZE, aes_stats_now_ns() - start_ns);
 }
\ No newline at end of file
@@ -10,6 +10,21 @@ int  check_aesni_support();
 
 void aes_keyexpansion_aesni(uint8_t* key, __m128i* key_schedule);
 
-void aesctr_enc_aesni(uint8_t* input, __m128i* key_schedule, uint8_t* output, int num_blocks, ctr_block_t* initial_ctr);
+void aesctr_enc_aesni(uint8_t* input, __m128i* key_schedule, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr);
+
+/**
+ * The kernel behind aesctr_enc_aesni, eight blocks in flight, without stats.
+ * For drivers that split a job and account for it themselves.
+ */
+void aesctr_kernel_aesni(uint8_t* input, __m128i* key_schedule, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr);
+
+// Streaming-store variant (see store.h); regular stores if output is not 16-byte aligned
+void aesctr_kernel_aesni_nt(uint8_t* input, __m128i* key_schedule, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr);
+
+/**
+ * Encrypts num_blocks independent blocks (ECB), eight in flight. Used on
+ * lists of counter blocks that are not consecutive, such as one per packet.
+ */
+void aes_ecb_kernel_aesni(const uint8_t* input, __m128i* key_schedule, uint8_t* output, size_t num_blocks);
 
 #endif
\ No newline at end of file
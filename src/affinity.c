@@ -0,0 +1,173 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "affinity.h"
+
+typedef struct {
+    int cpu;
+    int core;       // core_id, unique within a package
+    int package;
+    int smt;        // index among the core's siblings
+} cpu_info_t;
+
+static int num_threads = NUM_THREADS;
+static aes_pin_policy_t pin_policy = AES_PIN_NONE;
+
+// CPU orderings per policy, built once from sysfs
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+static cpu_info_t cpus[AES_MAX_THREADS];
+static int compact_order[AES_MAX_THREADS];
+static int scatter_order[AES_MAX_THREADS];
+static int physical_order[AES_MAX_THREADS];
+static int num_cpus_found;
+static int num_physical;
+static int num_packages;
+
+int aes_get_num_threads() {
+    return num_threads;
+}
+
+void aes_set_num_threads(int n) {
+    if (n < 1) n = 1;
+    if (n > AES_MAX_THREADS) n = AES_MAX_THREADS;
+    num_threads = n;
+}
+
+aes_pin_policy_t aes_get_pin_policy() {
+    return pin_policy;
+}
+
+void aes_set_pin_policy(aes_pin_policy_t policy) {
+    pin_policy = policy;
+}
+
+const char* aes_pin_policy_name(aes_pin_policy_t policy) {
+    switch (policy) {
+        case AES_PIN_COMPACT:  return "compact";
+        case AES_PIN_SCATTER:  return "scatter";
+        case AES_PIN_PHYSICAL: return "physical";
+        default:               return "none";
+    }
+}
+
+static int read_sysfs_int(int cpu, const char* name, int fallback) {
+    char path[128];
+    int value = fallback;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE* f = fopen(path, "r");
+    if (f) {
+        if (fscanf(f, "%d", &value) != 1) {
+            value = fallback;
+        }
+        fclose(f);
+    }
+    return value;
+}
+
+static int cmp_compact(const void* a, const void* b) {
+    const cpu_info_t* x = &cpus[*(const int*)a];
+    const cpu_info_t* y = &cpus[*(const int*)b];
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    return x->smt - y->smt;
+}
+
+static int cmp_scatter(const void* a, const void* b) {
+    const cpu_info_t* x = &cpus[*(const int*)a];
+    const cpu_info_t* y = &cpus[*(const int*)b];
+    if (x->smt != y->smt) return x->smt - y->smt;
+    if (x->core != y->core) return x->core - y->core;
+    return x->package - y->package;
+}
+
+static void load_topology() {
+    cpu_set_t allowed;
+    int max_package = 0;
+
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        for(int cpu = 0; cpu < AES_MAX_THREADS; cpu++) {
+            CPU_SET(cpu, &allowed);
+        }
+    }
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    for(int cpu = 0; cpu < AES_MAX_THREADS && num_cpus_found < online; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+
+        cpu_info_t* info = &cpus[num_cpus_found];
+        info->cpu = cpu;
+        info->core = read_sysfs_int(cpu, "core_id", cpu);
+        info->package = read_sysfs_int(cpu, "physical_package_id", 0);
+        info->smt = 0;
+
+        // Sibling index = number of earlier CPUs on the same core
+        for(int i = 0; i < num_cpus_found; i++) {
+            if (cpus[i].core == info->core && cpus[i].package == info->package) {
+                info->smt++;
+            }
+        }
+        if (info->smt == 0) {
+            num_physical++;
+        }
+        if (info->package > max_package) {
+            max_package = info->package;
+        }
+        num_cpus_found++;
+    }
+    if (num_cpus_found == 0) {
+        cpus[0].cpu = 0;
+        num_cpus_found = 1;
+        num_physical = 1;
+    }
+    num_packages = max_package + 1;
+
+    for(int i = 0; i < num_cpus_found; i++) {
+        compact_order[i] = i;
+        scatter_order[i] = i;
+    }
+    qsort(compact_order, num_cpus_found, sizeof(int), cmp_compact);
+    qsort(scatter_order, num_cpus_found, sizeof(int), cmp_scatter);
+
+    // Scatter order lists every first sibling before any second sibling
+    memcpy(physical_order, scatter_order, sizeof(int) * num_physical);
+}
+
+void aes_get_topology(aes_topology_t* topology) {
+    pthread_once(&topology_once, load_topology);
+    topology->num_cpus = num_cpus_found;
+    topology->num_cores = num_physical;
+    topology->num_packages = num_packages;
+}
+
+int aes_cpu_for_thread(int thread_idx) {
+    pthread_once(&topology_once, load_topology);
+
+    switch (pin_policy) {
+        case AES_PIN_COMPACT:  return cpus[compact_order[thread_idx % num_cpus_found]].cpu;
+        case AES_PIN_SCATTER:  return cpus[scatter_order[thread_idx % num_cpus_found]].cpu;
+        case AES_PIN_PHYSICAL: return cpus[physical_order[thread_idx % num_physical]].cpu;
+        default:               return -1;
+    }
+}
+
+int aes_pin_thread(int thread_idx) {
+    int cpu = aes_cpu_for_thread(thread_idx);
+    cpu_set_t set;
+
+    if (cpu < 0) {
+        return 0;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
@@ -0,0 +1,42 @@
+#ifndef AES_AFFINITY_H
+#define AES_AFFINITY_H
+
+#include "aes.h"
+
+#define AES_MAX_THREADS 256
+
+typedef enum {
+    AES_PIN_NONE = 0,   // leave placement to the OS
+    AES_PIN_COMPACT,    // fill SMT siblings of a core, then the next core, then the next socket
+    AES_PIN_SCATTER,    // spread across sockets first, then cores, SMT siblings last
+    AES_PIN_PHYSICAL    // one thread per physical core, wrapping around when oversubscribed
+} aes_pin_policy_t;
+
+typedef struct {
+    int num_cpus;
+    int num_cores;      // physical cores
+    int num_packages;   // sockets
+} aes_topology_t;
+
+// Thread count used by the pthread, OpenMP and VAES+pthread drivers (default NUM_THREADS)
+int  aes_get_num_threads();
+void aes_set_num_threads(int num_threads);
+
+aes_pin_policy_t aes_get_pin_policy();
+void aes_set_pin_policy(aes_pin_policy_t policy);
+const char* aes_pin_policy_name(aes_pin_policy_t policy);
+
+void aes_get_topology(aes_topology_t* topology);
+
+/**
+ * CPU that worker thread_idx runs on under the current policy, -1 for AES_PIN_NONE.
+ */
+int aes_cpu_for_thread(int thread_idx);
+
+/**
+ * Pins the calling thread according to the current policy.
+ * return: 0 on success or when no pinning is requested
+ */
+int aes_pin_thread(int thread_idx);
+
+#endif
@@ -0,0 +1,207 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "async.h"
+#include "dispatch.h"
+#include "stats.h"
+#include "trace.h"
+
+enum {
+    JOB_PENDING,
+    JOB_DONE,
+    JOB_WAITED                  // pending, with a thread asleep on the futex
+};
+
+typedef struct {
+    aes_task_t task;
+    aes_async_t* job;
+    size_t offset;              // block aligned
+    size_t len;
+} chunk_t;
+
+struct aes_async {
+    const uint8_t* input;
+    const uint8_t* roundKey;
+    uint8_t* output;
+    size_t len;
+    ctr_block_t ctr;
+    aesctr_bulk_fn kernel;
+    aes_async_cb callback;
+    void* arg;
+    int efd;
+    _Atomic int refs;           // the caller's and the completing worker's
+    uint64_t start_ns;
+    _Atomic size_t remaining;   // chunks not yet finished
+    _Atomic uint32_t state;
+    size_t num_chunks;
+    chunk_t chunks[];
+};
+
+static void futex_wait(_Atomic uint32_t* word, uint32_t seen) {
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t* word) {
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+static void job_destroy(aes_async_t* job) {
+    if (job->efd >= 0) {
+        close(job->efd);
+    }
+    free(job);
+}
+
+static void job_release(aes_async_t* job) {
+    if (atomic_fetch_sub(&job->refs, 1) == 1) {
+        job_destroy(job);
+    }
+}
+
+// Runs on the worker that finished the last chunk
+static void job_complete(aes_async_t* job) {
+    aes_stats_record(AES_BACKEND_ASYNC, job->len, aes_stats_now_ns() - job->start_ns);
+
+    if (job->callback) {
+        job->callback(job, job->arg);
+    }
+    // Done before the eventfd fires, so a loop woken by it sees aes_async_done
+    if (atomic_exchange(&job->state, JOB_DONE) == JOB_WAITED) {
+        futex_wake(&job->state);
+    }
+    if (job->efd >= 0) {
+        uint64_t one = 1;
+        while (write(job->efd, &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+    }
+    // The caller may have released the job already, from the callback or after seeing it done
+    job_release(job);
+}
+
+static void chunk_run(aes_task_t* task, int worker_idx) {
+    chunk_t* chunk = (chunk_t*)task;
+    aes_async_t* job = chunk->job;
+    size_t blocks = chunk->len / BLOCK_SIZE;
+    size_t tail = chunk->len % BLOCK_SIZE;
+    ctr_block_t ctr;
+    (void)worker_idx;
+
+    AES_TRACE(AES_TRACE_CHUNK_BEGIN, "async", chunk->len);
+    ctr_block_advance(&job->ctr, &ctr, chunk->offset / BLOCK_SIZE);
+    job->kernel((uint8_t*)job->input + chunk->offset, (uint8_t*)job->roundKey, job->output + chunk->offset,
+                blocks, &ctr);
+    if (tail) {
+        // Only the last chunk has one
+        uint8_t block[BLOCK_SIZE] = {0};
+        size_t at = chunk->offset + blocks * BLOCK_SIZE;
+        memcpy(block, job->input + at, tail);
+        ctr_block_advance(&job->ctr, &ctr, at / BLOCK_SIZE);
+        job->kernel(block, (uint8_t*)job->roundKey, block, 1, &ctr);
+        memcpy(job->output + at, block, tail);
+    }
+    AES_TRACE(AES_TRACE_CHUNK_END, "async", 0);
+
+    if (atomic_fetch_sub(&job->remaining, 1) == 1) {
+        job_complete(job);
+    }
+}
+
+// One chunk per worker, 4-block multiples to stay on the VAES fast path, within the chunk limits
+static size_t chunk_bytes(size_t len, int num_threads) {
+    size_t chunk = (len / num_threads + 63) & ~(size_t)63;
+    if (chunk < AES_ASYNC_CHUNK_MIN) chunk = AES_ASYNC_CHUNK_MIN;
+    if (chunk > AES_ASYNC_CHUNK_MAX) chunk = AES_ASYNC_CHUNK_MAX;
+    return chunk;
+}
+
+aes_async_t* aesctr_enc_async(aes_pool_t* pool, const uint8_t* input, const uint8_t* roundKey, uint8_t* output,
+                              size_t len, const ctr_block_t* initial_ctr, const aes_async_opts_t* opts) {
+    uint64_t start_ns = aes_stats_now_ns();
+
+    if (!pool) {
+        pool = aes_pool_default();
+    }
+    if (!pool) {
+        errno = EAGAIN;
+        return NULL;
+    }
+
+    size_t chunk = chunk_bytes(len, aes_pool_num_threads(pool));
+    size_t num_chunks = len ? (len + chunk - 1) / chunk : 1;
+    aes_async_t* job = (aes_async_t*)calloc(1, sizeof(aes_async_t) + num_chunks * sizeof(chunk_t));
+    if (!job) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    job->efd = -1;
+    if (opts && (opts->flags & AES_ASYNC_EVENTFD)) {
+        job->efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (job->efd < 0) {
+            free(job);
+            return NULL;
+        }
+    }
+    job->input = input;
+    job->roundKey = roundKey;
+    job->output = output;
+    job->len = len;
+    job->ctr = *initial_ctr;
+    job->kernel = aes_select_bulk_kernel_for(input, output, len, NULL);
+    job->callback = opts ? opts->callback : NULL;
+    job->arg = opts ? opts->arg : NULL;
+    job->start_ns = start_ns;
+    job->num_chunks = num_chunks;
+    atomic_init(&job->remaining, num_chunks);
+    atomic_init(&job->state, JOB_PENDING);
+    atomic_init(&job->refs, 2);
+
+    aes_prio_t prio = opts && (opts->flags & AES_ASYNC_BULK) ? AES_PRIO_BULK : AES_PRIO_LATENCY;
+    for (size_t i = 0; i < num_chunks; i++) {
+        chunk_t* c = &job->chunks[i];
+        c->task.fn = chunk_run;
+        c->task.arg = NULL;
+        c->task.group = NULL;
+        c->job = job;
+        c->offset = i * chunk;
+        c->len = i == num_chunks - 1 ? len - c->offset : chunk;
+        // Once the last chunk is queued the job may complete at any time
+        aes_pool_submit_prio(pool, &c->task, prio);
+    }
+    return job;
+}
+
+int aes_async_done(aes_async_t* job) {
+    return atomic_load(&job->state) == JOB_DONE;
+}
+
+void aes_async_wait(aes_async_t* job) {
+    uint32_t seen = atomic_load(&job->state);
+    while (seen != JOB_DONE) {
+        if (seen == JOB_PENDING && !atomic_compare_exchange_weak(&job->state, &seen, JOB_WAITED)) {
+            continue;
+        }
+        futex_wait(&job->state, JOB_WAITED);
+        seen = atomic_load(&job->state);
+    }
+}
+
+int aes_async_fd(aes_async_t* job) {
+    return job->efd;
+}
+
+void aes_async_free(aes_async_t* job) {
+    if (job) {
+        job_release(job);
+    }
+}
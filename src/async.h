@@ -0,0 +1,71 @@
+#ifndef AES_ASYNC_H
+#define AES_ASYNC_H
+
+#include "aes.h"
+#include "pool.h"
+
+/**
+ * Non-blocking CTR on the worker pool. A submit call cuts the job into
+ * chunks, queues them and returns a handle at once; the worker that finishes
+ * the last chunk reports completion through any of a callback, an eventfd
+ * that becomes readable (for poll/epoll/io_uring loops) or the handle itself
+ * (aes_async_done, aes_async_wait). The submitting thread never encrypts, so
+ * an event loop can hand off large objects without stalling. See async.hpp
+ * for a C++20 awaitable on top of this.
+ */
+
+#define AES_ASYNC_CHUNK_MIN (64UL * 1024)           // jobs are cut into chunks of 64 KB..4 MB,
+#define AES_ASYNC_CHUNK_MAX (4UL * 1024 * 1024)     // at least one per worker where they fit
+
+#define AES_ASYNC_EVENTFD 1     // give the job an eventfd, see aes_async_fd
+#define AES_ASYNC_BULK 2        // queue the chunks as bulk-class pool work (see pool.h)
+
+typedef struct aes_async aes_async_t;
+
+/**
+ * Runs on the pool worker that completes the job, before the job counts as
+ * done for aes_async_done/aes_async_wait and its eventfd. Keep it short: it
+ * holds up that worker.
+ */
+typedef void (*aes_async_cb)(aes_async_t* job, void* arg);
+
+typedef struct {
+    aes_async_cb callback;      // optional
+    void* arg;
+    int flags;                  // AES_ASYNC_EVENTFD, AES_ASYNC_BULK
+} aes_async_opts_t;
+
+/**
+ * Queues len bytes from input to output (may be the same buffer); byte i
+ * uses keystream byte i of the CTR stream starting at initial_ctr. Both
+ * buffers and roundKey must stay valid until the job completes.
+ * pool: NULL for aes_pool_default()
+ * roundKey: serial key schedule from aes_keyexpansion_serial
+ * opts: NULL for no callback and no eventfd
+ * return: the job, to be released with aes_async_free, or NULL
+ *         with errno set (nothing was queued)
+ */
+aes_async_t* aesctr_enc_async(aes_pool_t* pool, const uint8_t* input, const uint8_t* roundKey, uint8_t* output,
+                              size_t len, const ctr_block_t* initial_ctr, const aes_async_opts_t* opts);
+
+// 1 once the job has completed and its output is visible to the caller; already so when the eventfd fires
+int aes_async_done(aes_async_t* job);
+
+// Blocks until aes_async_done; for shutdown paths and threads outside the loop
+void aes_async_wait(aes_async_t* job);
+
+/**
+ * Eventfd that turns readable on completion, for jobs submitted with
+ * AES_ASYNC_EVENTFD; owned and closed by the job.
+ * return: -1 otherwise
+ */
+int aes_async_fd(aes_async_t* job);
+
+/**
+ * Releases the caller's handle, from any thread including the callback. A
+ * job still running completes as usual (its buffers must stay valid until
+ * then) and is freed by the worker that finishes it.
+ */
+void aes_async_free(aes_async_t* job);
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef AES_ASYNC_HPP
+#define AES_ASYNC_HPP
+
+#include <cerrno>
+#include <coroutine>
+#include <system_error>
+#include <utility>
+
+extern "C" {
+#include "async.h"
+}
+
+/**
+ * C++20 front end for async.h: `co_await aes::ctr_async(...)` suspends the
+ * coroutine while the pool encrypts and resumes it once the job is done.
+ * By default the coroutine continues on the pool worker that finished the
+ * job, which only suits short continuations; a coroutine that belongs to an
+ * event loop passes a resume_on callable that posts the handle back to the
+ * loop thread instead. A failed submit resumes at once and throws
+ * std::system_error from the co_await.
+ */
+
+namespace aes {
+
+struct resume_inline {
+    void operator()(std::coroutine_handle<> handle) const { handle.resume(); }
+};
+
+template <typename Resume = resume_inline>
+class ctr_awaitable {
+public:
+    ctr_awaitable(aes_pool_t* pool, const uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t len,
+                  const ctr_block_t& initial_ctr, Resume resume_on)
+        : pool_(pool), input_(input), roundKey_(roundKey), output_(output), len_(len), ctr_(initial_ctr),
+          resume_on_(std::move(resume_on)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        handle_ = handle;
+        aes_async_opts_t opts = { &ctr_awaitable::completed, this, 0 };
+        if (!aesctr_enc_async(pool_, input_, roundKey_, output_, len_, &ctr_, &opts)) {
+            error_ = errno;
+            return false;
+        }
+        // The job may already have resumed the coroutine and destroyed *this
+        return true;
+    }
+
+    void await_resume() const {
+        if (error_) {
+            throw std::system_error(error_, std::generic_category(), "aesctr_enc_async");
+        }
+    }
+
+private:
+    static void completed(aes_async_t* job, void* arg) {
+        auto* self = static_cast<ctr_awaitable*>(arg);
+        std::coroutine_handle<> handle = self->handle_;
+        // Resuming may end the frame holding *self, so nothing is read from it afterwards
+        Resume resume_on = std::move(self->resume_on_);
+        aes_async_free(job);
+        resume_on(handle);
+    }
+
+    aes_pool_t* pool_;
+    const uint8_t* input_;
+    const uint8_t* roundKey_;
+    uint8_t* output_;
+    size_t len_;
+    ctr_block_t ctr_;
+    Resume resume_on_;
+    std::coroutine_handle<> handle_;
+    int error_ = 0;
+};
+
+/**
+ * Awaitable CTR of len bytes from input to output on the worker pool; see
+ * aesctr_enc_async for the arguments. Buffers must outlive the co_await.
+ * resume_on: called with the coroutine handle on the completing worker
+ */
+template <typename Resume = resume_inline>
+ctr_awaitable<Resume> ctr_async(aes_pool_t* pool, const uint8_t* input, const uint8_t* roundKey, uint8_t* output,
+                                size_t len, const ctr_block_t& initial_ctr, Resume resume_on = Resume{}) {
+    return ctr_awaitable<Resume>(pool, input, roundKey, output, len, initial_ctr, std::move(resume_on));
+}
+
+}  // namespace aes
+
+#endif
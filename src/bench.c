@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "bench.h"
+
+// Keeps the read kernel from being optimised away
+static volatile uint64_t bench_sink;
+
+double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void bench_cache_sizes(size_t* l1, size_t* l2, size_t* llc) {
+    long size;
+
+    size = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    *l1 = size > 0 ? (size_t)size : 32 * 1024;
+    size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    *l2 = size > 0 ? (size_t)size : 1024 * 1024;
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    *llc = size > 0 ? (size_t)size : *l2 * 8;
+}
+
+int bench_num_cpus() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static uint64_t read_kernel(const uint64_t* a, size_t words) {
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+
+    for(; i + 4 <= words; i += 4) {
+        s0 += a[i];
+        s1 += a[i + 1];
+        s2 += a[i + 2];
+        s3 += a[i + 3];
+    }
+    for(; i < words; i++) {
+        s0 += a[i];
+    }
+    return s0 + s1 + s2 + s3;
+}
+
+static void write_kernel(uint64_t* a, size_t words, uint64_t value) {
+    for(size_t i = 0; i < words; i++) {
+        a[i] = value;
+    }
+}
+
+// Runs one kernel (0 = read, 1 = write, 2 = copy) reps times, returns seconds
+static double run_stream_kernel(int kernel, uint8_t* a, uint8_t* b, size_t bytes,
+                                int num_threads, size_t reps) {
+    double start = bench_now();
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        size_t words = bytes / 8;
+        size_t begin = words * tid / nthreads;
+        size_t end = words * (tid + 1) / nthreads;
+        uint64_t* src = (uint64_t*)a + begin;
+        uint64_t* dst = (uint64_t*)b + begin;
+        uint64_t sum = 0;
+
+        for(size_t r = 0; r < reps; r++) {
+            if (kernel == 0) {
+                sum += read_kernel(src, end - begin);
+            } else if (kernel == 1) {
+                write_kernel(dst, end - begin, r);
+            } else {
+                memcpy(dst, src, (end - begin) * 8);
+            }
+        }
+        if (kernel == 0) {
+            bench_sink += sum;
+        }
+    }
+
+    return bench_now() - start;
+}
+
+static double measure_kernel(int kernel, uint8_t* a, uint8_t* b, size_t bytes,
+                             int num_threads, double min_seconds) {
+    // One untimed pass to fault pages in, then grow reps until the run is long enough
+    size_t reps = 1;
+    double elapsed = run_stream_kernel(kernel, a, b, bytes, num_threads, 1);
+
+    while ((elapsed = run_stream_kernel(kernel, a, b, bytes, num_threads, reps)) < min_seconds) {
+        reps *= elapsed > 0 ? (size_t)(min_seconds / elapsed) + 1 : 2;
+    }
+
+    double moved = (double)bytes * reps * (kernel == 2 ? 2 : 1);
+    return moved / elapsed / (1024.0 * 1024.0 * 1024.0);
+}
+
+void bench_stream(uint8_t* a, uint8_t* b, size_t bytes, int num_threads,
+                  double min_seconds, bench_stream_t* result) {
+    result->read_gbs = measure_kernel(0, a, b, bytes, num_threads, min_seconds);
+    result->write_gbs = measure_kernel(1, a, b, bytes, num_threads, min_seconds);
+    result->copy_gbs = measure_kernel(2, a, b, bytes, num_threads, min_seconds);
+}
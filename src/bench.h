@@ -0,0 +1,31 @@
+#ifndef AES_BENCH_H
+#define AES_BENCH_H
+
+#include "aes.h"
+
+// STREAM-style bandwidth in GB/s (1 GB = 2^30 bytes, as in the testers).
+// copy counts bytes read + bytes written, like STREAM does.
+typedef struct {
+    double read_gbs;
+    double write_gbs;
+    double copy_gbs;
+} bench_stream_t;
+
+// Monotonic wall clock in seconds
+double bench_now();
+
+// Data cache sizes in bytes, with conservative defaults when sysconf can't tell
+void bench_cache_sizes(size_t* l1, size_t* l2, size_t* llc);
+
+// Number of online CPUs
+int bench_num_cpus();
+
+/**
+ * Measures read/write/copy bandwidth over bytes-sized buffers a and b,
+ * split evenly across num_threads threads. Each kernel is repeated until
+ * it has run for at least min_seconds.
+ */
+void bench_stream(uint8_t* a, uint8_t* b, size_t bytes, int num_threads,
+                  double min_seconds, bench_stream_t* result);
+
+#endif
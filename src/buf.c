@@ -0,0 +1,341 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "buf.h"
+#include "affinity.h"
+
+#define FALLBACK_HUGE_PAGE (2UL * 1024 * 1024)
+
+typedef struct buf_entry {
+    uint8_t* base;
+    size_t mapped;              // length of the mapping, a multiple of its page size
+    aes_buf_kind_t kind;
+    int no_huge;                // allocated with AES_BUF_NO_HUGE, only reused for the same
+    struct buf_entry* next;
+} buf_entry_t;
+
+typedef struct {
+    uint8_t* start;
+    size_t len;
+    size_t page;
+    int thread_idx;
+} prefault_range_t;
+
+static pthread_mutex_t buf_lock = PTHREAD_MUTEX_INITIALIZER;
+static buf_entry_t* live;       // handed out
+static buf_entry_t* cached;     // freed, most recent first
+static size_t pool_limit = AES_BUF_DEFAULT_POOL_LIMIT;
+static aes_buf_stats_t buf_stats;
+
+static pthread_once_t page_once = PTHREAD_ONCE_INIT;
+static size_t huge_page;
+static int thp_disabled;
+
+static void probe_pages() {
+    char line[256];
+    FILE* f = fopen("/proc/meminfo", "r");
+    huge_page = FALLBACK_HUGE_PAGE;
+    if (f) {
+        unsigned long kb;
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1 && kb > 0) {
+                huge_page = kb * 1024;
+                break;
+            }
+        }
+        fclose(f);
+    }
+
+    f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (f) {
+        thp_disabled = fgets(line, sizeof(line), f) && strstr(line, "[never]");
+        fclose(f);
+    }
+}
+
+size_t aes_buf_huge_page_size() {
+    pthread_once(&page_once, probe_pages);
+    return huge_page;
+}
+
+const char* aes_buf_kind_name(aes_buf_kind_t kind) {
+    switch (kind) {
+        case AES_BUF_THP:     return "thp";
+        case AES_BUF_HUGETLB: return "hugetlb";
+        default:              return "4k";
+    }
+}
+
+static size_t round_up(size_t bytes, size_t unit) {
+    return (bytes + unit - 1) / unit * unit;
+}
+
+/**
+ * Maps `mapped` bytes (a multiple of align) starting on an align boundary by
+ * over-allocating and trimming the ends.
+ */
+static uint8_t* map_aligned(size_t mapped, size_t align) {
+    size_t over = mapped + align;
+    uint8_t* raw = (uint8_t*)mmap(NULL, over, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    uint8_t* base = (uint8_t*)round_up((uintptr_t)raw, align);
+    if (base > raw) {
+        munmap(raw, base - raw);
+    }
+    if (raw + over > base + mapped) {
+        munmap(base + mapped, raw + over - (base + mapped));
+    }
+    return base;
+}
+
+static int map_buffer(buf_entry_t* entry, size_t bytes, int no_huge) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t huge = aes_buf_huge_page_size();
+
+    if (!no_huge && bytes >= huge) {
+        entry->mapped = round_up(bytes, huge);
+        entry->base = (uint8_t*)mmap(NULL, entry->mapped, PROT_READ | PROT_WRITE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (entry->base != MAP_FAILED) {
+            entry->kind = AES_BUF_HUGETLB;
+            return 0;
+        }
+
+        // No reserved hugetlb pages: huge-page aligned anonymous memory, advised
+        entry->base = map_aligned(entry->mapped, huge);
+        if (!entry->base) {
+            return -1;
+        }
+        entry->kind = !thp_disabled && madvise(entry->base, entry->mapped, MADV_HUGEPAGE) == 0
+                      ? AES_BUF_THP : AES_BUF_PAGES;
+        return 0;
+    }
+
+    entry->mapped = round_up(bytes, page);
+    entry->base = (uint8_t*)mmap(NULL, entry->mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (entry->base == MAP_FAILED) {
+        return -1;
+    }
+    if (no_huge) {
+        madvise(entry->base, entry->mapped, MADV_NOHUGEPAGE);
+    }
+    entry->kind = AES_BUF_PAGES;
+    return 0;
+}
+
+static size_t mapped_size(size_t bytes, int no_huge) {
+    size_t huge = aes_buf_huge_page_size();
+    if (!no_huge && bytes >= huge) {
+        return round_up(bytes, huge);
+    }
+    return round_up(bytes, (size_t)sysconf(_SC_PAGESIZE));
+}
+
+static size_t entry_page(const buf_entry_t* entry) {
+    return entry->kind == AES_BUF_PAGES ? (size_t)sysconf(_SC_PAGESIZE) : aes_buf_huge_page_size();
+}
+
+static void* prefault_worker(void* arg) {
+    prefault_range_t* range = (prefault_range_t*)arg;
+    aes_pin_thread(range->thread_idx);
+
+    // A read-modify-write faults the page in writable and keeps its contents
+    for (size_t off = 0; off < range->len; off += range->page) {
+        volatile uint8_t* p = range->start + off;
+        *p = *p;
+    }
+    return NULL;
+}
+
+static void prefault_pages(uint8_t* start, size_t len, size_t page) {
+    pthread_t threads[AES_MAX_THREADS];
+    prefault_range_t ranges[AES_MAX_THREADS];
+    size_t num_pages = (len + page - 1) / page;
+    size_t num_threads = (size_t)aes_get_num_threads();
+    if (num_threads > num_pages) {
+        num_threads = num_pages;
+    }
+    if (num_threads == 0) {
+        return;
+    }
+
+    // Contiguous page ranges, in the same order the drivers split their blocks
+    size_t per_thread = num_pages / num_threads;
+    size_t first = 0;
+    size_t started = 0;
+    for (size_t i = 0; i < num_threads; i++) {
+        size_t count = i == num_threads - 1 ? num_pages - first : per_thread;
+        ranges[i].start = start + first * page;
+        ranges[i].len = i == num_threads - 1 ? len - first * page : count * page;
+        ranges[i].page = page;
+        ranges[i].thread_idx = (int)i;
+        first += count;
+
+        if (pthread_create(&threads[i], NULL, prefault_worker, &ranges[i]) != 0) {
+            break;
+        }
+        started++;
+    }
+
+    // Whatever could not get its own thread is faulted in here
+    for (size_t i = started; i < num_threads; i++) {
+        prefault_worker(&ranges[i]);
+    }
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+void aes_buf_prefault(void* buf, size_t bytes) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+    pthread_mutex_lock(&buf_lock);
+    for (buf_entry_t* e = live; e; e = e->next) {
+        if (e->base == buf) {
+            page = entry_page(e);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&buf_lock);
+
+    prefault_pages((uint8_t*)buf, bytes, page);
+}
+
+void* aes_buf_alloc(size_t bytes, int flags) {
+    int no_huge = (flags & AES_BUF_NO_HUGE) != 0;
+    buf_entry_t* entry = NULL;
+
+    if (bytes == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    size_t mapped = mapped_size(bytes, no_huge);
+    pthread_mutex_lock(&buf_lock);
+    for (buf_entry_t** link = &cached; *link; link = &(*link)->next) {
+        if ((*link)->mapped == mapped && (*link)->no_huge == no_huge) {
+            entry = *link;
+            *link = entry->next;
+            buf_stats.cached_bytes -= entry->mapped;
+            buf_stats.pool_hits++;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&buf_lock);
+
+    // Reused buffers were faulted in by their first owner
+    int fresh = entry == NULL;
+    if (fresh) {
+        entry = (buf_entry_t*)calloc(1, sizeof(buf_entry_t));
+        if (!entry) {
+            return NULL;
+        }
+        if (map_buffer(entry, bytes, no_huge) != 0) {
+            free(entry);
+            errno = ENOMEM;
+            return NULL;
+        }
+        entry->no_huge = no_huge;
+    }
+
+    if (fresh && (flags & AES_BUF_PREFAULT)) {
+        prefault_pages(entry->base, entry->mapped, entry_page(entry));
+    }
+
+    pthread_mutex_lock(&buf_lock);
+    entry->next = live;
+    live = entry;
+    buf_stats.allocs++;
+    buf_stats.live_bytes += entry->mapped;
+    pthread_mutex_unlock(&buf_lock);
+
+    return entry->base;
+}
+
+void aes_buf_free(void* buf) {
+    buf_entry_t* entry = NULL;
+
+    if (!buf) {
+        return;
+    }
+
+    pthread_mutex_lock(&buf_lock);
+    for (buf_entry_t** link = &live; *link; link = &(*link)->next) {
+        if ((*link)->base == buf) {
+            entry = *link;
+            *link = entry->next;
+            buf_stats.live_bytes -= entry->mapped;
+            break;
+        }
+    }
+    if (entry && buf_stats.cached_bytes + entry->mapped <= pool_limit) {
+        entry->next = cached;
+        cached = entry;
+        buf_stats.cached_bytes += entry->mapped;
+        entry = NULL;
+    }
+    pthread_mutex_unlock(&buf_lock);
+
+    if (entry) {
+        munmap(entry->base, entry->mapped);
+        free(entry);
+    }
+}
+
+aes_buf_kind_t aes_buf_kind(const void* buf) {
+    aes_buf_kind_t kind = AES_BUF_PAGES;
+
+    pthread_mutex_lock(&buf_lock);
+    for (buf_entry_t* e = live; e; e = e->next) {
+        if (e->base == buf) {
+            kind = e->kind;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&buf_lock);
+    return kind;
+}
+
+size_t aes_buf_get_pool_limit() {
+    return pool_limit;
+}
+
+void aes_buf_set_pool_limit(size_t bytes) {
+    pthread_mutex_lock(&buf_lock);
+    pool_limit = bytes;
+    int trim = buf_stats.cached_bytes > bytes;
+    pthread_mutex_unlock(&buf_lock);
+    if (trim) {
+        aes_buf_pool_trim();
+    }
+}
+
+void aes_buf_pool_trim() {
+    pthread_mutex_lock(&buf_lock);
+    buf_entry_t* entry = cached;
+    cached = NULL;
+    buf_stats.cached_bytes = 0;
+    pthread_mutex_unlock(&buf_lock);
+
+    while (entry) {
+        buf_entry_t* next = entry->next;
+        munmap(entry->base, entry->mapped);
+        free(entry);
+        entry = next;
+    }
+}
+
+void aes_buf_get_stats(aes_buf_stats_t* stats) {
+    pthread_mutex_lock(&buf_lock);
+    *stats = buf_stats;
+    pthread_mutex_unlock(&buf_lock);
+}
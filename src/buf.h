@@ -0,0 +1,68 @@
+#ifndef AES_BUF_H
+#define AES_BUF_H
+
+#include "aes.h"
+
+/**
+ * Page-backed buffers for bulk jobs. Buffers of at least one huge page come
+ * from the hugetlb pool when the kernel has pages reserved, otherwise from
+ * transparent huge pages via madvise, so the kernels take fewer TLB misses and
+ * page faults than on malloc'd 4 KB pages. Freed buffers are kept in a small
+ * cache and handed out again for the same size, which suits services that see
+ * the same job sizes over and over.
+ */
+
+#define AES_BUF_ALIGN 64                            // guaranteed minimum; every buffer is in fact page aligned
+#define AES_BUF_DEFAULT_POOL_LIMIT (1UL << 30)      // bytes kept for reuse after aes_buf_free
+
+// aes_buf_alloc flags
+#define AES_BUF_PREFAULT 1      // fault every page in from pinned worker threads before returning
+#define AES_BUF_NO_HUGE  2      // plain 4 KB pages, for comparison
+
+typedef enum {
+    AES_BUF_PAGES = 0,          // regular pages
+    AES_BUF_THP,                // transparent huge pages requested with MADV_HUGEPAGE
+    AES_BUF_HUGETLB             // explicit MAP_HUGETLB pages
+} aes_buf_kind_t;
+
+typedef struct {
+    uint64_t allocs;            // aes_buf_alloc calls that returned a buffer
+    uint64_t pool_hits;         // of those, served from the cache
+    size_t live_bytes;          // mapped bytes handed out and not yet freed
+    size_t cached_bytes;        // mapped bytes waiting in the cache
+} aes_buf_stats_t;
+
+/**
+ * bytes: must be non-zero; rounded up to the page size of the backing
+ * flags: AES_BUF_* or 0
+ * return: buffer, or NULL with errno set. A fresh buffer reads as zero; one
+ *         reused from the cache holds whatever its previous owner left.
+ */
+void* aes_buf_alloc(size_t bytes, int flags);
+
+// Returns buf to the cache, or unmaps it when the cache is full. NULL is ignored.
+void aes_buf_free(void* buf);
+
+aes_buf_kind_t aes_buf_kind(const void* buf);
+const char* aes_buf_kind_name(aes_buf_kind_t kind);
+
+// Default huge page size from /proc/meminfo, 2 MB if it can't be read
+size_t aes_buf_huge_page_size();
+
+/**
+ * Faults in every page of [buf, buf + bytes) without changing its contents,
+ * splitting the range across aes_get_num_threads() threads pinned as the
+ * drivers pin theirs, so on NUMA hosts each range lands near its worker.
+ */
+void aes_buf_prefault(void* buf, size_t bytes);
+
+// 0 disables the cache
+size_t aes_buf_get_pool_limit();
+void aes_buf_set_pool_limit(size_t bytes);
+
+// Unmaps every cached buffer
+void aes_buf_pool_trim();
+
+void aes_buf_get_stats(aes_buf_stats_t* stats);
+
+#endif
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "burst.h"
+#include "dispatch.h"
+#include "ctrbatch.h"
+#include "affinity.h"
+#include "stats.h"
+#include "trace.h"
+
+typedef struct {
+    aes_task_t task;
+    aes_packet_t* pkts;
+    int count;
+    const uint8_t* roundKey;
+    uint64_t salt;
+    aes_ecb_fn ecb;
+    aesctr_bulk_fn bulk;
+} burst_range_t;
+
+static void packet_ctr(uint64_t salt, uint64_t seq, ctr_block_t* ctr) {
+    uint64_t nonce = salt ^ __builtin_bswap64(seq);
+    memcpy(ctr->nonce, &nonce, 8);
+    memset(ctr->counter, 0, sizeof(ctr->counter));
+}
+
+static void packet_item(void* ctx, size_t i, aes_ctrbatch_item_t* item) {
+    const burst_range_t* range = (const burst_range_t*)ctx;
+    const aes_packet_t* pkt = &range->pkts[i];
+
+    item->src = pkt->src;
+    item->dst = pkt->dst;
+    item->len = pkt->len;
+    item->roundKey = range->roundKey;
+    packet_ctr(range->salt, pkt->seq, &item->ctr);
+}
+
+static void burst_run(burst_range_t* range) {
+    aes_ctrbatch_run(range, range->count, packet_item, range->ecb, range->bulk);
+}
+
+static void burst_range_run(aes_task_t* task, int worker_idx) {
+    burst_range_t* range = (burst_range_t*)task;
+    (void)worker_idx;
+
+    AES_TRACE(AES_TRACE_CHUNK_BEGIN, "burst", range->count);
+    burst_run(range);
+    AES_TRACE(AES_TRACE_CHUNK_END, "burst", 0);
+}
+
+static void init_range(burst_range_t* range, aes_packet_t* pkts, int count, const uint8_t* roundKey,
+                       const uint8_t salt[8], aes_ecb_fn ecb, aesctr_bulk_fn bulk) {
+    range->pkts = pkts;
+    range->count = count;
+    range->roundKey = roundKey;
+    memcpy(&range->salt, salt, 8);
+    range->ecb = ecb;
+    range->bulk = bulk;
+}
+
+static size_t burst_bytes(const aes_packet_t* pkts, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += pkts[i].len;
+    }
+    return total;
+}
+
+void aes_packet_ctr(const uint8_t salt[8], uint64_t seq, ctr_block_t* ctr) {
+    uint64_t salt64;
+    memcpy(&salt64, salt, 8);
+    packet_ctr(salt64, seq, ctr);
+}
+
+size_t aesctr_enc_burst(aes_packet_t* pkts, int count, const uint8_t* roundKey, const uint8_t salt[8]) {
+    uint64_t start_ns = aes_stats_now_ns();
+    size_t total = burst_bytes(pkts, count);
+    burst_range_t range;
+
+    init_range(&range, pkts, count, roundKey, salt, aes_select_ecb_kernel(NULL), aes_select_bulk_kernel(NULL));
+    burst_run(&range);
+
+    aes_stats_record(AES_BACKEND_BURST, total, aes_stats_now_ns() - start_ns);
+    return total;
+}
+
+size_t aesctr_enc_burst_pool(aes_pool_t* pool, aes_packet_t* pkts, int count, const uint8_t* roundKey,
+                             const uint8_t salt[8]) {
+    size_t total = burst_bytes(pkts, count);
+
+    if (!pool) {
+        pool = aes_pool_default();
+    }
+    int num_threads = aes_pool_num_threads(pool);
+    if (total < AES_BURST_PARALLEL_MIN || num_threads == 1) {
+        return aesctr_enc_burst(pkts, count, roundKey, salt);
+    }
+
+    burst_range_t ranges[AES_MAX_THREADS];
+    aes_taskgroup_t group;
+    uint64_t start_ns = aes_stats_now_ns();
+    aes_ecb_fn ecb = aes_select_ecb_kernel(NULL);
+    aesctr_bulk_fn bulk = aes_select_bulk_kernel(NULL);
+    size_t per_thread = total / num_threads;
+    size_t done = 0;
+    int first = 0;
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "burst", total);
+    aes_taskgroup_init(&group);
+    for (int i = 0; i < num_threads && first < count; i++) {
+        // Whole packets until this range's share of the bytes is reached
+        int end = first;
+        size_t target = i == num_threads - 1 ? total : (i + 1) * per_thread;
+        while (end < count && (done < target || end == first)) {
+            done += pkts[end++].len;
+        }
+        if (i == num_threads - 1) {
+            end = count;
+        }
+        init_range(&ranges[i], pkts + first, end - first, roundKey, salt, ecb, bulk);
+        ranges[i].task.fn = burst_range_run;
+        ranges[i].task.arg = NULL;
+        ranges[i].task.group = &group;
+        aes_pool_submit(pool, &ranges[i].task);
+        first = end;
+    }
+    aes_taskgroup_wait(&group);
+    aes_taskgroup_destroy(&group);
+    AES_TRACE(AES_TRACE_JOB_END, "burst", 0);
+
+    aes_stats_record(AES_BACKEND_BURST, total, aes_stats_now_ns() - start_ns);
+    return total;
+}
@@ -0,0 +1,47 @@
+#ifndef AES_BURST_H
+#define AES_BURST_H
+
+#include "aes.h"
+#include "pool.h"
+
+/**
+ * Burst encryption of many short packets under one key, each with its own
+ * IV. Rather than one kernel call (and its setup) per packet, the counter
+ * blocks of every packet in the burst are laid out back to back, encrypted
+ * as one list by the widest ECB kernel (see dispatch.h) and XORed into the
+ * packets, so even 64-byte packets keep all AES lanes busy.
+ */
+
+#define AES_BURST_PARALLEL_MIN (256UL * 1024)   // bursts smaller than this stay on the calling thread
+
+typedef struct {
+    uint64_t seq;               // per-packet sequence number, unique under the key
+    const uint8_t* src;
+    uint8_t* dst;               // may equal src
+    size_t len;                 // any length, including 0
+} aes_packet_t;
+
+/**
+ * Counter block of a packet's first block: nonce = salt XOR big-endian seq,
+ * counter = 0. Block j of the packet uses counter j. The same derivation as
+ * the burst functions, for callers that handle a packet on its own.
+ */
+void aes_packet_ctr(const uint8_t salt[8], uint64_t seq, ctr_block_t* ctr);
+
+/**
+ * Encrypts (or decrypts) every packet with the counter stream from
+ * aes_packet_ctr(salt, seq).
+ * roundKey: serial key schedule from aes_keyexpansion_serial
+ * return: total bytes processed
+ */
+size_t aesctr_enc_burst(aes_packet_t* pkts, int count, const uint8_t* roundKey, const uint8_t salt[8]);
+
+/**
+ * As aesctr_enc_burst, with bursts of at least AES_BURST_PARALLEL_MIN bytes
+ * split into runs of whole packets of about equal size, one per pool worker.
+ * pool: NULL for aes_pool_default()
+ */
+size_t aesctr_enc_burst_pool(aes_pool_t* pool, aes_packet_t* pkts, int count, const uint8_t* roundKey,
+                             const uint8_t salt[8]);
+
+#endif
@@ -0,0 +1,146 @@
+// Built without -maes so callers can dispatch at runtime
+#pragma GCC target("sse4.1,aes")
+
+#include <pthread.h>
+#include <wmmintrin.h>
+#include <smmintrin.h>
+
+#include "cmac.h"
+#include "aesni.h"
+
+static void encrypt_block(const uint8_t* roundKey, const uint8_t* in, uint8_t* out) {
+    uint8_t block[16];
+    memcpy(block, in, 16);
+    aes_enc1block_serial(block, roundKey, out);
+}
+
+// Doubling in GF(2^128), the subkey derivation of RFC 4493 section 2.3
+static void dbl(const uint8_t* in, uint8_t* out) {
+    uint8_t carry = in[0] >> 7;
+    for (int i = 0; i < 15; i++) {
+        out[i] = (uint8_t)(in[i] << 1 | in[i + 1] >> 7);
+    }
+    out[15] = (uint8_t)(in[15] << 1) ^ (carry ? 0x87 : 0);
+}
+
+void aes_cmac_key_init(aes_cmac_key_t* key, const uint8_t* roundKey) {
+    uint8_t zero[16] = {0};
+    uint8_t l[16];
+
+    key->roundKey = roundKey;
+    encrypt_block(roundKey, zero, l);
+    dbl(l, key->k1);
+    dbl(key->k1, key->k2);
+}
+
+/**
+ * x = E(x ^ block) over num_blocks whole blocks. One block at a time either
+ * way: every step needs the previous one's output.
+ */
+static void cbc_mac_aesni(const uint8_t* roundKey, uint8_t* x, const uint8_t* data, size_t num_blocks) {
+    __m128i rk[Nr + 1];
+    for (int r = 0; r <= Nr; r++) {
+        rk[r] = _mm_loadu_si128((const __m128i*)(roundKey + 16 * r));
+    }
+
+    __m128i state = _mm_loadu_si128((const __m128i*)x);
+    for (size_t i = 0; i < num_blocks; i++) {
+        state = _mm_xor_si128(state, _mm_loadu_si128((const __m128i*)(data + 16 * i)));
+        state = _mm_xor_si128(state, rk[0]);
+        for (int r = 1; r < Nr; r++) {
+            state = _mm_aesenc_si128(state, rk[r]);
+        }
+        state = _mm_aesenclast_si128(state, rk[Nr]);
+    }
+    _mm_storeu_si128((__m128i*)x, state);
+}
+
+static void cbc_mac_serial(const uint8_t* roundKey, uint8_t* x, const uint8_t* data, size_t num_blocks) {
+    for (size_t i = 0; i < num_blocks; i++) {
+        for (int j = 0; j < 16; j++) {
+            x[j] ^= data[16 * i + j];
+        }
+        encrypt_block(roundKey, x, x);
+    }
+}
+
+static pthread_once_t probe_once = PTHREAD_ONCE_INIT;
+static int have_aesni;
+
+static void probe_cpu() {
+    have_aesni = check_aesni_support();
+}
+
+static void cbc_mac(const uint8_t* roundKey, uint8_t* x, const uint8_t* data, size_t num_blocks) {
+    pthread_once(&probe_once, probe_cpu);
+    if (have_aesni) {
+        cbc_mac_aesni(roundKey, x, data, num_blocks);
+    } else {
+        cbc_mac_serial(roundKey, x, data, num_blocks);
+    }
+}
+
+void aes_cmac_begin(aes_cmac_ctx_t* ctx, const aes_cmac_key_t* key) {
+    ctx->key = key;
+    memset(ctx->x, 0, sizeof(ctx->x));
+    ctx->buf_len = 0;
+}
+
+void aes_cmac_update(aes_cmac_ctx_t* ctx, const uint8_t* data, size_t len) {
+    // The last block gets a subkey, so a full buffer is only flushed once more data follows
+    if (ctx->buf_len > 0) {
+        size_t take = 16 - ctx->buf_len;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(ctx->buf + ctx->buf_len, data, take);
+        ctx->buf_len += take;
+        data += take;
+        len -= take;
+        if (len == 0) {
+            return;
+        }
+        cbc_mac(ctx->key->roundKey, ctx->x, ctx->buf, 1);
+        ctx->buf_len = 0;
+    }
+
+    if (len > 16) {
+        size_t num_blocks = (len - 1) / 16;
+        cbc_mac(ctx->key->roundKey, ctx->x, data, num_blocks);
+        data += num_blocks * 16;
+        len -= num_blocks * 16;
+    }
+
+    memcpy(ctx->buf, data, len);
+    ctx->buf_len = len;
+}
+
+void aes_cmac_final(aes_cmac_ctx_t* ctx, uint8_t tag[AES_CMAC_TAG_SIZE]) {
+    const uint8_t* subkey = ctx->key->k1;
+
+    if (ctx->buf_len < 16) {
+        memset(ctx->buf + ctx->buf_len, 0, 16 - ctx->buf_len);
+        ctx->buf[ctx->buf_len] = 0x80;
+        subkey = ctx->key->k2;
+    }
+    for (int i = 0; i < 16; i++) {
+        ctx->buf[i] ^= subkey[i];
+    }
+    cbc_mac(ctx->key->roundKey, ctx->x, ctx->buf, 1);
+    memcpy(tag, ctx->x, AES_CMAC_TAG_SIZE);
+}
+
+void aes_cmac(const aes_cmac_key_t* key, const uint8_t* data, size_t len, uint8_t tag[AES_CMAC_TAG_SIZE]) {
+    aes_cmac_ctx_t ctx;
+    aes_cmac_begin(&ctx, key);
+    aes_cmac_update(&ctx, data, len);
+    aes_cmac_final(&ctx, tag);
+}
+
+int aes_cmac_equal(const uint8_t* a, const uint8_t* b) {
+    uint8_t diff = 0;
+    for (int i = 0; i < AES_CMAC_TAG_SIZE; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
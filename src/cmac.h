@@ -0,0 +1,40 @@
+#ifndef AES_CMAC_H
+#define AES_CMAC_H
+
+#include "aes.h"
+
+/**
+ * AES-128-CMAC (RFC 4493, NIST SP 800-38B). The chaining is inherently
+ * serial, so the CBC loop runs on single-block AES-NI when the CPU has it and
+ * on the serial cipher otherwise; parallelism comes from MACing independent
+ * messages (e.g. container chunks) on different threads.
+ */
+
+#define AES_CMAC_TAG_SIZE 16
+
+typedef struct {
+    const uint8_t* roundKey;    // serial key schedule from aes_keyexpansion_serial, not copied
+    uint8_t k1[16];             // subkeys for a complete / padded last block
+    uint8_t k2[16];
+} aes_cmac_key_t;
+
+// Incremental state; holds back the last block until final
+typedef struct {
+    const aes_cmac_key_t* key;
+    uint8_t x[16];
+    uint8_t buf[16];
+    size_t buf_len;
+} aes_cmac_ctx_t;
+
+void aes_cmac_key_init(aes_cmac_key_t* key, const uint8_t* roundKey);
+
+void aes_cmac_begin(aes_cmac_ctx_t* ctx, const aes_cmac_key_t* key);
+void aes_cmac_update(aes_cmac_ctx_t* ctx, const uint8_t* data, size_t len);
+void aes_cmac_final(aes_cmac_ctx_t* ctx, uint8_t tag[AES_CMAC_TAG_SIZE]);
+
+void aes_cmac(const aes_cmac_key_t* key, const uint8_t* data, size_t len, uint8_t tag[AES_CMAC_TAG_SIZE]);
+
+// Constant-time comparison of two tags; return: 1 if equal
+int aes_cmac_equal(const uint8_t* a, const uint8_t* b);
+
+#endif
@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "coalesce.h"
+#include "dispatch.h"
+#include "ctrbatch.h"
+#include "affinity.h"
+#include "stats.h"
+#include "trace.h"
+
+struct aes_coalescer {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        // for the coalescer thread
+    aes_creq_t* head;
+    aes_creq_t* tail;
+    size_t pending;
+    size_t pending_bytes;
+    int flush_now;
+    int stop;
+    pthread_t thread;
+
+    aes_pool_t* pool;
+    uint64_t deadline_ns;
+    size_t max_requests;
+    size_t max_bytes;
+    aes_ecb_fn ecb;
+    aesctr_bulk_fn bulk;
+
+    aes_creq_t** batch;         // the batch being run, max_requests long; coalescer thread only
+    aes_coalesce_stats_t stats;
+};
+
+typedef struct {
+    aes_task_t task;
+    aes_creq_t** reqs;
+    size_t count;
+    aes_ecb_fn ecb;
+    aesctr_bulk_fn bulk;
+} creq_range_t;
+
+static void creq_item(void* ctx, size_t i, aes_ctrbatch_item_t* item) {
+    const aes_creq_t* req = ((const creq_range_t*)ctx)->reqs[i];
+
+    item->src = req->src;
+    item->dst = req->dst;
+    item->len = req->len;
+    item->roundKey = req->roundKey;
+    item->ctr = req->ctr;
+}
+
+static void range_run(const creq_range_t* range) {
+    aes_ctrbatch_run((void*)range, range->count, creq_item, range->ecb, range->bulk);
+    for (size_t i = 0; i < range->count; i++) {
+        aes_creq_t* req = range->reqs[i];
+        req->done(req, req->arg);
+    }
+}
+
+static void range_task_run(aes_task_t* task, int worker_idx) {
+    creq_range_t* range = (creq_range_t*)task;
+    (void)worker_idx;
+
+    AES_TRACE(AES_TRACE_CHUNK_BEGIN, "coalesce", range->count);
+    range_run(range);
+    AES_TRACE(AES_TRACE_CHUNK_END, "coalesce", 0);
+}
+
+// Groups requests by key, so runs under one key fill whole ECB calls
+static int cmp_key(const void* a, const void* b) {
+    uintptr_t x = (uintptr_t)(*(aes_creq_t* const*)a)->roundKey;
+    uintptr_t y = (uintptr_t)(*(aes_creq_t* const*)b)->roundKey;
+    return x < y ? -1 : x > y;
+}
+
+static void run_batch(aes_coalescer_t* c, size_t count, size_t bytes) {
+    uint64_t start_ns = aes_stats_now_ns();
+    int num_threads = aes_pool_num_threads(c->pool);
+
+    qsort(c->batch, count, sizeof(aes_creq_t*), cmp_key);
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "coalesce", bytes);
+
+    if (bytes < AES_COALESCE_PARALLEL_MIN || num_threads == 1) {
+        creq_range_t range = { .reqs = c->batch, .count = count, .ecb = c->ecb, .bulk = c->bulk };
+        range_run(&range);
+    } else {
+        // Ranges of about equal bytes, cut between requests
+        creq_range_t ranges[AES_MAX_THREADS];
+        aes_taskgroup_t group;
+        size_t per_thread = bytes / num_threads;
+        size_t first = 0;
+
+        aes_taskgroup_init(&group);
+        for (int t = 0; t < num_threads && first < count; t++) {
+            size_t last = first, got = 0;
+            while (last < count && (got < per_thread || t == num_threads - 1)) {
+                got += c->batch[last++]->len;
+            }
+            ranges[t].task.fn = range_task_run;
+            ranges[t].task.arg = NULL;
+            ranges[t].task.group = &group;
+            ranges[t].reqs = c->batch + first;
+            ranges[t].count = last - first;
+            ranges[t].ecb = c->ecb;
+            ranges[t].bulk = c->bulk;
+            aes_pool_submit(c->pool, &ranges[t].task);
+            first = last;
+        }
+        AES_TRACE(AES_TRACE_JOIN_BEGIN, NULL, 0);
+        aes_taskgroup_wait(&group);
+        AES_TRACE(AES_TRACE_JOIN_END, NULL, 0);
+        aes_taskgroup_destroy(&group);
+    }
+
+    AES_TRACE(AES_TRACE_JOB_END, "coalesce", 0);
+    aes_stats_record(AES_BACKEND_COALESCE, bytes, aes_stats_now_ns() - start_ns);
+}
+
+static void wait_until(aes_coalescer_t* c, uint64_t ns) {
+    struct timespec ts = { (time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL) };
+    pthread_cond_timedwait(&c->wake, &c->lock, &ts);
+}
+
+static int batch_full(const aes_coalescer_t* c) {
+    return c->pending >= c->max_requests || c->pending_bytes >= c->max_bytes;
+}
+
+static void* coalescer_main(void* arg) {
+    aes_coalescer_t* c = (aes_coalescer_t*)arg;
+
+    pthread_mutex_lock(&c->lock);
+    for (;;) {
+        if (!c->head) {
+            if (c->stop) {
+                break;
+            }
+            c->flush_now = 0;
+            pthread_cond_wait(&c->wake, &c->lock);
+            continue;
+        }
+
+        uint64_t now = aes_stats_now_ns();
+        int full = batch_full(c);
+        int due = now >= c->head->queued_ns + c->deadline_ns;
+        if (!full && !due && !c->flush_now && !c->stop) {
+            wait_until(c, c->head->queued_ns + c->deadline_ns);
+            continue;
+        }
+
+        // Take up to one batch's worth; anything beyond waits for the next round
+        size_t count = 0, bytes = 0;
+        while (c->head && count < c->max_requests && bytes < c->max_bytes) {
+            aes_creq_t* req = c->head;
+            c->head = req->next;
+            c->batch[count++] = req;
+            bytes += req->len;
+            c->stats.wait_ns += now - req->queued_ns;
+        }
+        if (!c->head) {
+            c->tail = NULL;
+            c->flush_now = 0;
+        }
+        c->pending -= count;
+        c->pending_bytes -= bytes;
+
+        c->stats.batches++;
+        if (count > c->stats.max_batch) c->stats.max_batch = count;
+        if (full) {
+            c->stats.full_flushes++;
+        } else if (due) {
+            c->stats.deadline_flushes++;
+        }
+        int bucket = 63 - __builtin_clzll(count);
+        c->stats.batch_hist[bucket < AES_COALESCE_HIST ? bucket : AES_COALESCE_HIST - 1]++;
+        pthread_mutex_unlock(&c->lock);
+
+        run_batch(c, count, bytes);
+        pthread_mutex_lock(&c->lock);
+    }
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+aes_coalescer_t* aes_coalescer_create(const aes_coalesce_opts_t* opts) {
+    aes_coalescer_t* c = (aes_coalescer_t*)calloc(1, sizeof(aes_coalescer_t));
+    if (!c) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    c->deadline_ns = (uint64_t)(opts && opts->deadline_us ? opts->deadline_us : AES_COALESCE_DEFAULT_DEADLINE_US) * 1000;
+    c->max_requests = opts && opts->max_requests ? opts->max_requests : AES_COALESCE_DEFAULT_MAX_REQUESTS;
+    c->max_bytes = opts && opts->max_bytes ? opts->max_bytes : AES_COALESCE_DEFAULT_MAX_BYTES;
+    c->pool = opts && opts->pool ? opts->pool : aes_pool_default();
+    c->ecb = aes_select_ecb_kernel(NULL);
+    c->bulk = aes_select_bulk_kernel(NULL);
+    c->batch = (aes_creq_t**)malloc(c->max_requests * sizeof(aes_creq_t*));
+    if (!c->pool || !c->batch) {
+        free(c->batch);
+        free(c);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // The deadline is a CLOCK_MONOTONIC time, like aes_stats_now_ns
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&c->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&c->lock, NULL);
+
+    int err = pthread_create(&c->thread, NULL, coalescer_main, c);
+    if (err) {
+        pthread_cond_destroy(&c->wake);
+        pthread_mutex_destroy(&c->lock);
+        free(c->batch);
+        free(c);
+        errno = err;
+        return NULL;
+    }
+    return c;
+}
+
+int aes_coalesce_submit(aes_coalescer_t* c, aes_creq_t* req) {
+    if (!req->done) {
+        errno = EINVAL;
+        return -1;
+    }
+    req->next = NULL;
+    req->queued_ns = aes_stats_now_ns();
+
+    pthread_mutex_lock(&c->lock);
+    if (c->stop) {
+        pthread_mutex_unlock(&c->lock);
+        errno = ESHUTDOWN;
+        return -1;
+    }
+    int was_empty = !c->head;
+    if (c->tail) {
+        c->tail->next = req;
+    } else {
+        c->head = req;
+    }
+    c->tail = req;
+    c->pending++;
+    c->pending_bytes += req->len;
+    c->stats.requests++;
+    c->stats.bytes += req->len;
+
+    // The thread only needs waking to start a deadline or to issue a full batch early
+    if (was_empty || c->pending == c->max_requests ||
+        (c->pending_bytes >= c->max_bytes && c->pending_bytes - req->len < c->max_bytes)) {
+        pthread_cond_signal(&c->wake);
+    }
+    pthread_mutex_unlock(&c->lock);
+    return 0;
+}
+
+void aes_coalesce_flush(aes_coalescer_t* c) {
+    pthread_mutex_lock(&c->lock);
+    if (c->head) {
+        c->flush_now = 1;
+        pthread_cond_signal(&c->wake);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+void aes_coalescer_get_stats(aes_coalescer_t* c, aes_coalesce_stats_t* stats) {
+    pthread_mutex_lock(&c->lock);
+    *stats = c->stats;
+    pthread_mutex_unlock(&c->lock);
+}
+
+void aes_coalescer_destroy(aes_coalescer_t* c) {
+    pthread_mutex_lock(&c->lock);
+    c->stop = 1;
+    pthread_cond_signal(&c->wake);
+    pthread_mutex_unlock(&c->lock);
+    pthread_join(c->thread, NULL);
+
+    pthread_cond_destroy(&c->wake);
+    pthread_mutex_destroy(&c->lock);
+    free(c->batch);
+    free(c);
+}
@@ -0,0 +1,90 @@
+#ifndef AES_COALESCE_H
+#define AES_COALESCE_H
+
+#include "aes.h"
+#include "pool.h"
+
+/**
+ * Request coalescing for many small, independent CTR calls. Requests are
+ * queued as they arrive and issued together once the batch reaches a size
+ * or byte limit, or once its oldest request has waited for the deadline,
+ * whichever comes first. A batch is sorted by key, its counter blocks are
+ * laid out back to back and turned into keystream by the ECB kernel (see
+ * dispatch.h) a few KB at a time, so tiny requests share kernel calls
+ * instead of paying for one each; large batches are split across the worker
+ * pool. Every request completes on its own through its callback.
+ *
+ * The deadline bounds the latency a request can pick up from waiting; the
+ * limits bound how much work a batch carries. Shorter deadlines and smaller
+ * batches favour latency, longer ones throughput.
+ */
+
+#define AES_COALESCE_DEFAULT_DEADLINE_US 50
+#define AES_COALESCE_DEFAULT_MAX_REQUESTS 256
+#define AES_COALESCE_DEFAULT_MAX_BYTES (256UL * 1024)
+#define AES_COALESCE_PARALLEL_MIN (256UL * 1024)   // smaller batches run on the coalescer's own thread
+#define AES_COALESCE_HIST 16                        // batch size histogram: bucket i holds sizes [2^i, 2^(i+1))
+
+typedef struct aes_coalescer aes_coalescer_t;
+typedef struct aes_creq aes_creq_t;
+
+// Runs once the request's output is written, on the coalescer thread or a pool worker
+typedef void (*aes_creq_cb)(aes_creq_t* req, void* arg);
+
+/**
+ * Caller-owned; the request and its buffers must stay valid until the
+ * callback has been called. Byte i of src is XORed with keystream byte i of
+ * the CTR stream starting at ctr.
+ */
+struct aes_creq {
+    const uint8_t* src;
+    uint8_t* dst;               // may equal src
+    size_t len;
+    const uint8_t* roundKey;    // serial key schedule from aes_keyexpansion_serial; keys may differ per request
+    ctr_block_t ctr;
+    aes_creq_cb done;
+    void* arg;
+    aes_creq_t* next;           // queue link, owned by the coalescer
+    uint64_t queued_ns;         // owned by the coalescer
+};
+
+typedef struct {
+    unsigned deadline_us;       // 0 for AES_COALESCE_DEFAULT_DEADLINE_US
+    size_t max_requests;        // 0 for AES_COALESCE_DEFAULT_MAX_REQUESTS
+    size_t max_bytes;           // 0 for AES_COALESCE_DEFAULT_MAX_BYTES
+    aes_pool_t* pool;           // NULL for aes_pool_default()
+} aes_coalesce_opts_t;
+
+typedef struct {
+    uint64_t requests;
+    uint64_t bytes;
+    uint64_t batches;
+    uint64_t max_batch;         // requests
+    uint64_t full_flushes;      // batches issued on a size or byte limit
+    uint64_t deadline_flushes;  // batches issued on the deadline
+    uint64_t wait_ns;           // total time requests spent queued before their batch started
+    uint64_t batch_hist[AES_COALESCE_HIST];
+} aes_coalesce_stats_t;
+
+/**
+ * Starts the coalescer thread.
+ * opts: NULL for defaults
+ * return: NULL with errno set on failure
+ */
+aes_coalescer_t* aes_coalescer_create(const aes_coalesce_opts_t* opts);
+
+/**
+ * Queues a request; never blocks on encryption.
+ * return: -1 with errno EINVAL if req has no callback, ESHUTDOWN while destroying
+ */
+int aes_coalesce_submit(aes_coalescer_t* c, aes_creq_t* req);
+
+// Issues whatever is queued now, without waiting for the deadline
+void aes_coalesce_flush(aes_coalescer_t* c);
+
+void aes_coalescer_get_stats(aes_coalescer_t* c, aes_coalesce_stats_t* stats);
+
+// Completes every queued request, then stops the thread
+void aes_coalescer_destroy(aes_coalescer_t* c);
+
+#endif
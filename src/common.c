@@ -1,6 +1,9 @@
+#include <ctype.h>
+#include <errno.h>
+
 #include "aes.h"
 
-inline void set_counter_value(uint8_t* counter, uint64_t value) {
+static inline void set_counter_value(uint8_t* counter, uint64_t value) {
     counter[7] = value & 0xFF;
     counter[6] = (value >> 8) & 0xFF;
     counter[5] = (value >> 16) & 0xFF;
@@ -41,6 +44,16 @@ void setup_counter_block(uint8_t* counter_block, const uint8_t* nonce, uint64_t
     counter_block[8] = (counter_value >> 56) & 0xFF;
 }
 
+void ctr_block_advance(const ctr_block_t* base, ctr_block_t* out, uint64_t blocks) {
+    uint64_t counter_value = 0;
+    for (int i = 0; i < 8; i++) {
+        counter_value = (counter_value << 8) | base->counter[i];
+    }
+
+    memmove(out->nonce, base->nonce, 8);
+    set_counter_value(out->counter, counter_value + blocks);
+}
+
 int compare_buffers(uint8_t* buf1, uint8_t* buf2, size_t size) {
     for(size_t i = 0; i < size; i++) {
         if(buf1[i] != buf2[i]) {
@@ -51,6 +64,42 @@ int compare_buffers(uint8_t* buf1, uint8_t* buf2, size_t size) {
     return 1;
 }
 
+static int hex_value(char c) {
+    return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+int parse_hex(const char* hex, uint8_t* out, size_t len) {
+    if (strlen(hex) != len * 2) {
+        return -1;
+    }
+    // Digits only: no sign, no 0x prefix, no whitespace
+    for (size_t i = 0; i < len * 2; i++) {
+        if (!isxdigit((unsigned char)hex[i])) {
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < len; i++) {
+        out[i] = (uint8_t)(hex_value(hex[2 * i]) << 4 | hex_value(hex[2 * i + 1]));
+    }
+    return 0;
+}
+
+int parse_u64(const char* str, int base, uint64_t* out) {
+    char* end;
+
+    // strtoull would also take whitespace and a sign, wrapping "-1" around
+    if (!isdigit((unsigned char)str[0])) {
+        return -1;
+    }
+    errno = 0;
+    unsigned long long value = strtoull(str, &end, base);
+    if (errno != 0 || *end != '\0') {
+        return -1;
+    }
+    *out = value;
+    return 0;
+}
+
 const uint8_t sbox[256] = {
     0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
     0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
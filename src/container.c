@@ -0,0 +1,456 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#include "container.h"
+#include "dispatch.h"
+#include "affinity.h"
+#include "trace.h"
+#include "buf.h"
+
+#define MAC_PREFIX 24           // nonce || chunk index || data_len ahead of each chunk's ciphertext
+
+struct aes_container {
+    int fd;
+    aes_container_header_t header;
+    aes_container_keys_t keys;
+};
+
+typedef struct chunk_job chunk_job_t;
+typedef int (*chunk_fn)(chunk_job_t* job, uint8_t* scratch, uint64_t chunk);
+
+// One pack or read call; tasks claim chunks first..last from next
+struct chunk_job {
+    chunk_fn fn;
+    int in_fd;
+    int out_fd;
+    const aes_container_keys_t* keys;
+    const aes_container_header_t* header;
+    aesctr_bulk_fn kernel;
+    uint64_t first;
+    uint64_t last;
+    _Atomic uint64_t next;
+    _Atomic int err;
+    uint64_t offset;            // read: plaintext range and destination
+    size_t len;
+    uint8_t* out;
+};
+
+typedef struct {
+    aes_task_t task;
+    chunk_job_t* job;
+} chunk_task_t;
+
+//----------------------------------encoding----------------------------------
+
+static void put_le32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void put_le64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint32_t get_le32(const uint8_t* p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) v = v << 8 | p[i];
+    return v;
+}
+
+static uint64_t get_le64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = v << 8 | p[i];
+    return v;
+}
+
+static void encode_header(const aes_container_header_t* header, const aes_container_keys_t* keys,
+                          uint8_t out[AES_CONTAINER_HEADER_SIZE]) {
+    memset(out, 0, AES_CONTAINER_HEADER_SIZE);
+    memcpy(out, AES_CONTAINER_MAGIC, 8);
+    put_le32(out + 8, AES_CONTAINER_VERSION);
+    put_le32(out + 12, header->chunk_size);
+    put_le64(out + 16, header->data_len);
+    put_le64(out + 24, header->key_id);
+    memcpy(out + 32, header->nonce, 8);
+    aes_cmac(&keys->cmac, out, 48, out + 48);
+}
+
+static int decode_header(const uint8_t in[AES_CONTAINER_HEADER_SIZE], aes_container_header_t* header) {
+    if (memcmp(in, AES_CONTAINER_MAGIC, 8) != 0 || get_le32(in + 8) != AES_CONTAINER_VERSION) {
+        return -1;
+    }
+    header->chunk_size = get_le32(in + 12);
+    header->data_len = get_le64(in + 16);
+    header->key_id = get_le64(in + 24);
+    memcpy(header->nonce, in + 32, 8);
+    return header->chunk_size > 0 && header->chunk_size % BLOCK_SIZE == 0 ? 0 : -1;
+}
+
+//----------------------------------helpers----------------------------------
+
+void aes_container_keys_init(aes_container_keys_t* keys, uint8_t* enc_key, uint8_t* mac_key) {
+    aes_keyexpansion_serial(enc_key, keys->enc);
+    aes_keyexpansion_serial(mac_key, keys->mac);
+    aes_cmac_key_init(&keys->cmac, keys->mac);
+}
+
+uint64_t aes_container_chunk_offset(const aes_container_header_t* header, uint64_t chunk) {
+    return AES_CONTAINER_HEADER_SIZE + chunk * ((uint64_t)header->chunk_size + AES_CMAC_TAG_SIZE);
+}
+
+static uint64_t num_chunks(const aes_container_header_t* header) {
+    return (header->data_len + header->chunk_size - 1) / header->chunk_size;
+}
+
+static size_t chunk_len(const aes_container_header_t* header, uint64_t chunk) {
+    uint64_t start = chunk * header->chunk_size;
+    uint64_t left = header->data_len - start;
+    return left < header->chunk_size ? (size_t)left : header->chunk_size;
+}
+
+static int pread_full(int fd, uint8_t* buf, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pread(fd, buf, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) {
+            errno = EBADMSG;    // the file ends before its header says it does
+            return -1;
+        }
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int pwrite_full(int fd, const uint8_t* buf, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, buf, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+static void chunk_tag(const chunk_job_t* job, uint64_t chunk, const uint8_t* data, size_t len, uint8_t* tag) {
+    uint8_t prefix[MAC_PREFIX];
+    aes_cmac_ctx_t ctx;
+
+    memcpy(prefix, job->header->nonce, 8);
+    put_le64(prefix + 8, chunk);
+    put_le64(prefix + 16, job->header->data_len);
+
+    aes_cmac_begin(&ctx, &job->keys->cmac);
+    aes_cmac_update(&ctx, prefix, sizeof(prefix));
+    aes_cmac_update(&ctx, data, len);
+    aes_cmac_final(&ctx, tag);
+}
+
+// CTR over one chunk in place; chunks start on block boundaries, only the last can end mid-block
+static void crypt_chunk(const chunk_job_t* job, uint64_t chunk, uint8_t* data, size_t len) {
+    ctr_block_t base, ctr;
+    size_t num_blocks = len / BLOCK_SIZE;
+    size_t tail = len % BLOCK_SIZE;
+
+    memcpy(base.nonce, job->header->nonce, 8);
+    memset(base.counter, 0, 8);
+    ctr_block_advance(&base, &ctr, chunk * (job->header->chunk_size / BLOCK_SIZE));
+    job->kernel(data, job->keys->enc, data, num_blocks, &ctr);
+
+    if (tail > 0) {
+        uint8_t block[BLOCK_SIZE] = {0};
+
+        ctr_block_advance(&ctr, &ctr, num_blocks);
+        memcpy(block, data + num_blocks * BLOCK_SIZE, tail);
+        aesctr_kernel_serial(block, job->keys->enc, block, 1, &ctr);
+        memcpy(data + num_blocks * BLOCK_SIZE, block, tail);
+    }
+}
+
+static int pack_chunk(chunk_job_t* job, uint8_t* scratch, uint64_t chunk) {
+    size_t len = chunk_len(job->header, chunk);
+
+    if (pread_full(job->in_fd, scratch, len, chunk * job->header->chunk_size) < 0) {
+        return -1;
+    }
+    crypt_chunk(job, chunk, scratch, len);
+    chunk_tag(job, chunk, scratch, len, scratch + len);
+    return pwrite_full(job->out_fd, scratch, len + AES_CMAC_TAG_SIZE,
+                       aes_container_chunk_offset(job->header, chunk));
+}
+
+static int read_chunk(chunk_job_t* job, uint8_t* scratch, uint64_t chunk) {
+    size_t len = chunk_len(job->header, chunk);
+    uint8_t tag[AES_CMAC_TAG_SIZE];
+
+    if (pread_full(job->in_fd, scratch, len + AES_CMAC_TAG_SIZE, aes_container_chunk_offset(job->header, chunk)) < 0) {
+        return -1;
+    }
+    chunk_tag(job, chunk, scratch, len, tag);
+    if (!aes_cmac_equal(tag, scratch + len)) {
+        errno = EBADMSG;
+        return -1;
+    }
+    crypt_chunk(job, chunk, scratch, len);
+
+    // Copy out the part of the chunk inside the requested range
+    uint64_t chunk_start = chunk * job->header->chunk_size;
+    uint64_t from = job->offset > chunk_start ? job->offset : chunk_start;
+    uint64_t to = job->offset + job->len < chunk_start + len ? job->offset + job->len : chunk_start + len;
+    memcpy(job->out + (from - job->offset), scratch + (from - chunk_start), to - from);
+    return 0;
+}
+
+//----------------------------------chunk jobs----------------------------------
+
+static void run_chunks(chunk_job_t* job) {
+    uint8_t* scratch = (uint8_t*)aes_buf_alloc(job->header->chunk_size + AES_CMAC_TAG_SIZE, 0);
+    if (!scratch) {
+        int none = 0;
+        atomic_compare_exchange_strong(&job->err, &none, ENOMEM);
+        return;
+    }
+
+    for (;;) {
+        uint64_t chunk = atomic_fetch_add(&job->next, 1);
+        if (chunk > job->last || atomic_load(&job->err) != 0) {
+            break;
+        }
+        AES_TRACE(AES_TRACE_CHUNK_BEGIN, "container", chunk_len(job->header, chunk));
+        if (job->fn(job, scratch, chunk) < 0) {
+            int none = 0;
+            atomic_compare_exchange_strong(&job->err, &none, errno);
+        }
+        AES_TRACE(AES_TRACE_CHUNK_END, "container", 0);
+    }
+    aes_buf_free(scratch);
+}
+
+static void chunk_task_run(aes_task_t* task, int worker_idx) {
+    (void)worker_idx;
+    run_chunks(((chunk_task_t*)task)->job);
+}
+
+/**
+ * Runs job->fn over chunks first..last: inline for a single chunk, otherwise
+ * one task per worker, each claiming chunks until none are left.
+ * return: 0, or -1 with errno set to the first failure
+ */
+static int run_job(chunk_job_t* job, aes_pool_t* pool) {
+    uint64_t count = job->last - job->first + 1;
+
+    atomic_init(&job->next, job->first);
+    atomic_init(&job->err, 0);
+    job->kernel = aes_select_bulk_kernel(NULL);
+
+    if (count == 1) {
+        run_chunks(job);
+    } else {
+        chunk_task_t tasks[AES_MAX_THREADS];
+        aes_taskgroup_t group;
+
+        if (!pool) {
+            pool = aes_pool_default();
+        }
+        int num_tasks = aes_pool_num_threads(pool);
+        if ((uint64_t)num_tasks > count) {
+            num_tasks = (int)count;
+        }
+
+        aes_taskgroup_init(&group);
+        for (int i = 0; i < num_tasks; i++) {
+            tasks[i].task.fn = chunk_task_run;
+            tasks[i].task.arg = NULL;
+            tasks[i].task.group = &group;
+            tasks[i].job = job;
+            aes_pool_submit(pool, &tasks[i].task);
+        }
+        aes_taskgroup_wait(&group);
+        aes_taskgroup_destroy(&group);
+    }
+
+    int err = atomic_load(&job->err);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+//----------------------------------API----------------------------------
+
+int64_t aes_container_pack(const char* in_path, const char* out_path, const aes_container_keys_t* keys,
+                           aes_container_header_t* header, aes_pool_t* pool) {
+    uint8_t encoded[AES_CONTAINER_HEADER_SIZE];
+    struct stat st;
+    int err = 0;
+
+    if (header->chunk_size == 0) {
+        header->chunk_size = AES_CONTAINER_DEFAULT_CHUNK;
+    }
+    if (header->chunk_size % BLOCK_SIZE != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int in_fd = open(in_path, O_RDONLY);
+    if (in_fd < 0) {
+        return -1;
+    }
+    if (fstat(in_fd, &st) < 0) {
+        err = errno;
+        close(in_fd);
+        errno = err;
+        return -1;
+    }
+    int out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        err = errno;
+        close(in_fd);
+        errno = err;
+        return -1;
+    }
+
+    header->data_len = (uint64_t)st.st_size;
+    uint64_t chunks = num_chunks(header);
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "container", header->data_len);
+    encode_header(header, keys, encoded);
+    if (pwrite_full(out_fd, encoded, sizeof(encoded), 0) < 0) {
+        err = errno;
+    } else if (chunks > 0) {
+        chunk_job_t job = {0};
+        job.fn = pack_chunk;
+        job.in_fd = in_fd;
+        job.out_fd = out_fd;
+        job.keys = keys;
+        job.header = header;
+        job.first = 0;
+        job.last = chunks - 1;
+        if (run_job(&job, pool) < 0) {
+            err = errno;
+        }
+    }
+    AES_TRACE(AES_TRACE_JOB_END, "container", 0);
+
+    close(in_fd);
+    if (close(out_fd) < 0 && !err) {
+        err = errno;
+    }
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return (int64_t)header->data_len;
+}
+
+static int read_header(int fd, uint8_t encoded[AES_CONTAINER_HEADER_SIZE], aes_container_header_t* header) {
+    if (pread_full(fd, encoded, AES_CONTAINER_HEADER_SIZE, 0) < 0 || decode_header(encoded, header) < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int aes_container_probe(const char* path, aes_container_header_t* header) {
+    uint8_t encoded[AES_CONTAINER_HEADER_SIZE];
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int ret = read_header(fd, encoded, header);
+    int err = errno;
+    close(fd);
+    errno = err;
+    return ret;
+}
+
+aes_container_t* aes_container_open(const char* path, const aes_container_keys_t* keys) {
+    uint8_t encoded[AES_CONTAINER_HEADER_SIZE];
+    uint8_t tag[AES_CMAC_TAG_SIZE];
+    int err;
+
+    aes_container_t* container = (aes_container_t*)calloc(1, sizeof(aes_container_t));
+    if (!container) {
+        return NULL;
+    }
+    container->keys = *keys;
+    container->keys.cmac.roundKey = container->keys.mac;
+
+    container->fd = open(path, O_RDONLY);
+    if (container->fd < 0) {
+        err = errno;
+        goto fail;
+    }
+    if (read_header(container->fd, encoded, &container->header) < 0) {
+        err = errno;
+        goto fail;
+    }
+    aes_cmac(&container->keys.cmac, encoded, 48, tag);
+    if (!aes_cmac_equal(tag, encoded + 48)) {
+        err = EBADMSG;
+        goto fail;
+    }
+    return container;
+
+fail:
+    if (container->fd >= 0) {
+        close(container->fd);
+    }
+    free(container);
+    errno = err;
+    return NULL;
+}
+
+const aes_container_header_t* aes_container_get_header(const aes_container_t* container) {
+    return &container->header;
+}
+
+int64_t aes_container_read(aes_container_t* container, uint64_t offset, void* buf, size_t len, aes_pool_t* pool) {
+    const aes_container_header_t* header = &container->header;
+
+    if (offset >= header->data_len || len == 0) {
+        return 0;
+    }
+    if (len > header->data_len - offset) {
+        len = (size_t)(header->data_len - offset);
+    }
+
+    chunk_job_t job = {0};
+    job.fn = read_chunk;
+    job.in_fd = container->fd;
+    job.keys = &container->keys;
+    job.header = header;
+    job.first = offset / header->chunk_size;
+    job.last = (offset + len - 1) / header->chunk_size;
+    job.offset = offset;
+    job.len = len;
+    job.out = (uint8_t*)buf;
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "container", len);
+    int ret = run_job(&job, pool);
+    AES_TRACE(AES_TRACE_JOB_END, "container", 0);
+    return ret < 0 ? -1 : (int64_t)len;
+}
+
+void aes_container_close(aes_container_t* container) {
+    if (container) {
+        close(container->fd);
+        free(container);
+    }
+}
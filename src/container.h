@@ -0,0 +1,90 @@
+#ifndef AES_CONTAINER_H
+#define AES_CONTAINER_H
+
+#include "aes.h"
+#include "cmac.h"
+#include "pool.h"
+
+/**
+ * Seekable encrypted container. Layout, integers little-endian:
+ *
+ *   header (64 bytes)
+ *     0  magic "AESCTRC1"
+ *     8  version (u32), chunk_size (u32)
+ *    16  data_len (u64): plaintext bytes
+ *    24  key_id (u64): opaque, for the reader to pick its keys
+ *    32  nonce (8 bytes)
+ *    40  reserved, zero (8 bytes)
+ *    48  CMAC of bytes 0..47
+ *   chunk i at AES_CONTAINER_HEADER_SIZE + i * (chunk_size + 16)
+ *     ciphertext (chunk_size bytes, shorter for the last chunk)
+ *     CMAC over nonce || i || data_len || ciphertext
+ *
+ * The data is one CTR stream: plaintext offset o uses counter block
+ * nonce || o / 16, so any chunk decrypts on its own. Each tag binds its chunk
+ * to its position and to the file's length, so chunks can't be swapped,
+ * replayed from another container or truncated away unnoticed.
+ * Encryption and MAC take separate keys.
+ */
+
+#define AES_CONTAINER_MAGIC "AESCTRC1"
+#define AES_CONTAINER_VERSION 1
+#define AES_CONTAINER_HEADER_SIZE 64
+#define AES_CONTAINER_DEFAULT_CHUNK (64UL * 1024)
+
+typedef struct {
+    uint32_t chunk_size;        // multiple of 16; 0 for AES_CONTAINER_DEFAULT_CHUNK when packing
+    uint64_t data_len;          // filled in by pack / open
+    uint64_t key_id;
+    uint8_t nonce[8];
+} aes_container_header_t;
+
+typedef struct {
+    uint8_t enc[176];           // serial key schedules
+    uint8_t mac[176];
+    aes_cmac_key_t cmac;
+} aes_container_keys_t;
+
+typedef struct aes_container aes_container_t;
+
+void aes_container_keys_init(aes_container_keys_t* keys, uint8_t* enc_key, uint8_t* mac_key);
+
+// Byte offset of chunk `chunk` in the file
+uint64_t aes_container_chunk_offset(const aes_container_header_t* header, uint64_t chunk);
+
+/**
+ * Encrypts in_path into a new container at out_path, chunks spread over the pool.
+ * header: chunk_size, key_id and nonce to use; data_len is set on return
+ * pool: NULL for aes_pool_default()
+ * return: plaintext bytes packed, or -1 with errno set
+ */
+int64_t aes_container_pack(const char* in_path, const char* out_path, const aes_container_keys_t* keys,
+                           aes_container_header_t* header, aes_pool_t* pool);
+
+/**
+ * Reads the header without keys, e.g. to look up key_id.
+ * return: 0, or -1 with errno set (EINVAL for a file that isn't a container)
+ */
+int aes_container_probe(const char* path, aes_container_header_t* header);
+
+/**
+ * Opens a container and verifies its header tag.
+ * return: NULL with errno set; EBADMSG if the header fails authentication
+ */
+aes_container_t* aes_container_open(const char* path, const aes_container_keys_t* keys);
+
+const aes_container_header_t* aes_container_get_header(const aes_container_t* container);
+
+/**
+ * Decrypts plaintext bytes [offset, offset + len) into buf, reading and
+ * authenticating only the chunks that cover the range, in parallel on the pool
+ * when there are several. Safe to call from several threads at once.
+ * pool: NULL for aes_pool_default()
+ * return: bytes read (short at end of data), or -1 with errno set; EBADMSG if
+ *         a covering chunk fails authentication, in which case buf is undefined
+ */
+int64_t aes_container_read(aes_container_t* container, uint64_t offset, void* buf, size_t len, aes_pool_t* pool);
+
+void aes_container_close(aes_container_t* container);
+
+#endif
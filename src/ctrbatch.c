@@ -0,0 +1,133 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "ctrbatch.h"
+
+#define BATCH_BLOCKS 256        // counter blocks encrypted per ECB call; 4 KB stays in L1
+
+typedef uint8_t vec16_t __attribute__((vector_size(16)));
+
+typedef struct {
+    void* ctx;
+    size_t count;
+    aes_ctrbatch_item_fn get;
+    aes_ecb_fn ecb;
+    aesctr_bulk_fn bulk;
+} batch_t;
+
+// Position in the list: message i, block blk of that message
+typedef struct {
+    size_t i;
+    size_t blk;
+    aes_ctrbatch_item_t item;   // message i, while i < count
+} batch_pos_t;
+
+static size_t item_blocks(const aes_ctrbatch_item_t* item) {
+    return (item->len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+// First block of a message that goes through the ECB batch; long messages only batch their partial tail
+static size_t first_batched(const aes_ctrbatch_item_t* item) {
+    return item->len >= AES_CTRBATCH_DIRECT_MIN ? item->len / BLOCK_SIZE : 0;
+}
+
+// Moves pos to message i without encrypting anything
+static void seek(const batch_t* b, batch_pos_t* pos, size_t i) {
+    pos->i = i;
+    pos->blk = 0;
+    if (i < b->count) {
+        b->get(b->ctx, i, &pos->item);
+        pos->blk = first_batched(&pos->item);
+    }
+}
+
+// Moves pos to message i, first encrypting the whole blocks of a long message in one CTR call
+static void enter_item(const batch_t* b, batch_pos_t* pos, size_t i) {
+    seek(b, pos, i);
+    if (i < b->count && pos->blk > 0) {
+        ctr_block_t ctr = pos->item.ctr;
+        b->bulk((uint8_t*)pos->item.src, pos->item.roundKey, pos->item.dst, pos->blk, &ctr);
+    }
+}
+
+static void xor_keystream(uint8_t* dst, const uint8_t* src, const uint8_t* keystream, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        vec16_t a, b;
+        memcpy(&a, src + i, 16);
+        memcpy(&b, keystream + i, 16);
+        a ^= b;
+        memcpy(dst + i, &a, 16);
+    }
+    for (; i < n; i++) {
+        dst[i] = src[i] ^ keystream[i];
+    }
+}
+
+/**
+ * Up to BATCH_BLOCKS counter blocks from pos on, message after message, for
+ * as long as the messages share roundKey; pos moves past them.
+ * return: blocks written
+ */
+static size_t fill_counters(const batch_t* b, batch_pos_t* pos, const uint8_t* roundKey, uint8_t* blocks) {
+    uint64_t* out = (uint64_t*)blocks;
+    size_t n = 0;
+
+    while (pos->i < b->count && n < BATCH_BLOCKS && pos->item.roundKey == roundKey) {
+        const aes_ctrbatch_item_t* item = &pos->item;
+        size_t take = item_blocks(item) - pos->blk;
+        if (take > BATCH_BLOCKS - n) take = BATCH_BLOCKS - n;
+
+        uint64_t nonce, counter;
+        memcpy(&nonce, item->ctr.nonce, 8);
+        memcpy(&counter, item->ctr.counter, 8);
+        counter = __builtin_bswap64(counter) + pos->blk;
+        for (size_t k = 0; k < take; k++) {
+            out[2 * (n + k)] = nonce;
+            out[2 * (n + k) + 1] = __builtin_bswap64(counter + k);
+        }
+        n += take;
+        pos->blk += take;
+        if (pos->blk == item_blocks(item)) {
+            enter_item(b, pos, pos->i + 1);
+        }
+    }
+    return n;
+}
+
+// XORs n blocks of keystream into the messages from pos on, trimming each message's last block
+static void apply_keystream(const batch_t* b, batch_pos_t pos, const uint8_t* keystream, size_t n) {
+    while (n > 0) {
+        const aes_ctrbatch_item_t* item = &pos.item;
+        size_t take = item_blocks(item) - pos.blk;
+        if (take > n) take = n;
+
+        size_t off = pos.blk * BLOCK_SIZE;
+        size_t bytes = item->len - off < take * BLOCK_SIZE ? item->len - off : take * BLOCK_SIZE;
+        xor_keystream(item->dst + off, item->src + off, keystream, bytes);
+
+        keystream += take * BLOCK_SIZE;
+        n -= take;
+        pos.blk += take;
+        if (pos.blk == item_blocks(item)) {
+            seek(b, &pos, pos.i + 1);
+        }
+    }
+}
+
+void aes_ctrbatch_run(void* ctx, size_t count, aes_ctrbatch_item_fn get, aes_ecb_fn ecb, aesctr_bulk_fn bulk) {
+    uint8_t keystream[BATCH_BLOCKS * BLOCK_SIZE] __attribute__((aligned(64)));
+    batch_t b = { ctx, count, get, ecb, bulk };
+    batch_pos_t pos;
+
+    enter_item(&b, &pos, 0);
+    while (pos.i < count) {
+        const uint8_t* roundKey = pos.item.roundKey;
+        batch_pos_t start = pos;
+        size_t n = fill_counters(&b, &pos, roundKey, keystream);
+        if (n > 0) {
+            ecb(keystream, roundKey, keystream, n);
+            apply_keystream(&b, start, keystream, n);
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef AES_CTRBATCH_H
+#define AES_CTRBATCH_H
+
+#include "aes.h"
+#include "dispatch.h"
+
+/**
+ * CTR over a list of short, unrelated messages, each with its own counter
+ * stream, as used by the burst and coalescing paths. The counter blocks of
+ * consecutive messages under the same key are laid out back to back,
+ * encrypted by an ECB kernel in batches that stay in L1 and XORed into the
+ * messages, so short messages keep all AES lanes busy. Messages of at least
+ * AES_CTRBATCH_DIRECT_MIN bytes run their whole blocks through the bulk CTR
+ * kernel instead and only batch their partial last block.
+ */
+
+#define AES_CTRBATCH_DIRECT_MIN 512
+
+typedef struct {
+    const uint8_t* src;
+    uint8_t* dst;               // may equal src
+    size_t len;
+    const uint8_t* roundKey;    // a batch ends where the key changes
+    ctr_block_t ctr;            // counter block of the message's first block
+} aes_ctrbatch_item_t;
+
+// Describes message i of ctx; called more than once per message
+typedef void (*aes_ctrbatch_item_fn)(void* ctx, size_t i, aes_ctrbatch_item_t* item);
+
+// Encrypts (or decrypts) messages 0 to count - 1 of ctx, in order, on the calling thread
+void aes_ctrbatch_run(void* ctx, size_t count, aes_ctrbatch_item_fn get, aes_ecb_fn ecb, aesctr_bulk_fn bulk);
+
+#endif
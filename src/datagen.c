@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "datagen.h"
+#include "affinity.h"
+
+#define GOLDEN_GAMMA 0x9E3779B97F4A7C15ULL
+
+typedef struct {
+    uint8_t* buf;
+    size_t begin;       // byte offsets, multiples of 64 except for the last end
+    size_t end;
+    aes_datagen_pattern_t pattern;
+    uint64_t seed;
+    int thread_idx;
+} datagen_task_t;
+
+const char* aes_datagen_pattern_name(aes_datagen_pattern_t pattern) {
+    switch (pattern) {
+        case AES_DATAGEN_ZERO:           return "zero";
+        case AES_DATAGEN_INCOMPRESSIBLE: return "incompressible";
+        case AES_DATAGEN_REPEATING:      return "repeating";
+        default:                         return "random";
+    }
+}
+
+static inline uint64_t mix_fast(uint64_t x) {
+    x *= GOLDEN_GAMMA;
+    return x ^ (x >> 29);
+}
+
+// splitmix64 finalizer
+static inline uint64_t mix_full(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t word_at(aes_datagen_pattern_t pattern, uint64_t seed, uint64_t word_idx) {
+    switch (pattern) {
+        case AES_DATAGEN_INCOMPRESSIBLE: return mix_full(seed + word_idx * GOLDEN_GAMMA);
+        case AES_DATAGEN_REPEATING:      return mix_full(seed + (word_idx % (AES_DATAGEN_PERIOD / 8)) * GOLDEN_GAMMA);
+        default:                         return mix_fast(seed ^ word_idx);
+    }
+}
+
+// Words are independent, so the loop bodies carry no dependency between iterations
+static void fill_words(uint64_t* words, uint64_t first_idx, size_t count,
+                       aes_datagen_pattern_t pattern, uint64_t seed) {
+    size_t i = 0;
+
+    switch (pattern) {
+        case AES_DATAGEN_INCOMPRESSIBLE:
+            for(; i < count; i++) {
+                words[i] = mix_full(seed + (first_idx + i) * GOLDEN_GAMMA);
+            }
+            break;
+        case AES_DATAGEN_REPEATING: {
+            uint64_t j = first_idx % (AES_DATAGEN_PERIOD / 8);
+            for(; i < count; i++) {
+                words[i] = mix_full(seed + j * GOLDEN_GAMMA);
+                if (++j == AES_DATAGEN_PERIOD / 8) {
+                    j = 0;
+                }
+            }
+            break;
+        }
+        default:
+            for(; i < count; i++) {
+                words[i] = mix_fast(seed ^ (first_idx + i));
+            }
+            break;
+    }
+}
+
+static void* datagen_worker(void* arg) {
+    datagen_task_t* task = (datagen_task_t*)arg;
+    size_t len = task->end - task->begin;
+
+    if (task->thread_idx >= 0) {
+        aes_pin_thread(task->thread_idx);
+    }
+
+    if (task->pattern == AES_DATAGEN_ZERO) {
+        memset(task->buf + task->begin, 0, len);
+        return NULL;
+    }
+
+    // begin is 64-byte aligned relative to buf, so word indices line up across threads
+    size_t words = len / 8;
+    uint64_t first_idx = task->begin / 8;
+    uint64_t* out = (uint64_t*)(task->buf + task->begin);
+
+    if (((uintptr_t)out & 7) == 0) {
+        fill_words(out, first_idx, words, task->pattern, task->seed);
+    } else {
+        for(size_t i = 0; i < words; i++) {
+            uint64_t w = word_at(task->pattern, task->seed, first_idx + i);
+            memcpy(task->buf + task->begin + i * 8, &w, 8);
+        }
+    }
+
+    // Partial word at the very end of the buffer
+    if (len % 8) {
+        uint64_t w = word_at(task->pattern, task->seed, first_idx + words);
+        memcpy(task->buf + task->begin + words * 8, &w, len % 8);
+    }
+
+    return NULL;
+}
+
+void aes_datagen_fill(uint8_t* buf, size_t len, aes_datagen_pattern_t pattern, uint64_t seed) {
+    int num_threads = aes_get_num_threads();
+    pthread_t threads[AES_MAX_THREADS];
+    datagen_task_t tasks[AES_MAX_THREADS];
+
+    // Small buffers are not worth a thread
+    size_t lines = len / 64;
+    if (lines < (size_t)num_threads * 1024) {
+        num_threads = 1;
+    }
+
+    size_t current = 0;
+    for(int i = 0; i < num_threads; i++) {
+        tasks[i].buf = buf;
+        tasks[i].begin = current;
+        tasks[i].end = (i == num_threads - 1) ? len : current + (lines / num_threads) * 64;
+        tasks[i].pattern = pattern;
+        tasks[i].seed = seed;
+        tasks[i].thread_idx = i;
+        current = tasks[i].end;
+    }
+
+    if (num_threads == 1) {
+        // Run on the caller without touching its affinity
+        tasks[0].thread_idx = -1;
+        datagen_worker(&tasks[0]);
+        return;
+    }
+
+    for(int i = 0; i < num_threads; i++) {
+        pthread_create(&threads[i], NULL, datagen_worker, &tasks[i]);
+    }
+    for(int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef AES_DATAGEN_H
+#define AES_DATAGEN_H
+
+#include "aes.h"
+
+// Period of AES_DATAGEN_REPEATING in bytes
+#define AES_DATAGEN_PERIOD 4096
+
+typedef enum {
+    AES_DATAGEN_RANDOM = 0,       // one multiply-xorshift per word, fastest random-looking fill
+    AES_DATAGEN_ZERO,             // all zero bytes, still touched in parallel
+    AES_DATAGEN_INCOMPRESSIBLE,   // full splitmix64 per word: bijective, no repeated words
+    AES_DATAGEN_REPEATING         // random AES_DATAGEN_PERIOD-byte pattern repeated
+} aes_datagen_pattern_t;
+
+const char* aes_datagen_pattern_name(aes_datagen_pattern_t pattern);
+
+/**
+ * Fills buf with len bytes of the given pattern using aes_get_num_threads() threads.
+ * Every word is a pure function of (seed, offset), so the content does not
+ * depend on the thread count and the same seed always gives the same buffer.
+ */
+void aes_datagen_fill(uint8_t* buf, size_t len, aes_datagen_pattern_t pattern, uint64_t seed);
+
+#endif
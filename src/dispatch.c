@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "dispatch.h"
+#include "aesni.h"
+#include "vaes.h"
+#include "store.h"
+
+// The serial key schedule has the same byte layout as the AES-NI one
+static void load_key_schedule(const uint8_t* roundKey, __m128i* key_schedule) {
+    for (int i = 0; i <= Nr; i++) {
+        key_schedule[i] = _mm_loadu_si128((const __m128i*)(roundKey + i * 16));
+    }
+}
+
+static void bulk_vaes(uint8_t* input, const uint8_t* roundKey, uint8_t* output,
+                      size_t num_blocks, ctr_block_t* initial_ctr) {
+    __m128i key_schedule[Nr + 1];
+    load_key_schedule(roundKey, key_schedule);
+    aesctr_kernel_vaes(input, key_schedule, output, num_blocks, initial_ctr);
+}
+
+static void bulk_aesni(uint8_t* input, const uint8_t* roundKey, uint8_t* output,
+                       size_t num_blocks, ctr_block_t* initial_ctr) {
+    __m128i key_schedule[Nr + 1];
+    load_key_schedule(roundKey, key_schedule);
+    aesctr_kernel_aesni(input, key_schedule, output, num_blocks, initial_ctr);
+}
+
+static void bulk_vaes_nt(uint8_t* input, const uint8_t* roundKey, uint8_t* output,
+                         size_t num_blocks, ctr_block_t* initial_ctr) {
+    __m128i key_schedule[Nr + 1];
+    load_key_schedule(roundKey, key_schedule);
+    aesctr_kernel_vaes_nt(input, key_schedule, output, num_blocks, initial_ctr);
+}
+
+static void bulk_aesni_nt(uint8_t* input, const uint8_t* roundKey, uint8_t* output,
+                          size_t num_blocks, ctr_block_t* initial_ctr) {
+    __m128i key_schedule[Nr + 1];
+    load_key_schedule(roundKey, key_schedule);
+    aesctr_kernel_aesni_nt(input, key_schedule, output, num_blocks, initial_ctr);
+}
+
+static void ecb_vaes(const uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t num_blocks) {
+    __m128i key_schedule[Nr + 1];
+    load_key_schedule(roundKey, key_schedule);
+    aes_ecb_kernel_vaes(input, key_schedule, output, num_blocks);
+}
+
+static void ecb_aesni(const uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t num_blocks) {
+    __m128i key_schedule[Nr + 1];
+    load_key_schedule(roundKey, key_schedule);
+    aes_ecb_kernel_aesni(input, key_schedule, output, num_blocks);
+}
+
+static void ecb_serial(const uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t num_blocks) {
+    uint8_t block[BLOCK_SIZE];
+    for (size_t i = 0; i < num_blocks; i++) {
+        memcpy(block, input + i * BLOCK_SIZE, BLOCK_SIZE);
+        aes_enc1block_serial(block, roundKey, output + i * BLOCK_SIZE);
+    }
+}
+
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+static int detected_aesni, detected_vaes;
+
+// cpuid traps to the hypervisor on many VMs, too slow to repeat for every packet burst
+static void probe_cpu() {
+    const char* want = getenv("AES_KERNEL");
+
+    detected_aesni = check_aesni_support();
+    detected_vaes = detected_aesni && check_vaes_support();
+    if (want && *want) {
+        if (strcmp(want, "serial") == 0) {
+            detected_vaes = detected_aesni = 0;
+        } else if (strcmp(want, "aesni") == 0) {
+            detected_vaes = 0;
+        }
+    }
+}
+
+// Supported instruction sets, narrowed by AES_KERNEL; probed once per process
+static void detect_kernels(int* have_aesni, int* have_vaes) {
+    pthread_once(&detect_once, probe_cpu);
+    *have_aesni = detected_aesni;
+    *have_vaes = detected_vaes;
+}
+
+static aesctr_bulk_fn select_kernel(int streaming, const char** name) {
+    int have_aesni, have_vaes;
+
+    detect_kernels(&have_aesni, &have_vaes);
+    if (have_vaes) {
+        if (name) *name = streaming ? "vaes-nt" : "vaes";
+        return streaming ? bulk_vaes_nt : bulk_vaes;
+    }
+    if (have_aesni) {
+        if (name) *name = streaming ? "aesni-nt" : "aesni";
+        return streaming ? bulk_aesni_nt : bulk_aesni;
+    }
+    if (name) *name = "serial";
+    return aesctr_kernel_serial;
+}
+
+aesctr_bulk_fn aes_select_bulk_kernel(const char** name) {
+    return select_kernel(0, name);
+}
+
+aes_ecb_fn aes_select_ecb_kernel(const char** name) {
+    int have_aesni, have_vaes;
+
+    detect_kernels(&have_aesni, &have_vaes);
+    if (have_vaes) {
+        if (name) *name = "vaes";
+        return ecb_vaes;
+    }
+    if (have_aesni) {
+        if (name) *name = "aesni";
+        return ecb_aesni;
+    }
+    if (name) *name = "serial";
+    return ecb_serial;
+}
+
+aesctr_bulk_fn aes_select_bulk_kernel_for(const void* input, const void* output, size_t bytes, const char** name) {
+    return select_kernel(aes_streaming_stores(input, output, bytes), name);
+}
@@ -0,0 +1,37 @@
+#ifndef AES_DISPATCH_H
+#define AES_DISPATCH_H
+
+#include "aes.h"
+
+/**
+ * Bulk CTR kernel over a contiguous range, keyed by the serial round keys
+ * from aes_keyexpansion_serial. Does not record stats.
+ */
+typedef void (*aesctr_bulk_fn)(uint8_t* input, const uint8_t* roundKey, uint8_t* output,
+                               size_t num_blocks, ctr_block_t* initial_ctr);
+
+/**
+ * Widest kernel this CPU supports: VAES, then pipelined AES-NI, then serial.
+ * name: optional, receives "vaes", "aesni" or "serial"
+ * Setting AES_KERNEL=<name> in the environment forces a supported kernel.
+ */
+aesctr_bulk_fn aes_select_bulk_kernel(const char** name);
+
+/**
+ * As aes_select_bulk_kernel, with the streaming-store variant ("vaes-nt",
+ * "aesni-nt") when the store policy picks it for this job (see store.h).
+ * Call once per job with the whole job's buffers, then split.
+ */
+aesctr_bulk_fn aes_select_bulk_kernel_for(const void* input, const void* output, size_t bytes, const char** name);
+
+/**
+ * Block encryption of num_blocks independent 16-byte blocks (ECB), keyed by
+ * the serial round keys. input and output may be the same buffer. Turns a
+ * list of arbitrary counter blocks into keystream in one pass.
+ */
+typedef void (*aes_ecb_fn)(const uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t num_blocks);
+
+// ECB counterpart of aes_select_bulk_kernel, honouring AES_KERNEL the same way
+aes_ecb_fn aes_select_ecb_kernel(const char** name);
+
+#endif
@@ -0,0 +1,143 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+
+#include "engine.hpp"
+
+extern "C" {
+#include "engine.h"
+#include "stats.h"
+}
+
+using namespace aes::engine;
+
+// Vectors in flight per policy: enough independent blocks to cover aesenc latency on current cores
+#define INTERLEAVE_SOFT 1
+#define INTERLEAVE_AESNI 8
+#define INTERLEAVE_VAES256 4
+#define INTERLEAVE_VAES512 4
+
+/**
+ * The deployed specializations: CTR and ECB for each key size and policy,
+ * each built for its policy's target.
+ */
+#define ENGINE_KERNELS(policy, isa, interleave, bits) \
+    __attribute__((target(isa))) static void ctr_##policy##_##bits( \
+            uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr) { \
+        ctr<policy, bits, interleave>(input, roundKey, output, num_blocks, *initial_ctr); \
+    } \
+    __attribute__((target(isa))) static void ecb_##policy##_##bits( \
+            const uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t num_blocks) { \
+        ecb<policy, bits, interleave>(input, roundKey, output, num_blocks); \
+    }
+
+#define ENGINE_KEY_SIZES(policy, isa, interleave) \
+    ENGINE_KERNELS(policy, isa, interleave, 128) \
+    ENGINE_KERNELS(policy, isa, interleave, 192) \
+    ENGINE_KERNELS(policy, isa, interleave, 256)
+
+ENGINE_KEY_SIZES(soft, AES_ENGINE_TARGET_SOFT, INTERLEAVE_SOFT)
+ENGINE_KEY_SIZES(aesni, AES_ENGINE_TARGET_AESNI, INTERLEAVE_AESNI)
+ENGINE_KEY_SIZES(vaes256, AES_ENGINE_TARGET_VAES256, INTERLEAVE_VAES256)
+ENGINE_KEY_SIZES(vaes512, AES_ENGINE_TARGET_VAES512, INTERLEAVE_VAES512)
+
+typedef struct {
+    const char* name;
+    aes_backend_t backend;
+    aesctr_bulk_fn ctr[3];      // 128, 192, 256
+    aes_ecb_fn ecb[3];
+} engine_entry_t;
+
+#define ENGINE_ENTRY(policy, backend) \
+    { policy::name, backend, { ctr_##policy##_128, ctr_##policy##_192, ctr_##policy##_256 }, \
+      { ecb_##policy##_128, ecb_##policy##_192, ecb_##policy##_256 } }
+
+// Widest first
+static const engine_entry_t entries[] = {
+    ENGINE_ENTRY(vaes512, AES_BACKEND_VAES),
+    ENGINE_ENTRY(vaes256, AES_BACKEND_VAES),
+    ENGINE_ENTRY(aesni, AES_BACKEND_AESNI),
+    ENGINE_ENTRY(soft, AES_BACKEND_SERIAL),
+};
+
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+static const engine_entry_t* selected;
+
+static void probe_cpu() {
+    const char* want = getenv("AES_KERNEL");
+    int first = 0;
+
+    if (want && strcmp(want, "serial") == 0) {
+        first = 3;
+    } else if (want && strcmp(want, "aesni") == 0) {
+        first = 2;
+    } else if (want && strcmp(want, "vaes256") == 0) {
+        first = 1;
+    }
+    const bool supported[] = { vaes512::supported(), vaes256::supported(), aesni::supported(), true };
+    for (int i = first; i < 4; i++) {
+        if (supported[i]) {
+            selected = &entries[i];
+            break;
+        }
+    }
+}
+
+// Index into the per-key-size tables, or -1
+static int key_index(int key_bits) {
+    switch (key_bits) {
+    case 128: return 0;
+    case 192: return 1;
+    case 256: return 2;
+    default: return -1;
+    }
+}
+
+static const engine_entry_t* select_entry(int key_bits, const char** name) {
+    if (key_index(key_bits) < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    pthread_once(&detect_once, probe_cpu);
+    if (name) *name = selected->name;
+    return selected;
+}
+
+size_t aes_engine_schedule_bytes(int key_bits) {
+    switch (key_bits) {
+    case 128: return key_size<128>::schedule_bytes;
+    case 192: return key_size<192>::schedule_bytes;
+    case 256: return key_size<256>::schedule_bytes;
+    default: return 0;
+    }
+}
+
+int aes_engine_keyexpansion(const uint8_t* key, int key_bits, uint8_t* roundKey) {
+    switch (key_bits) {
+    case 128: expand_key<128>(key, roundKey); return 0;
+    case 192: expand_key<192>(key, roundKey); return 0;
+    case 256: expand_key<256>(key, roundKey); return 0;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+aesctr_bulk_fn aes_engine_select_ctr(int key_bits, const char** name) {
+    const engine_entry_t* e = select_entry(key_bits, name);
+    return e ? e->ctr[key_index(key_bits)] : NULL;
+}
+
+aes_ecb_fn aes_engine_select_ecb(int key_bits, const char** name) {
+    const engine_entry_t* e = select_entry(key_bits, name);
+    return e ? e->ecb[key_index(key_bits)] : NULL;
+}
+
+void aesctr_enc_engine(uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr) {
+    const engine_entry_t* e = select_entry(128, NULL);
+    uint64_t start_ns = aes_stats_now_ns();
+
+    e->ctr[0](input, roundKey, output, num_blocks, initial_ctr);
+    aes_stats_record(e->backend, (uint64_t)num_blocks * BLOCK_SIZE, aes_stats_now_ns() - start_ns);
+}
@@ -0,0 +1,40 @@
+#ifndef AES_ENGINE_H
+#define AES_ENGINE_H
+
+#include "aes.h"
+#include "dispatch.h"
+
+/**
+ * C interface to the template engine in engine.hpp, for AES-128, -192 and
+ * -256. The kernels take the aesctr_bulk_fn / aes_ecb_fn signatures with a
+ * round key schedule of aes_engine_schedule_bytes(key_bits); for 128-bit
+ * keys that is the same 176 bytes as aes_keyexpansion_serial, so they drop
+ * in wherever the kernels of dispatch.h are used. Built from engine.cpp,
+ * which needs a C++17 compiler.
+ */
+
+#define AES_ENGINE_MAX_SCHEDULE 240     // AES-256: 15 round keys
+
+// Round key bytes for key_bits, 0 unless 128, 192 or 256
+size_t aes_engine_schedule_bytes(int key_bits);
+
+/**
+ * FIPS-197 key expansion.
+ * return: -1 with errno EINVAL for an unsupported key size
+ */
+int aes_engine_keyexpansion(const uint8_t* key, int key_bits, uint8_t* roundKey);
+
+/**
+ * Widest engine kernel this CPU supports for key_bits: VAES on zmm, VAES on
+ * ymm, AES-NI, then software. AES_KERNEL=serial|aesni|vaes256 narrows the
+ * choice as for aes_select_bulk_kernel.
+ * name: optional, receives "vaes512", "vaes256", "aesni" or "soft"
+ * return: NULL with errno EINVAL for an unsupported key size
+ */
+aesctr_bulk_fn aes_engine_select_ctr(int key_bits, const char** name);
+aes_ecb_fn aes_engine_select_ecb(int key_bits, const char** name);
+
+// AES-128 CTR through aes_engine_select_ctr(128), recorded in stats under the kernel's backend
+void aesctr_enc_engine(uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr);
+
+#endif
@@ -0,0 +1,407 @@
+#ifndef AES_ENGINE_HPP
+#define AES_ENGINE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <immintrin.h>
+#include <cpuid.h>
+
+extern "C" {
+#include "aes.h"
+}
+
+/**
+ * Header-only AES engine: one CTR/ECB core templated over the key size
+ * (128, 192 or 256 bits, so the round count is a constant), an instruction
+ * set policy (software, AES-NI on xmm, VAES on ymm or zmm) and the number
+ * of registers kept in flight. Rounds and lanes are unrolled by fold
+ * expressions, so each instantiation compiles to straight-line code like
+ * the hand-written kernels in aesni.c and vaes.c.
+ *
+ * Policy members carry their own target attribute and the core carries
+ * none, so a kernel must be instantiated from a function built for the
+ * policy's target: AES_ENGINE_TARGET_<POLICY> names it. engine.cpp does
+ * that for the specializations behind the C interface in engine.h.
+ *
+ * Round keys use the FIPS-197 byte layout of aes_keyexpansion_serial, for
+ * every key size and policy.
+ */
+
+#define AES_ENGINE_TARGET_SOFT "default"
+#define AES_ENGINE_TARGET_AESNI "aes,sse4.1"
+#define AES_ENGINE_TARGET_VAES256 "aes,avx2,vaes"
+#define AES_ENGINE_TARGET_VAES512 "aes,avx512f,vaes"
+
+#define AES_ENGINE_INLINE __attribute__((always_inline)) inline
+
+// The core is always inlined into a function built for the policy's target, so no vector crosses a call
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace aes::engine {
+
+template <int KeyBits>
+struct key_size {
+    static_assert(KeyBits == 128 || KeyBits == 192 || KeyBits == 256, "AES keys are 128, 192 or 256 bits");
+    static constexpr int key_words = KeyBits / 32;
+    static constexpr int rounds = key_words + 6;
+    static constexpr size_t schedule_bytes = 16 * (rounds + 1);
+};
+
+namespace detail {
+
+constexpr uint8_t xtime(uint8_t x) {
+    return (uint8_t)((x << 1) ^ ((x >> 7) * 0x1b));
+}
+
+constexpr uint8_t rotl8(uint8_t x, int n) {
+    return (uint8_t)((x << n) | (x >> (8 - n)));
+}
+
+// Walks p over the powers of 3 and q over the powers of its inverse, so q = p^-1 at each step
+constexpr std::array<uint8_t, 256> make_sbox() {
+    std::array<uint8_t, 256> s{};
+    uint8_t p = 1, q = 1;
+    do {
+        p = (uint8_t)(p ^ (p << 1) ^ (p & 0x80 ? 0x1b : 0));
+        q ^= (uint8_t)(q << 1);
+        q ^= (uint8_t)(q << 2);
+        q ^= (uint8_t)(q << 4);
+        if (q & 0x80) q ^= 0x09;
+        s[p] = (uint8_t)(q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4) ^ 0x63);
+    } while (p != 1);
+    s[0] = 0x63;
+    return s;
+}
+
+template <size_t... I, typename F>
+AES_ENGINE_INLINE constexpr void unroll(std::index_sequence<I...>, F&& f) {
+    (f(std::integral_constant<size_t, I>{}), ...);
+}
+
+// f(integral_constant<size_t, i>) for i in [0, N), expanded at compile time
+template <size_t N, typename F>
+AES_ENGINE_INLINE constexpr void unroll(F&& f) {
+    unroll(std::make_index_sequence<N>{}, f);
+}
+
+}  // namespace detail
+
+inline constexpr std::array<uint8_t, 256> sbox_table = detail::make_sbox();
+static_assert(sbox_table[0x00] == 0x63 && sbox_table[0x01] == 0x7c && sbox_table[0x53] == 0xed &&
+              sbox_table[0xff] == 0x16, "S-box differs from FIPS-197");
+
+/**
+ * FIPS-197 key expansion; usable in constant expressions.
+ * roundKey: key_size<KeyBits>::schedule_bytes
+ */
+template <int KeyBits>
+constexpr void expand_key(const uint8_t* key, uint8_t* roundKey) {
+    constexpr int nk = key_size<KeyBits>::key_words;
+    constexpr int words = 4 * (key_size<KeyBits>::rounds + 1);
+    uint8_t rcon = 1;
+
+    for (int i = 0; i < 4 * nk; i++) {
+        roundKey[i] = key[i];
+    }
+    for (int i = nk; i < words; i++) {
+        uint8_t t[4] = { roundKey[4 * i - 4], roundKey[4 * i - 3], roundKey[4 * i - 2], roundKey[4 * i - 1] };
+        if (i % nk == 0) {
+            uint8_t first = t[0];
+            t[0] = (uint8_t)(sbox_table[t[1]] ^ rcon);
+            t[1] = sbox_table[t[2]];
+            t[2] = sbox_table[t[3]];
+            t[3] = sbox_table[first];
+            rcon = detail::xtime(rcon);
+        } else if (nk > 6 && i % nk == 4) {
+            for (int k = 0; k < 4; k++) t[k] = sbox_table[t[k]];
+        }
+        for (int k = 0; k < 4; k++) {
+            roundKey[4 * i + k] = (uint8_t)(roundKey[4 * (i - nk) + k] ^ t[k]);
+        }
+    }
+}
+
+//--------------------------------policies--------------------------------
+//
+// A policy supplies a block vector of `lanes` AES blocks and its round key
+// type, plus: load_key (broadcast one 16-byte round key), counters (lanes
+// consecutive CTR blocks), load/store (unaligned), xor_, enc, enclast and a
+// runtime supported() check.
+
+// Table-based rounds on bytes, for CPUs without AES instructions and for constant expressions
+struct soft {
+    static constexpr int lanes = 1;
+    static constexpr const char* name = "soft";
+    struct vec {
+        uint8_t b[16];
+    };
+    using key = vec;
+
+    static constexpr bool supported() { return true; }
+
+    static constexpr vec load(const uint8_t* p) {
+        vec v{};
+        for (int i = 0; i < 16; i++) v.b[i] = p[i];
+        return v;
+    }
+    static constexpr void store(uint8_t* p, vec v) {
+        for (int i = 0; i < 16; i++) p[i] = v.b[i];
+    }
+    static constexpr key load_key(const uint8_t* p) { return load(p); }
+
+    static constexpr vec counters(const uint8_t* nonce, uint64_t counter) {
+        vec v{};
+        for (int i = 0; i < 8; i++) {
+            v.b[i] = nonce[i];
+            v.b[8 + i] = (uint8_t)(counter >> (56 - 8 * i));
+        }
+        return v;
+    }
+
+    static constexpr vec xor_(vec a, vec b) {
+        for (int i = 0; i < 16; i++) a.b[i] ^= b.b[i];
+        return a;
+    }
+
+    // SubBytes and ShiftRows; byte r + 4c is row r of column c
+    AES_ENGINE_INLINE static constexpr vec sub_shift(vec s) {
+        vec t{};
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) {
+                t.b[r + 4 * c] = sbox_table[s.b[r + 4 * ((c + r) % 4)]];
+            }
+        }
+        return t;
+    }
+
+    AES_ENGINE_INLINE static constexpr vec enc(vec s, key k) {
+        vec t = sub_shift(s);
+        for (int c = 0; c < 4; c++) {
+            uint8_t* col = t.b + 4 * c;
+            uint8_t all = (uint8_t)(col[0] ^ col[1] ^ col[2] ^ col[3]);
+            uint8_t first = col[0];
+            col[0] ^= (uint8_t)(all ^ detail::xtime((uint8_t)(col[0] ^ col[1])));
+            col[1] ^= (uint8_t)(all ^ detail::xtime((uint8_t)(col[1] ^ col[2])));
+            col[2] ^= (uint8_t)(all ^ detail::xtime((uint8_t)(col[2] ^ col[3])));
+            col[3] ^= (uint8_t)(all ^ detail::xtime((uint8_t)(col[3] ^ first)));
+        }
+        return xor_(t, k);
+    }
+
+    static constexpr vec enclast(vec s, key k) { return xor_(sub_shift(s), k); }
+};
+
+static inline uint64_t load_nonce(const uint8_t* nonce) {
+    uint64_t n;
+    memcpy(&n, nonce, 8);
+    return n;
+}
+
+struct aesni {
+    static constexpr int lanes = 1;
+    static constexpr const char* name = "aesni";
+    using vec = __m128i;
+    using key = __m128i;
+
+    static bool supported() {
+        unsigned int eax, ebx, ecx, edx;
+        return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES);
+    }
+
+    __attribute__((target(AES_ENGINE_TARGET_AESNI))) static inline vec load(const uint8_t* p) {
+        return _mm_loadu_si128((const __m128i*)p);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_AESNI))) static inline void store(uint8_t* p, vec v) {
+        _mm_storeu_si128((__m128i*)p, v);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_AESNI))) static inline key load_key(const uint8_t* p) { return load(p); }
+    __attribute__((target(AES_ENGINE_TARGET_AESNI))) static inline vec counters(const uint8_t* nonce, uint64_t counter) {
+        return _mm_set_epi64x((long long)__builtin_bswap64(counter), (long long)load_nonce(nonce));
+    }
+    __attribute__((target(AES_ENGINE_TARGET_AESNI))) static inline vec xor_(vec a, vec b) {
+        return _mm_xor_si128(a, b);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_AESNI))) static inline vec enc(vec s, key k) {
+        return _mm_aesenc_si128(s, k);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_AESNI))) static inline vec enclast(vec s, key k) {
+        return _mm_aesenclast_si128(s, k);
+    }
+};
+
+struct vaes256 {
+    static constexpr int lanes = 2;
+    static constexpr const char* name = "vaes256";
+    using vec = __m256i;
+    using key = __m256i;
+
+    static bool supported() {
+        unsigned int eax, ebx, ecx, edx;
+        return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX2) && (ecx & bit_VAES);
+    }
+
+    __attribute__((target(AES_ENGINE_TARGET_VAES256))) static inline vec load(const uint8_t* p) {
+        return _mm256_loadu_si256((const __m256i*)p);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_VAES256))) static inline void store(uint8_t* p, vec v) {
+        _mm256_storeu_si256((__m256i*)p, v);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_VAES256))) static inline key load_key(const uint8_t* p) {
+        return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)p));
+    }
+    __attribute__((target(AES_ENGINE_TARGET_VAES256))) static inline vec counters(const uint8_t* nonce, uint64_t counter) {
+        long long n = (long long)load_nonce(nonce);
+        return _mm256_set_epi64x((long long)__builtin_bswap64(counter + 1), n, (long long)__builtin_bswap64(counter), n);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_VAES256))) static inline vec xor_(vec a, vec b) {
+        return _mm256_xor_si256(a, b);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_VAES256))) static inline vec enc(vec s, key k) {
+        return _mm256_aesenc_epi128(s, k);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_VAES256))) static inline vec enclast(vec s, key k) {
+        return _mm256_aesenclast_epi128(s, k);
+    }
+};
+
+struct vaes512 {
+    static constexpr int lanes = 4;
+    static constexpr const char* name = "vaes512";
+    using vec = __m512i;
+    using key = __m512i;
+
+    static bool supported() {
+        unsigned int eax, ebx, ecx, edx;
+        return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX512F) && (ecx & bit_VAES);
+    }
+
+    __attribute__((target(AES_ENGINE_TARGET_VAES512))) static inline vec load(const uint8_t* p) {
+        return _mm512_loadu_si512((const void*)p);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_VAES512))) static inline void store(uint8_t* p, vec v) {
+        _mm512_storeu_si512((void*)p, v);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_VAES512))) static inline key load_key(const uint8_t* p) {
+        return _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)p));
+    }
+    __attribute__((target(AES_ENGINE_TARGET_VAES512))) static inline vec counters(const uint8_t* nonce, uint64_t counter) {
+        long long n = (long long)load_nonce(nonce);
+        return _mm512_set_epi64((long long)__builtin_bswap64(counter + 3), n, (long long)__builtin_bswap64(counter + 2), n,
+                                (long long)__builtin_bswap64(counter + 1), n, (long long)__builtin_bswap64(counter), n);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_VAES512))) static inline vec xor_(vec a, vec b) {
+        return _mm512_xor_si512(a, b);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_VAES512))) static inline vec enc(vec s, key k) {
+        return _mm512_aesenc_epi128(s, k);
+    }
+    __attribute__((target(AES_ENGINE_TARGET_VAES512))) static inline vec enclast(vec s, key k) {
+        return _mm512_aesenclast_epi128(s, k);
+    }
+};
+
+//---------------------------------core----------------------------------
+
+/**
+ * Round keys of one key schedule, broadcast to the policy's vector width
+ * once per call.
+ */
+template <typename P, int KeyBits>
+struct round_keys {
+    static constexpr int rounds = key_size<KeyBits>::rounds;
+    typename P::key k[rounds + 1];
+
+    AES_ENGINE_INLINE explicit constexpr round_keys(const uint8_t* roundKey) : k{} {
+        detail::unroll<rounds + 1>([&](auto r) __attribute__((always_inline)) { k[r] = P::load_key(roundKey + 16 * r); });
+    }
+};
+
+// All rounds on Interleave independent vectors; the lanes of one round are issued back to back
+template <typename P, int KeyBits, int Interleave>
+AES_ENGINE_INLINE constexpr void encrypt_vecs(typename P::vec (&v)[Interleave], const round_keys<P, KeyBits>& ks) {
+    constexpr int rounds = key_size<KeyBits>::rounds;
+    detail::unroll<Interleave>([&](auto l) __attribute__((always_inline)) { v[l] = P::xor_(v[l], ks.k[0]); });
+    detail::unroll<rounds - 1>([&](auto r) __attribute__((always_inline)) {
+        detail::unroll<Interleave>([&](auto l) __attribute__((always_inline)) { v[l] = P::enc(v[l], ks.k[r + 1]); });
+    });
+    detail::unroll<Interleave>([&](auto l) __attribute__((always_inline)) { v[l] = P::enclast(v[l], ks.k[rounds]); });
+}
+
+/**
+ * CTR over num_blocks whole blocks from the counter block ctr, as
+ * aesctr_bulk_fn. Interleave x P::lanes blocks per iteration; the last
+ * partial group goes through a padded copy. input and output may be the
+ * same buffer.
+ */
+template <typename P, int KeyBits, int Interleave>
+AES_ENGINE_INLINE void ctr(const uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t num_blocks,
+                           const ctr_block_t& ctr) {
+    static_assert(Interleave >= 1, "at least one vector in flight");
+    constexpr size_t step = (size_t)Interleave * P::lanes;
+    const round_keys<P, KeyBits> ks(roundKey);
+    uint64_t counter = 0;
+    size_t i = 0;
+
+    for (int j = 0; j < 8; j++) {
+        counter = (counter << 8) | ctr.counter[j];
+    }
+    for (; i + step <= num_blocks; i += step) {
+        typename P::vec v[Interleave];
+        detail::unroll<Interleave>([&](auto l) __attribute__((always_inline)) {
+            v[l] = P::counters(ctr.nonce, counter + i + l * P::lanes);
+        });
+        encrypt_vecs<P, KeyBits, Interleave>(v, ks);
+        detail::unroll<Interleave>([&](auto l) __attribute__((always_inline)) {
+            const size_t off = (i + l * P::lanes) * 16;
+            P::store(output + off, P::xor_(P::load(input + off), v[l]));
+        });
+    }
+    for (; i < num_blocks; i += P::lanes) {
+        uint8_t block[16 * P::lanes] = {};
+        size_t bytes = (num_blocks - i < (size_t)P::lanes ? num_blocks - i : (size_t)P::lanes) * 16;
+        typename P::vec v[1] = { P::counters(ctr.nonce, counter + i) };
+        memcpy(block, input + i * 16, bytes);
+        encrypt_vecs<P, KeyBits, 1>(v, ks);
+        P::store(block, P::xor_(P::load(block), v[0]));
+        memcpy(output + i * 16, block, bytes);
+    }
+}
+
+// ECB over num_blocks independent blocks, as aes_ecb_fn; input and output may be the same buffer
+template <typename P, int KeyBits, int Interleave>
+AES_ENGINE_INLINE constexpr void ecb(const uint8_t* input, const uint8_t* roundKey, uint8_t* output, size_t num_blocks) {
+    constexpr size_t step = (size_t)Interleave * P::lanes;
+    const round_keys<P, KeyBits> ks(roundKey);
+    size_t i = 0;
+
+    for (; i + step <= num_blocks; i += step) {
+        typename P::vec v[Interleave];
+        detail::unroll<Interleave>([&](auto l) __attribute__((always_inline)) {
+            v[l] = P::load(input + (i + l * P::lanes) * 16);
+        });
+        encrypt_vecs<P, KeyBits, Interleave>(v, ks);
+        detail::unroll<Interleave>([&](auto l) __attribute__((always_inline)) {
+            P::store(output + (i + l * P::lanes) * 16, v[l]);
+        });
+    }
+    for (; i < num_blocks; i += P::lanes) {
+        uint8_t block[16 * P::lanes] = {};
+        size_t bytes = (num_blocks - i < (size_t)P::lanes ? num_blocks - i : (size_t)P::lanes) * 16;
+        for (size_t b = 0; b < bytes; b++) block[b] = input[i * 16 + b];
+        typename P::vec v[1] = { P::load(block) };
+        encrypt_vecs<P, KeyBits, 1>(v, ks);
+        P::store(block, v[0]);
+        for (size_t b = 0; b < bytes; b++) output[i * 16 + b] = block[b];
+    }
+}
+
+}  // namespace aes::engine
+
+#pragma GCC diagnostic pop
+
+#endif
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fileenc.h"
+#include "openmp.h"
+
+static size_t file_window = AES_FILE_DEFAULT_WINDOW;
+
+size_t aes_file_get_window() {
+    return file_window;
+}
+
+void aes_file_set_window(size_t bytes) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    file_window = bytes < page ? page : (bytes + page - 1) / page * page;
+}
+
+static void* map_window(int fd, size_t len, off_t offset, int prot) {
+    void* p = mmap(NULL, len, prot, MAP_SHARED | MAP_POPULATE, fd, offset);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(p, len, MADV_SEQUENTIAL);
+    return p;
+}
+
+// Encrypts len bytes at file offset `offset`; only the last window can end in a partial block
+static void encrypt_window(uint8_t* src, uint8_t* dst, size_t len, uint64_t offset,
+                           uint8_t* roundKey, ctr_block_t* initial_ctr) {
+    ctr_block_t ctr;
+    size_t num_blocks = len / BLOCK_SIZE;
+    size_t tail = len % BLOCK_SIZE;
+
+    ctr_block_advance(initial_ctr, &ctr, offset / BLOCK_SIZE);
+    if (num_blocks > 0) {
+        aesctr_enc_openmp(src, roundKey, dst, num_blocks, &ctr);
+    }
+
+    if (tail > 0) {
+        uint8_t block[BLOCK_SIZE] = {0};
+
+        ctr_block_advance(&ctr, &ctr, num_blocks);
+        memcpy(block, src + num_blocks * BLOCK_SIZE, tail);
+        aesctr_kernel_serial(block, roundKey, block, 1, &ctr);
+        memcpy(dst + num_blocks * BLOCK_SIZE, block, tail);
+    }
+}
+
+int64_t aes_encrypt_file(const char* in_path, const char* out_path, uint8_t* roundKey, ctr_block_t* initial_ctr) {
+    struct stat in_st, out_st;
+    int in_place = out_path == NULL;
+    int in_fd, out_fd = -1;
+    int saved_errno;
+
+    if (!in_place && stat(out_path, &out_st) == 0 && stat(in_path, &in_st) == 0 &&
+        in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino) {
+        in_place = 1;
+    }
+
+    in_fd = open(in_path, in_place ? O_RDWR : O_RDONLY);
+    if (in_fd < 0) {
+        return -1;
+    }
+    if (fstat(in_fd, &in_st) < 0) {
+        goto fail;
+    }
+
+    if (!in_place) {
+        out_fd = open(out_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (out_fd < 0 || ftruncate(out_fd, in_st.st_size) < 0) {
+            goto fail;
+        }
+    }
+
+    uint64_t size = (uint64_t)in_st.st_size;
+    size_t window = file_window;
+
+    for (uint64_t offset = 0; offset < size; offset += window) {
+        size_t len = size - offset < window ? size - offset : window;
+        uint8_t* src;
+        uint8_t* dst;
+
+        if (in_place) {
+            src = dst = map_window(in_fd, len, offset, PROT_READ | PROT_WRITE);
+            if (!src) {
+                goto fail;
+            }
+        } else {
+            src = map_window(in_fd, len, offset, PROT_READ);
+            if (!src) {
+                goto fail;
+            }
+            dst = map_window(out_fd, len, offset, PROT_READ | PROT_WRITE);
+            if (!dst) {
+                saved_errno = errno;
+                munmap(src, len);
+                errno = saved_errno;
+                goto fail;
+            }
+        }
+
+        encrypt_window(src, dst, len, offset, roundKey, initial_ctr);
+
+        // Dirty pages are written back by the kernel; unmapping keeps only one window resident
+        munmap(dst, len);
+        if (!in_place) {
+            munmap(src, len);
+        }
+    }
+
+    close(in_fd);
+    if (out_fd >= 0 && close(out_fd) < 0) {
+        return -1;
+    }
+    return (int64_t)size;
+
+fail:
+    saved_errno = errno;
+    close(in_fd);
+    if (out_fd >= 0) {
+        close(out_fd);
+    }
+    errno = saved_errno;
+    return -1;
+}
@@ -0,0 +1,24 @@
+#ifndef AES_FILEENC_H
+#define AES_FILEENC_H
+
+#include "aes.h"
+
+// Bytes mapped at a time; bounds page cache and page-table use on files larger than RAM
+#define AES_FILE_DEFAULT_WINDOW (256UL * 1024 * 1024)
+
+size_t aes_file_get_window();
+// Rounded up to a multiple of the page size
+void aes_file_set_window(size_t bytes);
+
+/**
+ * CTR-encrypts in_path into out_path through mmap windows, each window run
+ * through aesctr_enc_openmp. Byte offset o of the file uses counter
+ * initial_ctr + o / 16, so any range can be decrypted on its own. A trailing
+ * partial block is XORed with the leading bytes of its keystream block.
+ * out_path: NULL or the same file as in_path encrypts in place
+ * roundKey: serial key schedule from aes_keyexpansion_serial
+ * return: bytes processed, or -1 with errno set
+ */
+int64_t aes_encrypt_file(const char* in_path, const char* out_path, uint8_t* roundKey, ctr_block_t* initial_ctr);
+
+#endif
@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "iov.h"
+#include "dispatch.h"
+#include "affinity.h"
+#include "stats.h"
+#include "trace.h"
+
+#define KEYSTREAM_BYTES 4096    // keystream generated per kernel call for fragmented runs
+#define DIRECT_MIN 512          // block-aligned runs at least this long skip the keystream buffer
+
+// Position in a segment chain; idx == cnt once it is used up
+typedef struct {
+    const struct iovec* iov;
+    int cnt;
+    int idx;
+    size_t off;
+} cursor_t;
+
+typedef struct {
+    aes_task_t task;
+    aesctr_bulk_fn kernel;
+    uint8_t* roundKey;
+    ctr_block_t* initial_ctr;
+    cursor_t in;
+    cursor_t out;
+    size_t len;
+    uint64_t pos;               // keystream byte of the range's first byte
+} iov_range_t;
+
+static const uint8_t zeros[KEYSTREAM_BYTES] __attribute__((aligned(64)));
+
+static void cursor_skip_empty(cursor_t* c) {
+    while (c->idx < c->cnt && c->off == c->iov[c->idx].iov_len) {
+        c->idx++;
+        c->off = 0;
+    }
+}
+
+static void cursor_seek(cursor_t* c, const struct iovec* iov, int cnt, size_t skip) {
+    c->iov = iov;
+    c->cnt = cnt;
+    c->idx = 0;
+    c->off = 0;
+    while (c->idx < cnt && skip >= iov[c->idx].iov_len) {
+        skip -= iov[c->idx].iov_len;
+        c->idx++;
+    }
+    c->off = skip;
+    cursor_skip_empty(c);
+}
+
+static void cursor_advance(cursor_t* c, size_t n) {
+    c->off += n;
+    cursor_skip_empty(c);
+}
+
+static size_t cursor_avail(const cursor_t* c) {
+    return c->iov[c->idx].iov_len - c->off;
+}
+
+static uint8_t* cursor_ptr(const cursor_t* c) {
+    return (uint8_t*)c->iov[c->idx].iov_base + c->off;
+}
+
+static size_t chain_len(const struct iovec* iov, int cnt) {
+    size_t total = 0;
+    for (int i = 0; i < cnt; i++) {
+        total += iov[i].iov_len;
+    }
+    return total;
+}
+
+static void xor_bytes(uint8_t* dst, const uint8_t* src, const uint8_t* keystream, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, src + i, 8);
+        memcpy(&b, keystream + i, 8);
+        a ^= b;
+        memcpy(dst + i, &a, 8);
+    }
+    for (; i < n; i++) {
+        dst[i] = src[i] ^ keystream[i];
+    }
+}
+
+/**
+ * Walks len bytes of both chains from the given cursors. Each step covers the
+ * longest run contiguous on both sides: straight through the kernel when it
+ * is block aligned and long enough, otherwise XORed with buffered keystream,
+ * which is refilled (from the current block on) when the run leaves it.
+ */
+static void encv_range(iov_range_t* range) {
+    uint8_t keystream[KEYSTREAM_BYTES] __attribute__((aligned(64)));
+    uint64_t ks_start = 0, ks_end = 0;
+    uint64_t pos = range->pos;
+    size_t len = range->len;
+    cursor_t in = range->in;
+    cursor_t out = range->out;
+    ctr_block_t ctr;
+
+    while (len > 0) {
+        size_t run = cursor_avail(&in);
+        if (cursor_avail(&out) < run) run = cursor_avail(&out);
+        if (len < run) run = len;
+
+        size_t n;
+        if (pos >= ks_start && pos < ks_end) {
+            n = ks_end - pos < run ? (size_t)(ks_end - pos) : run;
+            xor_bytes(cursor_ptr(&out), cursor_ptr(&in), keystream + (pos - ks_start), n);
+        } else if (pos % BLOCK_SIZE == 0 && run >= DIRECT_MIN) {
+            n = run & ~(size_t)(BLOCK_SIZE - 1);
+            ctr_block_advance(range->initial_ctr, &ctr, pos / BLOCK_SIZE);
+            range->kernel(cursor_ptr(&in), range->roundKey, cursor_ptr(&out), n / BLOCK_SIZE, &ctr);
+        } else {
+            // Keystream for the rest of the range, up to the buffer size
+            uint64_t want = (pos % BLOCK_SIZE + len + BLOCK_SIZE - 1) & ~(uint64_t)(BLOCK_SIZE - 1);
+            if (want > KEYSTREAM_BYTES) want = KEYSTREAM_BYTES;
+            ks_start = pos & ~(uint64_t)(BLOCK_SIZE - 1);
+            ks_end = ks_start + want;
+            ctr_block_advance(range->initial_ctr, &ctr, ks_start / BLOCK_SIZE);
+            range->kernel((uint8_t*)zeros, range->roundKey, keystream, want / BLOCK_SIZE, &ctr);
+            continue;
+        }
+
+        cursor_advance(&in, n);
+        cursor_advance(&out, n);
+        pos += n;
+        len -= n;
+    }
+}
+
+static void iov_range_run(aes_task_t* task, int worker_idx) {
+    iov_range_t* range = (iov_range_t*)task;
+    (void)worker_idx;
+
+    AES_TRACE(AES_TRACE_CHUNK_BEGIN, "iov", range->len);
+    encv_range(range);
+    AES_TRACE(AES_TRACE_CHUNK_END, "iov", 0);
+}
+
+static void init_range(iov_range_t* range, const struct iovec* in, int in_cnt, const struct iovec* out, int out_cnt,
+                       size_t start, size_t len, uint8_t* roundKey, ctr_block_t* initial_ctr, uint64_t stream_offset,
+                       aesctr_bulk_fn kernel) {
+    range->kernel = kernel;
+    range->roundKey = roundKey;
+    range->initial_ctr = initial_ctr;
+    cursor_seek(&range->in, in, in_cnt, start);
+    cursor_seek(&range->out, out, out_cnt, start);
+    range->len = len;
+    range->pos = stream_offset + start;
+}
+
+int64_t aesctr_encv(const struct iovec* in, int in_cnt, const struct iovec* out, int out_cnt,
+                    uint8_t* roundKey, ctr_block_t* initial_ctr, uint64_t stream_offset) {
+    uint64_t start_ns = aes_stats_now_ns();
+    size_t total = chain_len(in, in_cnt);
+    iov_range_t range;
+
+    if (chain_len(out, out_cnt) != total) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    init_range(&range, in, in_cnt, out, out_cnt, 0, total, roundKey, initial_ctr, stream_offset,
+               aes_select_bulk_kernel(NULL));
+    encv_range(&range);
+
+    aes_stats_record(AES_BACKEND_IOV, total, aes_stats_now_ns() - start_ns);
+    return (int64_t)total;
+}
+
+int64_t aesctr_encv_pool(aes_pool_t* pool, const struct iovec* in, int in_cnt, const struct iovec* out, int out_cnt,
+                         uint8_t* roundKey, ctr_block_t* initial_ctr, uint64_t stream_offset) {
+    size_t total = chain_len(in, in_cnt);
+
+    if (!pool) {
+        pool = aes_pool_default();
+    }
+    int num_threads = aes_pool_num_threads(pool);
+    if (total < AES_IOV_PARALLEL_MIN || num_threads == 1) {
+        return aesctr_encv(in, in_cnt, out, out_cnt, roundKey, initial_ctr, stream_offset);
+    }
+    if (chain_len(out, out_cnt) != total) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    iov_range_t ranges[AES_MAX_THREADS];
+    aes_taskgroup_t group;
+    uint64_t start_ns = aes_stats_now_ns();
+    aesctr_bulk_fn kernel = aes_select_bulk_kernel(NULL);
+
+    // Range starts fall on keystream block boundaries, so every range can use the direct path
+    size_t lead = (BLOCK_SIZE - stream_offset % BLOCK_SIZE) % BLOCK_SIZE;
+    size_t per_thread = ((total - lead) / num_threads) & ~(size_t)(BLOCK_SIZE - 1);
+    size_t start = 0;
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "iov", total);
+    aes_taskgroup_init(&group);
+    for (int i = 0; i < num_threads && start < total; i++) {
+        size_t end = i == num_threads - 1 ? total : lead + (i + 1) * per_thread;
+        init_range(&ranges[i], in, in_cnt, out, out_cnt, start, end - start, roundKey, initial_ctr,
+                   stream_offset, kernel);
+        ranges[i].task.fn = iov_range_run;
+        ranges[i].task.arg = NULL;
+        ranges[i].task.group = &group;
+        aes_pool_submit(pool, &ranges[i].task);
+        start = end;
+    }
+    aes_taskgroup_wait(&group);
+    aes_taskgroup_destroy(&group);
+    AES_TRACE(AES_TRACE_JOB_END, "iov", 0);
+
+    aes_stats_record(AES_BACKEND_IOV, total, aes_stats_now_ns() - start_ns);
+    return (int64_t)total;
+}
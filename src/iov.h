@@ -0,0 +1,41 @@
+#ifndef AES_IOV_H
+#define AES_IOV_H
+
+#include <sys/uio.h>
+
+#include "aes.h"
+#include "pool.h"
+
+/**
+ * Scatter-gather CTR. The input segments are read as one byte stream and the
+ * output segments written as another of the same length; segment boundaries
+ * on either side are arbitrary and need not line up with each other or with
+ * 16-byte blocks. Runs that are long and block aligned go straight through
+ * the bulk kernel (see dispatch.h); fragments are XORed with keystream that
+ * is generated a few KB at a time, so small segments don't each pay for a
+ * kernel call and a block split across segments is encrypted once.
+ */
+
+#define AES_IOV_PARALLEL_MIN (1UL * 1024 * 1024)  // chains shorter than this stay on the calling thread
+
+/**
+ * Byte i of the input stream is XORed with keystream byte stream_offset + i,
+ * where keystream byte o comes from counter block initial_ctr + o / 16. Calls
+ * over consecutive parts of one message therefore chain by passing the bytes
+ * done so far as stream_offset, mid-block or not.
+ * in, out: may be the same array (in place)
+ * roundKey: serial key schedule from aes_keyexpansion_serial
+ * return: bytes processed, or -1 with errno EINVAL if the totals differ
+ */
+int64_t aesctr_encv(const struct iovec* in, int in_cnt, const struct iovec* out, int out_cnt,
+                    uint8_t* roundKey, ctr_block_t* initial_ctr, uint64_t stream_offset);
+
+/**
+ * As aesctr_encv, with chains of at least AES_IOV_PARALLEL_MIN bytes split
+ * into one block-aligned byte range per pool worker.
+ * pool: NULL for aes_pool_default()
+ */
+int64_t aesctr_encv_pool(aes_pool_t* pool, const struct iovec* in, int in_cnt, const struct iovec* out, int out_cnt,
+                         uint8_t* roundKey, ctr_block_t* initial_ctr, uint64_t stream_offset);
+
+#endif
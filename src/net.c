@@ -0,0 +1,304 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+#include "net.h"
+#include "iov.h"
+#include "buf.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+typedef struct {
+    int sock;
+    uint64_t sends;             // MSG_ZEROCOPY sends issued on this call
+    uint64_t completed;         // of those, released by the kernel
+    aes_net_stats_t* stats;
+} zc_state_t;
+
+static void resolve_opts(const aes_net_opts_t* opts, size_t* buf_size, int* buffers) {
+    *buf_size = opts && opts->buf_size ? opts->buf_size : AES_NET_DEFAULT_BUF;
+    *buf_size = (*buf_size + BLOCK_SIZE - 1) & ~(size_t)(BLOCK_SIZE - 1);
+    *buffers = opts && opts->buffers > 0 ? opts->buffers : AES_NET_DEFAULT_BUFFERS;
+}
+
+// CTR over len bytes from in to out, where in starts at byte stream_offset of the keystream
+static void ctr_at(const uint8_t* in, uint8_t* out, size_t len, const uint8_t* roundKey,
+                   const ctr_block_t* initial_ctr, uint64_t stream_offset) {
+    struct iovec src = { (void*)in, len };
+    struct iovec dst = { out, len };
+    aesctr_encv(&src, 1, &dst, 1, (uint8_t*)roundKey, (ctr_block_t*)initial_ctr, stream_offset);
+}
+
+/**
+ * Reads zerocopy completions off the socket error queue. Each notification
+ * covers a range of send calls; TCP releases them in order, so a count is
+ * enough to know which ring buffers are free again.
+ * block: wait until at least one arrives
+ * return: -1 with errno set if the socket failed
+ */
+static int reap_completions(zc_state_t* zc, int block) {
+    int got = 0;
+
+    for (;;) {
+        char control[128];
+        struct msghdr msg = {0};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(zc->sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN || !block || got) {
+                return errno == EAGAIN ? 0 : -1;
+            }
+            // POLLERR is reported whenever the error queue is non-empty
+            struct pollfd pfd = { zc->sock, 0, 0 };
+            if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+                return -1;
+            }
+            if ((pfd.revents & POLLHUP) && !(pfd.revents & POLLERR)) {
+                errno = EPIPE;
+                return -1;
+            }
+            continue;
+        }
+
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                  (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            struct sock_extended_err* serr = (struct sock_extended_err*)CMSG_DATA(cmsg);
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0) {
+                continue;
+            }
+            uint32_t n = serr->ee_data - serr->ee_info + 1;   // inclusive range of send ids
+            zc->completed += n;
+            if (zc->stats && (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)) {
+                zc->stats->zerocopy_copied += n;
+            }
+            got = 1;
+        }
+    }
+}
+
+// Sends all of buf with MSG_ZEROCOPY, plain send only if the kernel can't pin more pages
+static int send_zerocopy(zc_state_t* zc, const uint8_t* buf, size_t len) {
+    while (len > 0) {
+        ssize_t r = send(zc->sock, buf, len, MSG_ZEROCOPY | MSG_NOSIGNAL);
+        int zerocopy = 1;
+        if (r < 0 && errno == ENOBUFS) {
+            // Out of option memory for notifications: drain some, or copy if none are pending
+            if (zc->completed < zc->sends) {
+                if (reap_completions(zc, 1) < 0) return -1;
+                continue;
+            }
+            r = send(zc->sock, buf, len, MSG_NOSIGNAL);
+            zerocopy = 0;
+        }
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (zerocopy) {
+            zc->sends++;
+            if (zc->stats) zc->stats->zerocopy_sends++;
+        }
+        if (zc->stats) zc->stats->calls++;
+        buf += r;
+        len -= (size_t)r;
+    }
+    return 0;
+}
+
+static int writev_all(int sock, struct iovec* iov, int cnt, aes_net_stats_t* stats) {
+    while (cnt > 0) {
+        ssize_t r = writev(sock, iov, cnt);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (stats) stats->calls++;
+        while (cnt > 0 && (size_t)r >= iov->iov_len) {
+            r -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + r;
+            iov->iov_len -= r;
+        }
+    }
+    return 0;
+}
+
+int64_t aes_net_send_file(int sock, int file_fd, off_t offset, size_t len, const uint8_t* roundKey,
+                          const ctr_block_t* initial_ctr, const aes_net_opts_t* opts, aes_net_stats_t* stats) {
+    aes_net_stats_t local;
+    size_t buf_size;
+    int buffers;
+    int one = 1;
+    int err = 0;
+
+    if (!stats) {
+        stats = &local;
+    }
+    memset(stats, 0, sizeof(*stats));
+    resolve_opts(opts, &buf_size, &buffers);
+    if (len == 0) {
+        return 0;
+    }
+
+    // Map from the page holding offset
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t lead = (size_t)offset % page;
+    uint8_t* map = (uint8_t*)mmap(NULL, len + lead, PROT_READ, MAP_SHARED, file_fd, offset - (off_t)lead);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    madvise(map, len + lead, MADV_SEQUENTIAL);
+    const uint8_t* src = map + lead;
+
+    uint8_t* ring = (uint8_t*)aes_buf_alloc((size_t)buffers * buf_size, AES_BUF_PREFAULT);
+    uint64_t* released_at = (uint64_t*)calloc(buffers, sizeof(uint64_t));    // send count that frees each buffer
+    struct iovec* iov = (struct iovec*)malloc(buffers * sizeof(struct iovec));
+    if (!ring || !released_at || !iov) {
+        err = ENOMEM;
+        goto out;
+    }
+
+    int zerocopy = !(opts && opts->no_zerocopy) &&
+                   setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+    if (zerocopy) {
+        zc_state_t zc = { sock, 0, 0, stats };
+        size_t i = 0;
+        for (size_t off = 0; off < len; off += buf_size, i++) {
+            size_t n = len - off < buf_size ? len - off : buf_size;
+            int b = (int)(i % buffers);
+            uint8_t* buf = ring + (size_t)b * buf_size;
+
+            if (zc.completed < released_at[b]) {
+                stats->buffer_waits++;
+                while (zc.completed < released_at[b]) {
+                    if (reap_completions(&zc, 1) < 0) {
+                        err = errno;
+                        goto out;
+                    }
+                }
+            }
+            ctr_at(src + off, buf, n, roundKey, initial_ctr, off);
+            if (send_zerocopy(&zc, buf, n) < 0) {
+                err = errno;
+                goto out;
+            }
+            released_at[b] = zc.sends;
+            reap_completions(&zc, 0);
+        }
+        // The ring is freed below, so every buffer must be released first
+        while (zc.completed < zc.sends) {
+            if (reap_completions(&zc, 1) < 0) {
+                err = errno;
+                goto out;
+            }
+        }
+    } else {
+        for (size_t off = 0; off < len;) {
+            int cnt = 0;
+            for (; cnt < buffers && off < len; cnt++) {
+                size_t n = len - off < buf_size ? len - off : buf_size;
+                uint8_t* buf = ring + (size_t)cnt * buf_size;
+                ctr_at(src + off, buf, n, roundKey, initial_ctr, off);
+                iov[cnt].iov_base = buf;
+                iov[cnt].iov_len = n;
+                off += n;
+            }
+            if (writev_all(sock, iov, cnt, stats) < 0) {
+                err = errno;
+                goto out;
+            }
+        }
+    }
+    stats->bytes = len;
+
+out:
+    munmap(map, len + lead);
+    if (ring) aes_buf_free(ring);
+    free(released_at);
+    free(iov);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return (int64_t)len;
+}
+
+int64_t aes_net_recv(int sock, int out_fd, const uint8_t* roundKey, const ctr_block_t* initial_ctr,
+                     const aes_net_opts_t* opts, aes_net_stats_t* stats) {
+    aes_net_stats_t local;
+    size_t buf_size;
+    int buffers;
+    uint64_t total = 0;
+    int err = 0;
+
+    if (!stats) {
+        stats = &local;
+    }
+    memset(stats, 0, sizeof(*stats));
+    resolve_opts(opts, &buf_size, &buffers);
+    uint8_t* buf = (uint8_t*)aes_buf_alloc(buf_size, AES_BUF_PREFAULT);
+    if (!buf) {
+        return -1;
+    }
+
+    for (;;) {
+        ssize_t r = recv(sock, buf, buf_size, 0);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            err = errno;
+            break;
+        }
+        if (r == 0) {
+            break;
+        }
+        stats->calls++;
+
+        // Reads end anywhere, mid-block included; the stream offset keeps the keystream aligned
+        ctr_at(buf, buf, (size_t)r, roundKey, initial_ctr, total);
+        total += (uint64_t)r;
+
+        for (ssize_t done = 0; out_fd >= 0 && done < r;) {
+            ssize_t w = write(out_fd, buf + done, (size_t)(r - done));
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                err = errno;
+                break;
+            }
+            done += w;
+        }
+        if (err) {
+            break;
+        }
+    }
+    stats->bytes = total;
+
+    aes_buf_free(buf);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return (int64_t)total;
+}
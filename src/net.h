@@ -0,0 +1,58 @@
+#ifndef AES_NET_H
+#define AES_NET_H
+
+#include <sys/types.h>
+
+#include "aes.h"
+
+/**
+ * Encrypted file streaming over TCP. The sender maps the source file,
+ * encrypts it chunk by chunk into a small ring of preallocated buffers and
+ * sends each with MSG_ZEROCOPY, so the kernel transmits from the ring
+ * instead of copying it; a buffer is reused once its completion notification
+ * arrives on the socket error queue. Where zerocopy is unavailable (or
+ * turned off) filled buffers are gathered into one writev instead. The
+ * receiver decrypts each read in place, at whatever byte offset it ends, so
+ * no second buffer is needed on either side.
+ */
+
+#define AES_NET_DEFAULT_BUF (256UL * 1024)
+#define AES_NET_DEFAULT_BUFFERS 8
+
+typedef struct {
+    size_t buf_size;            // bytes per ring buffer (and per receive), 0 for AES_NET_DEFAULT_BUF; rounded up to 16
+    int buffers;                // sender ring size, 0 for AES_NET_DEFAULT_BUFFERS
+    int no_zerocopy;            // send with writev even where MSG_ZEROCOPY is available
+} aes_net_opts_t;
+
+typedef struct {
+    uint64_t bytes;
+    uint64_t calls;             // send, writev or recv system calls
+    uint64_t zerocopy_sends;    // sends that went out with MSG_ZEROCOPY
+    uint64_t zerocopy_copied;   // of those, ones the kernel copied anyway (always the case over loopback)
+    uint64_t buffer_waits;      // times the sender waited for a buffer's completion
+} aes_net_stats_t;
+
+/**
+ * Sends len bytes of file_fd from offset on, encrypted: byte i of the range
+ * uses keystream byte i of the CTR stream starting at initial_ctr. Returns
+ * once every zerocopy buffer has been released by the kernel.
+ * sock: a connected, blocking TCP socket
+ * roundKey: serial key schedule from aes_keyexpansion_serial
+ * opts: NULL for defaults
+ * stats: optional
+ * return: bytes sent, or -1 with errno set
+ */
+int64_t aes_net_send_file(int sock, int file_fd, off_t offset, size_t len, const uint8_t* roundKey,
+                          const ctr_block_t* initial_ctr, const aes_net_opts_t* opts, aes_net_stats_t* stats);
+
+/**
+ * Receives until the peer closes the connection, decrypting in place, and
+ * writes the plaintext to out_fd.
+ * out_fd: -1 to only count the bytes
+ * return: bytes received, or -1 with errno set
+ */
+int64_t aes_net_recv(int sock, int out_fd, const uint8_t* roundKey, const ctr_block_t* initial_ctr,
+                     const aes_net_opts_t* opts, aes_net_stats_t* stats);
+
+#endif
@@ -6,37 +6,97 @@
 #include <stdlib.h>
 
 #include "openmp.h"
+#include "dispatch.h"
+#include "affinity.h"
+#include "perfmon.h"
+#include "trace.h"
+#include "stats.h"
 
-void aesctr_enc_openmp(uint8_t* input, uint8_t* roundKey, uint8_t* output, int num_blocks, ctr_block_t* initial_ctr) {
-    uint64_t base_counter = 0;
-    for(int i = 0; i < 8; i++) {
-        base_counter = (base_counter << 8) | initial_ctr->counter[i];
-    }
+static aes_omp_schedule_t omp_schedule = AES_OMP_STATIC;
+static size_t omp_grain = AES_OMP_DEFAULT_GRAIN;
+
+aes_omp_schedule_t aes_openmp_get_schedule() {
+    return omp_schedule;
+}
+
+void aes_openmp_set_schedule(aes_omp_schedule_t schedule) {
+    omp_schedule = schedule;
+}
+
+const char* aes_openmp_schedule_name(aes_omp_schedule_t schedule) {
+    return schedule == AES_OMP_GUIDED ? "guided" : "static";
+}
+
+size_t aes_openmp_get_grain() {
+    return omp_grain;
+}
+
+void aes_openmp_set_grain(size_t blocks) {
+    // Multiples of 4 keep every chunk on the VAES fast path
+    omp_grain = blocks < 4 ? 4 : (blocks + 3) & ~(size_t)3;
+}
+
+// Runs blocks [start, start + count) through the bulk kernel
+static void run_range(aesctr_bulk_fn kernel, uint8_t* input, const uint8_t* roundKey, uint8_t* output,
+                      size_t start, size_t count, const ctr_block_t* initial_ctr) {
+    ctr_block_t ctr;
+
+    ctr_block_advance(initial_ctr, &ctr, start);
+    kernel(input + start * BLOCK_SIZE, roundKey, output + start * BLOCK_SIZE, count, &ctr);
+}
+
+void aesctr_enc_openmp(uint8_t* input, uint8_t* roundKey, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr) {
+    aesctr_bulk_fn kernel = aes_select_bulk_kernel_for(input, output, num_blocks * BLOCK_SIZE, NULL);
+    aes_omp_schedule_t schedule = omp_schedule;
+    size_t grain = omp_grain;
+    size_t num_chunks = (num_blocks + grain - 1) / grain;
 
-    #pragma omp parallel
+    int num_threads = aes_get_num_threads();
+    aes_perf_job_t* perf = aes_perfmon_job_begin("openmp", num_threads);
+    uint64_t start_ns = aes_stats_now_ns();
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "openmp", (uint64_t)num_blocks * BLOCK_SIZE);
+
+    #pragma omp parallel num_threads(num_threads)
     {
-        uint8_t counter_block[16] __attribute__((aligned(16)));
-        uint8_t keystream[16] __attribute__((aligned(16)));
-        
-        #pragma omp for schedule(dynamic, 256)
-        for(int block = 0; block < num_blocks; block++) {
-            uint64_t counter_value = base_counter + block;
-            
-            // Setup counter block
-            setup_counter_block(counter_block, initial_ctr->nonce, counter_value);
-            
-            // Encrypt counter block
-            // AES_Encrypt_Block(counter_block, roundKey, keystream);
-            aes_enc1block_serial(counter_block, roundKey, keystream);
-
-            
-            // XOR using 64-bit operations
-            uint64_t* block_input = (uint64_t*)(input + (block * 16));
-            uint64_t* block_output = (uint64_t*)(output + (block * 16));
-            uint64_t* ks = (uint64_t*)keystream;
-            
-            block_output[0] = block_input[0] ^ ks[0];
-            block_output[1] = block_input[1] ^ ks[1];
+        aes_perf_ctx_t perf_ctx;
+        uint64_t thread_blocks = 0;
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+
+        aes_pin_thread(tid);
+        aes_perfmon_thread_begin(perf, &perf_ctx);
+
+        if (schedule == AES_OMP_STATIC) {
+            // Contiguous ranges in multiples of 4 blocks, the last thread takes the remainder
+            size_t per_thread = (num_blocks / nthreads) & ~(size_t)3;
+            size_t start = (size_t)tid * per_thread;
+            size_t count = tid == nthreads - 1 ? num_blocks - start : per_thread;
+
+            AES_TRACE(AES_TRACE_CHUNK_BEGIN, "openmp", count * BLOCK_SIZE);
+            if (count > 0) {
+                run_range(kernel, input, roundKey, output, start, count, initial_ctr);
+            }
+            thread_blocks = count;
+            AES_TRACE(AES_TRACE_CHUNK_END, "openmp", 0);
+        } else {
+            // nowait: the region's closing barrier would otherwise count as busy time
+            #pragma omp for schedule(guided) nowait
+            for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+                size_t start = chunk * grain;
+                size_t count = num_blocks - start < grain ? num_blocks - start : grain;
+
+                AES_TRACE(AES_TRACE_CHUNK_BEGIN, "openmp", count * BLOCK_SIZE);
+                run_range(kernel, input, roundKey, output, start, count, initial_ctr);
+                AES_TRACE(AES_TRACE_CHUNK_END, "openmp", 0);
+                thread_blocks += count;
+            }
         }
+
+        aes_perfmon_thread_end(perf, &perf_ctx, tid, thread_blocks * BLOCK_SIZE);
     }
-}
\ No newline at end of file
+
+    AES_TRACE(AES_TRACE_JOB_END, "openmp", 0);
+    aes_stats_record(AES_BACKEND_OPENMP, (uint64_t)num_blocks * BLOCK_SIZE, aes_stats_now_ns() - start_ns);
+    aes_perfmon_job_end(perf);
+}
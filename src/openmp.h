@@ -1,12 +1,31 @@
-
-#ifndef AESNI_H
-#define AESNI_H
+#ifndef AES_OPENMP_H
+#define AES_OPENMP_H
 
 #include "aes.h"
 #include <omp.h>
 
+typedef enum {
+    AES_OMP_STATIC = 0, // one contiguous range per thread
+    AES_OMP_GUIDED      // grain-sized chunks handed out with schedule(guided)
+} aes_omp_schedule_t;
+
+#define AES_OMP_DEFAULT_GRAIN 16384  // blocks, 256KB
+
 int  check_aesni_support();
 
-void aesctr_enc_openmp(uint8_t* input, uint8_t* key_schedule, uint8_t* output, int num_blocks, ctr_block_t* initial_ctr);
+/**
+ * Splits num_blocks across aes_get_num_threads() threads, each range run
+ * through the widest bulk kernel the CPU supports (see dispatch.h).
+ * roundKey: serial key schedule from aes_keyexpansion_serial
+ */
+void aesctr_enc_openmp(uint8_t* input, uint8_t* roundKey, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr);
+
+aes_omp_schedule_t aes_openmp_get_schedule();
+void aes_openmp_set_schedule(aes_omp_schedule_t schedule);
+const char* aes_openmp_schedule_name(aes_omp_schedule_t schedule);
+
+// Chunk size in blocks for AES_OMP_GUIDED, rounded up to a multiple of 4
+size_t aes_openmp_get_grain();
+void aes_openmp_set_grain(size_t blocks);
 
 #endif
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "page.h"
+#include "dispatch.h"
+#include "affinity.h"
+#include "stats.h"
+#include "trace.h"
+
+typedef struct {
+    aes_task_t task;
+    aes_page_t* pages;
+    size_t count;
+    size_t page_size;
+    uint64_t file_id;
+    const uint8_t* roundKey;
+    aesctr_bulk_fn kernel;
+} page_range_t;
+
+static void page_range_encrypt(const page_range_t* range) {
+    size_t page_blocks = range->page_size / BLOCK_SIZE;
+    ctr_block_t ctr;
+
+    for (size_t i = 0; i < range->count; i++) {
+        aes_page_t* page = &range->pages[i];
+        aes_page_ctr(range->file_id, page->page_no, range->page_size, &ctr);
+        range->kernel((uint8_t*)page->src, range->roundKey, page->dst, page_blocks, &ctr);
+    }
+}
+
+static void page_range_run(aes_task_t* task, int worker_idx) {
+    page_range_t* range = (page_range_t*)task;
+    (void)worker_idx;
+
+    AES_TRACE(AES_TRACE_CHUNK_BEGIN, "page", range->count * range->page_size);
+    page_range_encrypt(range);
+    AES_TRACE(AES_TRACE_CHUNK_END, "page", 0);
+}
+
+static void init_range(page_range_t* range, aes_page_t* pages, size_t count, size_t page_size, uint64_t file_id,
+                       const uint8_t* roundKey, aesctr_bulk_fn kernel) {
+    range->pages = pages;
+    range->count = count;
+    range->page_size = page_size;
+    range->file_id = file_id;
+    range->roundKey = roundKey;
+    range->kernel = kernel;
+}
+
+// Kernel for the whole batch, judged by its first page and total size
+static aesctr_bulk_fn batch_kernel(const aes_page_t* pages, size_t count, size_t bytes) {
+    if (count == 0) {
+        return aes_select_bulk_kernel(NULL);
+    }
+    return aes_select_bulk_kernel_for(pages[0].src, pages[0].dst, bytes, NULL);
+}
+
+void aes_page_ctr(uint64_t file_id, uint64_t page_no, size_t page_size, ctr_block_t* ctr) {
+    ctr_block_t base;
+    for (int i = 0; i < 8; i++) {
+        base.nonce[i] = (uint8_t)(file_id >> (56 - 8 * i));
+    }
+    memset(base.counter, 0, sizeof(base.counter));
+    ctr_block_advance(&base, ctr, page_no * (page_size / BLOCK_SIZE));
+}
+
+int64_t aesctr_enc_pages(aes_page_t* pages, size_t count, size_t page_size, uint64_t file_id,
+                         const uint8_t* roundKey) {
+    uint64_t start_ns = aes_stats_now_ns();
+    size_t total = count * page_size;
+    page_range_t range;
+
+    if (page_size == 0 || page_size % BLOCK_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    init_range(&range, pages, count, page_size, file_id, roundKey, batch_kernel(pages, count, total));
+    page_range_encrypt(&range);
+
+    aes_stats_record(AES_BACKEND_PAGE, total, aes_stats_now_ns() - start_ns);
+    return (int64_t)total;
+}
+
+int64_t aesctr_enc_pages_pool(aes_pool_t* pool, aes_page_t* pages, size_t count, size_t page_size,
+                              uint64_t file_id, const uint8_t* roundKey) {
+    size_t total = count * page_size;
+
+    if (!pool) {
+        pool = aes_pool_default();
+    }
+    int num_threads = aes_pool_num_threads(pool);
+    if (total < AES_PAGE_PARALLEL_MIN || num_threads == 1 || page_size == 0 || page_size % BLOCK_SIZE) {
+        return aesctr_enc_pages(pages, count, page_size, file_id, roundKey);
+    }
+
+    page_range_t ranges[AES_MAX_THREADS];
+    aes_taskgroup_t group;
+    uint64_t start_ns = aes_stats_now_ns();
+    aesctr_bulk_fn kernel = batch_kernel(pages, count, total);
+    size_t per_thread = count / num_threads;
+    size_t extra = count % num_threads;
+    size_t first = 0;
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "page", total);
+    aes_taskgroup_init(&group);
+    for (int i = 0; i < num_threads && first < count; i++) {
+        size_t n = per_thread + ((size_t)i < extra);
+        init_range(&ranges[i], pages + first, n, page_size, file_id, roundKey, kernel);
+        ranges[i].task.fn = page_range_run;
+        ranges[i].task.arg = NULL;
+        ranges[i].task.group = &group;
+        aes_pool_submit(pool, &ranges[i].task);
+        first += n;
+    }
+    aes_taskgroup_wait(&group);
+    aes_taskgroup_destroy(&group);
+    AES_TRACE(AES_TRACE_JOB_END, "page", 0);
+
+    aes_stats_record(AES_BACKEND_PAGE, total, aes_stats_now_ns() - start_ns);
+    return (int64_t)total;
+}
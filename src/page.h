@@ -0,0 +1,46 @@
+#ifndef AES_PAGE_H
+#define AES_PAGE_H
+
+#include "aes.h"
+#include "pool.h"
+
+/**
+ * Page-granular CTR for storage engines: a batch of fixed-size pages, not
+ * necessarily adjacent, each with its counter derived from (file id, page
+ * number). Page n of a file is encrypted exactly as bytes n * page_size
+ * onwards of one CTR stream with nonce = big-endian file_id and counter 0,
+ * so a file written page by page decrypts as a whole (see fileenc.h) and
+ * vice versa. Rewriting a page in place reuses its keystream; engines that
+ * do so should fold a write generation into file_id.
+ */
+
+#define AES_PAGE_PARALLEL_MIN (256UL * 1024)    // batches smaller than this stay on the calling thread
+
+typedef struct {
+    uint64_t page_no;
+    const uint8_t* src;
+    uint8_t* dst;               // may equal src
+} aes_page_t;
+
+// Counter block of the first block of a page
+void aes_page_ctr(uint64_t file_id, uint64_t page_no, size_t page_size, ctr_block_t* ctr);
+
+/**
+ * Encrypts (or decrypts) count pages of page_size bytes each through the
+ * widest bulk kernel, streaming stores included (see store.h).
+ * page_size: a non-zero multiple of 16, typically 4, 8 or 16 KB
+ * roundKey: serial key schedule from aes_keyexpansion_serial
+ * return: bytes processed, or -1 with errno EINVAL for a bad page size
+ */
+int64_t aesctr_enc_pages(aes_page_t* pages, size_t count, size_t page_size, uint64_t file_id,
+                         const uint8_t* roundKey);
+
+/**
+ * As aesctr_enc_pages, with batches of at least AES_PAGE_PARALLEL_MIN bytes
+ * split into equal runs of pages, one per pool worker.
+ * pool: NULL for aes_pool_default()
+ */
+int64_t aesctr_enc_pages_pool(aes_pool_t* pool, aes_page_t* pages, size_t count, size_t page_size,
+                              uint64_t file_id, const uint8_t* roundKey);
+
+#endif
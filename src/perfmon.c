@@ -0,0 +1,202 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perfmon.h"
+
+#define NUM_COUNTERS AES_PERFMON_COUNTERS
+
+static int perfmon_on = -1;     // -1 until the environment has been read
+static FILE* perfmon_out;
+static int warned_unavailable;
+
+static const uint64_t counter_configs[NUM_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,     // last-level cache misses on most PMUs
+    PERF_COUNT_HW_REF_CPU_CYCLES,
+};
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int aes_perfmon_enabled() {
+    if (perfmon_on < 0) {
+        const char* env = getenv("AES_PERFMON");
+        perfmon_on = env && env[0] && env[0] != '0';
+        perfmon_out = stderr;
+    }
+    return perfmon_on;
+}
+
+void aes_perfmon_enable(int enable) {
+    aes_perfmon_enabled();
+    perfmon_on = enable != 0;
+}
+
+void aes_perfmon_set_output(FILE* out) {
+    aes_perfmon_enabled();
+    perfmon_out = out;
+}
+
+aes_perf_job_t* aes_perfmon_job_begin(const char* driver, int num_threads) {
+    if (__builtin_expect(!aes_perfmon_enabled(), 1)) {
+        return NULL;
+    }
+
+    aes_perf_job_t* job = (aes_perf_job_t*)calloc(1, sizeof(aes_perf_job_t));
+    if (!job) {
+        return NULL;
+    }
+    job->driver = driver;
+    job->num_threads = num_threads < AES_MAX_THREADS ? num_threads : AES_MAX_THREADS;
+    job->start_ns = now_ns();
+    return job;
+}
+
+static long perf_event_open(struct perf_event_attr* attr, int group_fd) {
+    // This thread, any CPU
+    return syscall(__NR_perf_event_open, attr, 0, -1, group_fd, 0);
+}
+
+static void close_counters(int* fds) {
+    for(int i = 0; i < NUM_COUNTERS; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+        fds[i] = -1;
+    }
+}
+
+// Opens the group into fds, or leaves every fd at -1
+static int open_counters(int* fds) {
+    for(int i = 0; i < NUM_COUNTERS; i++) {
+        fds[i] = -1;
+    }
+    for(int i = 0; i < NUM_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = counter_configs[i];
+        attr.disabled = (i == 0);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        fds[i] = (int)perf_event_open(&attr, fds[0]);
+        if (fds[i] < 0) {
+            // Each member is its own fd; closing the leader leaves the others open
+            close_counters(fds);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void aes_perfmon_thread_begin(aes_perf_job_t* job, aes_perf_ctx_t* ctx) {
+    if (__builtin_expect(job == NULL, 1)) {
+        return;
+    }
+
+    int ok = open_counters(ctx->fds) == 0;
+    if (!ok && !__atomic_exchange_n(&warned_unavailable, 1, __ATOMIC_RELAXED) && perfmon_out) {
+        fprintf(perfmon_out, "perfmon: hardware counters unavailable, reporting times only\n");
+    }
+    if (ok) {
+        ioctl(ctx->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(ctx->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    ctx->start_ns = now_ns();
+}
+
+void aes_perfmon_thread_end(aes_perf_job_t* job, aes_perf_ctx_t* ctx, int thread_idx, uint64_t bytes) {
+    if (__builtin_expect(job == NULL, 1)) {
+        return;
+    }
+
+    uint64_t end_ns = now_ns();
+    aes_perf_thread_t* t = &job->threads[thread_idx];
+
+    t->bytes = bytes;
+    t->start_ns = ctx->start_ns - job->start_ns;
+    t->busy_ns = end_ns - ctx->start_ns;
+
+    if (ctx->fds[0] >= 0) {
+        struct { uint64_t nr; uint64_t values[NUM_COUNTERS]; } data;
+
+        ioctl(ctx->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        if (read(ctx->fds[0], &data, sizeof(data)) == sizeof(data)) {
+            t->cycles = data.values[0];
+            t->instructions = data.values[1];
+            t->llc_misses = data.values[2];
+            t->ref_cycles = data.values[3];
+            t->counters_ok = 1;
+        }
+        close_counters(ctx->fds);
+    }
+}
+
+void aes_perfmon_job_end(aes_perf_job_t* job) {
+    if (__builtin_expect(job == NULL, 1)) {
+        return;
+    }
+
+    job->wall_ns = now_ns() - job->start_ns;
+    for(int i = 0; i < job->num_threads; i++) {
+        aes_perf_thread_t* t = &job->threads[i];
+        t->wait_ns = job->wall_ns > t->busy_ns ? job->wall_ns - t->busy_ns : 0;
+    }
+
+    if (perfmon_out) {
+        aes_perfmon_report(job, perfmon_out);
+    }
+    free(job);
+}
+
+void aes_perfmon_report(const aes_perf_job_t* job, FILE* out) {
+    uint64_t max_busy = 0, total_busy = 0, total_bytes = 0;
+
+    for(int i = 0; i < job->num_threads; i++) {
+        const aes_perf_thread_t* t = &job->threads[i];
+        total_busy += t->busy_ns;
+        total_bytes += t->bytes;
+        if (t->busy_ns > max_busy) {
+            max_busy = t->busy_ns;
+        }
+    }
+
+    double mean_busy = job->num_threads ? (double)total_busy / job->num_threads : 0;
+    fprintf(out, "perfmon: %s, %d threads, %.3f ms wall, %.2f GB/s, imbalance %.2f (max/mean busy)\n",
+            job->driver, job->num_threads, job->wall_ns / 1e6,
+            job->wall_ns ? total_bytes / (job->wall_ns / 1e9) / (1024.0 * 1024.0 * 1024.0) : 0.0,
+            mean_busy > 0 ? max_busy / mean_busy : 0.0);
+    fprintf(out, "%6s %12s %9s %9s %9s %6s %10s %9s\n",
+            "thread", "bytes", "start ms", "busy ms", "wait ms", "IPC", "LLCmiss/KB", "freq/ref");
+
+    for(int i = 0; i < job->num_threads; i++) {
+        const aes_perf_thread_t* t = &job->threads[i];
+
+        fprintf(out, "%6d %12llu %9.3f %9.3f %9.3f", i, (unsigned long long)t->bytes,
+                t->start_ns / 1e6, t->busy_ns / 1e6, t->wait_ns / 1e6);
+        if (t->counters_ok && t->cycles && t->ref_cycles) {
+            fprintf(out, " %6.2f %10.3f %9.2f\n",
+                    (double)t->instructions / t->cycles,
+                    t->bytes ? t->llc_misses / (t->bytes / 1024.0) : 0.0,
+                    (double)t->cycles / t->ref_cycles);
+        } else {
+            fprintf(out, " %6s %10s %9s\n", "-", "-", "-");
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef AES_PERFMON_H
+#define AES_PERFMON_H
+
+#include "aes.h"
+#include "affinity.h"
+
+/**
+ * Optional per-thread instrumentation for the parallel drivers.
+ * Off by default; enable with aes_perfmon_enable(1) or AES_PERFMON=1 in the
+ * environment. When off, each driver pays one predictable branch per job.
+ * Hardware counters come from perf_event_open and are left at zero if the
+ * kernel refuses them (perf_event_paranoid, containers, no PMU).
+ */
+
+#define AES_PERFMON_COUNTERS 4  // cycles, instructions, LLC misses, ref-cycles
+
+typedef struct {
+    int fds[AES_PERFMON_COUNTERS];  // fds[0] leads the group; all -1 if counters are unavailable
+    uint64_t start_ns;
+} aes_perf_ctx_t;
+
+typedef struct {
+    uint64_t bytes;
+    uint64_t start_ns;          // relative to job start
+    uint64_t busy_ns;
+    uint64_t wait_ns;           // job wall time not spent on this thread's work
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t llc_misses;
+    uint64_t ref_cycles;        // constant-rate cycles; cycles / ref_cycles shows frequency drops
+    int counters_ok;
+} aes_perf_thread_t;
+
+typedef struct {
+    const char* driver;
+    int num_threads;
+    uint64_t start_ns;
+    uint64_t wall_ns;
+    aes_perf_thread_t threads[AES_MAX_THREADS];
+} aes_perf_job_t;
+
+int  aes_perfmon_enabled();
+void aes_perfmon_enable(int enable);
+
+// Where job reports go, stderr by default; NULL silences them
+void aes_perfmon_set_output(FILE* out);
+
+/**
+ * Starts a job, or returns NULL when instrumentation is off.
+ * The drivers pass the result to their workers and to aes_perfmon_job_end.
+ */
+aes_perf_job_t* aes_perfmon_job_begin(const char* driver, int num_threads);
+void aes_perfmon_job_end(aes_perf_job_t* job);
+
+// Called on the worker thread around its share of the job; no-ops for a NULL job
+void aes_perfmon_thread_begin(aes_perf_job_t* job, aes_perf_ctx_t* ctx);
+void aes_perfmon_thread_end(aes_perf_job_t* job, aes_perf_ctx_t* ctx, int thread_idx, uint64_t bytes);
+
+void aes_perfmon_report(const aes_perf_job_t* job, FILE* out);
+
+#endif
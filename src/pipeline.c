@@ -0,0 +1,738 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/io_uring.h>
+// linux/fs.h, pulled in above, has its own BLOCK_SIZE; aes.h's 16-byte one applies here
+#undef BLOCK_SIZE
+
+#include "pipeline.h"
+#include "dispatch.h"
+#include "stats.h"
+#include "trace.h"
+#include "buf.h"
+
+#define PIPELINE_IO_THREADS 4
+#define EVENTFD_TAG UINT64_MAX
+#define RING_POLL_NS 1000000L   // completion poll interval once io_uring_enter fails
+
+typedef enum {
+    BUF_FREE = 0,
+    BUF_READING,
+    BUF_ENCRYPTING,
+    BUF_WRITING
+} buf_state_t;
+
+typedef struct pipeline pipeline_t;
+
+typedef struct pbuf {
+    aes_task_t task;
+    pipeline_t* pipe;
+    int idx;
+    uint8_t* data;
+    buf_state_t state;
+    uint64_t offset;            // file offset of data[0]
+    size_t len;                 // valid bytes
+    size_t io_len;              // bytes to transfer, len rounded up for O_DIRECT
+    size_t done;                // bytes transferred so far in the current state
+    ssize_t res;                // result of the last read/write
+    struct pbuf* next;          // free list, event list or I/O queue
+} pbuf_t;
+
+// Minimal io_uring over the raw syscalls, used only from the driver thread
+typedef struct {
+    int fd;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_ptr;
+    size_t sq_len;
+    void* cq_ptr;
+    size_t cq_len;
+    size_t sqes_len;
+    unsigned to_submit;
+} ring_t;
+
+struct pipeline {
+    int in_fd;
+    int out_fd;
+    uint8_t* roundKey;
+    ctr_block_t* initial_ctr;
+    aesctr_bulk_fn kernel;
+    aes_pool_t* pool;
+    aes_prio_t prio;
+    int direct;
+
+    pbuf_t* bufs;
+    int depth;
+    size_t buf_size;
+    pbuf_t* free_list;
+
+    // Completions posted by pool workers and, in thread mode, by the I/O threads
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pbuf_t* events;
+
+    aes_pipeline_io_t io;
+    ring_t ring;
+    int registered;
+    int efd;
+    uint64_t efd_value;
+
+    // Thread mode: requests for the I/O threads
+    pbuf_t* io_head;
+    pbuf_t* io_tail;
+    int io_shutdown;
+    pthread_cond_t io_cond;
+    pthread_t io_threads[PIPELINE_IO_THREADS];
+    int num_io_threads;
+
+    aes_pipeline_stats_t stats;
+};
+
+const char* aes_pipeline_io_name(aes_pipeline_io_t io) {
+    switch (io) {
+        case AES_PIPELINE_URING:   return "io_uring";
+        case AES_PIPELINE_THREADS: return "threads";
+        default:                   return "auto";
+    }
+}
+
+//----------------------------------io_uring----------------------------------
+
+static int ring_setup(ring_t* ring, unsigned entries) {
+    struct io_uring_params p;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&p, 0, sizeof(p));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (ring->fd < 0) {
+        return -1;
+    }
+
+    ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_len > ring->sq_len) ring->sq_len = ring->cq_len;
+        ring->cq_len = ring->sq_len;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        goto fail;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            munmap(ring->sq_ptr, ring->sq_len);
+            goto fail;
+        }
+    }
+
+    ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_len);
+        munmap(ring->sq_ptr, ring->sq_len);
+        goto fail;
+    }
+
+    uint8_t* sq = (uint8_t*)ring->sq_ptr;
+    uint8_t* cq = (uint8_t*)ring->cq_ptr;
+    ring->sq_head = (unsigned*)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + p.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 0;
+
+fail:
+    close(ring->fd);
+    ring->fd = -1;
+    return -1;
+}
+
+static void ring_teardown(ring_t* ring) {
+    munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_len);
+    munmap(ring->sq_ptr, ring->sq_len);
+    close(ring->fd);
+}
+
+// The ring has an entry for every buffer plus the eventfd read, so this never runs out
+static struct io_uring_sqe* ring_get_sqe(ring_t* ring) {
+    unsigned tail = *ring->sq_tail;
+    unsigned idx = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[idx] = idx;
+    return sqe;
+}
+
+static void ring_commit_sqe(ring_t* ring) {
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+}
+
+static int ring_enter(ring_t* ring, unsigned min_complete) {
+    for (;;) {
+        int ret = (int)syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, min_complete,
+                               min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (ret >= 0) {
+            ring->to_submit -= ret;
+            return 0;
+        }
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+//----------------------------------I/O submission----------------------------------
+
+static void queue_io(pipeline_t* pipe, pbuf_t* buf);
+
+static void submit_uring(pipeline_t* pipe, pbuf_t* buf) {
+    struct io_uring_sqe* sqe = ring_get_sqe(&pipe->ring);
+    int writing = buf->state == BUF_WRITING;
+
+    if (pipe->registered) {
+        sqe->opcode = writing ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = buf->idx;
+    } else {
+        sqe->opcode = writing ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sqe->fd = writing ? pipe->out_fd : pipe->in_fd;
+    sqe->off = buf->offset + buf->done;
+    sqe->addr = (uint64_t)(uintptr_t)(buf->data + buf->done);
+    sqe->len = (unsigned)(buf->io_len - buf->done);
+    sqe->user_data = (uint64_t)buf->idx;
+    ring_commit_sqe(&pipe->ring);
+}
+
+static void arm_eventfd(pipeline_t* pipe) {
+    struct io_uring_sqe* sqe = ring_get_sqe(&pipe->ring);
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = pipe->efd;
+    sqe->addr = (uint64_t)(uintptr_t)&pipe->efd_value;
+    sqe->len = sizeof(pipe->efd_value);
+    sqe->user_data = EVENTFD_TAG;
+    ring_commit_sqe(&pipe->ring);
+}
+
+static void start_io(pipeline_t* pipe, pbuf_t* buf) {
+    if (buf->state == BUF_WRITING) {
+        pipe->stats.writes++;
+    } else {
+        pipe->stats.reads++;
+    }
+
+    if (pipe->io == AES_PIPELINE_URING) {
+        submit_uring(pipe, buf);
+    } else {
+        queue_io(pipe, buf);
+    }
+}
+
+// Completions from other threads; the driver picks them up in wait_events
+static void post_event(pipeline_t* pipe, pbuf_t* buf) {
+    pthread_mutex_lock(&pipe->lock);
+    buf->next = pipe->events;
+    pipe->events = buf;
+    pthread_cond_signal(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+
+    if (pipe->io == AES_PIPELINE_URING) {
+        uint64_t one = 1;
+        ssize_t ignored = write(pipe->efd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+//----------------------------------thread fallback----------------------------------
+
+static void queue_io(pipeline_t* pipe, pbuf_t* buf) {
+    buf->next = NULL;
+    pthread_mutex_lock(&pipe->lock);
+    if (pipe->io_tail) {
+        pipe->io_tail->next = buf;
+    } else {
+        pipe->io_head = buf;
+    }
+    pipe->io_tail = buf;
+    pthread_cond_signal(&pipe->io_cond);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+static void* io_thread(void* arg) {
+    pipeline_t* pipe = (pipeline_t*)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pipe->lock);
+        while (!pipe->io_head && !pipe->io_shutdown) {
+            pthread_cond_wait(&pipe->io_cond, &pipe->lock);
+        }
+        pbuf_t* buf = pipe->io_head;
+        if (!buf) {
+            pthread_mutex_unlock(&pipe->lock);
+            return NULL;
+        }
+        pipe->io_head = buf->next;
+        if (!pipe->io_head) {
+            pipe->io_tail = NULL;
+        }
+        pthread_mutex_unlock(&pipe->lock);
+
+        if (buf->state == BUF_WRITING) {
+            buf->res = pwrite(pipe->out_fd, buf->data + buf->done, buf->io_len - buf->done, buf->offset + buf->done);
+        } else {
+            buf->res = pread(pipe->in_fd, buf->data + buf->done, buf->io_len - buf->done, buf->offset + buf->done);
+        }
+        if (buf->res < 0) {
+            buf->res = -errno;
+        }
+        post_event(pipe, buf);
+    }
+}
+
+//----------------------------------encryption----------------------------------
+
+static void encrypt_buf(aes_task_t* task, int worker_idx) {
+    pbuf_t* buf = (pbuf_t*)task;
+    pipeline_t* pipe = buf->pipe;
+    size_t num_blocks = buf->len / BLOCK_SIZE;
+    size_t tail = buf->len % BLOCK_SIZE;
+    uint64_t start_ns = aes_stats_now_ns();
+    ctr_block_t ctr;
+    (void)worker_idx;
+
+    AES_TRACE(AES_TRACE_CHUNK_BEGIN, "pipeline", buf->len);
+    ctr_block_advance(pipe->initial_ctr, &ctr, buf->offset / BLOCK_SIZE);
+    pipe->kernel(buf->data, pipe->roundKey, buf->data, num_blocks, &ctr);
+
+    // Only the buffer at the end of the file can end in a partial block
+    if (tail > 0) {
+        uint8_t block[BLOCK_SIZE] = {0};
+
+        ctr_block_advance(&ctr, &ctr, num_blocks);
+        memcpy(block, buf->data + num_blocks * BLOCK_SIZE, tail);
+        aesctr_kernel_serial(block, pipe->roundKey, block, 1, &ctr);
+        memcpy(buf->data + num_blocks * BLOCK_SIZE, block, tail);
+    }
+    AES_TRACE(AES_TRACE_CHUNK_END, "pipeline", 0);
+    aes_stats_record(AES_BACKEND_POOL, buf->len, aes_stats_now_ns() - start_ns);
+
+    buf->res = 0;
+    post_event(pipe, buf);
+}
+
+//----------------------------------driver----------------------------------
+
+static size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+static int open_files(pipeline_t* pipe, const char* in_path, const char* out_path, int direct, uint64_t* size) {
+    struct stat in_st, out_st;
+    int in_place = out_path == NULL;
+    int flags = direct ? O_DIRECT : 0;
+
+    if (!in_place && stat(out_path, &out_st) == 0 && stat(in_path, &in_st) == 0 &&
+        in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino) {
+        in_place = 1;
+    }
+
+    pipe->in_fd = open(in_path, (in_place ? O_RDWR : O_RDONLY) | flags);
+    if (pipe->in_fd < 0 && direct && errno == EINVAL) {
+        // Filesystem without O_DIRECT support (tmpfs); run buffered
+        return open_files(pipe, in_path, out_path, 0, size);
+    }
+    if (pipe->in_fd < 0 || fstat(pipe->in_fd, &in_st) < 0) {
+        return -1;
+    }
+
+    if (in_place) {
+        pipe->out_fd = pipe->in_fd;
+    } else {
+        pipe->out_fd = open(out_path, O_RDWR | O_CREAT | O_TRUNC | flags, 0644);
+        if (pipe->out_fd < 0 && direct && errno == EINVAL) {
+            close(pipe->in_fd);
+            return open_files(pipe, in_path, out_path, 0, size);
+        }
+        if (pipe->out_fd < 0) {
+            int saved_errno = errno;
+            close(pipe->in_fd);
+            errno = saved_errno;
+            return -1;
+        }
+    }
+
+    pipe->direct = direct;
+    *size = (uint64_t)in_st.st_size;
+    return 0;
+}
+
+static int start_uring(pipeline_t* pipe) {
+    if (ring_setup(&pipe->ring, (unsigned)pipe->depth + 1) < 0) {
+        return -1;
+    }
+    pipe->efd = eventfd(0, EFD_CLOEXEC);
+    if (pipe->efd < 0) {
+        ring_teardown(&pipe->ring);
+        return -1;
+    }
+
+    // Fixed buffers skip the per-request page pinning; RLIMIT_MEMLOCK may refuse them
+    struct iovec* iov = (struct iovec*)malloc(pipe->depth * sizeof(struct iovec));
+    if (iov) {
+        for (int i = 0; i < pipe->depth; i++) {
+            iov[i].iov_base = pipe->bufs[i].data;
+            iov[i].iov_len = pipe->buf_size;
+        }
+        pipe->registered = syscall(__NR_io_uring_register, pipe->ring.fd, IORING_REGISTER_BUFFERS,
+                                   iov, pipe->depth) == 0;
+        free(iov);
+    }
+
+    pipe->io = AES_PIPELINE_URING;
+    arm_eventfd(pipe);
+    return 0;
+}
+
+static void start_threads(pipeline_t* pipe) {
+    pipe->io = AES_PIPELINE_THREADS;
+    pthread_cond_init(&pipe->io_cond, NULL);
+    for (int i = 0; i < PIPELINE_IO_THREADS; i++) {
+        if (pthread_create(&pipe->io_threads[i], NULL, io_thread, pipe) != 0) {
+            break;
+        }
+        pipe->num_io_threads++;
+    }
+}
+
+static void stop_io(pipeline_t* pipe) {
+    if (pipe->io == AES_PIPELINE_URING) {
+        ring_teardown(&pipe->ring);
+        close(pipe->efd);
+        return;
+    }
+
+    pthread_mutex_lock(&pipe->lock);
+    pipe->io_shutdown = 1;
+    pthread_cond_broadcast(&pipe->io_cond);
+    pthread_mutex_unlock(&pipe->lock);
+    for (int i = 0; i < pipe->num_io_threads; i++) {
+        pthread_join(pipe->io_threads[i], NULL);
+    }
+    pthread_cond_destroy(&pipe->io_cond);
+}
+
+// Waits up to timeout_ns for a posted event, for draining without entering the ring
+static void wait_posted(pipeline_t* pipe, long timeout_ns) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += timeout_ns;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&pipe->lock);
+    if (!pipe->events) {
+        pthread_cond_timedwait(&pipe->cond, &pipe->lock, &ts);
+    }
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+/**
+ * Takes back the SQEs the kernel has not consumed; without SQPOLL it only
+ * reads the SQ inside io_uring_enter. Their buffers go on the done list as
+ * cancelled, since no completion will ever come for them.
+ */
+static pbuf_t* ring_withdraw(pipeline_t* pipe, pbuf_t* done) {
+    ring_t* ring = &pipe->ring;
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sq_tail;
+
+    for (unsigned i = head; i != tail; i++) {
+        struct io_uring_sqe* sqe = &ring->sqes[ring->sq_array[i & *ring->sq_mask]];
+        if (sqe->user_data == EVENTFD_TAG) {
+            continue;
+        }
+        pbuf_t* buf = &pipe->bufs[sqe->user_data];
+        buf->res = -ECANCELED;
+        buf->next = done;
+        done = buf;
+    }
+    __atomic_store_n(ring->sq_tail, head, __ATOMIC_RELEASE);
+    ring->to_submit = 0;
+    return done;
+}
+
+/**
+ * Collects completed buffers: posted events plus, with io_uring, CQEs. Blocks
+ * until there is one. Once *err is set the ring is no longer entered: what
+ * was never submitted comes back cancelled, and the rest is polled for, as
+ * every buffer in flight must be back before the pipeline is torn down.
+ */
+static pbuf_t* wait_events(pipeline_t* pipe, int* err) {
+    pbuf_t* done = NULL;
+
+    for (;;) {
+        pthread_mutex_lock(&pipe->lock);
+        if (pipe->io == AES_PIPELINE_THREADS) {
+            while (!pipe->events) {
+                pthread_cond_wait(&pipe->cond, &pipe->lock);
+            }
+        }
+        done = pipe->events;
+        pipe->events = NULL;
+        pthread_mutex_unlock(&pipe->lock);
+
+        if (pipe->io == AES_PIPELINE_THREADS) {
+            return done;
+        }
+
+        ring_t* ring = &pipe->ring;
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        int woken = 0;
+        for (; head != tail; head++) {
+            struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            if (cqe->user_data == EVENTFD_TAG) {
+                if (!*err) arm_eventfd(pipe);
+                woken = 1;
+                continue;
+            }
+            pbuf_t* buf = &pipe->bufs[cqe->user_data];
+            buf->res = cqe->res;
+            buf->next = done;
+            done = buf;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+        if (*err) {
+            // The kernel still fills the CQ and workers still post, without us entering
+            done = ring_withdraw(pipe, done);
+            if (done) {
+                return done;
+            }
+            wait_posted(pipe, RING_POLL_NS);
+            continue;
+        }
+        if (done || woken) {
+            // Hand over the eventfd re-arm without waiting
+            if (ring->to_submit && ring_enter(ring, 0) < 0) {
+                *err = errno;
+                done = ring_withdraw(pipe, done);
+            }
+            if (done) {
+                return done;
+            }
+            // Woken by a posted event that arrived after the list was checked
+            continue;
+        }
+        if (ring_enter(ring, 1) < 0) {
+            *err = errno;
+        }
+    }
+}
+
+int64_t aes_encrypt_file_pipeline(const char* in_path, const char* out_path, uint8_t* roundKey,
+                                  ctr_block_t* initial_ctr, const aes_pipeline_opts_t* opts,
+                                  aes_pipeline_stats_t* stats) {
+    aes_pipeline_opts_t defaults = {0};
+    pipeline_t pipe;
+    uint64_t size;
+    int err = 0;
+
+    if (!opts) {
+        opts = &defaults;
+    }
+
+    memset(&pipe, 0, sizeof(pipe));
+    pipe.roundKey = roundKey;
+    pipe.initial_ctr = initial_ctr;
+    pipe.kernel = aes_select_bulk_kernel(NULL);
+    pipe.pool = opts->pool ? opts->pool : aes_pool_default();
+    pipe.prio = opts->bulk ? AES_PRIO_BULK : AES_PRIO_LATENCY;
+    pipe.buf_size = round_up(opts->buf_size ? opts->buf_size : AES_PIPELINE_DEFAULT_BUF, AES_PIPELINE_ALIGN);
+    pipe.depth = opts->depth > 0 ? opts->depth : 2 * aes_pool_num_threads(pipe.pool);
+    if (pipe.depth < 4) {
+        pipe.depth = 4;
+    }
+
+    if (open_files(&pipe, in_path, out_path, opts->direct, &size) < 0) {
+        return -1;
+    }
+
+    // Never more buffers than the file needs
+    uint64_t needed = (size + pipe.buf_size - 1) / pipe.buf_size;
+    if (needed < (uint64_t)pipe.depth) {
+        pipe.depth = needed > 0 ? (int)needed : 1;
+    }
+
+    uint8_t* region = NULL;
+    pipe.bufs = (pbuf_t*)calloc(pipe.depth, sizeof(pbuf_t));
+    // Page aligned, so fine for O_DIRECT; cached by buf.c for the next file of the same shape
+    region = pipe.bufs ? (uint8_t*)aes_buf_alloc(pipe.depth * pipe.buf_size, 0) : NULL;
+    if (!region) {
+        err = ENOMEM;
+        goto out_close;
+    }
+    for (int i = 0; i < pipe.depth; i++) {
+        pbuf_t* buf = &pipe.bufs[i];
+        buf->pipe = &pipe;
+        buf->idx = i;
+        buf->data = region + (size_t)i * pipe.buf_size;
+        buf->task.fn = encrypt_buf;
+        buf->next = pipe.free_list;
+        pipe.free_list = buf;
+    }
+
+    pthread_mutex_init(&pipe.lock, NULL);
+    pthread_cond_init(&pipe.cond, NULL);
+    if (opts->io == AES_PIPELINE_THREADS || start_uring(&pipe) < 0) {
+        if (opts->io == AES_PIPELINE_URING) {
+            err = errno;
+            goto out_sync;
+        }
+        start_threads(&pipe);
+    }
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "pipeline", size);
+
+    uint64_t next_read = 0;
+    uint64_t written = 0;
+    int inflight = 0;
+
+    while (inflight > 0 || (!err && written < size)) {
+        // Refill: every free buffer starts reading the next slice of the file
+        while (!err && pipe.free_list && next_read < size) {
+            pbuf_t* buf = pipe.free_list;
+            pipe.free_list = buf->next;
+
+            buf->offset = next_read;
+            buf->len = size - next_read < pipe.buf_size ? size - next_read : pipe.buf_size;
+            buf->io_len = pipe.direct ? round_up(buf->len, AES_PIPELINE_ALIGN) : buf->len;
+            buf->done = 0;
+            buf->state = BUF_READING;
+            start_io(&pipe, buf);
+            next_read += buf->len;
+            inflight++;
+        }
+
+        // Even after an error, every buffer in flight must come back before teardown
+        pbuf_t* done = wait_events(&pipe, &err);
+
+        while (done) {
+            pbuf_t* buf = done;
+            done = buf->next;
+
+            if (buf->state == BUF_ENCRYPTING && err) {
+                buf->state = BUF_FREE;
+                inflight--;
+                continue;
+            }
+            if (buf->state == BUF_ENCRYPTING) {
+                buf->state = BUF_WRITING;
+                buf->done = 0;
+                start_io(&pipe, buf);
+                continue;
+            }
+
+            if (buf->res < 0 && buf->res != -EINTR && buf->res != -EAGAIN) {
+                if (!err) err = (int)-buf->res;
+            } else if (buf->res > 0) {
+                buf->done += buf->res;
+            }
+
+            if (buf->state == BUF_READING) {
+                int eof = buf->res == 0;
+                // A direct read at the end of the file stops short of io_len but covers len
+                if (!err && buf->done < buf->len && eof) {
+                    err = EIO;  // file shrank under us
+                }
+                if (err) {
+                    buf->state = BUF_FREE;
+                    inflight--;
+                } else if (buf->done < buf->len) {
+                    start_io(&pipe, buf);
+                } else {
+                    buf->state = BUF_ENCRYPTING;
+                    aes_pool_submit_prio(pipe.pool, &buf->task, pipe.prio);
+                }
+            } else {
+                if (!err && buf->done < buf->io_len) {
+                    start_io(&pipe, buf);
+                } else {
+                    if (!err) written += buf->len;
+                    buf->state = BUF_FREE;
+                    buf->next = pipe.free_list;
+                    pipe.free_list = buf;
+                    inflight--;
+                }
+            }
+        }
+    }
+
+    AES_TRACE(AES_TRACE_JOB_END, "pipeline", 0);
+
+    // Direct writes of the last buffer are rounded up to the alignment
+    if (!err && pipe.direct && ftruncate(pipe.out_fd, size) < 0) {
+        err = errno;
+    }
+
+    stop_io(&pipe);
+
+out_sync:
+    pthread_mutex_destroy(&pipe.lock);
+    pthread_cond_destroy(&pipe.cond);
+    pipe.stats.io = pipe.io;
+    pipe.stats.direct = pipe.direct;
+    pipe.stats.registered = pipe.registered;
+    if (stats) {
+        *stats = pipe.stats;
+    }
+
+out_close:
+    aes_buf_free(region);
+    free(pipe.bufs);
+    if (pipe.out_fd != pipe.in_fd && close(pipe.out_fd) < 0 && !err) {
+        err = errno;
+    }
+    close(pipe.in_fd);
+
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return (int64_t)size;
+}
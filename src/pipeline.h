@@ -0,0 +1,53 @@
+#ifndef AES_PIPELINE_H
+#define AES_PIPELINE_H
+
+#include "aes.h"
+#include "pool.h"
+
+/**
+ * Read-encrypt-write file pipeline. A fixed set of aligned buffers cycles
+ * through read, encryption on the worker pool and write, with several of
+ * each in flight, so I/O and the AES kernels overlap instead of alternating
+ * as they do with mmap page faults (see fileenc.h).
+ */
+
+#define AES_PIPELINE_DEFAULT_BUF (4UL * 1024 * 1024)
+#define AES_PIPELINE_ALIGN 4096   // buffer, offset and length alignment for O_DIRECT
+
+typedef enum {
+    AES_PIPELINE_AUTO = 0,      // io_uring if the kernel allows it, threads otherwise
+    AES_PIPELINE_URING,         // io_uring through raw syscalls, registered buffers when possible
+    AES_PIPELINE_THREADS        // pread/pwrite on a few I/O threads
+} aes_pipeline_io_t;
+
+typedef struct {
+    size_t buf_size;            // bytes per buffer, 0 for AES_PIPELINE_DEFAULT_BUF; rounded up to AES_PIPELINE_ALIGN
+    int depth;                  // buffers in flight, 0 for twice the pool's threads (at least 4)
+    int direct;                 // open both files with O_DIRECT where the filesystem supports it
+    aes_pipeline_io_t io;
+    aes_pool_t* pool;           // NULL for aes_pool_default()
+    int bulk;                   // encrypt as bulk-class pool work (see pool.h), for background jobs
+} aes_pipeline_opts_t;
+
+typedef struct {
+    aes_pipeline_io_t io;       // engine that ran
+    int direct;                 // whether O_DIRECT was in effect
+    int registered;             // io_uring fixed buffers in use
+    uint64_t reads;             // requests issued, including resubmitted short transfers
+    uint64_t writes;
+} aes_pipeline_stats_t;
+
+const char* aes_pipeline_io_name(aes_pipeline_io_t io);
+
+/**
+ * Same result as aes_encrypt_file: byte offset o uses counter initial_ctr + o / 16.
+ * out_path: NULL or the same file as in_path encrypts in place
+ * opts: NULL for defaults
+ * stats: optional
+ * return: bytes processed, or -1 with errno set
+ */
+int64_t aes_encrypt_file_pipeline(const char* in_path, const char* out_path, uint8_t* roundKey,
+                                  ctr_block_t* initial_ctr, const aes_pipeline_opts_t* opts,
+                                  aes_pipeline_stats_t* stats);
+
+#endif
@@ -0,0 +1,546 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <immintrin.h>
+
+#include "pool.h"
+#include "dispatch.h"
+#include "affinity.h"
+#include "trace.h"
+#include "stats.h"
+
+#define SPIN_BACKOFF_MAX 8      // pause instructions between polls at most
+#define SPIN_CLOCK_EVERY 64     // polls between idle-timeout checks
+
+enum {
+    SLOT_PARKED,                // not spinning; submitters go through the queue
+    SLOT_IDLE,                  // spinning and open for a handoff
+    SLOT_CLAIMED                // a task is on its way or running
+};
+
+// Per-worker handoff slot for spinning workers, one cache line each
+typedef struct {
+    _Atomic uint32_t state;
+    aes_task_t* _Atomic task;
+} __attribute__((aligned(64))) spin_slot_t;
+
+struct aes_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    aes_task_t* head;           // latency class, always served first
+    aes_task_t* tail;
+    aes_task_t* bulk_head;
+    aes_task_t* bulk_tail;
+    int bulk_running;           // workers inside a bulk task
+    int bulk_limit;             // at most this many, 0 for no limit
+    _Atomic int queued;         // tasks in either queue, polled by spinning workers
+    _Atomic int shutdown;
+    int num_threads;
+    _Atomic int spin_workers;   // workers 0..spin_workers-1 spin when idle
+    _Atomic uint64_t spin_idle_ns;
+    _Atomic unsigned spin_next; // where submitters start looking for an idle spinner
+    int spin_epoch;             // bumped by aes_pool_set_spin to wake parked workers
+    pthread_t threads[AES_MAX_THREADS];
+    spin_slot_t slots[AES_MAX_THREADS];
+};
+
+typedef struct {
+    aes_pool_t* pool;
+    int worker_idx;
+} worker_arg_t;
+
+typedef struct {
+    aes_task_t task;
+    aesctr_bulk_fn kernel;
+    uint8_t* input;
+    uint8_t* output;
+    uint8_t* roundKey;
+    ctr_block_t ctr;            // already advanced to the first block of the range
+    size_t num_blocks;
+} ctr_range_t;
+
+// Shared by the runners of one aesctr_enc_pool_bulk call
+typedef struct {
+    aes_pool_t* pool;
+    aesctr_bulk_fn kernel;
+    uint8_t* input;
+    uint8_t* output;
+    uint8_t* roundKey;
+    ctr_block_t ctr;
+    size_t num_blocks;
+    _Atomic size_t next;        // first block not yet claimed
+} bulk_job_t;
+
+typedef struct {
+    aes_task_t task;
+    bulk_job_t* job;
+} bulk_runner_t;
+
+static aes_pool_t* default_pool;
+static pthread_once_t default_once = PTHREAD_ONCE_INIT;
+
+void aes_taskgroup_init(aes_taskgroup_t* group) {
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->done, NULL);
+    group->pending = 0;
+}
+
+void aes_taskgroup_wait(aes_taskgroup_t* group) {
+    pthread_mutex_lock(&group->lock);
+    while (group->pending > 0) {
+        pthread_cond_wait(&group->done, &group->lock);
+    }
+    pthread_mutex_unlock(&group->lock);
+}
+
+void aes_taskgroup_destroy(aes_taskgroup_t* group) {
+    pthread_mutex_destroy(&group->lock);
+    pthread_cond_destroy(&group->done);
+}
+
+static void taskgroup_finish(aes_taskgroup_t* group) {
+    pthread_mutex_lock(&group->lock);
+    if (--group->pending == 0) {
+        pthread_cond_broadcast(&group->done);
+    }
+    pthread_mutex_unlock(&group->lock);
+}
+
+// Next runnable task, latency class first; called with the lock held
+static aes_task_t* take_queued(aes_pool_t* pool, int* bulk) {
+    aes_task_t* task;
+
+    if ((task = pool->head)) {
+        pool->head = task->next;
+        if (!pool->head) {
+            pool->tail = NULL;
+        }
+    } else if ((task = pool->bulk_head) && (pool->bulk_limit == 0 || pool->bulk_running < pool->bulk_limit)) {
+        pool->bulk_head = task->next;
+        if (!pool->bulk_head) {
+            pool->bulk_tail = NULL;
+        }
+        pool->bulk_running++;
+        *bulk = 1;
+    } else {
+        return NULL;
+    }
+    atomic_fetch_sub(&pool->queued, 1);
+    return task;
+}
+
+/**
+ * Polls the worker's slot and the queues with pause and bounded backoff
+ * until a task arrives. Leaves the slot SLOT_CLAIMED with a task.
+ * return: NULL once the slot is parked again: idle timeout, spinning turned
+ *         off for this worker, or shutdown
+ */
+static aes_task_t* spin_for_task(aes_pool_t* pool, int worker_idx, int* bulk) {
+    spin_slot_t* slot = &pool->slots[worker_idx];
+    uint64_t idle_since = aes_stats_now_ns();
+    int backoff = 1;
+
+    atomic_store(&slot->state, SLOT_IDLE);
+    for (unsigned polls = 1;; polls++) {
+        aes_task_t* task = atomic_load(&slot->task);
+        if (task) {
+            atomic_store(&slot->task, NULL);
+            return task;
+        }
+
+        int leave = 0;
+        if (atomic_load(&pool->queued) > 0) {
+            // Claim the slot first, so no handoff lands while this worker is in the queue
+            uint32_t idle = SLOT_IDLE;
+            if (atomic_compare_exchange_strong(&slot->state, &idle, SLOT_CLAIMED)) {
+                pthread_mutex_lock(&pool->lock);
+                task = take_queued(pool, bulk);
+                pthread_mutex_unlock(&pool->lock);
+                if (task) {
+                    return task;
+                }
+                // Only bulk tasks held back by the cap: carry on as if idle
+                atomic_store(&slot->state, SLOT_IDLE);
+            } else {
+                continue;       // claimed meanwhile: the task is on its way
+            }
+        }
+        if (atomic_load(&pool->shutdown) || worker_idx >= atomic_load(&pool->spin_workers)) {
+            leave = 1;
+        } else if (polls % SPIN_CLOCK_EVERY == 0 &&
+                   aes_stats_now_ns() - idle_since >= atomic_load(&pool->spin_idle_ns)) {
+            leave = 1;
+        }
+        if (leave) {
+            uint32_t idle = SLOT_IDLE;
+            if (atomic_compare_exchange_strong(&slot->state, &idle, SLOT_PARKED)) {
+                return NULL;
+            }
+            continue;           // claimed meanwhile: the task is on its way
+        }
+
+        for (int i = 0; i < backoff; i++) {
+            _mm_pause();
+        }
+        if (backoff < SPIN_BACKOFF_MAX) {
+            backoff *= 2;
+        }
+    }
+}
+
+static void* pool_worker(void* arg) {
+    worker_arg_t* worker = (worker_arg_t*)arg;
+    aes_pool_t* pool = worker->pool;
+    int worker_idx = worker->worker_idx;
+    int parked = 0;             // a spinner that timed out waits for queued work before spinning again
+    int seen_epoch = 0;
+
+    free(worker);
+    aes_pin_thread(worker_idx);
+
+    for (;;) {
+        aes_task_t* task = NULL;
+        int bulk = 0;
+
+        if (!parked && worker_idx < atomic_load(&pool->spin_workers) && !atomic_load(&pool->shutdown)) {
+            task = spin_for_task(pool, worker_idx, &bulk);
+            parked = !task;
+        }
+        if (!task) {
+            int stop = 0;
+            pthread_mutex_lock(&pool->lock);
+            for (;;) {
+                if ((task = take_queued(pool, &bulk))) {
+                    break;
+                }
+                // Bulk tasks held back by the limit still run before shutdown, once a bulk worker frees up
+                if (pool->shutdown && !pool->bulk_head) {
+                    stop = 1;
+                    break;
+                }
+                if (pool->spin_epoch != seen_epoch) {
+                    seen_epoch = pool->spin_epoch;
+                    parked = 0;
+                    break;
+                }
+                pthread_cond_wait(&pool->work, &pool->lock);
+            }
+            pthread_mutex_unlock(&pool->lock);
+            if (stop) {
+                break;
+            }
+            if (!task) {
+                continue;
+            }
+        }
+        parked = 0;
+
+        // The group must be read first: fn may free or reuse the task
+        aes_taskgroup_t* group = task->group;
+        task->fn(task, worker_idx);
+        aes_stats_queue_add(-1);
+        // Only this worker touches a claimed slot; outside spin_for_task it stays parked
+        atomic_store(&pool->slots[worker_idx].state, SLOT_PARKED);
+        if (bulk) {
+            pthread_mutex_lock(&pool->lock);
+            pool->bulk_running--;
+            if (pool->bulk_head) {
+                pthread_cond_signal(&pool->work);
+            }
+            pthread_mutex_unlock(&pool->lock);
+        }
+        if (group) {
+            taskgroup_finish(group);
+        }
+    }
+
+    return NULL;
+}
+
+aes_pool_t* aes_pool_create(int num_threads) {
+    aes_pool_t* pool = (aes_pool_t*)calloc(1, sizeof(aes_pool_t));
+    if (!pool) {
+        return NULL;
+    }
+    if (num_threads <= 0) {
+        num_threads = aes_get_num_threads();
+    }
+    if (num_threads > AES_MAX_THREADS) {
+        num_threads = AES_MAX_THREADS;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+
+    for (int i = 0; i < num_threads; i++) {
+        worker_arg_t* worker = (worker_arg_t*)malloc(sizeof(worker_arg_t));
+        if (!worker) {
+            break;
+        }
+        worker->pool = pool;
+        worker->worker_idx = i;
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, worker) != 0) {
+            free(worker);
+            break;
+        }
+        pool->num_threads++;
+    }
+
+    if (pool->num_threads == 0) {
+        aes_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void aes_pool_destroy(aes_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    free(pool);
+}
+
+int aes_pool_num_threads(aes_pool_t* pool) {
+    return pool->num_threads;
+}
+
+void aes_pool_submit(aes_pool_t* pool, aes_task_t* task) {
+    aes_pool_submit_prio(pool, task, AES_PRIO_LATENCY);
+}
+
+// Hands a latency task straight to a spinning worker, if one is idle; return: 1 if it did
+static int handoff(aes_pool_t* pool, aes_task_t* task) {
+    int spinners = atomic_load(&pool->spin_workers);
+    if (spinners == 0) {
+        return 0;
+    }
+    unsigned start = atomic_fetch_add(&pool->spin_next, 1);
+    for (int i = 0; i < spinners; i++) {
+        spin_slot_t* slot = &pool->slots[(start + i) % spinners];
+        uint32_t idle = SLOT_IDLE;
+        if (atomic_load(&slot->state) == SLOT_IDLE &&
+            atomic_compare_exchange_strong(&slot->state, &idle, SLOT_CLAIMED)) {
+            atomic_store(&slot->task, task);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void aes_pool_submit_prio(aes_pool_t* pool, aes_task_t* task, aes_prio_t prio) {
+    if (task->group) {
+        pthread_mutex_lock(&task->group->lock);
+        task->group->pending++;
+        pthread_mutex_unlock(&task->group->lock);
+    }
+    task->next = NULL;
+    aes_stats_queue_add(1);
+
+    if (prio == AES_PRIO_LATENCY && handoff(pool, task)) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    atomic_fetch_add(&pool->queued, 1);
+    aes_task_t** head = prio == AES_PRIO_BULK ? &pool->bulk_head : &pool->head;
+    aes_task_t** tail = prio == AES_PRIO_BULK ? &pool->bulk_tail : &pool->tail;
+    if (*tail) {
+        (*tail)->next = task;
+    } else {
+        *head = task;
+    }
+    *tail = task;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void aes_pool_set_bulk_workers(aes_pool_t* pool, int workers) {
+    pthread_mutex_lock(&pool->lock);
+    pool->bulk_limit = workers > 0 && workers < pool->num_threads ? workers : 0;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void aes_pool_set_spin(aes_pool_t* pool, int workers, unsigned idle_us) {
+    if (workers < 0) workers = 0;
+    if (workers > pool->num_threads) workers = pool->num_threads;
+
+    pthread_mutex_lock(&pool->lock);
+    atomic_store(&pool->spin_idle_ns, (uint64_t)(idle_us ? idle_us : AES_POOL_DEFAULT_SPIN_IDLE_US) * 1000);
+    atomic_store(&pool->spin_workers, workers);
+    pool->spin_epoch++;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int aes_pool_spinning(aes_pool_t* pool) {
+    int spinning = 0;
+    for (int i = 0; i < pool->num_threads; i++) {
+        spinning += atomic_load(&pool->slots[i].state) == SLOT_IDLE;
+    }
+    return spinning;
+}
+
+int aes_pool_bulk_workers(aes_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    int workers = pool->bulk_limit ? pool->bulk_limit : pool->num_threads;
+    pthread_mutex_unlock(&pool->lock);
+    return workers;
+}
+
+static void create_default_pool() {
+    default_pool = aes_pool_create(0);
+
+    // AES_POOL_SPIN=<workers>[:<idle us>]
+    const char* spin = getenv("AES_POOL_SPIN");
+    if (default_pool && spin) {
+        char* end;
+        int workers = (int)strtol(spin, &end, 10);
+        unsigned idle_us = *end == ':' ? (unsigned)strtoul(end + 1, NULL, 10) : 0;
+        aes_pool_set_spin(default_pool, workers, idle_us);
+    }
+}
+
+aes_pool_t* aes_pool_default() {
+    pthread_once(&default_once, create_default_pool);
+    return default_pool;
+}
+
+static void ctr_range_run(aes_task_t* task, int worker_idx) {
+    ctr_range_t* range = (ctr_range_t*)task;
+    (void)worker_idx;
+
+    AES_TRACE(AES_TRACE_CHUNK_BEGIN, "pool", range->num_blocks * BLOCK_SIZE);
+    range->kernel(range->input, range->roundKey, range->output, range->num_blocks, &range->ctr);
+    AES_TRACE(AES_TRACE_CHUNK_END, "pool", 0);
+}
+
+void aesctr_enc_pool(aes_pool_t* pool, uint8_t* input, uint8_t* roundKey, uint8_t* output,
+                     size_t num_blocks, ctr_block_t* initial_ctr) {
+    ctr_range_t ranges[AES_MAX_THREADS];
+    aes_taskgroup_t group;
+    uint64_t start_ns = aes_stats_now_ns();
+
+    if (!pool) {
+        pool = aes_pool_default();
+    }
+
+    int num_threads = pool->num_threads;
+    aesctr_bulk_fn kernel = aes_select_bulk_kernel_for(input, output, num_blocks * BLOCK_SIZE, NULL);
+    // Multiples of 4 blocks keep every range on the VAES fast path
+    size_t per_thread = (num_blocks / num_threads) & ~(size_t)3;
+    size_t start = 0;
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "pool", num_blocks * BLOCK_SIZE);
+    aes_taskgroup_init(&group);
+
+    for (int i = 0; i < num_threads && start < num_blocks; i++) {
+        size_t count = i == num_threads - 1 || per_thread == 0 ? num_blocks - start : per_thread;
+
+        ranges[i].task.fn = ctr_range_run;
+        ranges[i].task.arg = NULL;
+        ranges[i].task.group = &group;
+        ranges[i].kernel = kernel;
+        ranges[i].input = input + start * BLOCK_SIZE;
+        ranges[i].output = output + start * BLOCK_SIZE;
+        ranges[i].roundKey = roundKey;
+        ranges[i].num_blocks = count;
+        ctr_block_advance(initial_ctr, &ranges[i].ctr, start);
+
+        aes_pool_submit(pool, &ranges[i].task);
+        start += count;
+    }
+
+    AES_TRACE(AES_TRACE_JOIN_BEGIN, NULL, 0);
+    aes_taskgroup_wait(&group);
+    AES_TRACE(AES_TRACE_JOIN_END, NULL, 0);
+    aes_taskgroup_destroy(&group);
+
+    AES_TRACE(AES_TRACE_JOB_END, "pool", 0);
+    aes_stats_record(AES_BACKEND_POOL, num_blocks * BLOCK_SIZE, aes_stats_now_ns() - start_ns);
+}
+
+/**
+ * Claims the next chunk of the job, encrypts it and, if any are left,
+ * queues itself again at the back of the bulk class, so the worker returns
+ * to the scheduler between chunks and latency tasks go ahead of the rest.
+ */
+static void bulk_runner_run(aes_task_t* task, int worker_idx) {
+    bulk_runner_t* runner = (bulk_runner_t*)task;
+    bulk_job_t* job = runner->job;
+    size_t start = atomic_fetch_add(&job->next, AES_POOL_BULK_CHUNK / BLOCK_SIZE);
+    (void)worker_idx;
+
+    if (start < job->num_blocks) {
+        size_t count = job->num_blocks - start;
+        if (count > AES_POOL_BULK_CHUNK / BLOCK_SIZE) {
+            count = AES_POOL_BULK_CHUNK / BLOCK_SIZE;
+        }
+        ctr_block_t ctr;
+        ctr_block_advance(&job->ctr, &ctr, start);
+
+        AES_TRACE(AES_TRACE_CHUNK_BEGIN, "pool_bulk", count * BLOCK_SIZE);
+        job->kernel(job->input + start * BLOCK_SIZE, job->roundKey, job->output + start * BLOCK_SIZE, count, &ctr);
+        AES_TRACE(AES_TRACE_CHUNK_END, "pool_bulk", 0);
+    }
+    // Queued before this run counts as finished, so the group can't drain in between
+    if (atomic_load(&job->next) < job->num_blocks) {
+        aes_pool_submit_prio(job->pool, task, AES_PRIO_BULK);
+    }
+}
+
+void aesctr_enc_pool_bulk(aes_pool_t* pool, uint8_t* input, uint8_t* roundKey, uint8_t* output,
+                          size_t num_blocks, ctr_block_t* initial_ctr) {
+    bulk_runner_t runners[AES_MAX_THREADS];
+    aes_taskgroup_t group;
+    bulk_job_t job;
+    uint64_t start_ns = aes_stats_now_ns();
+
+    if (!pool) {
+        pool = aes_pool_default();
+    }
+
+    size_t chunks = (num_blocks * BLOCK_SIZE + AES_POOL_BULK_CHUNK - 1) / AES_POOL_BULK_CHUNK;
+    size_t num_runners = (size_t)aes_pool_bulk_workers(pool);
+    if (num_runners > chunks) {
+        num_runners = chunks;
+    }
+
+    job.pool = pool;
+    job.kernel = aes_select_bulk_kernel_for(input, output, num_blocks * BLOCK_SIZE, NULL);
+    job.input = input;
+    job.output = output;
+    job.roundKey = roundKey;
+    job.ctr = *initial_ctr;
+    job.num_blocks = num_blocks;
+    atomic_init(&job.next, 0);
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "pool_bulk", num_blocks * BLOCK_SIZE);
+    aes_taskgroup_init(&group);
+    for (size_t i = 0; i < num_runners; i++) {
+        runners[i].task.fn = bulk_runner_run;
+        runners[i].task.arg = NULL;
+        runners[i].task.group = &group;
+        runners[i].job = &job;
+        aes_pool_submit_prio(pool, &runners[i].task, AES_PRIO_BULK);
+    }
+
+    AES_TRACE(AES_TRACE_JOIN_BEGIN, NULL, 0);
+    aes_taskgroup_wait(&group);
+    AES_TRACE(AES_TRACE_JOIN_END, NULL, 0);
+    aes_taskgroup_destroy(&group);
+
+    AES_TRACE(AES_TRACE_JOB_END, "pool_bulk", 0);
+    aes_stats_record(AES_BACKEND_POOL, num_blocks * BLOCK_SIZE, aes_stats_now_ns() - start_ns);
+}
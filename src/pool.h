@@ -0,0 +1,125 @@
+#ifndef AES_POOL_H
+#define AES_POOL_H
+
+#include "aes.h"
+#include <pthread.h>
+
+/**
+ * Persistent worker pool. Unlike the pthread and VAES+pthread drivers, which
+ * create and join threads per call, workers are started once, pinned with
+ * aes_pin_thread and then run submitted tasks in FIFO order.
+ *
+ * Tasks come in two classes. A worker always takes a queued latency task
+ * before a bulk one, and bulk tasks can be confined to a share of the
+ * workers (aes_pool_set_bulk_workers), so large background jobs cut into
+ * chunks don't hold up small interactive ones by more than one chunk.
+ *
+ * Workers normally sleep on a condition variable when idle, and waking one
+ * costs several microseconds. With aes_pool_set_spin some of them busy-poll
+ * a per-worker slot instead, and a latency task submitted while one is
+ * idle is handed over through the slot without taking the queue lock.
+ */
+
+#define AES_POOL_DEFAULT_SPIN_IDLE_US 1000       // spinning workers park after this long without work
+#define AES_POOL_BULK_CHUNK (1UL * 1024 * 1024)    // unit of preemption for aesctr_enc_pool_bulk
+
+typedef struct aes_pool aes_pool_t;
+typedef struct aes_task aes_task_t;
+
+typedef enum {
+    AES_PRIO_LATENCY = 0,       // what aes_pool_submit uses
+    AES_PRIO_BULK
+} aes_prio_t;
+
+// worker_idx: 0..aes_pool_num_threads()-1 of the worker running the task
+typedef void (*aes_task_fn)(aes_task_t* task, int worker_idx);
+
+/**
+ * Counts outstanding tasks so a submitter can wait for a batch.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    size_t pending;
+} aes_taskgroup_t;
+
+/**
+ * Caller-owned; must stay valid until fn has returned.
+ * To pass arguments, make it the first member of a larger struct, so fn can
+ * cast the task pointer back to that struct; or use arg.
+ */
+struct aes_task {
+    aes_task_fn fn;
+    void* arg;
+    aes_taskgroup_t* group;     // optional, signalled after fn returns
+    aes_task_t* next;           // queue link, owned by the pool
+};
+
+/**
+ * num_threads: 0 for aes_get_num_threads()
+ * return: NULL if no worker could be started
+ */
+aes_pool_t* aes_pool_create(int num_threads);
+
+// Runs every task already submitted, then stops and joins the workers
+void aes_pool_destroy(aes_pool_t* pool);
+
+int aes_pool_num_threads(aes_pool_t* pool);
+
+// Queues a latency-class task
+void aes_pool_submit(aes_pool_t* pool, aes_task_t* task);
+
+void aes_pool_submit_prio(aes_pool_t* pool, aes_task_t* task, aes_prio_t prio);
+
+/**
+ * Caps how many workers run bulk tasks at once, leaving the rest free for
+ * latency tasks; takes effect as running bulk tasks finish.
+ * workers: 0 (or the pool size or more) for no cap
+ */
+void aes_pool_set_bulk_workers(aes_pool_t* pool, int workers);
+
+// The current cap, or the pool size if there is none
+int aes_pool_bulk_workers(aes_pool_t* pool);
+
+/**
+ * Makes workers 0..workers-1 spin when idle, polling their slot and the
+ * queues with pause and a short backoff, for callers that would rather burn
+ * dedicated cores than pay for a wakeup. A spinner with nothing to do for
+ * idle_us parks like any other worker and spins again after its next task.
+ * Also set for the default pool by AES_POOL_SPIN=<workers>[:<idle us>].
+ * workers: 0 to turn spinning off
+ * idle_us: 0 for AES_POOL_DEFAULT_SPIN_IDLE_US
+ */
+void aes_pool_set_spin(aes_pool_t* pool, int workers, unsigned idle_us);
+
+// Workers spinning right now and free to take a handoff
+int aes_pool_spinning(aes_pool_t* pool);
+
+/**
+ * Process-wide pool of aes_get_num_threads() workers, created on first use.
+ */
+aes_pool_t* aes_pool_default();
+
+void aes_taskgroup_init(aes_taskgroup_t* group);
+void aes_taskgroup_wait(aes_taskgroup_t* group);
+void aes_taskgroup_destroy(aes_taskgroup_t* group);
+
+/**
+ * Splits num_blocks into one range per worker, runs them through the widest
+ * bulk kernel (see dispatch.h) and waits for all of them.
+ * pool: NULL for aes_pool_default()
+ * roundKey: serial key schedule from aes_keyexpansion_serial
+ */
+void aesctr_enc_pool(aes_pool_t* pool, uint8_t* input, uint8_t* roundKey, uint8_t* output,
+                     size_t num_blocks, ctr_block_t* initial_ctr);
+
+/**
+ * As aesctr_enc_pool, run as bulk-class work for backups and other large
+ * background jobs: one runner per allowed bulk worker claims
+ * AES_POOL_BULK_CHUNK at a time and requeues itself after each, so latency
+ * tasks are picked up at the next chunk boundary.
+ */
+void aesctr_enc_pool_bulk(aes_pool_t* pool, uint8_t* input, uint8_t* roundKey, uint8_t* output,
+                          size_t num_blocks, ctr_block_t* initial_ctr);
+
+#endif
@@ -6,11 +6,20 @@
 #include <time.h>
 
 #include "aes.h"
-#include "pthread.h"
+#include "aes_pthread.h"
+#include "affinity.h"
+#include "trace.h"
+#include "stats.h"
 
 void* thread_worker(void* arg) {
     thread_data_t* data = (thread_data_t*)arg;
     uint8_t counter_block[16];
+
+    aes_perf_ctx_t perf_ctx;
+
+    aes_pin_thread(data->thread_idx);
+    aes_perfmon_thread_begin(data->perf, &perf_ctx);
+    AES_TRACE(AES_TRACE_CHUNK_BEGIN, "pthread", data->num_blocks * BLOCK_SIZE);
     
     // Encrypt assigned blocks
     for(size_t i = 0; i < data->num_blocks; i++) {
@@ -23,35 +32,53 @@ void* thread_worker(void* arg) {
             data->key_schedule,
             data->output + (block_idx * BLOCK_SIZE));
     }
+
+    AES_TRACE(AES_TRACE_CHUNK_END, "pthread", 0);
+    aes_perfmon_thread_end(data->perf, &perf_ctx, data->thread_idx, data->num_blocks * BLOCK_SIZE);
     
     return NULL;
 }
 
 void aesctr_enc_pthread(uint8_t* input, uint8_t* key_schedule, uint8_t* output, size_t total_blocks, ctr_block_t* initial_ctr) {
-    pthread_t threads[NUM_THREADS];
-    thread_data_t thread_data[NUM_THREADS];
+    int num_threads = aes_get_num_threads();
+    pthread_t threads[AES_MAX_THREADS];
+    thread_data_t thread_data[AES_MAX_THREADS];
     
     // Calculate blocks per thread
-    size_t blocks_per_thread = total_blocks / NUM_THREADS;
-    size_t remaining_blocks = total_blocks % NUM_THREADS;
+    size_t blocks_per_thread = total_blocks / num_threads;
+    size_t remaining_blocks = total_blocks % num_threads;
     size_t current_block = 0;
+    aes_perf_job_t* perf = aes_perfmon_job_begin("pthread", num_threads);
+    uint64_t start_ns = aes_stats_now_ns();
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "pthread", total_blocks * BLOCK_SIZE);
     
     // Create and launch threads
-    for(int i = 0; i < NUM_THREADS; i++) {
+    for(int i = 0; i < num_threads; i++) {
         thread_data[i].input = input;
         thread_data[i].output = output;
         thread_data[i].key_schedule = key_schedule;
         thread_data[i].start_block = current_block;
-        thread_data[i].num_blocks = blocks_per_thread + (i < remaining_blocks ? 1 : 0);
+        thread_data[i].num_blocks = blocks_per_thread + ((size_t)i < remaining_blocks ? 1 : 0);
         thread_data[i].initial_counter = initial_ctr;
+        thread_data[i].thread_idx = i;
+        thread_data[i].perf = perf;
         
+        aes_stats_queue_add(1);
         pthread_create(&threads[i], NULL, thread_worker, &thread_data[i]);
         current_block += thread_data[i].num_blocks;
     }
     
     // Wait for all threads
-    for(int i = 0; i < NUM_THREADS; i++) {
+    AES_TRACE(AES_TRACE_JOIN_BEGIN, NULL, 0);
+    for(int i = 0; i < num_threads; i++) {
         pthread_join(threads[i], NULL);
     }
+    AES_TRACE(AES_TRACE_JOIN_END, NULL, 0);
+    AES_TRACE(AES_TRACE_JOB_END, "pthread", 0);
+    aes_stats_queue_add(-num_threads);
+    aes_stats_record(AES_BACKEND_PTHREAD, total_blocks * BLOCK_SIZE, aes_stats_now_ns() - start_ns);
+
+    aes_perfmon_job_end(perf);
 }
 
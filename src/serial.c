@@ -1,4 +1,5 @@
 #include "aes.h"
+#include "stats.h"
 
 static inline void increment_counter(uint8_t* counter) {
     for (int i = 7; i >= 0; i--) {
@@ -168,12 +169,12 @@ void aesctr_enc1block_serial(uint8_t* counter, uint8_t* input, const uint8_t* ro
     }
 }
 
-void aesctr_enc_serial(uint8_t* input, const uint8_t* roundKey, uint8_t* output, 
-                          int num_blocks, ctr_block_t* initial_ctr) {
+void aesctr_kernel_serial(uint8_t* input, const uint8_t* roundKey, uint8_t* output,
+                          size_t num_blocks, ctr_block_t* initial_ctr) {
     uint8_t counter_block[16];
     uint8_t keystream[16];
     
-    for(int i = 0; i < num_blocks; i++) {
+    for(size_t i = 0; i < num_blocks; i++) {
         // Prepare counter block for this block
         prepare_ctr_block(initial_ctr, counter_block, i);
         
@@ -185,4 +186,13 @@ void aesctr_enc_serial(uint8_t* input, const uint8_t* roundKey, uint8_t* output,
             output[i * 16 + j] = input[i * 16 + j] ^ keystream[j];
         }
     }
+}
+
+void aesctr_enc_serial(uint8_t* input, const uint8_t* roundKey, uint8_t* output, 
+                          size_t num_blocks, ctr_block_t* initial_ctr) {
+    uint64_t start_ns = aes_stats_now_ns();
+
+    aesctr_kernel_serial(input, roundKey, output, num_blocks, initial_ctr);
+
+    aes_stats_record(AES_BACKEND_SERIAL, (uint64_t)num_blocks * BLOCK_SIZE, aes_stats_now_ns() - start_ns);
 }
\ No newline at end of file
@@ -0,0 +1,612 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#include "service.h"
+#include "pool.h"
+#include "dispatch.h"
+#include "trace.h"
+
+#define SERVICE_MAGIC 0x41455343u   // "AESC"
+
+enum {
+    OP_HELLO = 1,
+    OP_CTR = 2
+};
+
+// Client to daemon, once, with the region memfd attached
+typedef struct {
+    uint32_t magic;
+    uint32_t op;
+    uint64_t region_bytes;
+} hello_msg_t;
+
+typedef struct {
+    uint32_t op;
+    uint32_t key_id;
+    uint64_t tag;
+    uint64_t offset;
+    uint64_t len;
+    ctr_block_t ctr;
+} request_msg_t;
+
+// Daemon to client: one per request, and one to acknowledge the hello
+typedef struct {
+    uint64_t tag;
+    int32_t error;              // 0 or an errno value
+    uint32_t reserved;
+} reply_msg_t;
+
+typedef struct {
+    int fd;                     // -1 for a free slot
+    uint8_t* region;            // NULL until the hello has been handled
+    size_t region_bytes;
+    int closing;
+} client_slot_t;
+
+// A request gathered into the current batch
+typedef struct {
+    int client;
+    uint64_t tag;
+    int error;
+    uint8_t* data;
+    size_t len;
+    ctr_block_t ctr;
+    uint8_t roundKey[176];      // copied, so a key replaced mid-batch can't tear
+} pending_t;
+
+typedef struct {
+    aes_task_t task;
+    uint8_t* data;
+    size_t len;
+    const uint8_t* roundKey;
+    ctr_block_t ctr;
+    aesctr_bulk_fn kernel;
+} chunk_task_t;
+
+struct aes_service {
+    char path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+    int listen_fd;
+    int wake_fd;
+    pthread_t thread;
+    aes_pool_t* pool;
+    pthread_mutex_t lock;       // keys and stats
+    struct {
+        int used;
+        uint8_t roundKey[176];
+    } keys[AES_SERVICE_MAX_KEYS];
+    aes_service_stats_t stats;
+    client_slot_t clients[AES_SERVICE_MAX_CLIENTS];
+    int next_client;            // first client read next round, for fairness when batches fill up
+    pending_t batch[AES_SERVICE_MAX_BATCH];
+    chunk_task_t* tasks;
+    size_t task_cap;
+};
+
+struct aes_service_client {
+    int fd;
+    uint8_t* region;
+    size_t region_bytes;
+};
+
+static int unix_address(const char* path, struct sockaddr_un* addr) {
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+// CTR over len bytes in place; a partial last block goes through a padded copy
+static void ctr_bytes(aesctr_bulk_fn kernel, uint8_t* data, size_t len, const uint8_t* roundKey,
+                      const ctr_block_t* ctr) {
+    size_t blocks = len / BLOCK_SIZE;
+    size_t tail = len % BLOCK_SIZE;
+    ctr_block_t c = *ctr;
+
+    kernel(data, roundKey, data, blocks, &c);
+    if (tail) {
+        uint8_t block[BLOCK_SIZE] = {0};
+        memcpy(block, data + blocks * BLOCK_SIZE, tail);
+        ctr_block_advance(ctr, &c, blocks);
+        kernel(block, roundKey, block, 1, &c);
+        memcpy(data + blocks * BLOCK_SIZE, block, tail);
+    }
+}
+
+static void chunk_run(aes_task_t* task, int worker_idx) {
+    chunk_task_t* chunk = (chunk_task_t*)task;
+    (void)worker_idx;
+
+    AES_TRACE(AES_TRACE_CHUNK_BEGIN, "service", chunk->len);
+    ctr_bytes(chunk->kernel, chunk->data, chunk->len, chunk->roundKey, &chunk->ctr);
+    AES_TRACE(AES_TRACE_CHUNK_END, "service", 0);
+}
+
+//----------------------------------daemon----------------------------------
+
+static void close_client(aes_service_t* svc, int idx) {
+    client_slot_t* c = &svc->clients[idx];
+    if (c->region) {
+        munmap(c->region, c->region_bytes);
+    }
+    close(c->fd);
+    c->fd = -1;
+    c->region = NULL;
+    c->closing = 0;
+}
+
+static void accept_client(aes_service_t* svc) {
+    int fd = accept4(svc->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    for (int i = 0; i < AES_SERVICE_MAX_CLIENTS; i++) {
+        if (svc->clients[i].fd < 0) {
+            svc->clients[i].fd = fd;
+            pthread_mutex_lock(&svc->lock);
+            svc->stats.clients++;
+            pthread_mutex_unlock(&svc->lock);
+            return;
+        }
+    }
+    close(fd);
+}
+
+// Maps the client's memfd and acknowledges; the client is dropped if anything is off
+static void handle_hello(aes_service_t* svc, int idx) {
+    client_slot_t* c = &svc->clients[idx];
+    hello_msg_t hello;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { &hello, sizeof(hello) };
+    struct msghdr msg = {0};
+    reply_msg_t reply = {0};
+    int memfd = -1;
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t r = recvmsg(c->fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if (r < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    struct cmsghdr* cmsg = r > 0 ? CMSG_FIRSTHDR(&msg) : NULL;
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        memcpy(&memfd, CMSG_DATA(cmsg), sizeof(int));
+    }
+
+    /*
+     * A region the client could still truncate would SIGBUS whichever worker
+     * touched it next, so the memfd must be sealed against shrinking before
+     * its size means anything.
+     */
+    struct stat st;
+    int seals = memfd >= 0 ? fcntl(memfd, F_GET_SEALS) : -1;
+    if (r != sizeof(hello) || hello.magic != SERVICE_MAGIC || hello.op != OP_HELLO || memfd < 0 ||
+        seals < 0 || !(seals & F_SEAL_SHRINK) ||
+        hello.region_bytes == 0 || fstat(memfd, &st) < 0 || (uint64_t)st.st_size < hello.region_bytes) {
+        reply.error = EPROTO;
+    } else {
+        void* region = mmap(NULL, hello.region_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+        if (region == MAP_FAILED) {
+            reply.error = errno;
+        } else {
+            c->region = (uint8_t*)region;
+            c->region_bytes = hello.region_bytes;
+        }
+    }
+    if (memfd >= 0) {
+        close(memfd);
+    }
+    if (send(c->fd, &reply, sizeof(reply), MSG_NOSIGNAL) != sizeof(reply) || reply.error) {
+        c->closing = 1;
+    }
+}
+
+/**
+ * Reads whatever requests client idx has queued, up to a full batch.
+ * return: new batch size
+ */
+static size_t read_requests(aes_service_t* svc, int idx, size_t count) {
+    client_slot_t* c = &svc->clients[idx];
+
+    while (count < AES_SERVICE_MAX_BATCH) {
+        request_msg_t req;
+        ssize_t r = recv(c->fd, &req, sizeof(req), MSG_DONTWAIT);
+        if (r < 0 && (errno == EAGAIN || errno == EINTR)) {
+            break;
+        }
+        if (r != sizeof(req)) {
+            c->closing = 1;     // hung up, or not speaking the protocol
+            break;
+        }
+
+        pending_t* p = &svc->batch[count++];
+        p->client = idx;
+        p->tag = req.tag;
+        p->error = 0;
+        p->len = req.len;
+        p->ctr = req.ctr;
+        if (req.op != OP_CTR || req.offset > c->region_bytes || req.len > c->region_bytes - req.offset) {
+            p->error = EINVAL;
+            continue;
+        }
+        p->data = c->region + req.offset;
+
+        pthread_mutex_lock(&svc->lock);
+        if (req.key_id >= AES_SERVICE_MAX_KEYS || !svc->keys[req.key_id].used) {
+            p->error = ENOKEY;
+        } else {
+            memcpy(p->roundKey, svc->keys[req.key_id].roundKey, sizeof(p->roundKey));
+        }
+        pthread_mutex_unlock(&svc->lock);
+    }
+    return count;
+}
+
+// Runs every request of the batch on the pool as one task group, then replies in order
+static void run_batch(aes_service_t* svc, size_t count) {
+    aesctr_bulk_fn kernel = aes_select_bulk_kernel(NULL);
+    aes_taskgroup_t group;
+    size_t chunks = 0;
+    uint64_t bytes = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (!svc->batch[i].error) {
+            chunks += (svc->batch[i].len + AES_SERVICE_CHUNK - 1) / AES_SERVICE_CHUNK;
+        }
+    }
+    if (chunks > svc->task_cap) {
+        chunk_task_t* tasks = (chunk_task_t*)realloc(svc->tasks, chunks * sizeof(chunk_task_t));
+        if (!tasks) {
+            for (size_t i = 0; i < count; i++) {
+                svc->batch[i].error = ENOMEM;
+            }
+            chunks = 0;
+        } else {
+            svc->tasks = tasks;
+            svc->task_cap = chunks;
+        }
+    }
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "service", count);
+    aes_taskgroup_init(&group);
+    size_t t = 0;
+    for (size_t i = 0; i < count && chunks; i++) {
+        pending_t* p = &svc->batch[i];
+        if (p->error) {
+            continue;
+        }
+        for (size_t off = 0; off < p->len; off += AES_SERVICE_CHUNK) {
+            chunk_task_t* chunk = &svc->tasks[t++];
+            chunk->data = p->data + off;
+            chunk->len = p->len - off < AES_SERVICE_CHUNK ? p->len - off : AES_SERVICE_CHUNK;
+            chunk->roundKey = p->roundKey;
+            ctr_block_advance(&p->ctr, &chunk->ctr, off / BLOCK_SIZE);
+            chunk->kernel = kernel;
+            chunk->task.fn = chunk_run;
+            chunk->task.arg = NULL;
+            chunk->task.group = &group;
+            aes_pool_submit(svc->pool, &chunk->task);
+        }
+        bytes += p->len;
+    }
+    aes_taskgroup_wait(&group);
+    aes_taskgroup_destroy(&group);
+    AES_TRACE(AES_TRACE_JOB_END, "service", 0);
+
+    for (size_t i = 0; i < count; i++) {
+        pending_t* p = &svc->batch[i];
+        client_slot_t* c = &svc->clients[p->client];
+        reply_msg_t reply = { p->tag, p->error, 0 };
+        // Never block the whole service on one client that has stopped reading its replies
+        if (!c->closing && send(c->fd, &reply, sizeof(reply), MSG_NOSIGNAL | MSG_DONTWAIT) != sizeof(reply)) {
+            c->closing = 1;
+        }
+    }
+
+    pthread_mutex_lock(&svc->lock);
+    svc->stats.requests += count;
+    svc->stats.batches++;
+    svc->stats.bytes += bytes;
+    if (count > svc->stats.max_batch) {
+        svc->stats.max_batch = count;
+    }
+    pthread_mutex_unlock(&svc->lock);
+}
+
+static void* service_main(void* arg) {
+    aes_service_t* svc = (aes_service_t*)arg;
+    struct pollfd fds[2 + AES_SERVICE_MAX_CLIENTS];
+    int slot_of[2 + AES_SERVICE_MAX_CLIENTS];
+
+    for (;;) {
+        int n = 0;
+        fds[n].fd = svc->wake_fd;
+        fds[n++].events = POLLIN;
+        fds[n].fd = svc->listen_fd;
+        fds[n++].events = POLLIN;
+        for (int k = 0; k < AES_SERVICE_MAX_CLIENTS; k++) {
+            int i = (svc->next_client + k) % AES_SERVICE_MAX_CLIENTS;
+            if (svc->clients[i].fd >= 0) {
+                fds[n].fd = svc->clients[i].fd;
+                fds[n].events = POLLIN;
+                slot_of[n++] = i;
+            }
+        }
+
+        if (poll(fds, n, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[0].revents) {
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            accept_client(svc);
+        }
+
+        size_t count = 0;
+        for (int k = 2; k < n && count < AES_SERVICE_MAX_BATCH; k++) {
+            if (!fds[k].revents) {
+                continue;
+            }
+            if (!svc->clients[slot_of[k]].region) {
+                handle_hello(svc, slot_of[k]);
+            } else {
+                count = read_requests(svc, slot_of[k], count);
+            }
+        }
+        if (count) {
+            run_batch(svc, count);
+        }
+
+        for (int i = 0; i < AES_SERVICE_MAX_CLIENTS; i++) {
+            if (svc->clients[i].fd >= 0 && svc->clients[i].closing) {
+                close_client(svc, i);
+            }
+        }
+        svc->next_client = (svc->next_client + 1) % AES_SERVICE_MAX_CLIENTS;
+    }
+    return NULL;
+}
+
+aes_service_t* aes_service_start(const char* path, const aes_service_opts_t* opts) {
+    struct sockaddr_un addr;
+    int err;
+
+    if (unix_address(path, &addr) < 0) {
+        return NULL;
+    }
+    aes_service_t* svc = (aes_service_t*)calloc(1, sizeof(aes_service_t));
+    if (!svc) {
+        return NULL;
+    }
+    strcpy(svc->path, path);
+    svc->wake_fd = -1;
+    for (int i = 0; i < AES_SERVICE_MAX_CLIENTS; i++) {
+        svc->clients[i].fd = -1;
+    }
+    pthread_mutex_init(&svc->lock, NULL);
+
+    svc->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (svc->listen_fd < 0) {
+        goto fail;
+    }
+    unlink(path);
+    if (bind(svc->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(svc->listen_fd, AES_SERVICE_MAX_CLIENTS) < 0) {
+        goto fail;
+    }
+    svc->wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (svc->wake_fd < 0) {
+        goto fail;
+    }
+    for (int i = 0; opts && i < opts->num_keys; i++) {
+        if (aes_service_add_key(svc, opts->keys[i].key_id, opts->keys[i].key) < 0) {
+            goto fail;
+        }
+    }
+    svc->pool = aes_pool_create(opts ? opts->workers : 0);
+    if (!svc->pool) {
+        goto fail;
+    }
+    err = pthread_create(&svc->thread, NULL, service_main, svc);
+    if (err) {
+        errno = err;
+        goto fail;
+    }
+    return svc;
+
+fail:
+    err = errno;
+    if (svc->pool) aes_pool_destroy(svc->pool);
+    if (svc->wake_fd >= 0) close(svc->wake_fd);
+    if (svc->listen_fd >= 0) {
+        close(svc->listen_fd);
+        unlink(path);
+    }
+    pthread_mutex_destroy(&svc->lock);
+    free(svc);
+    errno = err;
+    return NULL;
+}
+
+int aes_service_add_key(aes_service_t* svc, uint32_t key_id, const uint8_t key[16]) {
+    uint8_t copy[16];
+
+    if (key_id >= AES_SERVICE_MAX_KEYS) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(copy, key, sizeof(copy));
+    pthread_mutex_lock(&svc->lock);
+    aes_keyexpansion_serial(copy, svc->keys[key_id].roundKey);
+    svc->keys[key_id].used = 1;
+    pthread_mutex_unlock(&svc->lock);
+    return 0;
+}
+
+void aes_service_get_stats(aes_service_t* svc, aes_service_stats_t* stats) {
+    pthread_mutex_lock(&svc->lock);
+    *stats = svc->stats;
+    pthread_mutex_unlock(&svc->lock);
+}
+
+void aes_service_stop(aes_service_t* svc) {
+    uint64_t one = 1;
+
+    if (write(svc->wake_fd, &one, sizeof(one)) == sizeof(one)) {
+        pthread_join(svc->thread, NULL);
+    }
+    for (int i = 0; i < AES_SERVICE_MAX_CLIENTS; i++) {
+        if (svc->clients[i].fd >= 0) {
+            close_client(svc, i);
+        }
+    }
+    close(svc->listen_fd);
+    close(svc->wake_fd);
+    unlink(svc->path);
+    aes_pool_destroy(svc->pool);
+    pthread_mutex_destroy(&svc->lock);
+    free(svc->tasks);
+    free(svc);
+}
+
+//----------------------------------client----------------------------------
+
+aes_service_client_t* aes_service_connect(const char* path, size_t region_bytes) {
+    struct sockaddr_un addr;
+    aes_service_client_t* client;
+    hello_msg_t hello = { SERVICE_MAGIC, OP_HELLO, region_bytes };
+    reply_msg_t reply;
+    int memfd = -1;
+    int err;
+
+    if (unix_address(path, &addr) < 0) {
+        return NULL;
+    }
+    if (region_bytes == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    client = (aes_service_client_t*)calloc(1, sizeof(aes_service_client_t));
+    if (!client) {
+        return NULL;
+    }
+    client->region = MAP_FAILED;
+
+    client->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (client->fd < 0 || connect(client->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        goto fail;
+    }
+    memfd = memfd_create("aesctr-service", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    // Sealed at its size: the daemon refuses regions that could shrink under its mapping
+    if (memfd < 0 || ftruncate(memfd, (off_t)region_bytes) < 0 ||
+        fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) < 0) {
+        goto fail;
+    }
+    client->region = (uint8_t*)mmap(NULL, region_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (client->region == MAP_FAILED) {
+        goto fail;
+    }
+    client->region_bytes = region_bytes;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { &hello, sizeof(hello) };
+    struct msghdr msg = {0};
+    memset(control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+    if (sendmsg(client->fd, &msg, MSG_NOSIGNAL) != sizeof(hello)) {
+        goto fail;
+    }
+    ssize_t r = recv(client->fd, &reply, sizeof(reply), 0);
+    if (r != sizeof(reply) || reply.error) {
+        errno = r == sizeof(reply) ? reply.error : (r < 0 ? errno : ECONNRESET);
+        goto fail;
+    }
+    close(memfd);
+    return client;
+
+fail:
+    err = errno;
+    if (client->region != MAP_FAILED) munmap(client->region, region_bytes);
+    if (memfd >= 0) close(memfd);
+    if (client->fd >= 0) close(client->fd);
+    free(client);
+    errno = err;
+    return NULL;
+}
+
+uint8_t* aes_service_region(aes_service_client_t* client, size_t* bytes) {
+    if (bytes) {
+        *bytes = client->region_bytes;
+    }
+    return client->region;
+}
+
+int aes_service_submit(aes_service_client_t* client, uint32_t key_id, size_t offset, size_t len,
+                       const ctr_block_t* ctr, uint64_t tag) {
+    request_msg_t req = { OP_CTR, key_id, tag, offset, len, *ctr };
+
+    return send(client->fd, &req, sizeof(req), MSG_NOSIGNAL) == sizeof(req) ? 0 : -1;
+}
+
+int aes_service_wait(aes_service_client_t* client, uint64_t* tag) {
+    reply_msg_t reply;
+    ssize_t r;
+
+    do {
+        r = recv(client->fd, &reply, sizeof(reply), 0);
+    } while (r < 0 && errno == EINTR);
+    if (r != sizeof(reply)) {
+        if (r >= 0) errno = ECONNRESET;
+        return -1;
+    }
+    if (tag) {
+        *tag = reply.tag;
+    }
+    if (reply.error) {
+        errno = reply.error;
+        return -1;
+    }
+    return 0;
+}
+
+int aes_service_ctr(aes_service_client_t* client, uint32_t key_id, size_t offset, size_t len,
+                    const ctr_block_t* ctr) {
+    if (aes_service_submit(client, key_id, offset, len, ctr, 0) < 0) {
+        return -1;
+    }
+    return aes_service_wait(client, NULL);
+}
+
+void aes_service_disconnect(aes_service_client_t* client) {
+    munmap(client->region, client->region_bytes);
+    close(client->fd);
+    free(client);
+}
@@ -0,0 +1,105 @@
+#ifndef AES_SERVICE_H
+#define AES_SERVICE_H
+
+#include "aes.h"
+
+/**
+ * Host-wide encryption service. One daemon owns the keys and a single
+ * worker pool (see pool.h) and serves any number of client processes, so a
+ * host runs one well-sized pool instead of one per process. Clients talk to
+ * it over a Unix domain socket (SOCK_SEQPACKET), but only for small request
+ * and reply messages: at connect time each client hands the daemon a memfd,
+ * sealed against resizing, both sides map it, and payloads are encrypted in
+ * place in that shared region. Requests from every client that has some
+ * pending are gathered into one batch, split into chunks and run on the same
+ * workers.
+ */
+
+#define AES_SERVICE_MAX_KEYS 64
+#define AES_SERVICE_MAX_CLIENTS 128
+#define AES_SERVICE_MAX_BATCH 256               // requests gathered per round across clients
+#define AES_SERVICE_CHUNK (256UL * 1024)        // requests are split into worker tasks of this size
+
+typedef struct aes_service aes_service_t;
+typedef struct aes_service_client aes_service_client_t;
+
+typedef struct {
+    uint32_t key_id;
+    uint8_t key[16];
+} aes_service_key_t;
+
+typedef struct {
+    int workers;                // pool size, 0 for aes_get_num_threads()
+    const aes_service_key_t* keys;  // installed before the first client is served
+    int num_keys;
+} aes_service_opts_t;
+
+typedef struct {
+    uint64_t clients;           // connections accepted
+    uint64_t requests;          // requests completed, failed ones included
+    uint64_t batches;           // rounds that ran at least one request
+    uint64_t max_batch;         // most requests in one round
+    uint64_t bytes;
+} aes_service_stats_t;
+
+//----------------------------------daemon----------------------------------
+
+/**
+ * Listens on path (replacing a stale socket there) and serves clients from a
+ * background thread until aes_service_stop.
+ * opts: NULL for defaults
+ * return: NULL with errno set if the socket or pool could not be set up,
+ *         or EINVAL for a key id out of range
+ */
+aes_service_t* aes_service_start(const char* path, const aes_service_opts_t* opts);
+
+/**
+ * Installs (or replaces) a key while serving, e.g. for rotation; clients
+ * refer to it by key_id.
+ * return: -1 with errno EINVAL if key_id >= AES_SERVICE_MAX_KEYS
+ */
+int aes_service_add_key(aes_service_t* svc, uint32_t key_id, const uint8_t key[16]);
+
+void aes_service_get_stats(aes_service_t* svc, aes_service_stats_t* stats);
+
+// Stops serving, disconnects every client, removes the socket and frees svc
+void aes_service_stop(aes_service_t* svc);
+
+//----------------------------------client----------------------------------
+
+/**
+ * Connects to the daemon at path and shares a new region_bytes memfd with it.
+ * return: NULL with errno set on failure
+ */
+aes_service_client_t* aes_service_connect(const char* path, size_t region_bytes);
+
+// The shared region; requests name payloads by their offset in it
+uint8_t* aes_service_region(aes_service_client_t* client, size_t* bytes);
+
+/**
+ * Queues CTR over region bytes [offset, offset + len), in place, with counter
+ * block ctr for the first byte. Any number may be outstanding; replies come
+ * back in submission order.
+ * A client that lets its unread replies fill the socket buffer (thousands
+ * outstanding) is disconnected.
+ * tag: returned by aes_service_wait for this request
+ * return: -1 with errno set if the request could not be sent
+ */
+int aes_service_submit(aes_service_client_t* client, uint32_t key_id, size_t offset, size_t len,
+                       const ctr_block_t* ctr, uint64_t tag);
+
+/**
+ * Waits for the next reply.
+ * tag: optional, receives the request's tag
+ * return: 0 once the payload is done, or -1 with errno from the daemon
+ *         (ENOKEY for an unknown key, EINVAL for a range outside the region)
+ */
+int aes_service_wait(aes_service_client_t* client, uint64_t* tag);
+
+// aes_service_submit then aes_service_wait
+int aes_service_ctr(aes_service_client_t* client, uint32_t key_id, size_t offset, size_t len,
+                    const ctr_block_t* ctr);
+
+void aes_service_disconnect(aes_service_client_t* client);
+
+#endif
@@ -0,0 +1,256 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "stats.h"
+
+typedef struct stats_slot {
+    aes_stats_t counters;       // written only by the owner thread
+    aes_stats_t baseline;       // counters at the last reset; under slots_lock
+    struct stats_slot* next_all;
+    struct stats_slot* next_free;
+    int in_use;
+} stats_slot_t;
+
+static __thread stats_slot_t* thread_slot;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slot_key;
+static pthread_mutex_t slots_lock = PTHREAD_MUTEX_INITIALIZER;
+static stats_slot_t* all_slots;
+static stats_slot_t* free_slots;
+static aes_stats_t retired;     // counters of threads that have exited
+
+static const uint64_t size_bounds[AES_STATS_SIZE_BUCKETS - 1] = {
+    1 << 10, 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20, 16 << 20
+};
+static const char* size_labels[AES_STATS_SIZE_BUCKETS] = {
+    "1KiB", "4KiB", "16KiB", "64KiB", "256KiB", "1MiB", "16MiB", "inf"
+};
+static const uint64_t latency_bounds_ns[AES_STATS_LATENCY_BUCKETS - 1] = {
+    1000, 4000, 16000, 64000, 256000, 1000000, 4000000, 16000000, 64000000, 256000000, 1000000000
+};
+
+const char* aes_backend_name(aes_backend_t backend) {
+    static const char* names[AES_NUM_BACKENDS] = {
+        "serial", "aesni", "vaes", "pthread", "openmp", "vaes_pthread", "pool", "stream", "iov", "burst", "page", "async", "coalesce"
+    };
+    return backend < AES_NUM_BACKENDS ? names[backend] : "unknown";
+}
+
+uint64_t aes_stats_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// into += from - base; base may be NULL
+static void merge(aes_stats_t* into, const aes_stats_t* from, const aes_stats_t* base) {
+    const uint64_t* src = (const uint64_t*)from;
+    const uint64_t* sub = (const uint64_t*)base;
+    uint64_t* dst = (uint64_t*)into;
+
+    // Every field is a 64-bit counter, queue_depth included (two's complement)
+    for(size_t i = 0; i < sizeof(aes_stats_t) / sizeof(uint64_t); i++) {
+        dst[i] += __atomic_load_n(&src[i], __ATOMIC_RELAXED) - (sub ? sub[i] : 0);
+    }
+}
+
+static void retire_slot(void* arg) {
+    stats_slot_t* slot = (stats_slot_t*)arg;
+
+    pthread_mutex_lock(&slots_lock);
+    // The owner is exiting, so nothing writes the slot any more
+    merge(&retired, &slot->counters, &slot->baseline);
+    memset(&slot->counters, 0, sizeof(slot->counters));
+    memset(&slot->baseline, 0, sizeof(slot->baseline));
+    slot->in_use = 0;
+    slot->next_free = free_slots;
+    free_slots = slot;
+    pthread_mutex_unlock(&slots_lock);
+}
+
+static void stats_init() {
+    pthread_key_create(&slot_key, retire_slot);
+}
+
+static stats_slot_t* get_slot() {
+    stats_slot_t* slot = thread_slot;
+    if (__builtin_expect(slot != NULL, 1)) {
+        return slot;
+    }
+
+    pthread_once(&stats_once, stats_init);
+    pthread_mutex_lock(&slots_lock);
+    slot = free_slots;
+    if (slot) {
+        free_slots = slot->next_free;
+    } else {
+        slot = (stats_slot_t*)calloc(1, sizeof(stats_slot_t));
+        if (slot) {
+            slot->next_all = all_slots;
+            all_slots = slot;
+        }
+    }
+    if (slot) {
+        slot->in_use = 1;
+    }
+    pthread_mutex_unlock(&slots_lock);
+
+    if (slot) {
+        pthread_setspecific(slot_key, slot);
+        thread_slot = slot;
+    }
+    return slot;
+}
+
+// Owner-only increment: a relaxed load and store, no locked read-modify-write
+static inline void bump(uint64_t* counter, uint64_t delta) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + delta, __ATOMIC_RELAXED);
+}
+
+void aes_stats_record(aes_backend_t backend, uint64_t bytes, uint64_t latency_ns) {
+    stats_slot_t* slot = get_slot();
+    int size_bucket = 0, latency_bucket = 0;
+
+    if (!slot || backend >= AES_NUM_BACKENDS) {
+        return;
+    }
+    while (size_bucket < AES_STATS_SIZE_BUCKETS - 1 && bytes > size_bounds[size_bucket]) {
+        size_bucket++;
+    }
+    while (latency_bucket < AES_STATS_LATENCY_BUCKETS - 1 && latency_ns > latency_bounds_ns[latency_bucket]) {
+        latency_bucket++;
+    }
+
+    aes_stats_t* c = &slot->counters;
+    bump(&c->calls[backend], 1);
+    bump(&c->bytes[backend], bytes);
+    bump(&c->latency_ns_sum[backend][size_bucket], latency_ns);
+    bump(&c->latency_count[backend][size_bucket][latency_bucket], 1);
+}
+
+void aes_stats_queue_add(int64_t delta) {
+    stats_slot_t* slot = get_slot();
+    if (slot) {
+        bump((uint64_t*)&slot->counters.queue_depth, (uint64_t)delta);
+    }
+}
+
+void aes_stats_snapshot(aes_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    pthread_mutex_lock(&slots_lock);
+    merge(stats, &retired, NULL);
+    for(stats_slot_t* slot = all_slots; slot; slot = slot->next_all) {
+        if (slot->in_use) {
+            merge(stats, &slot->counters, &slot->baseline);
+        }
+    }
+    pthread_mutex_unlock(&slots_lock);
+}
+
+/**
+ * Live slots belong to their owner threads, which may be mid-update, so a
+ * reset only moves each slot's baseline up to its current counters. Queue
+ * depth keeps a zero baseline: jobs in flight are still in flight.
+ */
+void aes_stats_reset() {
+    pthread_mutex_lock(&slots_lock);
+    for(stats_slot_t* slot = all_slots; slot; slot = slot->next_all) {
+        const uint64_t* src = (const uint64_t*)&slot->counters;
+        uint64_t* base = (uint64_t*)&slot->baseline;
+        for(size_t i = 0; i < sizeof(aes_stats_t) / sizeof(uint64_t); i++) {
+            base[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        }
+        slot->baseline.queue_depth = 0;
+    }
+    int64_t depth = retired.queue_depth;
+    memset(&retired, 0, sizeof(retired));
+    retired.queue_depth = depth;
+    pthread_mutex_unlock(&slots_lock);
+}
+
+static void render(FILE* f, const aes_stats_t* s) {
+    fprintf(f, "# HELP aes_calls_total Encryption calls per backend.\n");
+    fprintf(f, "# TYPE aes_calls_total counter\n");
+    for(int b = 0; b < AES_NUM_BACKENDS; b++) {
+        fprintf(f, "aes_calls_total{backend=\"%s\"} %llu\n", aes_backend_name(b), (unsigned long long)s->calls[b]);
+    }
+
+    fprintf(f, "# HELP aes_bytes_total Bytes encrypted per backend.\n");
+    fprintf(f, "# TYPE aes_bytes_total counter\n");
+    for(int b = 0; b < AES_NUM_BACKENDS; b++) {
+        fprintf(f, "aes_bytes_total{backend=\"%s\"} %llu\n", aes_backend_name(b), (unsigned long long)s->bytes[b]);
+    }
+
+    fprintf(f, "# HELP aes_latency_seconds Call latency per backend and request size bucket.\n");
+    fprintf(f, "# TYPE aes_latency_seconds histogram\n");
+    for(int b = 0; b < AES_NUM_BACKENDS; b++) {
+        for(int z = 0; z < AES_STATS_SIZE_BUCKETS; z++) {
+            uint64_t cumulative = 0;
+            for(int l = 0; l < AES_STATS_LATENCY_BUCKETS; l++) {
+                cumulative += s->latency_count[b][z][l];
+            }
+            // Only size buckets that have seen traffic, to keep scrapes small
+            if (cumulative == 0) {
+                continue;
+            }
+
+            cumulative = 0;
+            for(int l = 0; l < AES_STATS_LATENCY_BUCKETS; l++) {
+                cumulative += s->latency_count[b][z][l];
+                if (l < AES_STATS_LATENCY_BUCKETS - 1) {
+                    fprintf(f, "aes_latency_seconds_bucket{backend=\"%s\",size=\"%s\",le=\"%g\"} %llu\n",
+                            aes_backend_name(b), size_labels[z], latency_bounds_ns[l] / 1e9,
+                            (unsigned long long)cumulative);
+                } else {
+                    fprintf(f, "aes_latency_seconds_bucket{backend=\"%s\",size=\"%s\",le=\"+Inf\"} %llu\n",
+                            aes_backend_name(b), size_labels[z], (unsigned long long)cumulative);
+                }
+            }
+            fprintf(f, "aes_latency_seconds_sum{backend=\"%s\",size=\"%s\"} %.9f\n",
+                    aes_backend_name(b), size_labels[z], s->latency_ns_sum[b][z] / 1e9);
+            fprintf(f, "aes_latency_seconds_count{backend=\"%s\",size=\"%s\"} %llu\n",
+                    aes_backend_name(b), size_labels[z], (unsigned long long)cumulative);
+        }
+    }
+
+    fprintf(f, "# HELP aes_queue_depth Worker chunks submitted and not yet finished.\n");
+    fprintf(f, "# TYPE aes_queue_depth gauge\n");
+    fprintf(f, "aes_queue_depth %lld\n", (long long)s->queue_depth);
+}
+
+size_t aes_stats_render_prometheus(char* buf, size_t len) {
+    aes_stats_t stats;
+    char* text = NULL;
+    size_t text_len = 0;
+
+    aes_stats_snapshot(&stats);
+
+    FILE* f = open_memstream(&text, &text_len);
+    if (!f) {
+        return 0;
+    }
+    render(f, &stats);
+    fclose(f);
+
+    if (len > 0) {
+        size_t n = text_len < len - 1 ? text_len : len - 1;
+        memcpy(buf, text, n);
+        buf[n] = '\0';
+    }
+    free(text);
+    return text_len;
+}
+
+int aes_stats_write_prometheus(FILE* out) {
+    aes_stats_t stats;
+
+    aes_stats_snapshot(&stats);
+    render(out, &stats);
+    return ferror(out) ? -1 : 0;
+}
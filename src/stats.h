@@ -0,0 +1,61 @@
+#ifndef AES_STATS_H
+#define AES_STATS_H
+
+#include "aes.h"
+
+/**
+ * Throughput counters for long-running processes.
+ * Every thread records into its own counter slot with plain relaxed stores,
+ * so the encryption path never touches a shared cache line; readers merge
+ * all slots. Counters of exited threads are folded into a retired total.
+ */
+
+typedef enum {
+    AES_BACKEND_SERIAL = 0,
+    AES_BACKEND_AESNI,
+    AES_BACKEND_VAES,
+    AES_BACKEND_PTHREAD,
+    AES_BACKEND_OPENMP,
+    AES_BACKEND_VAES_PTHREAD,
+    AES_BACKEND_POOL,
+    AES_BACKEND_STREAM,
+    AES_BACKEND_IOV,
+    AES_BACKEND_BURST,
+    AES_BACKEND_PAGE,
+    AES_BACKEND_ASYNC,
+    AES_BACKEND_COALESCE,
+    AES_NUM_BACKENDS
+} aes_backend_t;
+
+// Request size buckets, upper bounds in bytes: 1K 4K 16K 64K 256K 1M 16M, then larger
+#define AES_STATS_SIZE_BUCKETS 8
+// Latency buckets, upper bounds: 1us 4us 16us 64us 256us 1ms 4ms 16ms 64ms 256ms 1s, then slower
+#define AES_STATS_LATENCY_BUCKETS 12
+
+typedef struct {
+    uint64_t calls[AES_NUM_BACKENDS];
+    uint64_t bytes[AES_NUM_BACKENDS];
+    uint64_t latency_ns_sum[AES_NUM_BACKENDS][AES_STATS_SIZE_BUCKETS];
+    uint64_t latency_count[AES_NUM_BACKENDS][AES_STATS_SIZE_BUCKETS][AES_STATS_LATENCY_BUCKETS];
+    int64_t queue_depth;        // worker chunks submitted and not yet finished
+} aes_stats_t;
+
+const char* aes_backend_name(aes_backend_t backend);
+
+uint64_t aes_stats_now_ns();
+void aes_stats_record(aes_backend_t backend, uint64_t bytes, uint64_t latency_ns);
+void aes_stats_queue_add(int64_t delta);
+
+// Merged view of every thread's counters
+void aes_stats_snapshot(aes_stats_t* stats);
+// Zeroes the counters as seen by snapshots; safe while other threads record. Queue depth is kept.
+void aes_stats_reset();
+
+/**
+ * Renders the counters in Prometheus text exposition format.
+ * return: length of the full text; if it is >= len the output was truncated
+ */
+size_t aes_stats_render_prometheus(char* buf, size_t len);
+int aes_stats_write_prometheus(FILE* out);
+
+#endif
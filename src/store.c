@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "store.h"
+
+#define FALLBACK_LLC (32UL * 1024 * 1024)
+
+static aes_store_policy_t store_policy = AES_STORE_AUTO;
+static size_t streaming_threshold;  // 0 until resolved from the cache size
+
+aes_store_policy_t aes_get_store_policy() {
+    return store_policy;
+}
+
+void aes_set_store_policy(aes_store_policy_t policy) {
+    store_policy = policy;
+}
+
+const char* aes_store_policy_name(aes_store_policy_t policy) {
+    switch (policy) {
+        case AES_STORE_REGULAR:   return "regular";
+        case AES_STORE_STREAMING: return "streaming";
+        default:                  return "auto";
+    }
+}
+
+size_t aes_get_streaming_threshold() {
+    if (streaming_threshold == 0) {
+        long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (llc <= 0) {
+            llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        }
+        // Every thread resolves the same value, so the unsynchronized store is harmless
+        streaming_threshold = llc > 0 ? (size_t)llc : FALLBACK_LLC;
+    }
+    return streaming_threshold;
+}
+
+void aes_set_streaming_threshold(size_t bytes) {
+    streaming_threshold = bytes;
+}
+
+int aes_streaming_stores(const void* input, const void* output, size_t bytes) {
+    switch (store_policy) {
+        case AES_STORE_REGULAR:   return 0;
+        case AES_STORE_STREAMING: return 1;
+        default:
+            // In place, the output lines are already cached by the loads
+            return input != output && 2 * bytes >= aes_get_streaming_threshold();
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef AES_STORE_H
+#define AES_STORE_H
+
+#include "aes.h"
+
+/**
+ * Store policy for the AES-NI and VAES kernels. Streaming (non-temporal)
+ * stores write ciphertext around the cache: no read-for-ownership of the
+ * output lines and no eviction of data that is still wanted, at the cost of
+ * the output not being cached afterwards. Streaming kernels also prefetch
+ * their input ahead and end with an sfence.
+ */
+
+typedef enum {
+    AES_STORE_AUTO = 0,     // streaming for out-of-place jobs whose input + output reach the threshold
+    AES_STORE_REGULAR,
+    AES_STORE_STREAMING     // always, including in-place jobs
+} aes_store_policy_t;
+
+aes_store_policy_t aes_get_store_policy();
+void aes_set_store_policy(aes_store_policy_t policy);
+const char* aes_store_policy_name(aes_store_policy_t policy);
+
+// Footprint in bytes (input + output) from which AES_STORE_AUTO streams; default (or 0): LLC size
+size_t aes_get_streaming_threshold();
+void aes_set_streaming_threshold(size_t bytes);
+
+/**
+ * Whether a job of `bytes` from input to output should use streaming stores
+ * under the current policy. Decide once per job, not per thread range.
+ */
+int aes_streaming_stores(const void* input, const void* output, size_t bytes);
+
+#endif
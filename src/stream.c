@@ -0,0 +1,371 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <immintrin.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "stream.h"
+#include "dispatch.h"
+#include "affinity.h"
+#include "stats.h"
+#include "trace.h"
+#include "buf.h"
+
+#define SPIN_LIMIT 128          // pause iterations before sleeping on the futex
+#define NO_END UINT64_MAX
+
+/**
+ * Slot state: phase in the low two bits, lap (seq / num_slots) above them, so
+ * a stage waiting for seq can't mistake the slot's previous use for its own.
+ * Reader fills EMPTY -> FILLED, a worker encrypts FILLED -> DONE, the writer
+ * drains DONE -> EMPTY of the next lap.
+ */
+enum { SLOT_EMPTY = 0, SLOT_FILLED = 1, SLOT_DONE = 2 };
+
+typedef struct {
+    _Atomic uint32_t state;
+    _Atomic uint32_t waiters;
+    size_t len;                 // 0 marks the end of the stream
+    uint8_t* data;
+} __attribute__((aligned(64))) slot_t;
+
+typedef struct {
+    slot_t* slots;
+    int num_slots;
+    size_t slot_size;
+    int in_fd;
+    int out_fd;
+    uint8_t* roundKey;
+    ctr_block_t* initial_ctr;
+    aesctr_bulk_fn kernel;
+
+    _Atomic uint64_t next_claim;        // next seq a worker takes
+    _Atomic uint32_t filled;            // slots published by the reader, wrapping; workers sleep on it
+    _Atomic uint32_t filled_waiters;
+    _Atomic uint64_t end_seq;           // seq of the end marker, NO_END until then
+    _Atomic int err;                    // first errno from either side
+    uint64_t written;
+
+    _Atomic uint64_t reader_waits;
+    _Atomic uint64_t worker_waits;
+    _Atomic uint64_t writer_waits;
+} stream_t;
+
+typedef struct {
+    stream_t* st;
+    int worker_idx;
+} worker_arg_t;
+
+static uint32_t slot_state(const stream_t* st, uint64_t seq, uint32_t phase) {
+    return (uint32_t)((seq / st->num_slots) << 2) | phase;
+}
+
+static void futex_wait(_Atomic uint32_t* word, uint32_t seen) {
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t* word) {
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+/**
+ * Spins briefly, then sleeps until *word differs from seen.
+ * return: 1 if it had to sleep
+ */
+static int wait_change(_Atomic uint32_t* word, _Atomic uint32_t* waiters, uint32_t seen) {
+    for (int i = 0; i < SPIN_LIMIT; i++) {
+        if (atomic_load(word) != seen) {
+            return 0;
+        }
+        _mm_pause();
+    }
+
+    // Publishers store the word before checking waiters, so one side always sees the other
+    atomic_fetch_add(waiters, 1);
+    while (atomic_load(word) == seen) {
+        futex_wait(word, seen);
+    }
+    atomic_fetch_sub(waiters, 1);
+    return 1;
+}
+
+static void wake_if_waiting(_Atomic uint32_t* word, _Atomic uint32_t* waiters) {
+    if (atomic_load(waiters) > 0) {
+        futex_wake(word);
+    }
+}
+
+// Waits for the slot to reach state; return: 1 if it had to sleep
+static int wait_slot(slot_t* slot, uint32_t state) {
+    int slept = 0;
+    uint32_t seen;
+    while ((seen = atomic_load(&slot->state)) != state) {
+        slept |= wait_change(&slot->state, &slot->waiters, seen);
+    }
+    return slept;
+}
+
+static void set_slot(slot_t* slot, uint32_t state) {
+    atomic_store(&slot->state, state);
+    wake_if_waiting(&slot->state, &slot->waiters);
+}
+
+static void publish_filled(stream_t* st) {
+    atomic_fetch_add(&st->filled, 1);
+    wake_if_waiting(&st->filled, &st->filled_waiters);
+}
+
+static void set_error(stream_t* st, int err) {
+    int none = 0;
+    atomic_compare_exchange_strong(&st->err, &none, err);
+}
+
+// Reads until len bytes or end of file; return: bytes read, or -1 with errno set
+static ssize_t read_full(int fd, uint8_t* buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = read(fd, buf + done, len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        done += n;
+    }
+    return done;
+}
+
+static int write_full(int fd, const uint8_t* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void encrypt_slot(stream_t* st, slot_t* slot, uint64_t seq) {
+    size_t num_blocks = slot->len / BLOCK_SIZE;
+    size_t tail = slot->len % BLOCK_SIZE;
+    uint64_t start_ns = aes_stats_now_ns();
+    ctr_block_t ctr;
+
+    AES_TRACE(AES_TRACE_CHUNK_BEGIN, "stream", slot->len);
+    // Every slot but the last is full, so seq fixes the stream offset
+    ctr_block_advance(st->initial_ctr, &ctr, seq * (st->slot_size / BLOCK_SIZE));
+    st->kernel(slot->data, st->roundKey, slot->data, num_blocks, &ctr);
+
+    if (tail > 0) {
+        uint8_t block[BLOCK_SIZE] = {0};
+
+        ctr_block_advance(&ctr, &ctr, num_blocks);
+        memcpy(block, slot->data + num_blocks * BLOCK_SIZE, tail);
+        aesctr_kernel_serial(block, st->roundKey, block, 1, &ctr);
+        memcpy(slot->data + num_blocks * BLOCK_SIZE, block, tail);
+    }
+    AES_TRACE(AES_TRACE_CHUNK_END, "stream", 0);
+    aes_stats_record(AES_BACKEND_STREAM, slot->len, aes_stats_now_ns() - start_ns);
+}
+
+static void* stream_worker(void* arg) {
+    worker_arg_t* worker = (worker_arg_t*)arg;
+    stream_t* st = worker->st;
+
+    aes_pin_thread(worker->worker_idx);
+
+    for (;;) {
+        uint64_t seq = atomic_fetch_add(&st->next_claim, 1);
+        int slept = 0;
+
+        for (;;) {
+            // filled first: the reader sets end_seq before its final bump
+            uint32_t filled = atomic_load(&st->filled);
+            if (seq >= atomic_load(&st->end_seq)) {
+                return NULL;
+            }
+            if ((int32_t)(filled - (uint32_t)seq) > 0) {
+                break;
+            }
+            slept |= wait_change(&st->filled, &st->filled_waiters, filled);
+        }
+        if (slept) {
+            atomic_fetch_add(&st->worker_waits, 1);
+        }
+
+        slot_t* slot = &st->slots[seq % st->num_slots];
+        encrypt_slot(st, slot, seq);
+        set_slot(slot, slot_state(st, seq, SLOT_DONE));
+    }
+}
+
+static void* stream_writer(void* arg) {
+    stream_t* st = (stream_t*)arg;
+
+    for (uint64_t seq = 0;; seq++) {
+        slot_t* slot = &st->slots[seq % st->num_slots];
+
+        if (wait_slot(slot, slot_state(st, seq, SLOT_DONE))) {
+            atomic_fetch_add(&st->writer_waits, 1);
+        }
+        if (slot->len == 0) {
+            break;
+        }
+        // After an error keep draining, so the reader and workers never block on a full ring
+        if (atomic_load(&st->err) == 0) {
+            if (write_full(st->out_fd, slot->data, slot->len) < 0) {
+                set_error(st, errno);
+            } else {
+                st->written += slot->len;
+            }
+        }
+        set_slot(slot, slot_state(st, seq + st->num_slots, SLOT_EMPTY));
+    }
+    return NULL;
+}
+
+// Runs on the calling thread; returns once the end marker is in the ring
+static void stream_reader(stream_t* st) {
+    int eof = 0;
+
+    for (uint64_t seq = 0;; seq++) {
+        slot_t* slot = &st->slots[seq % st->num_slots];
+
+        if (wait_slot(slot, slot_state(st, seq, SLOT_EMPTY))) {
+            atomic_fetch_add(&st->reader_waits, 1);
+        }
+
+        ssize_t len = 0;
+        if (!eof && atomic_load(&st->err) == 0) {
+            len = read_full(st->in_fd, slot->data, st->slot_size);
+            if (len < 0) {
+                set_error(st, errno);
+                len = 0;
+            }
+            // A short slot already saw end of file; don't read a terminal twice
+            eof = (size_t)len < st->slot_size;
+        }
+
+        if (len == 0) {
+            // The end marker skips the workers and stops the writer
+            slot->len = 0;
+            atomic_store(&st->end_seq, seq);
+            set_slot(slot, slot_state(st, seq, SLOT_DONE));
+            publish_filled(st);
+            return;
+        }
+
+        slot->len = len;
+        set_slot(slot, slot_state(st, seq, SLOT_FILLED));
+        publish_filled(st);
+    }
+}
+
+int64_t aes_encrypt_stream(int in_fd, int out_fd, uint8_t* roundKey, ctr_block_t* initial_ctr,
+                           const aes_stream_opts_t* opts, aes_stream_stats_t* stats) {
+    static const aes_stream_opts_t default_opts = {0};
+    pthread_t workers[AES_MAX_THREADS];
+    worker_arg_t worker_args[AES_MAX_THREADS];
+    pthread_t writer;
+    stream_t st;
+    int started = 0;
+    int err = 0;
+
+    if (!opts) {
+        opts = &default_opts;
+    }
+
+    memset(&st, 0, sizeof(st));
+    st.in_fd = in_fd;
+    st.out_fd = out_fd;
+    st.roundKey = roundKey;
+    st.initial_ctr = initial_ctr;
+    st.kernel = aes_select_bulk_kernel(NULL);
+    st.slot_size = opts->slot_size ? (opts->slot_size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE
+                                   : AES_STREAM_DEFAULT_SLOT;
+    atomic_store(&st.end_seq, NO_END);
+
+    int num_workers = opts->workers > 0 ? opts->workers : aes_get_num_threads();
+    if (num_workers > AES_MAX_THREADS) {
+        num_workers = AES_MAX_THREADS;
+    }
+    st.num_slots = opts->slots > 0 ? opts->slots : 2 * num_workers + 2;
+    if (st.num_slots < 4) {
+        st.num_slots = 4;
+    }
+
+    st.slots = (slot_t*)aligned_alloc(64, st.num_slots * sizeof(slot_t));
+    uint8_t* region = (uint8_t*)aes_buf_alloc(st.num_slots * st.slot_size, 0);
+    if (!st.slots || !region) {
+        free(st.slots);
+        aes_buf_free(region);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (int i = 0; i < st.num_slots; i++) {
+        atomic_init(&st.slots[i].state, slot_state(&st, i, SLOT_EMPTY));
+        atomic_init(&st.slots[i].waiters, 0);
+        st.slots[i].len = 0;
+        st.slots[i].data = region + (size_t)i * st.slot_size;
+    }
+
+    err = pthread_create(&writer, NULL, stream_writer, &st);
+    if (err) {
+        goto out_free;
+    }
+    for (int i = 0; i < num_workers; i++) {
+        worker_args[i].st = &st;
+        worker_args[i].worker_idx = i;
+        if (pthread_create(&workers[i], NULL, stream_worker, &worker_args[i]) != 0) {
+            break;
+        }
+        started++;
+    }
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "stream", 0);
+    if (started == 0) {
+        // Nobody to encrypt: end the stream at once so the writer exits
+        err = EAGAIN;
+        atomic_store(&st.end_seq, 0);
+        st.slots[0].len = 0;
+        set_slot(&st.slots[0], slot_state(&st, 0, SLOT_DONE));
+    } else {
+        stream_reader(&st);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_join(writer, NULL);
+    AES_TRACE(AES_TRACE_JOB_END, "stream", 0);
+
+    if (!err) {
+        err = atomic_load(&st.err);
+    }
+    if (stats) {
+        stats->slots = atomic_load(&st.end_seq);
+        stats->reader_waits = atomic_load(&st.reader_waits);
+        stats->worker_waits = atomic_load(&st.worker_waits);
+        stats->writer_waits = atomic_load(&st.writer_waits);
+    }
+
+out_free:
+    free(st.slots);
+    aes_buf_free(region);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return (int64_t)st.written;
+}
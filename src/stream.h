@@ -0,0 +1,43 @@
+#ifndef AES_STREAM_H
+#define AES_STREAM_H
+
+#include "aes.h"
+
+/**
+ * Streaming encryption between file descriptors of any kind (pipes, sockets,
+ * terminals), for use as a filter: tar | aesctr_stream | upload. A reader
+ * thread fills fixed-size slots of a ring, workers claim filled slots in
+ * stream order and encrypt them in place, and a writer thread emits them in
+ * order. The ring is the only buffering, so memory stays at slots * slot_size
+ * however long the stream is. Hand-off between stages is through atomics on
+ * the slots; a thread only sleeps (on a futex) when its next slot isn't ready.
+ */
+
+#define AES_STREAM_DEFAULT_SLOT (1UL * 1024 * 1024)
+
+typedef struct {
+    size_t slot_size;           // bytes per slot, 0 for AES_STREAM_DEFAULT_SLOT; rounded up to 16
+    int slots;                  // ring size, 0 for twice the workers plus two (at least 4)
+    int workers;                // encryption threads, 0 for aes_get_num_threads()
+} aes_stream_opts_t;
+
+typedef struct {
+    uint64_t slots;             // slots that carried data
+    uint64_t reader_waits;      // times the reader slept on a full ring (writer or workers behind)
+    uint64_t worker_waits;      // times a worker slept on an empty ring (input behind)
+    uint64_t writer_waits;      // times the writer slept on an unfinished slot
+} aes_stream_stats_t;
+
+/**
+ * Encrypts (or decrypts) everything read from in_fd until end of file and
+ * writes it to out_fd. Byte offset o of the stream uses counter
+ * initial_ctr + o / 16, the same as the file APIs.
+ * roundKey: serial key schedule from aes_keyexpansion_serial
+ * opts: NULL for defaults
+ * stats: optional
+ * return: bytes written, or -1 with errno set on a read or write error
+ */
+int64_t aes_encrypt_stream(int in_fd, int out_fd, uint8_t* roundKey, ctr_block_t* initial_ctr,
+                           const aes_stream_opts_t* opts, aes_stream_stats_t* stats);
+
+#endif
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+typedef struct {
+    uint64_t ts_ns;
+    const char* name;
+    uint64_t arg;
+    uint32_t type;
+} trace_entry_t;
+
+// One per thread lane. A ring is only written by the thread that owns it;
+// when that thread exits the ring goes on a free list for the next new thread.
+typedef struct trace_ring {
+    trace_entry_t events[AES_TRACE_RING_EVENTS];
+    uint64_t head;              // total events written, index = head % AES_TRACE_RING_EVENTS
+    int lane;
+    struct trace_ring* next_all;
+    struct trace_ring* next_free;
+} trace_ring_t;
+
+int aes_trace_on;
+
+static __thread trace_ring_t* thread_ring;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_ring_t* all_rings;
+static trace_ring_t* free_rings;
+static int num_lanes;
+static const char* exit_dump_path;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void release_ring(void* ring) {
+    pthread_mutex_lock(&rings_lock);
+    ((trace_ring_t*)ring)->next_free = free_rings;
+    free_rings = (trace_ring_t*)ring;
+    pthread_mutex_unlock(&rings_lock);
+}
+
+static void dump_at_exit() {
+    aes_trace_dump(exit_dump_path);
+}
+
+static void trace_init() {
+    pthread_key_create(&ring_key, release_ring);
+
+    const char* path = getenv("AES_TRACE");
+    if (path && path[0]) {
+        exit_dump_path = path;
+        aes_trace_on = 1;
+        atexit(dump_at_exit);
+    }
+}
+
+// Picks up AES_TRACE before main so the first job is already traced
+__attribute__((constructor)) static void trace_init_from_env() {
+    pthread_once(&trace_once, trace_init);
+}
+
+// Runs once per thread, on its first event
+static trace_ring_t* acquire_ring() {
+    trace_ring_t* ring;
+
+    pthread_mutex_lock(&rings_lock);
+    ring = free_rings;
+    if (ring) {
+        free_rings = ring->next_free;
+    } else {
+        ring = (trace_ring_t*)calloc(1, sizeof(trace_ring_t));
+        if (ring) {
+            ring->lane = num_lanes++;
+            ring->next_all = all_rings;
+            all_rings = ring;
+        }
+    }
+    pthread_mutex_unlock(&rings_lock);
+
+    if (ring) {
+        pthread_setspecific(ring_key, ring);
+    }
+    return ring;
+}
+
+void aes_trace_enable(int enable) {
+    pthread_once(&trace_once, trace_init);
+    aes_trace_on = enable != 0;
+}
+
+void aes_trace_record(aes_trace_event_t type, const char* name, uint64_t arg) {
+    trace_ring_t* ring = thread_ring;
+
+    if (__builtin_expect(ring == NULL, 0)) {
+        pthread_once(&trace_once, trace_init);
+        ring = thread_ring = acquire_ring();
+        if (!ring) {
+            return;
+        }
+    }
+
+    trace_entry_t* e = &ring->events[ring->head % AES_TRACE_RING_EVENTS];
+    e->ts_ns = now_ns();
+    e->name = name;
+    e->arg = arg;
+    e->type = type;
+    // Publish after the entry is complete, for a dump racing with a live thread
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+void aes_trace_clear() {
+    pthread_mutex_lock(&rings_lock);
+    for(trace_ring_t* ring = all_rings; ring; ring = ring->next_all) {
+        __atomic_store_n(&ring->head, 0, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&rings_lock);
+}
+
+static void write_event(FILE* f, const trace_entry_t* e, int lane, uint64_t origin_ns, int* first) {
+    static const char phases[] = { 'B', 'E', 'B', 'E', 'i', 'B', 'E' };
+    const char* name = e->name ? e->name : "event";
+
+    if (e->type == AES_TRACE_JOIN_BEGIN || e->type == AES_TRACE_JOIN_END) {
+        name = "join";
+    } else if (e->type == AES_TRACE_STEAL) {
+        name = "steal";
+    }
+
+    fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+            *first ? "" : ",", name, phases[e->type], (e->ts_ns - origin_ns) / 1e3, lane);
+    if (e->type == AES_TRACE_STEAL) {
+        fprintf(f, ",\"s\":\"t\"");
+    }
+    if (e->arg) {
+        fprintf(f, ",\"args\":{\"bytes\":%llu}", (unsigned long long)e->arg);
+    }
+    fprintf(f, "}");
+    *first = 0;
+}
+
+int aes_trace_dump(const char* path) {
+    FILE* f = fopen(path, "w");
+    uint64_t origin_ns = UINT64_MAX;
+    int first = 1;
+
+    if (!f) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&rings_lock);
+
+    // Timestamps are relative to the oldest buffered event
+    for(trace_ring_t* ring = all_rings; ring; ring = ring->next_all) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t begin = head > AES_TRACE_RING_EVENTS ? head - AES_TRACE_RING_EVENTS : 0;
+        if (head > begin && ring->events[begin % AES_TRACE_RING_EVENTS].ts_ns < origin_ns) {
+            origin_ns = ring->events[begin % AES_TRACE_RING_EVENTS].ts_ns;
+        }
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for(trace_ring_t* ring = all_rings; ring; ring = ring->next_all) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t begin = head > AES_TRACE_RING_EVENTS ? head - AES_TRACE_RING_EVENTS : 0;
+
+        fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"lane %d\"}}",
+                first ? "" : ",", ring->lane, ring->lane);
+        first = 0;
+        for(uint64_t i = begin; i < head; i++) {
+            write_event(f, &ring->events[i % AES_TRACE_RING_EVENTS], ring->lane, origin_ns, &first);
+        }
+    }
+    fprintf(f, "\n]}\n");
+
+    pthread_mutex_unlock(&rings_lock);
+
+    return fclose(f) == 0 ? 0 : -1;
+}
@@ -0,0 +1,50 @@
+#ifndef AES_TRACE_H
+#define AES_TRACE_H
+
+#include "aes.h"
+
+/**
+ * Timeline tracing for the parallel drivers, dumped as Chrome trace JSON
+ * (open in Perfetto or chrome://tracing).
+ * Each thread appends to its own ring buffer, so recording takes no locks;
+ * when tracing is off a record is a single predicted branch on aes_trace_on.
+ * Enable with aes_trace_enable(1), or set AES_TRACE=<file.json> to trace the
+ * whole process and dump at exit.
+ */
+
+// Events kept per thread; older ones are overwritten
+#define AES_TRACE_RING_EVENTS 8192
+
+typedef enum {
+    AES_TRACE_JOB_BEGIN = 0,    // arg: bytes in the job
+    AES_TRACE_JOB_END,
+    AES_TRACE_CHUNK_BEGIN,      // arg: bytes in the chunk
+    AES_TRACE_CHUNK_END,        // arg: bytes, if not known at the start
+    AES_TRACE_STEAL,            // arg: bytes taken from another worker's share
+    AES_TRACE_JOIN_BEGIN,
+    AES_TRACE_JOIN_END,
+} aes_trace_event_t;
+
+extern int aes_trace_on;
+
+void aes_trace_enable(int enable);
+void aes_trace_record(aes_trace_event_t type, const char* name, uint64_t arg);
+
+/**
+ * Writes every buffered event to path as Chrome trace JSON.
+ * Call once the traced jobs have returned.
+ * return: 0 on success, -1 if the file can't be written
+ */
+int aes_trace_dump(const char* path);
+
+// Drops buffered events
+void aes_trace_clear();
+
+#define AES_TRACE(type, name, arg) \
+    do { \
+        if (__builtin_expect(aes_trace_on, 0)) { \
+            aes_trace_record((type), (name), (arg)); \
+        } \
+    } while (0)
+
+#endif
@@ -0,0 +1,263 @@
+// Built without -mavx512f -mvaes so callers can dispatch at runtime
+#pragma GCC target("aes,avx512f,vaes")
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <immintrin.h>
+#include <cpuid.h>
+
+#include "vaes.h"
+#include "aes_pthread.h"
+#include "affinity.h"
+#include "trace.h"
+#include "stats.h"
+#include "store.h"
+
+// Check for AVX-512F + VAES support
+int check_vaes_support() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    return (ebx & bit_AVX512F) != 0 && (ecx & bit_VAES) != 0;
+}
+
+static inline uint64_t load_counter_value(const ctr_block_t* ctr) {
+    uint64_t counter_value = 0;
+    for (int i = 0; i < 8; i++) {
+        counter_value = (counter_value << 8) | ctr->counter[i];
+    }
+    return counter_value;
+}
+
+// Four consecutive counter blocks, one per 128-bit lane
+static inline __m512i make_counter_vec(uint64_t nonce, uint64_t counter_value) {
+    return _mm512_set_epi64(
+        __builtin_bswap64(counter_value + 3), nonce,
+        __builtin_bswap64(counter_value + 2), nonce,
+        __builtin_bswap64(counter_value + 1), nonce,
+        __builtin_bswap64(counter_value + 0), nonce);
+}
+
+// Input prefetch distance for the streaming variant, past what the hardware prefetcher covers
+#define PREFETCH_BYTES 1024
+
+// One block with 128-bit AES-NI, for the unaligned head and the 1-3 block tail
+static inline void vaes_one_block(uint8_t* input, __m128i* key_schedule, uint8_t* output,
+                                  uint64_t nonce, uint64_t counter_value, size_t i) {
+    __m128i counter_block_vec = _mm_set_epi64x(__builtin_bswap64(counter_value + i), nonce);
+
+    counter_block_vec = _mm_xor_si128(counter_block_vec, key_schedule[0]);
+    for(int j = 1; j < 10; j++) {
+        counter_block_vec = _mm_aesenc_si128(counter_block_vec, key_schedule[j]);
+    }
+    __m128i keystream = _mm_aesenclast_si128(counter_block_vec, key_schedule[10]);
+
+    __m128i input_block = _mm_loadu_si128((__m128i*)(input + i * 16));
+    _mm_storeu_si128((__m128i*)(output + i * 16), _mm_xor_si128(input_block, keystream));
+}
+
+static inline __attribute__((always_inline))
+void vaes_ctr(uint8_t* input, __m128i* key_schedule, uint8_t* output,
+              size_t num_blocks, ctr_block_t* initial_ctr, const int stream) {
+    __m512i key_schedule512[11];
+    uint64_t nonce;
+    uint64_t counter_value = load_counter_value(initial_ctr);
+    size_t i = 0;
+
+    memcpy(&nonce, initial_ctr->nonce, 8);
+    for(int j = 0; j < 11; j++) {
+        key_schedule512[j] = _mm512_broadcast_i32x4(key_schedule[j]);
+    }
+
+    // 512-bit streaming stores need a 64-byte aligned destination
+    if (stream) {
+        for(; i < num_blocks && ((uintptr_t)(output + i * 16) & 63); i++) {
+            vaes_one_block(input, key_schedule, output, nonce, counter_value, i);
+        }
+    }
+
+    for(; i + 4 <= num_blocks; i += 4) {
+        if (stream) {
+            _mm_prefetch((const char*)(input + i * 16 + PREFETCH_BYTES), _MM_HINT_NTA);
+        }
+
+        __m512i counter_block_vec = make_counter_vec(nonce, counter_value + i);
+
+        counter_block_vec = _mm512_xor_si512(counter_block_vec, key_schedule512[0]);
+        for(int j = 1; j < 10; j++) {
+            counter_block_vec = _mm512_aesenc_epi128(counter_block_vec, key_schedule512[j]);
+        }
+        __m512i keystream = _mm512_aesenclast_epi128(counter_block_vec, key_schedule512[10]);
+
+        // XOR with input
+        __m512i input_block = _mm512_loadu_si512((__m512i*)(input + i * 16));
+        if (stream) {
+            _mm512_stream_si512((__m512i*)(output + i * 16), _mm512_xor_si512(input_block, keystream));
+        } else {
+            _mm512_storeu_si512((__m512i*)(output + i * 16), _mm512_xor_si512(input_block, keystream));
+        }
+    }
+
+    // Remaining 1-3 blocks with 128-bit AES-NI
+    for(; i < num_blocks; i++) {
+        vaes_one_block(input, key_schedule, output, nonce, counter_value, i);
+    }
+
+    // Streaming stores are weakly ordered; make them visible before the caller signals completion
+    if (stream) {
+        _mm_sfence();
+    }
+}
+
+void aesctr_kernel_vaes(uint8_t* input, __m128i* key_schedule, uint8_t* output,
+                        size_t num_blocks, ctr_block_t* initial_ctr) {
+    vaes_ctr(input, key_schedule, output, num_blocks, initial_ctr, 0);
+}
+
+void aesctr_kernel_vaes_nt(uint8_t* input, __m128i* key_schedule, uint8_t* output,
+                           size_t num_blocks, ctr_block_t* initial_ctr) {
+    if ((uintptr_t)output & 15) {
+        vaes_ctr(input, key_schedule, output, num_blocks, initial_ctr, 0);
+    } else {
+        vaes_ctr(input, key_schedule, output, num_blocks, initial_ctr, 1);
+    }
+}
+
+// One VAES round on all four in-flight vectors
+#define VAESENC4(op, key) do { \
+        v0 = op(v0, key); v1 = op(v1, key); v2 = op(v2, key); v3 = op(v3, key); \
+    } while (0)
+
+// Independent blocks, sixteen in flight; input and output may be the same buffer
+void aes_ecb_kernel_vaes(const uint8_t* input, __m128i* key_schedule, uint8_t* output, size_t num_blocks) {
+    __m512i key_schedule512[11];
+    size_t i = 0;
+
+    for(int j = 0; j < 11; j++) {
+        key_schedule512[j] = _mm512_broadcast_i32x4(key_schedule[j]);
+    }
+
+    for(; i + 16 <= num_blocks; i += 16) {
+        const __m512i* in = (const __m512i*)(input + i * 16);
+        __m512i v0 = _mm512_xor_si512(_mm512_loadu_si512(in + 0), key_schedule512[0]);
+        __m512i v1 = _mm512_xor_si512(_mm512_loadu_si512(in + 1), key_schedule512[0]);
+        __m512i v2 = _mm512_xor_si512(_mm512_loadu_si512(in + 2), key_schedule512[0]);
+        __m512i v3 = _mm512_xor_si512(_mm512_loadu_si512(in + 3), key_schedule512[0]);
+
+        for(int j = 1; j < 10; j++) {
+            VAESENC4(_mm512_aesenc_epi128, key_schedule512[j]);
+        }
+        VAESENC4(_mm512_aesenclast_epi128, key_schedule512[10]);
+
+        __m512i* out = (__m512i*)(output + i * 16);
+        _mm512_storeu_si512(out + 0, v0);
+        _mm512_storeu_si512(out + 1, v1);
+        _mm512_storeu_si512(out + 2, v2);
+        _mm512_storeu_si512(out + 3, v3);
+    }
+
+    for(; i + 4 <= num_blocks; i += 4) {
+        __m512i v = _mm512_xor_si512(_mm512_loadu_si512((const __m512i*)(input + i * 16)), key_schedule512[0]);
+        for(int j = 1; j < 10; j++) {
+            v = _mm512_aesenc_epi128(v, key_schedule512[j]);
+        }
+        _mm512_storeu_si512((__m512i*)(output + i * 16), _mm512_aesenclast_epi128(v, key_schedule512[10]));
+    }
+
+    for(; i < num_blocks; i++) {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(input + i * 16)), key_schedule[0]);
+        for(int j = 1; j < 10; j++) {
+            b = _mm_aesenc_si128(b, key_schedule[j]);
+        }
+        _mm_storeu_si128((__m128i*)(output + i * 16), _mm_aesenclast_si128(b, key_schedule[10]));
+    }
+}
+
+void aesctr_enc_vaes(uint8_t* input, __m128i* key_schedule, uint8_t* output,
+                     size_t num_blocks, ctr_block_t* initial_ctr) {
+    uint64_t start_ns = aes_stats_now_ns();
+
+    if (aes_streaming_stores(input, output, num_blocks * BLOCK_SIZE)) {
+        aesctr_kernel_vaes_nt(input, key_schedule, output, num_blocks, initial_ctr);
+    } else {
+        aesctr_kernel_vaes(input, key_schedule, output, num_blocks, initial_ctr);
+    }
+    aes_stats_record(AES_BACKEND_VAES, (uint64_t)num_blocks * BLOCK_SIZE, aes_stats_now_ns() - start_ns);
+}
+
+void* vaes_threadworkers(void* arg) {
+    thread_data_t* data = (thread_data_t*)arg;
+    ctr_block_t thread_ctr;
+    aes_perf_ctx_t perf_ctx;
+
+    aes_pin_thread(data->thread_idx);
+    aes_perfmon_thread_begin(data->perf, &perf_ctx);
+    AES_TRACE(AES_TRACE_CHUNK_BEGIN, "vaes+pthread", data->num_blocks * BLOCK_SIZE);
+
+    // Each thread runs the kernel on its own contiguous range
+    ctr_block_advance(data->initial_counter, &thread_ctr, data->start_block);
+    if (data->streaming) {
+        aesctr_kernel_vaes_nt(data->input + data->start_block * BLOCK_SIZE,
+                        (__m128i*)data->key_schedule,
+                        data->output + data->start_block * BLOCK_SIZE,
+                        data->num_blocks, &thread_ctr);
+    } else {
+        aesctr_kernel_vaes(data->input + data->start_block * BLOCK_SIZE,
+                        (__m128i*)data->key_schedule,
+                        data->output + data->start_block * BLOCK_SIZE,
+                        data->num_blocks, &thread_ctr);
+    }
+
+    AES_TRACE(AES_TRACE_CHUNK_END, "vaes+pthread", 0);
+    aes_perfmon_thread_end(data->perf, &perf_ctx, data->thread_idx, data->num_blocks * BLOCK_SIZE);
+
+    return NULL;
+}
+
+void aesctr_enc_vaes_pthread(uint8_t* input, __m128i* key_schedule, uint8_t* output,
+                             size_t total_blocks, ctr_block_t* initial_ctr) {
+    int num_threads = aes_get_num_threads();
+    pthread_t threads[AES_MAX_THREADS];
+    thread_data_t thread_data[AES_MAX_THREADS];
+
+    // Calculate blocks per thread, keeping every range a multiple of 4 blocks
+    size_t blocks_per_thread = (total_blocks / num_threads) & ~(size_t)3;
+    size_t current_block = 0;
+    int streaming = aes_streaming_stores(input, output, total_blocks * BLOCK_SIZE);
+    aes_perf_job_t* perf = aes_perfmon_job_begin("vaes+pthread", num_threads);
+    uint64_t start_ns = aes_stats_now_ns();
+
+    AES_TRACE(AES_TRACE_JOB_BEGIN, "vaes+pthread", total_blocks * BLOCK_SIZE);
+
+    // Create and launch threads
+    for(int i = 0; i < num_threads; i++) {
+        thread_data[i].input = input;
+        thread_data[i].output = output;
+        thread_data[i].key_schedule = (uint8_t*)key_schedule;
+        thread_data[i].start_block = current_block;
+        thread_data[i].num_blocks = (i == num_threads - 1) ? total_blocks - current_block : blocks_per_thread;
+        thread_data[i].initial_counter = initial_ctr;
+        thread_data[i].thread_idx = i;
+        thread_data[i].perf = perf;
+        thread_data[i].streaming = streaming;
+
+        aes_stats_queue_add(1);
+        pthread_create(&threads[i], NULL, vaes_threadworkers, &thread_data[i]);
+        current_block += thread_data[i].num_blocks;
+    }
+
+    // Wait for all threads
+    AES_TRACE(AES_TRACE_JOIN_BEGIN, NULL, 0);
+    for(int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    AES_TRACE(AES_TRACE_JOIN_END, NULL, 0);
+    AES_TRACE(AES_TRACE_JOB_END, "vaes+pthread", 0);
+    aes_stats_queue_add(-num_threads);
+    aes_stats_record(AES_BACKEND_VAES_PTHREAD, total_blocks * BLOCK_SIZE, aes_stats_now_ns() - start_ns);
+
+    aes_perfmon_job_end(perf);
+}
@@ -0,0 +1,36 @@
+#ifndef AES_VAES_H
+#define AES_VAES_H
+
+#include "aes.h"
+
+#include <immintrin.h>  // AVX-512 + VAES intrinsics
+#include <cpuid.h>      // for checking VAES support
+
+int  check_vaes_support();
+
+/**
+ * Encrypts num_blocks blocks, four per 512-bit VAES instruction.
+ * key_schedule: AES-NI key schedule from aes_keyexpansion_aesni
+ */
+void aesctr_enc_vaes(uint8_t* input, __m128i* key_schedule, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr);
+
+/**
+ * The kernel behind aesctr_enc_vaes, without stats, for drivers that split a job.
+ */
+void aesctr_kernel_vaes(uint8_t* input, __m128i* key_schedule, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr);
+
+// Streaming-store variant (see store.h); regular stores if output is not 16-byte aligned
+void aesctr_kernel_vaes_nt(uint8_t* input, __m128i* key_schedule, uint8_t* output, size_t num_blocks, ctr_block_t* initial_ctr);
+
+/**
+ * Encrypts num_blocks independent blocks (ECB), sixteen in flight across
+ * four 512-bit vectors. Used on lists of non-consecutive counter blocks.
+ */
+void aes_ecb_kernel_vaes(const uint8_t* input, __m128i* key_schedule, uint8_t* output, size_t num_blocks);
+
+/**
+ * VAES kernel split across aes_get_num_threads() pthreads.
+ */
+void aesctr_enc_vaes_pthread(uint8_t* input, __m128i* key_schedule, uint8_t* output, size_t total_blocks, ctr_block_t* initial_ctr);
+
+#endif
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "verify.h"
+#include "affinity.h"
+
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+
+// Work is handed out in chunks from a shared cursor so a slow thread doesn't hold up the rest
+typedef struct {
+    const uint8_t* input;
+    const uint8_t* buf;
+    size_t len;
+    uint64_t* digests;
+    const uint8_t* roundKey;
+    ctr_block_t* initial_ctr;
+    size_t next_chunk;           // atomically incremented
+    size_t mismatch;             // lowest bad byte offset found, atomically lowered
+} verify_job_t;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t digest_round(uint64_t acc, uint64_t word) {
+    acc += word * PRIME2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME1;
+}
+
+// Four independent lanes, 32 bytes per iteration, in the style of xxHash64
+static uint64_t digest_chunk(const uint8_t* p, size_t len, uint64_t chunk_idx) {
+    uint64_t v0 = chunk_idx + PRIME1 + PRIME2;
+    uint64_t v1 = chunk_idx + PRIME2;
+    uint64_t v2 = chunk_idx;
+    uint64_t v3 = chunk_idx - PRIME1;
+    size_t i = 0;
+
+    for(; i + 32 <= len; i += 32) {
+        uint64_t w[4];
+        memcpy(w, p + i, 32);
+        v0 = digest_round(v0, w[0]);
+        v1 = digest_round(v1, w[1]);
+        v2 = digest_round(v2, w[2]);
+        v3 = digest_round(v3, w[3]);
+    }
+
+    uint64_t h = rotl64(v0, 1) + rotl64(v1, 7) + rotl64(v2, 12) + rotl64(v3, 18) + len;
+    for(; i < len; i++) {
+        h = rotl64(h ^ (p[i] * PRIME3), 11) * PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    return h;
+}
+
+static void* digest_worker(void* arg) {
+    verify_job_t* job = (verify_job_t*)arg;
+    size_t num_chunks = AES_VERIFY_NUM_CHUNKS(job->len);
+    size_t c;
+
+    while ((c = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED)) < num_chunks) {
+        size_t begin = c * AES_VERIFY_CHUNK;
+        size_t len = job->len - begin < AES_VERIFY_CHUNK ? job->len - begin : AES_VERIFY_CHUNK;
+        job->digests[c] = digest_chunk(job->buf + begin, len, c);
+    }
+
+    return NULL;
+}
+
+static void* verify_worker(void* arg) {
+    verify_job_t* job = (verify_job_t*)arg;
+    size_t num_chunks = AES_VERIFY_NUM_CHUNKS(job->len);
+    uint8_t reference[AES_VERIFY_CHUNK];
+    ctr_block_t chunk_ctr;
+    size_t c;
+
+    while ((c = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED)) < num_chunks) {
+        size_t begin = c * AES_VERIFY_CHUNK;
+        size_t len = job->len - begin < AES_VERIFY_CHUNK ? job->len - begin : AES_VERIFY_CHUNK;
+
+        // Chunks past a known mismatch can't lower it
+        if (begin > __atomic_load_n(&job->mismatch, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        ctr_block_advance(job->initial_ctr, &chunk_ctr, begin / BLOCK_SIZE);
+        aesctr_kernel_serial((uint8_t*)job->input + begin, job->roundKey, reference,
+                             len / BLOCK_SIZE, &chunk_ctr);
+
+        if (memcmp(reference, job->buf + begin, len) != 0) {
+            size_t i = 0;
+            while (reference[i] == job->buf[begin + i]) {
+                i++;
+            }
+
+            size_t seen = __atomic_load_n(&job->mismatch, __ATOMIC_RELAXED);
+            while (begin + i < seen &&
+                   !__atomic_compare_exchange_n(&job->mismatch, &seen, begin + i, 0,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void run_job(verify_job_t* job, void* (*worker)(void*)) {
+    int num_threads = aes_get_num_threads();
+    pthread_t threads[AES_MAX_THREADS];
+
+    for(int i = 0; i < num_threads; i++) {
+        pthread_create(&threads[i], NULL, worker, job);
+    }
+    for(int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+void aes_digest_chunks(const uint8_t* buf, size_t len, uint64_t* digests) {
+    verify_job_t job = {
+        .buf = buf,
+        .len = len,
+        .digests = digests,
+    };
+    run_job(&job, digest_worker);
+}
+
+long aes_digest_compare(const uint64_t* expected, const uint64_t* actual, size_t num_chunks) {
+    for(size_t i = 0; i < num_chunks; i++) {
+        if (expected[i] != actual[i]) {
+            return (long)i;
+        }
+    }
+    return -1;
+}
+
+int aes_verify_ctr(const uint8_t* input, const uint8_t* output, size_t num_blocks,
+                   const uint8_t* roundKey, ctr_block_t* initial_ctr, size_t* mismatch) {
+    verify_job_t job = {
+        .input = input,
+        .buf = output,
+        .len = num_blocks * BLOCK_SIZE,
+        .roundKey = roundKey,
+        .initial_ctr = initial_ctr,
+        .mismatch = SIZE_MAX,
+    };
+    run_job(&job, verify_worker);
+
+    if (mismatch) {
+        *mismatch = job.mismatch;
+    }
+    return job.mismatch == SIZE_MAX;
+}
@@ -0,0 +1,32 @@
+#ifndef AES_VERIFY_H
+#define AES_VERIFY_H
+
+#include "aes.h"
+
+// Bytes covered by one digest; small enough to stay in L2 while hashing
+#define AES_VERIFY_CHUNK (64 * 1024)
+
+// Number of digests aes_digest_chunks writes for a len-byte buffer
+#define AES_VERIFY_NUM_CHUNKS(len) (((len) + AES_VERIFY_CHUNK - 1) / AES_VERIFY_CHUNK)
+
+/**
+ * 64-bit digest of every AES_VERIFY_CHUNK bytes of buf, computed across
+ * aes_get_num_threads() threads. Lets a tester check the reference and the
+ * candidate output in the same buffer, one after the other.
+ */
+void aes_digest_chunks(const uint8_t* buf, size_t len, uint64_t* digests);
+
+/**
+ * return: index of the first differing digest, or -1 if all num_chunks match
+ */
+long aes_digest_compare(const uint64_t* expected, const uint64_t* actual, size_t num_chunks);
+
+/**
+ * Recomputes the reference serially in cache-sized chunks, in parallel, and
+ * compares it with output, without a second full-size buffer.
+ * return: 1 if output matches, 0 otherwise with the first bad byte offset in *mismatch
+ */
+int aes_verify_ctr(const uint8_t* input, const uint8_t* output, size_t num_blocks,
+                   const uint8_t* roundKey, ctr_block_t* initial_ctr, size_t* mismatch);
+
+#endif
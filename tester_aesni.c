@@ -6,6 +6,8 @@
 #include <stdlib.h>
 
 #include "aesni.h"
+#include "verify.h"
+#include "buf.h"
 
 int main() {
     // Check AES-NI support
@@ -25,44 +27,51 @@ int main() {
         .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
     };
     
-    // Aligned memory allocation (aligned to 16-byte boundary for SSE)
-    uint8_t *input = (uint8_t*)aligned_alloc(16, NUM_BLOCKS * 16);
-    uint8_t *output_serial = (uint8_t*)aligned_alloc(16, NUM_BLOCKS * 16);
-    uint8_t *output_aesni = (uint8_t*)aligned_alloc(16, NUM_BLOCKS * 16);
+    // Huge-page backed buffers, faulted in up front so the timings exclude it (see buf.h)
+    // Serial and AES-NI results share one buffer and are compared by chunk digests
+    size_t num_chunks = AES_VERIFY_NUM_CHUNKS((size_t)NUM_BLOCKS * 16);
+    uint8_t *input = (uint8_t*)aes_buf_alloc(NUM_BLOCKS * 16, AES_BUF_PREFAULT);
+    uint8_t *output = (uint8_t*)aes_buf_alloc(NUM_BLOCKS * 16, AES_BUF_PREFAULT);
+    uint64_t *digests_serial = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
+    uint64_t *digests_aesni = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
     uint8_t *roundKey = (uint8_t*)aligned_alloc(16, 176);
     __m128i *key_schedule = (__m128i*)aligned_alloc(16, 176);
+    uint8_t first_block_serial[16];
     
-    if (!input || !output_serial || !output_aesni || !roundKey || !key_schedule) {
+    if (!input || !output || !digests_serial || !digests_aesni || !roundKey || !key_schedule) {
         printf("Memory allocation failed!\n");
         return 1;
     }
     
     // Initialize input
-    for(int i = 0; i < NUM_BLOCKS * 16; i++) {
+    for(size_t i = 0; i < NUM_BLOCKS * 16; i++) {
         input[i] = i & 0xFF;
     }
     
     // warmup
     aes_keyexpansion_serial(key, roundKey);  // For serial version
     aes_keyexpansion_aesni(key, key_schedule);  // For AES-NI version
-    aesctr_enc_serial(input, roundKey, output_serial, 1, &initial_ctr);
-    aesctr_enc_aesni(input, key_schedule, output_aesni, 1, &initial_ctr);
+    aesctr_enc_serial(input, roundKey, output, 1, &initial_ctr);
+    aesctr_enc_aesni(input, key_schedule, output, 1, &initial_ctr);
     
     // Serial encryption
     clock_t start = clock();
     aes_keyexpansion_serial(key, roundKey);  // For serial version
-    aesctr_enc_serial(input, roundKey, output_serial, NUM_BLOCKS, &initial_ctr);
+    aesctr_enc_serial(input, roundKey, output, NUM_BLOCKS, &initial_ctr);
     double serial_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    aes_digest_chunks(output, (size_t)NUM_BLOCKS * 16, digests_serial);
+    memcpy(first_block_serial, output, 16);
     
     // AES-NI encryption
     start = clock();
     aes_keyexpansion_aesni(key, key_schedule);  // For AES-NI version
-    aesctr_enc_aesni(input, key_schedule, output_aesni, NUM_BLOCKS, &initial_ctr);
+    aesctr_enc_aesni(input, key_schedule, output, NUM_BLOCKS, &initial_ctr);
     double aesni_time = (double)(clock() - start) / CLOCKS_PER_SEC;
     
     // Verify results
+    aes_digest_chunks(output, (size_t)NUM_BLOCKS * 16, digests_aesni);
     printf("Results match: %s\n",
-           memcmp(output_serial, output_aesni, NUM_BLOCKS * 16) == 0 ? "Yes" : "No");
+           aes_digest_compare(digests_serial, digests_aesni, num_chunks) < 0 ? "Yes" : "No");
     
     // Calculate throughput
     double data_size_gb = (double)(NUM_BLOCKS * BLOCK_SIZE) / (1024 * 1024 * 1024);
@@ -77,18 +86,19 @@ int main() {
     // Print first block comparison
     printf("\nFirst block comparison:\nSerial: ");
     for(int i = 0; i < 16; i++) {
-        printf("%02x ", output_serial[i]);
+        printf("%02x ", first_block_serial[i]);
     }
     printf("\nAES-NI: ");
     for(int i = 0; i < 16; i++) {
-        printf("%02x ", output_aesni[i]);
+        printf("%02x ", output[i]);
     }
     printf("\n");
     
     // Clean up
-    free(input);
-    free(output_serial);
-    free(output_aesni);
+    aes_buf_free(input);
+    aes_buf_free(output);
+    free(digests_serial);
+    free(digests_aesni);
     free(roundKey);
     free(key_schedule);
     
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "aes.h"
+#include "async.h"
+#include "pool.h"
+#include "dispatch.h"
+#include "bench.h"
+#include "datagen.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define TEST_MB 256
+#define INFLIGHT 8              // jobs the event loop keeps submitted
+#define POLL_MS 1               // loop tick when nothing completes
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+static ctr_block_t initial_ctr = {
+    .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+static _Atomic int callbacks_run;
+
+// Local reference for one message: whole blocks, then the padded tail
+static void local_ctr(const uint8_t* in, uint8_t* out, size_t len, const ctr_block_t* ctr) {
+    aesctr_bulk_fn kernel = aes_select_bulk_kernel(NULL);
+    ctr_block_t c = *ctr;
+    size_t blocks = len / BLOCK_SIZE;
+
+    kernel((uint8_t*)in, roundKey, out, blocks, &c);
+    if (len % BLOCK_SIZE) {
+        uint8_t block[BLOCK_SIZE] = {0};
+        memcpy(block, in + blocks * BLOCK_SIZE, len % BLOCK_SIZE);
+        ctr_block_advance(ctr, &c, blocks);
+        kernel(block, roundKey, block, 1, &c);
+        memcpy(out + blocks * BLOCK_SIZE, block, len % BLOCK_SIZE);
+    }
+}
+
+static void count_callback(aes_async_t* job, void* arg) {
+    (void)arg;
+    atomic_fetch_add(&callbacks_run, 1);
+    aes_async_free(job);
+}
+
+/**
+ * Messages of assorted lengths, each with its own counter, submitted all at
+ * once; every third completes through a callback that frees the job, an
+ * eventfd polled here, or aes_async_wait.
+ * return: 1 if all match local CTR
+ */
+static int check_messages(const uint8_t* in, uint8_t* out, uint8_t* expected, size_t bytes) {
+    static const size_t lens[] = { 0, 1, 17, 4096, 65536 + 15, 3 * 1024 * 1024 + 5, 777, 40 * 1024 * 1024 + 1 };
+    aes_async_t* jobs[256];
+    int modes[256];
+    int n = 0, expected_callbacks = 0;
+    size_t off = 0;
+
+    atomic_store(&callbacks_run, 0);
+    memset(out, 0, bytes);
+    for (uint64_t i = 0; n < 256 && off < bytes; i++, n++) {
+        size_t len = lens[i % (sizeof(lens) / sizeof(lens[0]))];
+        if (len > bytes - off) len = bytes - off;
+        ctr_block_t ctr;
+        ctr_block_advance(&initial_ctr, &ctr, i << 32);
+        local_ctr(in + off, expected + off, len, &ctr);
+
+        aes_async_opts_t opts = {0};
+        modes[n] = n % 3;
+        if (modes[n] == 0) {
+            opts.callback = count_callback;
+            expected_callbacks++;
+        } else if (modes[n] == 1) {
+            opts.flags = AES_ASYNC_EVENTFD;
+        }
+        jobs[n] = aesctr_enc_async(NULL, in + off, roundKey, out + off, len, &ctr, &opts);
+        if (!jobs[n]) {
+            printf("aesctr_enc_async failed: %s\n", strerror(errno));
+            return 0;
+        }
+        off += len;
+    }
+
+    int ok = 1;
+    for (int i = 0; i < n; i++) {
+        if (modes[i] == 1) {
+            struct pollfd pfd = { aes_async_fd(jobs[i]), POLLIN, 0 };
+            while (poll(&pfd, 1, -1) < 1) {
+            }
+            ok = ok && aes_async_done(jobs[i]);
+            aes_async_free(jobs[i]);
+        } else if (modes[i] == 2) {
+            aes_async_wait(jobs[i]);
+            ok = ok && aes_async_done(jobs[i]);
+            aes_async_free(jobs[i]);
+        }
+    }
+    // Callback jobs free themselves; wait for the stragglers
+    while (atomic_load(&callbacks_run) < expected_callbacks) {
+        usleep(100);
+    }
+    return ok && memcmp(out, expected, off) == 0;
+}
+
+/**
+ * Encrypts bytes as objects of obj_bytes from a single-threaded loop,
+ * either blocking in aesctr_enc_pool per object or keeping INFLIGHT async
+ * jobs submitted and polling their eventfds with a POLL_MS timeout.
+ * max_tick: longest stretch the loop could not run, in seconds
+ * return: seconds for all objects
+ */
+static double run_loop(const uint8_t* in, uint8_t* out, size_t bytes, size_t obj_bytes, int async, double* max_tick) {
+    size_t num_objs = bytes / obj_bytes;
+    double start = bench_now(), last = start;
+    *max_tick = 0;
+
+    if (!async) {
+        for (size_t i = 0; i < num_objs; i++) {
+            aesctr_enc_pool(NULL, (uint8_t*)in + i * obj_bytes, roundKey, out + i * obj_bytes,
+                            obj_bytes / BLOCK_SIZE, &initial_ctr);
+            double now = bench_now();
+            if (now - last > *max_tick) *max_tick = now - last;
+            last = now;
+        }
+        return bench_now() - start;
+    }
+
+    aes_async_t* jobs[INFLIGHT];
+    struct pollfd pfds[INFLIGHT];
+    aes_async_opts_t opts = { .flags = AES_ASYNC_EVENTFD };
+    size_t next = 0, done = 0;
+    int inflight = 0;
+    while (done < num_objs) {
+        while (inflight < INFLIGHT && next < num_objs) {
+            jobs[inflight] = aesctr_enc_async(NULL, in + next * obj_bytes, roundKey, out + next * obj_bytes,
+                                              obj_bytes, &initial_ctr, &opts);
+            if (!jobs[inflight]) {
+                return -1;
+            }
+            pfds[inflight].fd = aes_async_fd(jobs[inflight]);
+            pfds[inflight].events = POLLIN;
+            inflight++;
+            next++;
+        }
+        poll(pfds, inflight, POLL_MS);
+        for (int i = 0; i < inflight;) {
+            if (aes_async_done(jobs[i])) {
+                aes_async_free(jobs[i]);
+                jobs[i] = jobs[--inflight];
+                pfds[i] = pfds[inflight];
+                done++;
+            } else {
+                i++;
+            }
+        }
+        double now = bench_now();
+        if (now - last > *max_tick) *max_tick = now - last;
+        last = now;
+    }
+    return bench_now() - start;
+}
+
+/**
+ * usage: tester_async [mb]
+ *
+ * Checks messages encrypted through the async API against local CTR for
+ * each completion style, then drives the pool from a single-threaded event
+ * loop for several object sizes: blocking calls against async jobs polled by
+ * eventfd, reporting throughput and the longest time the loop was held up.
+ */
+int main(int argc, char** argv) {
+    size_t bytes = (argc > 1 ? strtoul(argv[1], NULL, 10) : TEST_MB) * 1024 * 1024;
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+
+    uint8_t* in = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* out = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* expected = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    if (!in || !out || !expected) {
+        printf("Allocation failed\n");
+        return 1;
+    }
+    aes_datagen_fill(in, bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+
+    int ok = check_messages(in, out, expected, bytes);
+    printf("Callback, eventfd and wait completions match local CTR: %s\n", ok ? "Yes" : "No");
+
+    printf("\n%zu MB from one event loop, %d pool workers, %d jobs in flight\n", bytes >> 20,
+           aes_pool_num_threads(aes_pool_default()), INFLIGHT);
+    printf("%-10s %12s %12s %16s %16s\n", "object", "block GB/s", "async GB/s", "block max tick", "async max tick");
+    static const size_t sizes[] = { 64 * 1024, 1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        if (sizes[s] > bytes) {
+            break;
+        }
+        size_t total = bytes - bytes % sizes[s];
+        double block_tick, async_tick;
+        double block_t = run_loop(in, expected, total, sizes[s], 0, &block_tick);
+        double async_t = run_loop(in, out, total, sizes[s], 1, &async_tick);
+        int match = async_t > 0 && memcmp(out, expected, total) == 0;
+        ok = ok && match;
+        printf("%6zu KB %12.2f %12.2f %13.2f ms %13.2f ms%s\n", sizes[s] >> 10, total / block_t / (1 << 30),
+               async_t > 0 ? total / async_t / (1 << 30) : 0.0, block_tick * 1e3, async_tick * 1e3,
+               match ? "" : "  (output differs)");
+    }
+
+    aes_buf_free(in);
+    aes_buf_free(out);
+    aes_buf_free(expected);
+    return ok ? 0 : 1;
+}
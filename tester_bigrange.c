@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "aes.h"
+#include "aesni.h"
+#include "vaes.h"
+#include "aes_pthread.h"
+#include "openmp.h"
+#include "bench.h"
+#include "datagen.h"
+#include "verify.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define LOGICAL_GB 64   // 2^32 blocks, twice the old int limit
+#define WINDOW_MB 8
+#define NUM_WINDOWS 8
+#define MAX_WINDOWS 64
+
+typedef struct {
+    const char* name;
+    int (*supported)();
+    void (*run)(uint8_t* input, uint8_t* output, size_t num_blocks, ctr_block_t* ctr);
+} backend_t;
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+static __m128i key_schedule[11];
+static ctr_block_t initial_ctr = {
+    .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+static int always_supported() { return 1; }
+static int vaes_supported() { return check_aesni_support() && check_vaes_support(); }
+
+static void run_aesni(uint8_t* input, uint8_t* output, size_t num_blocks, ctr_block_t* ctr) {
+    aesctr_enc_aesni(input, key_schedule, output, num_blocks, ctr);
+}
+
+static void run_vaes(uint8_t* input, uint8_t* output, size_t num_blocks, ctr_block_t* ctr) {
+    aesctr_enc_vaes(input, key_schedule, output, num_blocks, ctr);
+}
+
+static void run_pthread(uint8_t* input, uint8_t* output, size_t num_blocks, ctr_block_t* ctr) {
+    aesctr_enc_pthread(input, roundKey, output, num_blocks, ctr);
+}
+
+static void run_openmp(uint8_t* input, uint8_t* output, size_t num_blocks, ctr_block_t* ctr) {
+    aesctr_enc_openmp(input, roundKey, output, num_blocks, ctr);
+}
+
+static void run_vaes_pthread(uint8_t* input, uint8_t* output, size_t num_blocks, ctr_block_t* ctr) {
+    aesctr_enc_vaes_pthread(input, key_schedule, output, num_blocks, ctr);
+}
+
+// The first backend is checked against the serial reference, the rest against its digests
+static const backend_t backends[] = {
+    { "aesni",        check_aesni_support, run_aesni },
+    { "vaes",         vaes_supported,      run_vaes },
+    { "pthread",      always_supported,    run_pthread },
+    { "openmp",       always_supported,    run_openmp },
+    { "vaes+pthread", vaes_supported,      run_vaes_pthread },
+};
+
+#define NUM_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+static int cmp_offset(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Spreads windows over [0, total_blocks): first and last window pinned to the
+ * ends, one straddling block 2^31 where the old int counts overflowed, the
+ * rest evenly spaced and deliberately not 4-block aligned.
+ */
+static int place_windows(uint64_t total_blocks, uint64_t window_blocks, int num_windows, uint64_t* offsets) {
+    uint64_t last = total_blocks - window_blocks;
+    uint64_t int_limit = (uint64_t)1 << 31;
+
+    for (int w = 0; w < num_windows; w++) {
+        offsets[w] = num_windows > 1 ? last / (num_windows - 1) * w : 0;
+        if (w > 0 && w < num_windows - 1) {
+            offsets[w] += w * 5;
+        }
+    }
+    offsets[num_windows - 1] = last;
+
+    if (num_windows > 2 && total_blocks > int_limit + window_blocks) {
+        offsets[1] = int_limit - window_blocks / 2;
+        qsort(offsets, num_windows, sizeof(uint64_t), cmp_offset);
+    }
+    return num_windows;
+}
+
+// Checks one block against a counter built from the logical index, independent of ctr_block_advance
+static int check_block(const uint8_t* input, const uint8_t* output, uint64_t logical_idx) {
+    uint8_t counter_block[16];
+    uint8_t expected[16];
+
+    prepare_ctr_block(&initial_ctr, counter_block, logical_idx);
+    aesctr_enc1block_serial(counter_block, (uint8_t*)input, roundKey, expected);
+    return memcmp(expected, output, 16) == 0;
+}
+
+/**
+ * usage: tester_bigrange [logical_gb] [window_mb] [windows]
+ *
+ * Encrypts sparse windows of a logical stream larger than 32 GB by starting
+ * each window at its counter offset, so every backend sees block indices and
+ * counters past 2^31 without a buffer of that size.
+ */
+int main(int argc, char** argv) {
+    uint64_t logical_bytes = (argc > 1 ? strtoull(argv[1], NULL, 10) : LOGICAL_GB) << 30;
+    size_t window_bytes = (argc > 2 ? strtoul(argv[2], NULL, 10) : WINDOW_MB) * 1024 * 1024;
+    int num_windows = argc > 3 ? atoi(argv[3]) : NUM_WINDOWS;
+    if (num_windows < 1) num_windows = 1;
+    if (num_windows > MAX_WINDOWS) num_windows = MAX_WINDOWS;
+
+    uint64_t total_blocks = logical_bytes / BLOCK_SIZE;
+    size_t window_blocks = window_bytes / BLOCK_SIZE;
+    if (window_blocks == 0 || window_blocks > total_blocks) {
+        printf("Window must be non-empty and fit in the logical range\n");
+        return 1;
+    }
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+    if (check_aesni_support()) {
+        aes_keyexpansion_aesni(key, key_schedule);
+    }
+
+    size_t num_chunks = AES_VERIFY_NUM_CHUNKS(window_bytes);
+    uint8_t* input = (uint8_t*)aes_buf_alloc(window_bytes, AES_BUF_PREFAULT);
+    uint8_t* output = (uint8_t*)aes_buf_alloc(window_bytes, AES_BUF_PREFAULT);
+    uint64_t* digests_ref = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
+    uint64_t* digests = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
+    if (!input || !output || !digests_ref || !digests) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+
+    uint64_t offsets[MAX_WINDOWS];
+    place_windows(total_blocks, window_blocks, num_windows, offsets);
+
+    double seconds[NUM_BACKENDS] = {0};
+    int ok[NUM_BACKENDS];
+    for (size_t b = 0; b < NUM_BACKENDS; b++) {
+        ok[b] = 1;
+    }
+
+    printf("Logical range: %.1f GB (%llu blocks), %d windows of %zu MB\n\n",
+           (double)logical_bytes / (1 << 30), (unsigned long long)total_blocks, num_windows, window_bytes >> 20);
+    printf("%-8s %18s %12s\n", "window", "first block", "GB offset");
+
+    for (int w = 0; w < num_windows; w++) {
+        ctr_block_t window_ctr;
+        int have_ref = 0;
+
+        printf("%-8d %18llu %12.3f\n", w, (unsigned long long)offsets[w],
+               (double)offsets[w] * BLOCK_SIZE / (1 << 30));
+
+        ctr_block_advance(&initial_ctr, &window_ctr, offsets[w]);
+        aes_datagen_fill(input, window_bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED ^ offsets[w]);
+
+        for (size_t b = 0; b < NUM_BACKENDS; b++) {
+            if (!backends[b].supported()) {
+                continue;
+            }
+
+            memset(output, 0, window_bytes);
+            double start = bench_now();
+            backends[b].run(input, output, window_blocks, &window_ctr);
+            seconds[b] += bench_now() - start;
+
+            int match = check_block(input, output, offsets[w]) &&
+                        check_block(input + (window_blocks - 1) * BLOCK_SIZE,
+                                    output + (window_blocks - 1) * BLOCK_SIZE,
+                                    offsets[w] + window_blocks - 1);
+
+            aes_digest_chunks(output, window_bytes, digests);
+            if (!have_ref) {
+                size_t mismatch;
+                match = match && aes_verify_ctr(input, output, window_blocks, roundKey, &window_ctr, &mismatch);
+                memcpy(digests_ref, digests, num_chunks * sizeof(uint64_t));
+                have_ref = 1;
+            } else {
+                match = match && aes_digest_compare(digests_ref, digests, num_chunks) < 0;
+            }
+
+            if (!match) {
+                printf("  %s mismatch in window %d\n", backends[b].name, w);
+                ok[b] = 0;
+            }
+        }
+    }
+
+    double gb = (double)window_bytes * num_windows / (1 << 30);
+    printf("\n%-14s %10s %8s\n", "backend", "GB/s", "match");
+    for (size_t b = 0; b < NUM_BACKENDS; b++) {
+        if (!backends[b].supported()) {
+            printf("%-14s %10s %8s\n", backends[b].name, "-", "n/a");
+            continue;
+        }
+        printf("%-14s %10.2f %8s\n", backends[b].name, gb / seconds[b], ok[b] ? "Yes" : "No");
+    }
+
+    aes_buf_free(input);
+    aes_buf_free(output);
+    free(digests_ref);
+    free(digests);
+
+    for (size_t b = 0; b < NUM_BACKENDS; b++) {
+        if (!ok[b]) return 1;
+    }
+    return 0;
+}
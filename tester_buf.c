@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "aes.h"
+#include "openmp.h"
+#include "buf.h"
+#include "bench.h"
+#include "datagen.h"
+#include "verify.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define TEST_MB 512
+
+typedef struct {
+    const char* name;
+    int flags;
+} variant_t;
+
+static const variant_t variants[] = {
+    { "4k",             AES_BUF_NO_HUGE },
+    { "4k+prefault",    AES_BUF_NO_HUGE | AES_BUF_PREFAULT },
+    { "huge",           0 },
+    { "huge+prefault",  AES_BUF_PREFAULT },
+};
+
+#define NUM_VARIANTS (sizeof(variants) / sizeof(variants[0]))
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+static ctr_block_t initial_ctr = {
+    .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+// AnonHugePages of this process in KB, -1 if the kernel doesn't report it
+static long anon_huge_kb() {
+    char line[256];
+    long kb = -1;
+    FILE* f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+/**
+ * usage: tester_buf [mb]
+ *
+ * Allocates an output buffer with 4 KB and with huge pages, each with and
+ * without pre-faulting, and times the allocation, the first OpenMP pass that
+ * writes into it and a second pass over resident pages. A last round frees and
+ * reallocates the same size to show the cache hit.
+ */
+int main(int argc, char** argv) {
+    size_t bytes = (argc > 1 ? strtoul(argv[1], NULL, 10) : TEST_MB) * 1024 * 1024;
+    size_t num_blocks = bytes / BLOCK_SIZE;
+    if (num_blocks == 0) {
+        printf("Size must be at least 1 MB\n");
+        return 1;
+    }
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+
+    size_t num_chunks = AES_VERIFY_NUM_CHUNKS(bytes);
+    uint8_t* input = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint64_t* digests_ref = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
+    uint64_t* digests = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
+    if (!input || !digests_ref || !digests) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    aes_datagen_fill(input, bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+
+    printf("Buffer: %zu MB, huge page: %zu KB, input backed by %s\n\n",
+           bytes >> 20, aes_buf_huge_page_size() >> 10, aes_buf_kind_name(aes_buf_kind(input)));
+    printf("%-14s %-8s %10s %12s %12s %12s %8s\n",
+           "variant", "backing", "alloc ms", "1st GB/s", "2nd GB/s", "THP MB", "match");
+
+    // Cache off, so every variant maps fresh pages
+    aes_buf_set_pool_limit(0);
+    int ok = 1;
+    int have_ref = 0;
+    double gb = (double)bytes / (1 << 30);
+
+    for (size_t v = 0; v < NUM_VARIANTS; v++) {
+        long huge_before = anon_huge_kb();
+        double start = bench_now();
+        uint8_t* output = (uint8_t*)aes_buf_alloc(bytes, variants[v].flags);
+        double alloc = bench_now() - start;
+        if (!output) {
+            printf("%-14s allocation failed\n", variants[v].name);
+            ok = 0;
+            continue;
+        }
+
+        start = bench_now();
+        aesctr_enc_openmp(input, roundKey, output, num_blocks, &initial_ctr);
+        double first = bench_now() - start;
+        start = bench_now();
+        aesctr_enc_openmp(input, roundKey, output, num_blocks, &initial_ctr);
+        double second = bench_now() - start;
+        long huge_after = anon_huge_kb();
+
+        aes_digest_chunks(output, bytes, digests);
+        int match = 1;
+        if (!have_ref) {
+            size_t mismatch;
+            match = aes_verify_ctr(input, output, num_blocks, roundKey, &initial_ctr, &mismatch);
+            memcpy(digests_ref, digests, num_chunks * sizeof(uint64_t));
+            have_ref = 1;
+        } else {
+            match = aes_digest_compare(digests_ref, digests, num_chunks) < 0;
+        }
+        ok = ok && match;
+
+        char thp[16] = "-";
+        if (huge_before >= 0 && huge_after >= 0) {
+            snprintf(thp, sizeof(thp), "%ld", (huge_after - huge_before) >> 10);
+        }
+        printf("%-14s %-8s %10.2f %12.2f %12.2f %12s %8s\n", variants[v].name,
+               aes_buf_kind_name(aes_buf_kind(output)), alloc * 1e3, gb / first, gb / second,
+               thp, match ? "Yes" : "No");
+        aes_buf_free(output);
+    }
+
+    // Recurring job size: the second allocation comes back from the cache already faulted in
+    aes_buf_set_pool_limit(AES_BUF_DEFAULT_POOL_LIMIT);
+    uint8_t* output = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    aes_buf_free(output);
+    double start = bench_now();
+    output = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    double alloc = bench_now() - start;
+    start = bench_now();
+    aesctr_enc_openmp(input, roundKey, output, num_blocks, &initial_ctr);
+    double first = bench_now() - start;
+
+    aes_buf_stats_t stats;
+    aes_buf_get_stats(&stats);
+    printf("%-14s %-8s %10.2f %12.2f %12s %12s %8s\n", "cached", aes_buf_kind_name(aes_buf_kind(output)),
+           alloc * 1e3, gb / first, "-", "-", stats.pool_hits > 0 ? "hit" : "miss");
+    ok = ok && stats.pool_hits > 0;
+
+    aes_buf_free(output);
+    aes_buf_free(input);
+    aes_buf_pool_trim();
+    free(digests_ref);
+    free(digests);
+    return ok ? 0 : 1;
+}
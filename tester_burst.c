@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "aes.h"
+#include "burst.h"
+#include "pool.h"
+#include "dispatch.h"
+#include "bench.h"
+#include "datagen.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define BURST 32                // packets per call, as in a typical rx/tx burst
+#define RING_PACKETS 4096       // packet slots for the checks and the pool runs
+#define HOT_PACKETS 256         // slots cycled per burst, so packets stay cache-resident as after rx
+#define SLOT_BYTES 2176         // DPDK mbuf stride: 2 KB data + headroom, which also spreads L1 sets
+#define MIN_SECONDS 0.3
+#define RANDOM_TRIALS 500
+
+typedef struct {
+    const char* name;
+    size_t len;                 // 0: IMIX, 7:4:1 of 64, 576 and 1500 bytes
+} shape_t;
+
+static const shape_t shapes[] = {
+    { "64 B",   64 },
+    { "128 B",  128 },
+    { "256 B",  256 },
+    { "576 B",  576 },
+    { "1500 B", 1500 },
+    { "IMIX",   0 },
+};
+
+#define NUM_SHAPES (sizeof(shapes) / sizeof(shapes[0]))
+
+static const uint8_t salt[8] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+
+static size_t imix_len(int i) {
+    static const size_t lens[12] = { 64, 576, 64, 64, 1500, 64, 576, 64, 576, 64, 576, 64 };
+    return lens[i % 12];
+}
+
+// Reference: one packet through the serial kernel, tail padded to a whole block
+static void encrypt_packet_serial(const aes_packet_t* pkt, uint8_t* out) {
+    uint8_t buf[SLOT_BYTES + BLOCK_SIZE];
+    size_t blocks = (pkt->len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    ctr_block_t ctr;
+
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, pkt->src, pkt->len);
+    aes_packet_ctr(salt, pkt->seq, &ctr);
+    aesctr_kernel_serial(buf, roundKey, buf, blocks, &ctr);
+    memcpy(out, buf, pkt->len);
+}
+
+// Per-packet baseline: bulk kernel for the whole blocks, then the padded tail
+static void encrypt_packet_bulk(const aes_packet_t* pkt, aesctr_bulk_fn kernel) {
+    size_t blocks = pkt->len / BLOCK_SIZE;
+    size_t tail = pkt->len % BLOCK_SIZE;
+    ctr_block_t ctr;
+
+    aes_packet_ctr(salt, pkt->seq, &ctr);
+    kernel((uint8_t*)pkt->src, roundKey, pkt->dst, blocks, &ctr);
+    if (tail) {
+        uint8_t block[BLOCK_SIZE] = {0};
+        memcpy(block, pkt->src + blocks * BLOCK_SIZE, tail);
+        ctr_block_advance(&ctr, &ctr, blocks);
+        kernel(block, roundKey, block, 1, &ctr);
+        memcpy(pkt->dst + blocks * BLOCK_SIZE, block, tail);
+    }
+}
+
+/**
+ * Random bursts: lengths 0..SLOT_BYTES, random sequence numbers, in place
+ * and out of place, through both entry points, against the serial reference.
+ */
+static int check_random(uint8_t* src, uint8_t* dst, uint8_t* expected) {
+    aes_packet_t pkts[RING_PACKETS];
+    srand(11);
+
+    for (int t = 0; t < RANDOM_TRIALS; t++) {
+        int count = t % 10 == 0 ? RING_PACKETS : 1 + rand() % 64;
+        int in_place = t % 3 == 0;
+        for (int i = 0; i < count; i++) {
+            pkts[i].seq = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+            pkts[i].src = src + (size_t)i * SLOT_BYTES;
+            pkts[i].len = (size_t)rand() % (SLOT_BYTES + 1);
+            pkts[i].dst = in_place ? (uint8_t*)pkts[i].src : dst + (size_t)i * SLOT_BYTES;
+            encrypt_packet_serial(&pkts[i], expected + (size_t)i * SLOT_BYTES);
+        }
+
+        // In place overwrites the plaintext; keep a copy to restore it
+        if (in_place) memcpy(dst, src, (size_t)count * SLOT_BYTES);
+        if (t % 2) {
+            aesctr_enc_burst(pkts, count, roundKey, salt);
+        } else {
+            aesctr_enc_burst_pool(NULL, pkts, count, roundKey, salt);
+        }
+        for (int i = 0; i < count; i++) {
+            if (memcmp(pkts[i].dst, expected + (size_t)i * SLOT_BYTES, pkts[i].len) != 0) {
+                printf("  trial %d: packet %d of %d (%zu bytes) mismatch\n", t, i, count, pkts[i].len);
+                return 0;
+            }
+        }
+        if (in_place) memcpy(src, dst, (size_t)count * SLOT_BYTES);
+    }
+    return 1;
+}
+
+typedef enum { MODE_PER_PACKET, MODE_BURST, MODE_BURST_POOL } run_mode_t;
+
+// return: packets per second over repeated passes of the first ring_packets slots
+static double run_mode(aes_packet_t* ring, int ring_packets, int burst, run_mode_t mode, aesctr_bulk_fn kernel) {
+    size_t packets = 0;
+    double start = bench_now(), elapsed;
+
+    do {
+        for (int i = 0; i + burst <= ring_packets; i += burst) {
+            if (mode == MODE_PER_PACKET) {
+                for (int k = 0; k < burst; k++) {
+                    encrypt_packet_bulk(&ring[i + k], kernel);
+                }
+            } else if (mode == MODE_BURST) {
+                aesctr_enc_burst(ring + i, burst, roundKey, salt);
+            } else {
+                aesctr_enc_burst_pool(NULL, ring + i, burst, roundKey, salt);
+            }
+            packets += burst;
+        }
+        elapsed = bench_now() - start;
+    } while (elapsed < MIN_SECONDS);
+    return packets / elapsed;
+}
+
+/**
+ * usage: tester_burst [burst]
+ *
+ * Checks aesctr_enc_burst against per-packet serial CTR, then measures
+ * packets per second for fixed sizes and IMIX: one bulk-kernel call per
+ * packet and one aesctr_enc_burst call per burst over cache-resident
+ * packets, and the pool variant on bursts of the whole ring.
+ */
+int main(int argc, char** argv) {
+    int burst = argc > 1 ? atoi(argv[1]) : BURST;
+    if (burst < 1 || burst > RING_PACKETS) {
+        printf("Burst must be 1..%d packets\n", RING_PACKETS);
+        return 1;
+    }
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+
+    size_t ring_bytes = (size_t)RING_PACKETS * SLOT_BYTES;
+    uint8_t* src = (uint8_t*)aes_buf_alloc(ring_bytes, AES_BUF_PREFAULT);
+    uint8_t* dst = (uint8_t*)aes_buf_alloc(ring_bytes, AES_BUF_PREFAULT);
+    uint8_t* expected = (uint8_t*)aes_buf_alloc(ring_bytes, AES_BUF_PREFAULT);
+    aes_packet_t* ring = (aes_packet_t*)malloc(RING_PACKETS * sizeof(aes_packet_t));
+    if (!src || !dst || !expected || !ring) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    aes_datagen_fill(src, ring_bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+
+    int ok = check_random(src, dst, expected);
+    printf("Random bursts against per-packet serial CTR (%d trials): %s\n\n", RANDOM_TRIALS, ok ? "Yes" : "No");
+
+    const char* kernel_name;
+    const char* ecb_name;
+    aesctr_bulk_fn kernel = aes_select_bulk_kernel(&kernel_name);
+    aes_select_ecb_kernel(&ecb_name);
+    printf("Burst: %d packets, kernels: %s / %s ecb, pool: %d workers\n", burst, kernel_name, ecb_name,
+           aes_pool_num_threads(aes_pool_default()));
+    printf("%-8s %12s %12s %12s %10s\n", "packet", "per-packet", "burst", "pool", "burst GB/s");
+
+    for (size_t s = 0; s < NUM_SHAPES; s++) {
+        size_t bytes = 0;
+        for (int i = 0; i < RING_PACKETS; i++) {
+            ring[i].seq = (uint64_t)i;
+            ring[i].src = src + (size_t)i * SLOT_BYTES;
+            ring[i].dst = dst + (size_t)i * SLOT_BYTES;
+            ring[i].len = shapes[s].len ? shapes[s].len : imix_len(i);
+            bytes += ring[i].len;
+        }
+
+        double pps[3];
+        int hot = burst > HOT_PACKETS ? burst : HOT_PACKETS;
+        pps[0] = run_mode(ring, hot, burst, MODE_PER_PACKET, kernel);
+        pps[1] = run_mode(ring, hot, burst, MODE_BURST, kernel);
+        pps[2] = run_mode(ring, RING_PACKETS, RING_PACKETS, MODE_BURST_POOL, kernel);
+        double gbs = pps[1] * ((double)bytes / RING_PACKETS) / (1 << 30);
+
+        printf("%-8s %10.2f M %10.2f M %10.2f M %10.2f\n", shapes[s].name, pps[0] / 1e6, pps[1] / 1e6,
+               pps[2] / 1e6, gbs);
+    }
+    printf("(packets per second)\n");
+
+    aes_buf_free(src);
+    aes_buf_free(dst);
+    aes_buf_free(expected);
+    free(ring);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "aes.h"
+#include "coalesce.h"
+#include "async.h"
+#include "dispatch.h"
+#include "stats.h"
+#include "bench.h"
+#include "datagen.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define NUM_KEYS 3
+#define CHECK_REQUESTS 20000
+#define WINDOW 1024             // requests in flight in the timed runs
+#define RUN_SECONDS 0.5
+#define MAX_SAMPLES (1 << 22)
+
+// One in-flight request of the timed runs; slots cycle through a free list
+typedef struct slot {
+    aes_creq_t req;
+    uint64_t submit_ns;
+    struct slot* next_free;
+} slot_t;
+
+static uint8_t roundKeys[NUM_KEYS][176] __attribute__((aligned(64)));
+
+static pthread_mutex_t free_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t free_cond = PTHREAD_COND_INITIALIZER;
+static slot_t* free_slots;
+static double* samples;
+static _Atomic size_t num_samples;
+static _Atomic size_t checked_done;
+
+// Local reference for one request: whole blocks, then the padded tail
+static void local_ctr(const uint8_t* in, uint8_t* out, size_t len, const uint8_t* roundKey, const ctr_block_t* ctr) {
+    aesctr_bulk_fn kernel = aes_select_bulk_kernel(NULL);
+    ctr_block_t c = *ctr;
+    size_t blocks = len / BLOCK_SIZE;
+
+    kernel((uint8_t*)in, roundKey, out, blocks, &c);
+    if (len % BLOCK_SIZE) {
+        uint8_t block[BLOCK_SIZE] = {0};
+        memcpy(block, in + blocks * BLOCK_SIZE, len % BLOCK_SIZE);
+        ctr_block_advance(ctr, &c, blocks);
+        kernel(block, roundKey, block, 1, &c);
+        memcpy(out + blocks * BLOCK_SIZE, block, len % BLOCK_SIZE);
+    }
+}
+
+static void count_done(aes_creq_t* req, void* arg) {
+    (void)req;
+    (void)arg;
+    atomic_fetch_add(&checked_done, 1);
+}
+
+/**
+ * Requests of random length (mostly under 100 bytes, a few up to 8 KB)
+ * under random keys and counters, some near the 64-bit wrap, checked
+ * against local CTR.
+ */
+static int check_requests(aes_coalescer_t* c, uint8_t* in, uint8_t* out, uint8_t* expected) {
+    aes_creq_t* reqs = (aes_creq_t*)calloc(CHECK_REQUESTS, sizeof(aes_creq_t));
+    uint64_t rng = DATAGEN_SEED;
+    size_t off = 0;
+
+    atomic_store(&checked_done, 0);
+    for (int i = 0; i < CHECK_REQUESTS; i++) {
+        rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t r = rng >> 16;
+        size_t len = r % 8 == 0 ? r % 8192 : r % 100;
+        aes_creq_t* req = &reqs[i];
+
+        req->src = in + off;
+        req->dst = out + off;
+        req->len = len;
+        req->roundKey = roundKeys[r % NUM_KEYS];
+        memcpy(req->ctr.nonce, &rng, 8);
+        uint64_t counter = r % 5 == 0 ? UINT64_MAX - (r % 3) : r;
+        for (int k = 0; k < 8; k++) {
+            req->ctr.counter[k] = (uint8_t)(counter >> (56 - 8 * k));
+        }
+        req->done = count_done;
+        local_ctr(req->src, expected + off, len, req->roundKey, &req->ctr);
+        aes_coalesce_submit(c, req);
+        off += len;
+    }
+    while (atomic_load(&checked_done) < CHECK_REQUESTS) {
+        usleep(100);
+    }
+    free(reqs);
+    return memcmp(out, expected, off) == 0;
+}
+
+static void release_slot(slot_t* slot) {
+    size_t n = atomic_fetch_add(&num_samples, 1);
+    if (n < MAX_SAMPLES) {
+        samples[n] = (aes_stats_now_ns() - slot->submit_ns) * 1e-9;
+    }
+    pthread_mutex_lock(&free_lock);
+    slot->next_free = free_slots;
+    free_slots = slot;
+    pthread_cond_signal(&free_cond);
+    pthread_mutex_unlock(&free_lock);
+}
+
+static void coalesce_done(aes_creq_t* req, void* arg) {
+    (void)req;
+    release_slot((slot_t*)arg);
+}
+
+static void async_done(aes_async_t* job, void* arg) {
+    aes_async_free(job);
+    release_slot((slot_t*)arg);
+}
+
+static slot_t* acquire_slot() {
+    pthread_mutex_lock(&free_lock);
+    while (!free_slots) {
+        pthread_cond_wait(&free_cond, &free_lock);
+    }
+    slot_t* slot = free_slots;
+    free_slots = slot->next_free;
+    pthread_mutex_unlock(&free_lock);
+    return slot;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Keeps WINDOW requests of len bytes in flight for RUN_SECONDS, through the
+ * coalescer c or, with c NULL, as one async pool job each.
+ * return: requests per second; p50/p99 latency in microseconds
+ */
+static double timed_run(aes_coalescer_t* c, slot_t* slots, const uint8_t* in, uint8_t* out, size_t len,
+                        double* p50, double* p99) {
+    free_slots = NULL;
+    for (int i = 0; i < WINDOW; i++) {
+        slots[i].next_free = free_slots;
+        free_slots = &slots[i];
+    }
+    atomic_store(&num_samples, 0);
+
+    uint64_t issued = 0;
+    double start = bench_now(), elapsed;
+    do {
+        for (int k = 0; k < 64; k++, issued++) {
+            slot_t* slot = acquire_slot();
+            size_t i = slot - slots;
+            slot->req.src = in + i * len;
+            slot->req.dst = out + i * len;
+            slot->req.len = len;
+            slot->req.roundKey = roundKeys[issued % NUM_KEYS];
+            ctr_block_advance(&slot->req.ctr, &slot->req.ctr, 1);
+            slot->submit_ns = aes_stats_now_ns();
+            if (c) {
+                slot->req.done = coalesce_done;
+                slot->req.arg = slot;
+                aes_coalesce_submit(c, &slot->req);
+            } else {
+                aes_async_opts_t opts = { .callback = async_done, .arg = slot };
+                aesctr_enc_async(NULL, slot->req.src, slot->req.roundKey, slot->req.dst, len, &slot->req.ctr, &opts);
+            }
+        }
+        elapsed = bench_now() - start;
+    } while (elapsed < RUN_SECONDS);
+
+    // Wait for the window to drain
+    for (int i = 0; i < WINDOW; i++) {
+        acquire_slot();
+    }
+    elapsed = bench_now() - start;
+
+    size_t n = atomic_load(&num_samples);
+    if (n > MAX_SAMPLES) n = MAX_SAMPLES;
+    qsort(samples, n, sizeof(double), cmp_double);
+    *p50 = samples[n / 2] * 1e6;
+    *p99 = samples[n * 99 / 100] * 1e6;
+    return issued / elapsed;
+}
+
+/**
+ * usage: tester_coalesce [request_bytes]
+ *
+ * Checks coalesced requests of random lengths, keys and counters against
+ * local CTR, then keeps WINDOW small requests in flight for several
+ * deadline and batch size settings, against submitting each as its own
+ * async pool job. Reports requests per second, latency from submit to
+ * callback and the batch sizes achieved.
+ */
+int main(int argc, char** argv) {
+    size_t len = argc > 1 ? strtoul(argv[1], NULL, 10) : 64;
+    size_t check_bytes = CHECK_REQUESTS * 8192;
+
+    for (int k = 0; k < NUM_KEYS; k++) {
+        uint8_t key[16] = {
+            0x2b, 0x7e, 0x15, 0x16,
+            0x28, 0xae, 0xd2, 0xa6,
+            0xab, 0xf7, 0x15, 0x88,
+            0x09, 0xcf, 0x4f, (uint8_t)(0x3c + k)
+        };
+        aes_keyexpansion_serial(key, roundKeys[k]);
+    }
+    uint8_t* in = (uint8_t*)malloc(check_bytes);
+    uint8_t* out = (uint8_t*)malloc(check_bytes);
+    uint8_t* expected = (uint8_t*)malloc(check_bytes);
+    slot_t* slots = (slot_t*)calloc(WINDOW, sizeof(slot_t));
+    samples = (double*)malloc(MAX_SAMPLES * sizeof(double));
+    if (!in || !out || !expected || !slots || !samples || len == 0 || len * WINDOW > check_bytes) {
+        printf("Setup failed\n");
+        return 1;
+    }
+    aes_datagen_fill(in, check_bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+
+    aes_coalescer_t* c = aes_coalescer_create(NULL);
+    int ok = c && check_requests(c, in, out, expected);
+    printf("Coalesced requests under %d keys match local CTR: %s\n", NUM_KEYS, ok ? "Yes" : "No");
+    aes_creq_t no_callback = { .src = in, .dst = out, .len = 16, .roundKey = roundKeys[0] };
+    int rejected = c && aes_coalesce_submit(c, &no_callback) == -1 && errno == EINVAL;
+    printf("Request without a callback rejected: %s\n", rejected ? "Yes" : "No");
+    ok = ok && rejected;
+    aes_coalescer_destroy(c);
+
+    printf("\n%zu B requests, %d in flight, %d pool workers\n", len, WINDOW, aes_pool_num_threads(aes_pool_default()));
+    printf("%-24s %12s %9s %9s %10s %8s %10s\n", "", "req/s", "p50 us", "p99 us", "mean batch", "max", "% deadline");
+    double p50, p99;
+    double rate = timed_run(NULL, slots, in, out, len, &p50, &p99);
+    printf("%-24s %12.0f %9.1f %9.1f\n", "async job per request", rate, p50, p99);
+
+    static const struct { unsigned deadline_us; size_t max_requests; } configs[] = {
+        { 10, 64 }, { 50, 256 }, { 200, 256 }, { 200, 1024 }, { 1000, 4096 }
+    };
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        aes_coalesce_opts_t opts = { .deadline_us = configs[i].deadline_us, .max_requests = configs[i].max_requests,
+                                     .max_bytes = 16UL * 1024 * 1024 };
+        aes_coalesce_stats_t stats;
+        char label[32];
+
+        c = aes_coalescer_create(&opts);
+        rate = timed_run(c, slots, in, out, len, &p50, &p99);
+        aes_coalescer_get_stats(c, &stats);
+        aes_coalescer_destroy(c);
+
+        snprintf(label, sizeof(label), "%u us / %zu", configs[i].deadline_us, configs[i].max_requests);
+        printf("%-24s %12.0f %9.1f %9.1f %10.1f %8llu %9.0f%%\n", label, rate, p50, p99,
+               stats.batches ? (double)stats.requests / stats.batches : 0.0, (unsigned long long)stats.max_batch,
+               stats.batches ? 100.0 * stats.deadline_flushes / stats.batches : 0.0);
+    }
+
+    free(in);
+    free(out);
+    free(expected);
+    free(slots);
+    free(samples);
+    return ok ? 0 : 1;
+}
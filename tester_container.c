@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "aes.h"
+#include "cmac.h"
+#include "container.h"
+#include "openmp.h"
+#include "pool.h"
+#include "datagen.h"
+#include "bench.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define FILE_MB 128
+#define TAIL_BYTES 4099         // partial last chunk ending mid-block
+#define CHUNK_SIZE (64 * 1024)
+#define NUM_SLICES 2000
+#define SLICE_BYTES 4096
+
+// RFC 4493 section 4
+typedef struct {
+    size_t len;
+    const char* tag;
+} cmac_vector_t;
+
+static const cmac_vector_t cmac_vectors[] = {
+    { 0,  "bb1d6929e95937287fa37d129b756746" },
+    { 16, "070a16b46b4d4144f79bdd9dd04a287c" },
+    { 40, "dfa66747de9ae63030ca32611497c827" },
+    { 64, "51f0bebf7e3b9d92fc49741779363cfe" },
+};
+
+static const uint8_t cmac_message[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+
+static uint8_t enc_key[16] = {
+    0x2b, 0x7e, 0x15, 0x16,
+    0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88,
+    0x09, 0xcf, 0x4f, 0x3c
+};
+
+static uint8_t mac_key[16] = {
+    0x60, 0x3d, 0xeb, 0x10,
+    0x15, 0xca, 0x71, 0xbe,
+    0x2b, 0x73, 0xae, 0xf0,
+    0x85, 0x7d, 0x77, 0x81
+};
+
+static int write_file(const char* path, const uint8_t* buf, size_t len) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    for (size_t done = 0; done < len; ) {
+        ssize_t n = write(fd, buf + done, len - done);
+        if (n <= 0) { close(fd); return -1; }
+        done += n;
+    }
+    return close(fd);
+}
+
+// XORs one byte of the file in place
+static int flip_byte(const char* path, uint64_t offset) {
+    uint8_t byte;
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return -1;
+    if (pread(fd, &byte, 1, offset) != 1) { close(fd); return -1; }
+    byte ^= 0x01;
+    if (pwrite(fd, &byte, 1, offset) != 1) { close(fd); return -1; }
+    return close(fd);
+}
+
+static int check_cmac_vectors() {
+    uint8_t roundKey[176];
+    aes_cmac_key_t key;
+    int ok = 1;
+
+    aes_keyexpansion_serial(enc_key, roundKey);
+    aes_cmac_key_init(&key, roundKey);
+
+    for (size_t v = 0; v < sizeof(cmac_vectors) / sizeof(cmac_vectors[0]); v++) {
+        uint8_t tag[AES_CMAC_TAG_SIZE], split_tag[AES_CMAC_TAG_SIZE];
+        char hex[2 * AES_CMAC_TAG_SIZE + 1];
+        aes_cmac_ctx_t ctx;
+
+        aes_cmac(&key, cmac_message, cmac_vectors[v].len, tag);
+
+        // Same message fed in uneven pieces
+        aes_cmac_begin(&ctx, &key);
+        for (size_t done = 0; done < cmac_vectors[v].len; done += 7) {
+            size_t n = cmac_vectors[v].len - done < 7 ? cmac_vectors[v].len - done : 7;
+            aes_cmac_update(&ctx, cmac_message + done, n);
+        }
+        aes_cmac_final(&ctx, split_tag);
+
+        for (int i = 0; i < AES_CMAC_TAG_SIZE; i++) {
+            sprintf(hex + 2 * i, "%02x", tag[i]);
+        }
+        int match = strcmp(hex, cmac_vectors[v].tag) == 0 && memcmp(tag, split_tag, sizeof(tag)) == 0;
+        printf("  CMAC %2zu bytes: %s\n", cmac_vectors[v].len, match ? "Yes" : "No");
+        ok = ok && match;
+    }
+    return ok;
+}
+
+/**
+ * usage: tester_container [dir] [file_mb]
+ *
+ * Checks CMAC against RFC 4493, packs a file into a container, compares its
+ * chunks with plain CTR over the whole file, reads it back whole and as
+ * random slices, and checks that tampering with a chunk fails exactly the
+ * reads that cover it.
+ */
+int main(int argc, char** argv) {
+    const char* dir = argc > 1 ? argv[1] : "/tmp";
+    size_t len = (argc > 2 ? strtoul(argv[2], NULL, 10) : FILE_MB) * 1024 * 1024 + TAIL_BYTES;
+    char plain_path[4096], box_path[4096];
+    int ok = 1;
+
+    snprintf(plain_path, sizeof(plain_path), "%s/aes_container_plain.%d", dir, (int)getpid());
+    snprintf(box_path, sizeof(box_path), "%s/aes_container_box.%d", dir, (int)getpid());
+
+    printf("RFC 4493 vectors:\n");
+    ok = check_cmac_vectors() && ok;
+
+    size_t padded_len = (len + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    uint8_t* plain = (uint8_t*)aes_buf_alloc(padded_len, AES_BUF_PREFAULT);
+    uint8_t* cipher = (uint8_t*)aes_buf_alloc(padded_len, AES_BUF_PREFAULT);
+    uint8_t* readback = (uint8_t*)aes_buf_alloc(len, AES_BUF_PREFAULT);
+    if (!plain || !cipher || !readback) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    aes_datagen_fill(plain, len, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+    if (write_file(plain_path, plain, len) < 0) {
+        printf("Can't write %s: %s\n", plain_path, strerror(errno));
+        return 1;
+    }
+
+    aes_container_keys_t keys;
+    aes_container_header_t header = {
+        .chunk_size = CHUNK_SIZE,
+        .key_id = 0x1234,
+        .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    };
+    aes_container_keys_init(&keys, enc_key, mac_key);
+
+    double start = bench_now();
+    int64_t packed = aes_container_pack(plain_path, box_path, &keys, &header, NULL);
+    double pack_seconds = bench_now() - start;
+    if (packed != (int64_t)len) {
+        printf("Pack failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    // Chunks hold plain CTR of the whole file: nonce || offset / 16
+    ctr_block_t ctr = {{0}, {0}};
+    memcpy(ctr.nonce, header.nonce, 8);
+    aesctr_enc_openmp(plain, keys.enc, cipher, padded_len / BLOCK_SIZE, &ctr);
+
+    uint64_t chunks = (len + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    int box_fd = open(box_path, O_RDONLY);
+    uint8_t* chunk_buf = (uint8_t*)malloc(CHUNK_SIZE);
+    int layout_ok = box_fd >= 0 && chunk_buf;
+    for (uint64_t c = 0; layout_ok && c < chunks; c++) {
+        size_t n = c == chunks - 1 ? len - c * CHUNK_SIZE : CHUNK_SIZE;
+        layout_ok = pread(box_fd, chunk_buf, n, aes_container_chunk_offset(&header, c)) == (ssize_t)n &&
+                    memcmp(chunk_buf, cipher + c * CHUNK_SIZE, n) == 0;
+    }
+    if (box_fd >= 0) close(box_fd);
+    free(chunk_buf);
+    ok = ok && layout_ok;
+
+    aes_container_header_t probed;
+    int probe_ok = aes_container_probe(box_path, &probed) == 0 && probed.key_id == header.key_id &&
+                   probed.data_len == len && probed.chunk_size == CHUNK_SIZE;
+    ok = ok && probe_ok;
+
+    aes_container_t* box = aes_container_open(box_path, &keys);
+    if (!box) {
+        printf("Open failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    memset(readback, 0, len);
+    start = bench_now();
+    int64_t got = aes_container_read(box, 0, readback, len, NULL);
+    double read_seconds = bench_now() - start;
+    int full_ok = got == (int64_t)len && memcmp(readback, plain, len) == 0;
+    ok = ok && full_ok;
+
+    // Random slices, many of them straddling a chunk boundary or running past the end
+    srand(1);
+    int slices_ok = 1;
+    uint64_t chunks_touched = 0;
+    start = bench_now();
+    for (int i = 0; i < NUM_SLICES; i++) {
+        uint64_t offset = ((uint64_t)rand() << 16 ^ rand()) % len;
+        size_t want = 1 + rand() % SLICE_BYTES;
+        size_t expect = offset + want > len ? len - offset : want;
+        got = aes_container_read(box, offset, readback, want, NULL);
+        slices_ok = slices_ok && got == (int64_t)expect && memcmp(readback, plain + offset, expect) == 0;
+        chunks_touched += (offset + expect - 1) / CHUNK_SIZE - offset / CHUNK_SIZE + 1;
+    }
+    double slice_seconds = bench_now() - start;
+    ok = ok && slices_ok;
+    aes_container_close(box);
+
+    double gb = len / (1024.0 * 1024.0 * 1024.0);
+    printf("\nContainer: %.1f MB in %llu chunks of %d KB\n", len / (1024.0 * 1024.0),
+           (unsigned long long)chunks, CHUNK_SIZE / 1024);
+    printf("  pack:          %.2f GB/s\n", gb / pack_seconds);
+    printf("  full read:     %.2f GB/s\n", gb / read_seconds);
+    printf("  slice reads:   %.1f us each, %.2f chunks touched on average\n",
+           slice_seconds / NUM_SLICES * 1e6, (double)chunks_touched / NUM_SLICES);
+    printf("  layout is CTR: %s\n", layout_ok ? "Yes" : "No");
+    printf("  probe key_id:  %s\n", probe_ok ? "Yes" : "No");
+    printf("  full read:     %s\n", full_ok ? "Yes" : "No");
+    printf("  slices match:  %s\n", slices_ok ? "Yes" : "No");
+
+    // Tampering: one flipped ciphertext byte fails its own chunk and nothing else
+    uint64_t victim = chunks / 2;
+    uint64_t victim_start = victim * CHUNK_SIZE;
+    flip_byte(box_path, aes_container_chunk_offset(&header, victim) + 100);
+    box = aes_container_open(box_path, &keys);
+    int tamper_ok = box != NULL;
+    if (box) {
+        errno = 0;
+        int covering = aes_container_read(box, victim_start + CHUNK_SIZE - 10, readback, 20, NULL) < 0 && errno == EBADMSG;
+        int before = aes_container_read(box, victim_start - 100, readback, 100, NULL) == 100;
+        int after = aes_container_read(box, victim_start + CHUNK_SIZE, readback, 100, NULL) == 100;
+        tamper_ok = covering && before && after;
+        aes_container_close(box);
+    }
+    printf("  tampered chunk rejected, neighbours readable: %s\n", tamper_ok ? "Yes" : "No");
+
+    // A flipped header byte or the wrong MAC key fails at open
+    flip_byte(box_path, 20);
+    errno = 0;
+    box = aes_container_open(box_path, &keys);
+    int header_ok = box == NULL && errno == EBADMSG;
+    flip_byte(box_path, 20);
+
+    aes_container_keys_t wrong;
+    mac_key[0] ^= 1;
+    aes_container_keys_init(&wrong, enc_key, mac_key);
+    errno = 0;
+    box = aes_container_open(box_path, &wrong);
+    header_ok = header_ok && box == NULL && errno == EBADMSG;
+    printf("  tampered header / wrong key rejected: %s\n", header_ok ? "Yes" : "No");
+    ok = ok && tamper_ok && header_ok;
+
+    unlink(plain_path);
+    unlink(box_path);
+    aes_buf_free(plain);
+    aes_buf_free(cipher);
+    aes_buf_free(readback);
+    return ok ? 0 : 1;
+}
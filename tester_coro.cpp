@@ -0,0 +1,199 @@
+#include <atomic>
+#include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "async.hpp"
+
+extern "C" {
+#include "dispatch.h"
+#include "bench.h"
+#include "datagen.h"
+#include "buf.h"
+}
+
+#define DATAGEN_SEED 0x5eedULL
+#define TEST_MB 256
+#define NUM_TASKS 16
+#define POLL_MS 1
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+static ctr_block_t initial_ctr = {
+    {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+/**
+ * Single-threaded event loop of the kind a coroutine server runs: handles
+ * posted from other threads are queued and an eventfd wakes the poll.
+ */
+class event_loop {
+public:
+    event_loop() : efd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {}
+    ~event_loop() { close(efd_); }
+
+    void post(std::coroutine_handle<> handle) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_.push_back(handle);
+        }
+        uint64_t one = 1;
+        if (write(efd_, &one, sizeof(one)) < 0) {
+            std::abort();
+        }
+    }
+
+    // Resumes posted coroutines until running reaches 0; max_tick is the longest gap between polls
+    void run(const std::atomic<int>& running, double* max_tick) {
+        double last = bench_now();
+        *max_tick = 0;
+        thread_ = std::this_thread::get_id();
+        while (running.load() > 0) {
+            struct pollfd pfd = { efd_, POLLIN, 0 };
+            poll(&pfd, 1, POLL_MS);
+            uint64_t count;
+            if (read(efd_, &count, sizeof(count)) < 0) {
+                count = 0;
+            }
+            std::deque<std::coroutine_handle<>> batch;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                batch.swap(ready_);
+            }
+            for (auto handle : batch) {
+                handle.resume();
+            }
+            double now = bench_now();
+            if (now - last > *max_tick) *max_tick = now - last;
+            last = now;
+        }
+    }
+
+    bool on_loop_thread() const { return std::this_thread::get_id() == thread_; }
+
+    // Resume policy for aes::ctr_async
+    struct poster {
+        event_loop* loop;
+        void operator()(std::coroutine_handle<> handle) const { loop->post(handle); }
+    };
+    poster resume_here() { return poster{this}; }
+
+private:
+    int efd_;
+    std::mutex mutex_;
+    std::deque<std::coroutine_handle<>> ready_;
+    std::thread::id thread_;
+};
+
+// Fire-and-forget coroutine that starts at once and counts itself out of running when it ends
+struct task {
+    struct promise_type {
+        task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+struct result {
+    bool match = true;
+    bool on_loop = true;
+};
+
+/**
+ * One connection's worth of work: encrypts its object, checks the
+ * ciphertext, decrypts it back in place and checks the plaintext, each
+ * through a co_await that resumes on the loop.
+ */
+static task handle_object(event_loop& loop, std::atomic<int>& running, const uint8_t* plain, const uint8_t* expected,
+                          uint8_t* buf, size_t len, result& res) {
+    co_await aes::ctr_async(nullptr, plain, roundKey, buf, len, initial_ctr, loop.resume_here());
+    res.on_loop = res.on_loop && loop.on_loop_thread();
+    res.match = res.match && memcmp(buf, expected, len) == 0;
+
+    co_await aes::ctr_async(nullptr, buf, roundKey, buf, len, initial_ctr, loop.resume_here());
+    res.on_loop = res.on_loop && loop.on_loop_thread();
+    res.match = res.match && memcmp(buf, plain, len) == 0;
+    running--;
+}
+
+/**
+ * usage: tester_coro [mb]
+ *
+ * Runs NUM_TASKS coroutines on a single-threaded event loop, each
+ * co_awaiting encryption and decryption of its own object through the async
+ * pool API (src/async.hpp) with resumption posted back to the loop. Checks
+ * the results against the bulk kernel and that every coroutine resumed on
+ * the loop thread, and reports throughput and the longest loop tick.
+ */
+int main(int argc, char** argv) {
+    size_t bytes = (argc > 1 ? strtoul(argv[1], NULL, 10) : TEST_MB) * 1024 * 1024;
+    size_t obj = (bytes / NUM_TASKS) - 5;    // odd lengths on purpose
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+
+    uint8_t* plain = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* expected = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* buf = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    if (!plain || !expected || !buf || obj < BLOCK_SIZE) {
+        printf("Setup failed\n");
+        return 1;
+    }
+    aes_datagen_fill(plain, bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+
+    // Reference: whole blocks through the bulk kernel, then the padded tail of each object
+    aesctr_bulk_fn kernel = aes_select_bulk_kernel(NULL);
+    for (int i = 0; i < NUM_TASKS; i++) {
+        size_t at = (size_t)i * obj;
+        size_t blocks = obj / BLOCK_SIZE;
+        ctr_block_t ctr = initial_ctr;
+        kernel(plain + at, roundKey, expected + at, blocks, &ctr);
+        uint8_t block[BLOCK_SIZE] = {0};
+        memcpy(block, plain + at + blocks * BLOCK_SIZE, obj % BLOCK_SIZE);
+        ctr_block_advance(&initial_ctr, &ctr, blocks);
+        kernel(block, roundKey, block, 1, &ctr);
+        memcpy(expected + at + blocks * BLOCK_SIZE, block, obj % BLOCK_SIZE);
+    }
+
+    event_loop loop;
+    std::atomic<int> running(NUM_TASKS);
+    std::vector<result> results(NUM_TASKS);
+    double max_tick;
+    double start = bench_now();
+    for (int i = 0; i < NUM_TASKS; i++) {
+        size_t at = (size_t)i * obj;
+        handle_object(loop, running, plain + at, expected + at, buf + at, obj, results[i]);
+    }
+    loop.run(running, &max_tick);
+    double seconds = bench_now() - start;
+
+    bool match = true, on_loop = true;
+    for (const result& res : results) {
+        match = match && res.match;
+        on_loop = on_loop && res.on_loop;
+    }
+    printf("%d coroutines, %.1f MB each: ciphertext and round trip match: %s, resumed on the loop thread: %s\n",
+           NUM_TASKS, obj / (1024.0 * 1024), match ? "Yes" : "No", on_loop ? "Yes" : "No");
+    printf("%.2f GB/s encrypted and decrypted, longest loop tick %.2f ms\n", 2.0 * obj * NUM_TASKS / seconds / (1 << 30),
+           max_tick * 1e3);
+
+    aes_buf_free(plain);
+    aes_buf_free(expected);
+    aes_buf_free(buf);
+    return match && on_loop ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "aes.h"
+#include "affinity.h"
+#include "datagen.h"
+#include "bench.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define RAND_BASELINE_MB 64
+
+static const aes_datagen_pattern_t patterns[] = {
+    AES_DATAGEN_RANDOM, AES_DATAGEN_ZERO, AES_DATAGEN_INCOMPRESSIBLE, AES_DATAGEN_REPEATING
+};
+
+int main() {
+    const size_t total_size = (size_t)MB_TO_TEST * 1024 * 1024;
+    // Both slices stay inside buf for small -DMB_TO_TEST builds
+    const size_t odd_size = (total_size - 16 < 8 * 1024 * 1024 ? total_size - 16 : 8 * 1024 * 1024) + 13;
+    const size_t rand_size = total_size < (size_t)RAND_BASELINE_MB * 1024 * 1024 ? total_size
+                                                                                : (size_t)RAND_BASELINE_MB * 1024 * 1024;
+    double gb = total_size / (1024.0 * 1024.0 * 1024.0);
+
+    printf("Benchmark parameters:\n");
+    printf("Total data size: %d MB\n", MB_TO_TEST);
+    printf("Number of threads: %d\n\n", aes_get_num_threads());
+
+    uint8_t* buf = (uint8_t*)aes_buf_alloc(total_size, AES_BUF_PREFAULT);
+    uint8_t* ref = (uint8_t*)aes_buf_alloc(odd_size, AES_BUF_PREFAULT);
+    if (!buf || !ref) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+
+    // Old tester_pthread.c init for comparison, on a smaller slice
+    srand(DATAGEN_SEED);
+    double start = bench_now();
+    for(size_t i = 0; i < rand_size; i++) {
+        buf[i] = rand() % 256;
+    }
+    double rand_gbs = (rand_size / (1024.0 * 1024.0 * 1024.0)) / (bench_now() - start);
+    printf("rand() %% 256 baseline: %.3f GB/s\n", rand_gbs);
+
+    bench_stream_t stream;
+    bench_stream(buf, buf, total_size, aes_get_num_threads(), 0.2, &stream);
+    printf("Write bandwidth (%d threads): %.2f GB/s\n\n", aes_get_num_threads(), stream.write_gbs);
+
+    int all_match = 1;
+    for(size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++) {
+        aes_datagen_pattern_t pattern = patterns[p];
+
+        aes_datagen_fill(buf, total_size, pattern, DATAGEN_SEED);  // first touch
+        start = bench_now();
+        aes_datagen_fill(buf, total_size, pattern, DATAGEN_SEED);
+        double elapsed = bench_now() - start;
+
+        // Same content regardless of thread count, including a partial last word
+        int threads = aes_get_num_threads();
+        aes_set_num_threads(1);
+        aes_datagen_fill(ref, odd_size, pattern, DATAGEN_SEED);
+        aes_set_num_threads(threads);
+        int match = memcmp(buf, ref, odd_size - 13) == 0;
+        aes_datagen_fill(buf, odd_size, pattern, DATAGEN_SEED);
+        match = match && memcmp(buf, ref, odd_size) == 0;
+        all_match &= match;
+
+        printf("%-15s %.4f seconds (%.2f GB/s, %.1f%% of write bandwidth, %.0fx rand()) reproducible: %s\n",
+               aes_datagen_pattern_name(pattern), elapsed, gb / elapsed,
+               100.0 * gb / elapsed / stream.write_gbs, gb / elapsed / rand_gbs,
+               match ? "Yes" : "No");
+    }
+
+    aes_buf_free(buf);
+    aes_buf_free(ref);
+
+    return all_match ? 0 : 1;
+}
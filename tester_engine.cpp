@@ -0,0 +1,264 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "engine.hpp"
+
+extern "C" {
+#include "engine.h"
+#include "dispatch.h"
+#include "bench.h"
+#include "datagen.h"
+#include "buf.h"
+}
+
+using namespace aes::engine;
+
+#define DATAGEN_SEED 0x5eedULL
+#define TEST_MB 64
+#define CHECK_BLOCKS 4099          // not a multiple of any interleave x lanes
+
+// FIPS-197 Appendix C: one block under keys 00 01 .. 0f / 17 / 1f
+static constexpr uint8_t fips197_plain[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+};
+static constexpr uint8_t fips197_cipher[3][16] = {
+    { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a },
+    { 0xdd, 0xa9, 0x7c, 0xa4, 0x86, 0x4c, 0xdf, 0xe0, 0x6e, 0xaf, 0x70, 0xa0, 0xec, 0x0d, 0x71, 0x91 },
+    { 0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf, 0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89 },
+};
+
+// SP 800-38A F.5.1, F.5.3, F.5.5: CTR-AES128/192/256 from counter block f0 f1 .. ff
+static const uint8_t sp800_keys[3][32] = {
+    { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c },
+    { 0x8e, 0x73, 0xb0, 0xf7, 0xda, 0x0e, 0x64, 0x52, 0xc8, 0x10, 0xf3, 0x2b, 0x80, 0x90, 0x79, 0xe5,
+      0x62, 0xf8, 0xea, 0xd2, 0x52, 0x2c, 0x6b, 0x7b },
+    { 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+      0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4 },
+};
+static const uint8_t sp800_plain[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10,
+};
+static const uint8_t sp800_cipher[3][64] = {
+    { 0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+      0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+      0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+      0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee },
+    { 0x1a, 0xbc, 0x93, 0x24, 0x17, 0x52, 0x1c, 0xa2, 0x4f, 0x2b, 0x04, 0x59, 0xfe, 0x7e, 0x6e, 0x0b,
+      0x09, 0x03, 0x39, 0xec, 0x0a, 0xa6, 0xfa, 0xef, 0xd5, 0xcc, 0xc2, 0xc6, 0xf4, 0xce, 0x8e, 0x94,
+      0x1e, 0x36, 0xb2, 0x6b, 0xd1, 0xeb, 0xc6, 0x70, 0xd1, 0xbd, 0x1d, 0x66, 0x56, 0x20, 0xab, 0xf7,
+      0x4f, 0x78, 0xa7, 0xf6, 0xd2, 0x98, 0x09, 0x58, 0x5a, 0x97, 0xda, 0xec, 0x58, 0xc6, 0xb0, 0x50 },
+    { 0x60, 0x1e, 0xc3, 0x13, 0x77, 0x57, 0x89, 0xa5, 0xb7, 0xa7, 0xf5, 0x04, 0xbb, 0xf3, 0xd2, 0x28,
+      0xf4, 0x43, 0xe3, 0xca, 0x4d, 0x62, 0xb5, 0x9a, 0xca, 0x84, 0xe9, 0x90, 0xca, 0xca, 0xf5, 0xc5,
+      0x2b, 0x09, 0x30, 0xda, 0xa2, 0x3d, 0xe9, 0x4c, 0xe8, 0x70, 0x17, 0xba, 0x2d, 0x84, 0x98, 0x8d,
+      0xdf, 0xc9, 0xc5, 0x8d, 0xb6, 0x7a, 0xad, 0xa6, 0x13, 0xc2, 0xdd, 0x08, 0x45, 0x79, 0x41, 0xa6 },
+};
+static const ctr_block_t sp800_ctr = {
+    {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7},
+    {0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff}
+};
+
+// The FIPS-197 AES-128 vector, run through the software policy at compile time
+constexpr bool fips197_at_compile_time() {
+    uint8_t key[16] = {}, roundKey[key_size<128>::schedule_bytes] = {}, out[16] = {};
+    for (int i = 0; i < 16; i++) key[i] = (uint8_t)i;
+    expand_key<128>(key, roundKey);
+    ecb<soft, 128, 1>(fips197_plain, roundKey, out, 1);
+    for (int i = 0; i < 16; i++) {
+        if (out[i] != fips197_cipher[0][i]) return false;
+    }
+    return true;
+}
+static_assert(fips197_at_compile_time(), "software policy fails FIPS-197 C.1");
+
+/**
+ * One instantiation of the core: policy, key size and interleave. The
+ * tester builds a grid of them to compare interleave widths; engine.cpp
+ * builds only the deployed ones.
+ */
+typedef struct {
+    const char* policy;
+    int key_bits;
+    int interleave;
+    bool (*supported)();
+    aesctr_bulk_fn ctr;
+    aes_ecb_fn ecb;
+} variant_t;
+
+#define VARIANT(policy, isa, bits, n) \
+    __attribute__((target(isa))) static void ctr_##policy##_##bits##_##n( \
+            uint8_t* in, const uint8_t* rk, uint8_t* out, size_t blocks, ctr_block_t* c) { \
+        ctr<policy, bits, n>(in, rk, out, blocks, *c); \
+    } \
+    __attribute__((target(isa))) static void ecb_##policy##_##bits##_##n( \
+            const uint8_t* in, const uint8_t* rk, uint8_t* out, size_t blocks) { \
+        ecb<policy, bits, n>(in, rk, out, blocks); \
+    }
+#define VARIANTS_FOR_KEY(policy, isa, bits) \
+    VARIANT(policy, isa, bits, 1) VARIANT(policy, isa, bits, 2) VARIANT(policy, isa, bits, 4) VARIANT(policy, isa, bits, 8)
+#define VARIANTS(policy, isa) \
+    VARIANTS_FOR_KEY(policy, isa, 128) VARIANTS_FOR_KEY(policy, isa, 192) VARIANTS_FOR_KEY(policy, isa, 256)
+
+VARIANTS(soft, AES_ENGINE_TARGET_SOFT)
+VARIANTS(aesni, AES_ENGINE_TARGET_AESNI)
+VARIANTS(vaes256, AES_ENGINE_TARGET_VAES256)
+VARIANTS(vaes512, AES_ENGINE_TARGET_VAES512)
+
+static bool soft_supported() { return soft::supported(); }
+static bool aesni_supported() { return aesni::supported(); }
+static bool vaes256_supported() { return vaes256::supported(); }
+static bool vaes512_supported() { return vaes512::supported(); }
+
+#define ENTRY(policy, bits, n) { #policy, bits, n, policy##_supported, ctr_##policy##_##bits##_##n, ecb_##policy##_##bits##_##n }
+#define ENTRIES_FOR_KEY(policy, bits) ENTRY(policy, bits, 1), ENTRY(policy, bits, 2), ENTRY(policy, bits, 4), ENTRY(policy, bits, 8)
+#define ENTRIES(policy) ENTRIES_FOR_KEY(policy, 128), ENTRIES_FOR_KEY(policy, 192), ENTRIES_FOR_KEY(policy, 256)
+
+static const variant_t variants[] = { ENTRIES(soft), ENTRIES(aesni), ENTRIES(vaes256), ENTRIES(vaes512) };
+
+static int key_index(int key_bits) {
+    return (key_bits - 128) / 64;
+}
+
+// Known-answer vectors, then CHECK_BLOCKS of random data against the reference kernel
+static bool check_variant(const variant_t& v, uint8_t* in, uint8_t* out, const uint8_t* expected,
+                          const uint8_t (*roundKeys)[AES_ENGINE_MAX_SCHEDULE], const ctr_block_t& check_ctr) {
+    int k = key_index(v.key_bits);
+    uint8_t key[32], roundKey[AES_ENGINE_MAX_SCHEDULE], blocks[37 * 16];
+    bool ok = true;
+
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)i;
+    aes_engine_keyexpansion(key, v.key_bits, roundKey);
+    for (int b = 0; b < 37; b++) memcpy(blocks + 16 * b, fips197_plain, 16);
+    v.ecb(blocks, roundKey, blocks, 37);
+    for (int b = 0; b < 37; b++) ok = ok && memcmp(blocks + 16 * b, fips197_cipher[k], 16) == 0;
+
+    uint8_t ct[64];
+    ctr_block_t c = sp800_ctr;
+    aes_engine_keyexpansion(sp800_keys[k], v.key_bits, roundKey);
+    v.ctr((uint8_t*)sp800_plain, roundKey, ct, 4, &c);
+    ok = ok && memcmp(ct, sp800_cipher[k], 64) == 0;
+
+    c = check_ctr;
+    memset(out, 0, CHECK_BLOCKS * 16);
+    v.ctr(in, roundKeys[k], out, CHECK_BLOCKS, &c);
+    return ok && memcmp(out, expected + (size_t)k * CHECK_BLOCKS * 16, CHECK_BLOCKS * 16) == 0;
+}
+
+static double throughput(aesctr_bulk_fn fn, uint8_t* in, const uint8_t* roundKey, uint8_t* out, size_t bytes) {
+    double best = 0;
+    for (int r = 0; r < 3; r++) {
+        ctr_block_t c = sp800_ctr;
+        double start = bench_now();
+        fn(in, roundKey, out, bytes / 16, &c);
+        double gbps = bytes / (bench_now() - start) / (1 << 30);
+        if (gbps > best) best = gbps;
+    }
+    return best;
+}
+
+/**
+ * usage: tester_engine [mb]
+ *
+ * Checks every policy x key size x interleave of the template engine
+ * (src/engine.hpp) that this CPU supports against the FIPS-197 and
+ * SP 800-38A vectors and against the serial kernel, plus the C interface
+ * of src/engine.h. Then single-thread AES-128 CTR throughput of each
+ * instantiation over mb MB, next to the hand-written kernel that
+ * aes_select_bulk_kernel picks.
+ */
+int main(int argc, char** argv) {
+    size_t bytes = (argc > 1 ? strtoul(argv[1], NULL, 10) : TEST_MB) * 1024 * 1024;
+    size_t check_bytes = CHECK_BLOCKS * 16;
+    static uint8_t roundKeys[3][AES_ENGINE_MAX_SCHEDULE] __attribute__((aligned(64)));
+    uint8_t key[32] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+        0x76, 0x2e, 0x71, 0x60, 0xf3, 0x8b, 0x4d, 0xa5, 0x6a, 0x78, 0x4d, 0x90, 0x45, 0x19, 0x0c, 0xfe
+    };
+    // Starts two blocks before the 64-bit counter wraps
+    ctr_block_t check_ctr = {
+        {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+        {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe}
+    };
+
+    uint8_t* in = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* out = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* expected = (uint8_t*)malloc(3 * check_bytes);
+    if (!in || !out || !expected || bytes < check_bytes) {
+        printf("Setup failed\n");
+        return 1;
+    }
+    aes_datagen_fill(in, bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+
+    // References: the serial kernel for AES-128, the software policy for the others (checked by the vectors)
+    uint8_t serial_keys[176];
+    aes_keyexpansion_serial(key, serial_keys);
+    for (int k = 0; k < 3; k++) {
+        aes_engine_keyexpansion(key, 128 + 64 * k, roundKeys[k]);
+    }
+    bool ok = memcmp(serial_keys, roundKeys[0], 176) == 0;
+    printf("AES-128 key schedule matches aes_keyexpansion_serial: %s\n", ok ? "Yes" : "No");
+    ctr_block_t c = check_ctr;
+    aesctr_kernel_serial(in, roundKeys[0], expected, CHECK_BLOCKS, &c);
+    c = check_ctr;
+    ctr_soft_192_1(in, roundKeys[1], expected + check_bytes, CHECK_BLOCKS, &c);
+    c = check_ctr;
+    ctr_soft_256_1(in, roundKeys[2], expected + 2 * check_bytes, CHECK_BLOCKS, &c);
+
+    int checked = 0, failed = 0;
+    for (const variant_t& v : variants) {
+        if (!v.supported()) continue;
+        checked++;
+        if (!check_variant(v, in, out, expected, roundKeys, check_ctr)) {
+            printf("  %s AES-%d x%d differs\n", v.policy, v.key_bits, v.interleave);
+            failed++;
+        }
+    }
+    printf("%d supported instantiations match FIPS-197, SP 800-38A and the reference: %s\n", checked,
+           failed ? "No" : "Yes");
+    ok = ok && !failed;
+
+    bool c_abi = true;
+    for (int k = 0; k < 3; k++) {
+        int bits = 128 + 64 * k;
+        const char* name;
+        aesctr_bulk_fn fn = aes_engine_select_ctr(bits, &name);
+        aes_ecb_fn ecb_fn = aes_engine_select_ecb(bits, NULL);
+        variant_t v = { name, bits, 0, soft_supported, fn, ecb_fn };
+        c_abi = c_abi && fn && ecb_fn && check_variant(v, in, out, expected, roundKeys, check_ctr);
+    }
+    c = check_ctr;
+    memset(out, 0, check_bytes);
+    aesctr_enc_engine(in, roundKeys[0], out, CHECK_BLOCKS, &c);
+    c_abi = c_abi && memcmp(out, expected, check_bytes) == 0;
+    c_abi = c_abi && !aes_engine_select_ctr(160, NULL) && errno == EINVAL && aes_engine_schedule_bytes(160) == 0;
+    printf("C interface (engine.h) matches and rejects other key sizes: %s\n", c_abi ? "Yes" : "No");
+    ok = ok && c_abi;
+
+    const char* kernel_name;
+    const char* engine_name;
+    aesctr_bulk_fn kernel = aes_select_bulk_kernel(&kernel_name);
+    aes_engine_select_ctr(128, &engine_name);
+    printf("\nAES-128 CTR, one thread, %zu MB, GB/s; engine.h picks %s\n", bytes >> 20, engine_name);
+    printf("%-10s %8s %8s %8s %8s\n", "policy", "x1", "x2", "x4", "x8");
+    for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i += 12) {
+        if (!variants[i].supported()) continue;
+        // The software policy runs at tens of MB/s; a slice is enough to time it
+        size_t run = strcmp(variants[i].policy, "soft") == 0 ? bytes / 64 : bytes;
+        printf("%-10s", variants[i].policy);
+        for (int n = 0; n < 4; n++) {
+            printf(" %8.2f", throughput(variants[i + n].ctr, in, roundKeys[0], out, run));
+        }
+        printf("\n");
+    }
+    printf("%-10s %8.2f  (hand-written %s kernel)\n", "dispatch.h", throughput(kernel, in, roundKeys[0], out, bytes),
+           kernel_name);
+
+    aes_buf_free(in);
+    aes_buf_free(out);
+    free(expected);
+    return ok ? 0 : 1;
+}
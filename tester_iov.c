@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+
+#include "aes.h"
+#include "iov.h"
+#include "openmp.h"
+#include "pool.h"
+#include "dispatch.h"
+#include "bench.h"
+#include "datagen.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define TEST_MB 64
+#define REPEATS 3
+#define RANDOM_TRIALS 200
+
+typedef struct {
+    const char* name;
+    size_t seg_bytes;           // 0: one segment for the whole buffer
+} shape_t;
+
+static const shape_t shapes[] = {
+    { "contiguous",  0 },
+    { "64 KB",       64 * 1024 },
+    { "1500 B",      1500 },
+    { "256 B",       256 },
+    { "64 B",        64 },
+};
+
+#define NUM_SHAPES (sizeof(shapes) / sizeof(shapes[0]))
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+static ctr_block_t initial_ctr = {
+    .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+// Cuts buf into segments of seg_bytes (the last one shorter); return: segment count
+static int fixed_chain(uint8_t* buf, size_t len, size_t seg_bytes, struct iovec* iov) {
+    int cnt = 0;
+    if (seg_bytes == 0) {
+        seg_bytes = len;
+    }
+    for (size_t off = 0; off < len; off += seg_bytes) {
+        iov[cnt].iov_base = buf + off;
+        iov[cnt].iov_len = len - off < seg_bytes ? len - off : seg_bytes;
+        cnt++;
+    }
+    return cnt;
+}
+
+// Random segment lengths in [0, max_seg], zero-length ones included
+static int random_chain(uint8_t* buf, size_t len, size_t max_seg, struct iovec* iov) {
+    int cnt = 0;
+    size_t off = 0;
+    while (off < len) {
+        size_t n = (size_t)rand() % (max_seg + 1);
+        if (n > len - off) n = len - off;
+        iov[cnt].iov_base = buf + off;
+        iov[cnt].iov_len = n;
+        cnt++;
+        off += n;
+    }
+    return cnt;
+}
+
+// Staging baseline: gather into one buffer, encrypt it, scatter back out
+static void gather_encrypt_scatter(const struct iovec* in, int in_cnt, const struct iovec* out, int out_cnt,
+                                   uint8_t* staging, size_t len, aesctr_bulk_fn kernel) {
+    size_t off = 0;
+    for (int i = 0; i < in_cnt; i++) {
+        memcpy(staging + off, in[i].iov_base, in[i].iov_len);
+        off += in[i].iov_len;
+    }
+    kernel(staging, roundKey, staging, len / BLOCK_SIZE, &initial_ctr);
+    off = 0;
+    for (int i = 0; i < out_cnt; i++) {
+        memcpy(out[i].iov_base, staging + off, out[i].iov_len);
+        off += out[i].iov_len;
+    }
+}
+
+/**
+ * Random chains: different random boundaries on each side, random starting
+ * offsets into the keystream and messages split across two calls, all
+ * compared with contiguous CTR over the same bytes.
+ */
+static int check_random(const uint8_t* input, const uint8_t* expected, uint8_t* output, size_t max_len,
+                        struct iovec* in_iov, struct iovec* out_iov) {
+    srand(7);
+    for (int t = 0; t < RANDOM_TRIALS; t++) {
+        size_t len = 1 + (size_t)rand() % (t % 2 ? 4096 : max_len);
+        size_t skip = (size_t)rand() % 100;         // keystream offset, usually mid-block
+        size_t split = (size_t)rand() % (len + 1);  // first call covers [0, split)
+        size_t max_seg = t % 4 == 1 ? 40 : 5000;   // tiny segments only on the short trials
+
+        memset(output, 0, len);
+        int in_cnt = random_chain((uint8_t*)input + skip, split, max_seg, in_iov);
+        int out_cnt = random_chain(output, split, max_seg, out_iov);
+        if (aesctr_encv(in_iov, in_cnt, out_iov, out_cnt, roundKey, &initial_ctr, skip) != (int64_t)split) {
+            return 0;
+        }
+        in_cnt = random_chain((uint8_t*)input + skip + split, len - split, max_seg, in_iov);
+        out_cnt = random_chain(output + split, len - split, max_seg, out_iov);
+        if (aesctr_encv_pool(NULL, in_iov, in_cnt, out_iov, out_cnt, roundKey, &initial_ctr, skip + split)
+            != (int64_t)(len - split)) {
+            return 0;
+        }
+        if (memcmp(output, expected + skip, len) != 0) {
+            printf("  trial %d: len %zu skip %zu split %zu mismatch\n", t, len, skip, split);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * usage: tester_iov [mb]
+ *
+ * Checks aesctr_encv and aesctr_encv_pool on random chains against contiguous
+ * CTR, then times fixed segment sizes against gathering into a staging
+ * buffer, encrypting it and scattering it back.
+ */
+int main(int argc, char** argv) {
+    size_t bytes = (argc > 1 ? strtoul(argv[1], NULL, 10) : TEST_MB) * 1024 * 1024;
+    if (bytes == 0) {
+        printf("Size must be at least 1 MB\n");
+        return 1;
+    }
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+
+    size_t max_segments = bytes / 64 + 1;
+    uint8_t* input = (uint8_t*)aes_buf_alloc(bytes + 128, AES_BUF_PREFAULT);
+    uint8_t* expected = (uint8_t*)aes_buf_alloc(bytes + 128, AES_BUF_PREFAULT);
+    uint8_t* output = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* staging = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    struct iovec* in_iov = (struct iovec*)malloc(max_segments * sizeof(struct iovec));
+    struct iovec* out_iov = (struct iovec*)malloc(max_segments * sizeof(struct iovec));
+    if (!input || !expected || !output || !staging || !in_iov || !out_iov) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    aes_datagen_fill(input, bytes + 128, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+    aesctr_enc_openmp(input, roundKey, expected, (bytes + 128) / BLOCK_SIZE, &initial_ctr);
+
+    int ok = check_random(input, expected, output, bytes, in_iov, out_iov);
+    printf("Random chains, offsets and split calls (%d trials): %s\n\n", RANDOM_TRIALS, ok ? "Yes" : "No");
+
+    const char* kernel_name;
+    aesctr_bulk_fn kernel = aes_select_bulk_kernel(&kernel_name);
+    double gb = (double)bytes / (1 << 30);
+    printf("Buffer: %zu MB, kernel: %s, best of %d\n", bytes >> 20, kernel_name, REPEATS);
+    printf("%-12s %10s %10s %10s %8s\n", "segments", "staging", "encv", "encv_pool", "match");
+
+    for (size_t s = 0; s < NUM_SHAPES; s++) {
+        // Output boundaries offset from the input's, so runs rarely line up
+        int in_cnt = fixed_chain(input, bytes, shapes[s].seg_bytes, in_iov);
+        int out_cnt = shapes[s].seg_bytes ? fixed_chain(output, bytes, shapes[s].seg_bytes + 16, out_iov)
+                                          : fixed_chain(output, bytes, 0, out_iov);
+        double best[3] = {0};
+        int match = 1;
+
+        for (int r = 0; r < REPEATS; r++) {
+            double start = bench_now();
+            gather_encrypt_scatter(in_iov, in_cnt, out_iov, out_cnt, staging, bytes, kernel);
+            double t0 = bench_now() - start;
+            match = match && memcmp(output, expected, bytes) == 0;
+
+            memset(output, 0, bytes);
+            start = bench_now();
+            aesctr_encv(in_iov, in_cnt, out_iov, out_cnt, roundKey, &initial_ctr, 0);
+            double t1 = bench_now() - start;
+            match = match && memcmp(output, expected, bytes) == 0;
+
+            memset(output, 0, bytes);
+            start = bench_now();
+            aesctr_encv_pool(NULL, in_iov, in_cnt, out_iov, out_cnt, roundKey, &initial_ctr, 0);
+            double t2 = bench_now() - start;
+            match = match && memcmp(output, expected, bytes) == 0;
+
+            double t[3] = { t0, t1, t2 };
+            for (int k = 0; k < 3; k++) {
+                if (r == 0 || t[k] < best[k]) best[k] = t[k];
+            }
+        }
+
+        printf("%-12s %10.2f %10.2f %10.2f %8s\n", shapes[s].name, gb / best[0], gb / best[1], gb / best[2],
+               match ? "Yes" : "No");
+        ok = ok && match;
+    }
+    printf("(GB/s)\n");
+
+    aes_buf_free(input);
+    aes_buf_free(expected);
+    aes_buf_free(output);
+    aes_buf_free(staging);
+    free(in_iov);
+    free(out_iov);
+    return ok ? 0 : 1;
+}
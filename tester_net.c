@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+
+#include "aes.h"
+#include "net.h"
+#include "dispatch.h"
+#include "bench.h"
+#include "datagen.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define TEST_MB 256
+#define COPY_BUF (256 * 1024)
+
+typedef enum {
+    MODE_ZEROCOPY,      // aes_net_send_file with MSG_ZEROCOPY
+    MODE_WRITEV,        // aes_net_send_file, writev fallback
+    MODE_COPY,          // read, encrypt into a fresh buffer, write: the usual loop
+    MODE_SENDFILE       // plaintext sendfile, no encryption: the ceiling
+} send_mode_t;
+
+static const char* mode_names[] = { "zerocopy", "writev", "read+enc+write", "sendfile (plain)" };
+
+typedef struct {
+    struct sockaddr_in addr;
+    int file_fd;
+    size_t len;
+    send_mode_t mode;
+    aes_net_stats_t stats;
+    int ok;
+} sender_t;
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+static ctr_block_t initial_ctr = {
+    .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+// The usual loop the zerocopy sender replaces: a read buffer, an output buffer, write()
+static int send_copy(int sock, int fd, size_t len) {
+    uint8_t* in = (uint8_t*)malloc(COPY_BUF);
+    uint8_t* out = (uint8_t*)malloc(COPY_BUF);
+    aesctr_bulk_fn kernel = aes_select_bulk_kernel(NULL);
+    int ok = in && out;
+
+    for (size_t off = 0; ok && off < len;) {
+        ssize_t r = pread(fd, in, COPY_BUF, (off_t)off);
+        if (r <= 0) {
+            ok = 0;
+            break;
+        }
+        // Full buffers only until the end, so every read starts on a block boundary
+        size_t blocks = ((size_t)r + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        ctr_block_t ctr;
+        ctr_block_advance(&initial_ctr, &ctr, off / BLOCK_SIZE);
+        kernel(in, roundKey, out, blocks, &ctr);
+        for (ssize_t done = 0; ok && done < r;) {
+            ssize_t w = write(sock, out + done, (size_t)(r - done));
+            ok = w > 0;
+            done += w;
+        }
+        off += (size_t)r;
+    }
+    free(in);
+    free(out);
+    return ok;
+}
+
+static void* sender_main(void* arg) {
+    sender_t* s = (sender_t*)arg;
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&s->stats, 0, sizeof(s->stats));
+    if (sock < 0 || connect(sock, (struct sockaddr*)&s->addr, sizeof(s->addr)) < 0) {
+        s->ok = 0;
+        return NULL;
+    }
+    if (s->mode == MODE_ZEROCOPY || s->mode == MODE_WRITEV) {
+        aes_net_opts_t opts = { .no_zerocopy = s->mode == MODE_WRITEV };
+        s->ok = aes_net_send_file(sock, s->file_fd, 0, s->len, roundKey, &initial_ctr, &opts, &s->stats)
+                == (int64_t)s->len;
+    } else if (s->mode == MODE_COPY) {
+        s->ok = send_copy(sock, s->file_fd, s->len);
+    } else {
+        off_t off = 0;
+        s->ok = 1;
+        while (s->ok && (size_t)off < s->len) {
+            s->ok = sendfile(sock, s->file_fd, &off, s->len - (size_t)off) > 0;
+        }
+    }
+    close(sock);
+    return NULL;
+}
+
+// Plain receive for the sendfile baseline
+static int64_t recv_plain(int sock) {
+    static uint8_t buf[COPY_BUF];
+    int64_t total = 0;
+    ssize_t r;
+    while ((r = recv(sock, buf, sizeof(buf), 0)) > 0) {
+        total += r;
+    }
+    return r < 0 ? -1 : total;
+}
+
+/**
+ * One transfer over loopback: sender thread against a receiver on this
+ * thread, which writes plaintext to out_fd (-1 to discard).
+ * return: seconds end to end, or -1 on failure
+ */
+static double transfer(int listen_fd, sender_t* s, int out_fd, aes_net_stats_t* rstats) {
+    pthread_t thread;
+    double start = bench_now();
+
+    pthread_create(&thread, NULL, sender_main, s);
+    int sock = accept(listen_fd, NULL, NULL);
+    int64_t got = -1;
+    if (sock >= 0) {
+        if (s->mode == MODE_SENDFILE) {
+            got = recv_plain(sock);
+        } else {
+            got = aes_net_recv(sock, out_fd, roundKey, &initial_ctr, NULL, rstats);
+        }
+        close(sock);
+    }
+    pthread_join(thread, NULL);
+    double seconds = bench_now() - start;
+    return s->ok && got == (int64_t)s->len ? seconds : -1;
+}
+
+static int same_as_source(int out_fd, const uint8_t* source, size_t len) {
+    uint8_t* out = (uint8_t*)mmap(NULL, len, PROT_READ, MAP_SHARED, out_fd, 0);
+    if (out == MAP_FAILED) {
+        return 0;
+    }
+    int same = memcmp(out, source, len) == 0;
+    munmap(out, len);
+    return same;
+}
+
+/**
+ * usage: tester_net [mb]
+ *
+ * Streams an encrypted file over TCP loopback with the zerocopy sender and
+ * with its writev fallback, decrypts in place on the receiving side and
+ * checks the plaintext matches, then reports end-to-end throughput next to a
+ * read/encrypt/write loop and a plaintext sendfile. Loopback always copies
+ * zerocopy sends (reported as "copied"); a real NIC is needed to see the
+ * saving.
+ */
+int main(int argc, char** argv) {
+    size_t bytes = (argc > 1 ? strtoul(argv[1], NULL, 10) : TEST_MB) * 1024 * 1024 + 1234;  // odd tail on purpose
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+
+    char src_path[64], out_path[64];
+    snprintf(src_path, sizeof(src_path), "/tmp/aesctr-net-src-%d", (int)getpid());
+    snprintf(out_path, sizeof(out_path), "/tmp/aesctr-net-out-%d", (int)getpid());
+    int src_fd = open(src_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    int out_fd = open(out_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    uint8_t* source = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    if (src_fd < 0 || out_fd < 0 || !source) {
+        printf("Setup failed: %s\n", strerror(errno));
+        return 1;
+    }
+    aes_datagen_fill(source, bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+    if (write(src_fd, source, bytes) != (ssize_t)bytes) {
+        printf("Writing %s failed\n", src_path);
+        return 1;
+    }
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    sender_t s = { .file_fd = src_fd, .len = bytes };
+    socklen_t addr_len = sizeof(s.addr);
+    s.addr.sin_family = AF_INET;
+    s.addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    s.addr.sin_port = 0;
+    if (bind(listen_fd, (struct sockaddr*)&s.addr, sizeof(s.addr)) < 0 || listen(listen_fd, 4) < 0 ||
+        getsockname(listen_fd, (struct sockaddr*)&s.addr, &addr_len) < 0) {
+        printf("Loopback listen failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    int ok = 1;
+    for (send_mode_t mode = MODE_ZEROCOPY; mode <= MODE_WRITEV; mode++) {
+        aes_net_stats_t rstats;
+        s.mode = mode;
+        if (ftruncate(out_fd, 0) < 0 || lseek(out_fd, 0, SEEK_SET) < 0) {
+            return 1;
+        }
+        int match = transfer(listen_fd, &s, out_fd, &rstats) > 0 && same_as_source(out_fd, source, bytes);
+        printf("%-9s sender, in-place receiver, plaintext matches: %s\n", mode_names[mode], match ? "Yes" : "No");
+        ok = ok && match;
+    }
+
+    printf("\n%.1f MB over loopback, end to end, best of 3\n", bytes / (1024.0 * 1024));
+    printf("%-18s %8s %8s %10s %8s %8s\n", "sender", "GB/s", "sends", "zerocopy", "copied", "waits");
+    for (send_mode_t mode = MODE_ZEROCOPY; mode <= MODE_SENDFILE; mode++) {
+        aes_net_stats_t rstats;
+        double best = -1;
+        s.mode = mode;
+        for (int r = 0; r < 3; r++) {
+            double t = transfer(listen_fd, &s, -1, &rstats);
+            if (t < 0) {
+                ok = 0;
+            } else if (best < 0 || t < best) {
+                best = t;
+            }
+        }
+        printf("%-18s %8.2f", mode_names[mode], best > 0 ? bytes / best / (1 << 30) : 0.0);
+        if (mode <= MODE_WRITEV) {
+            printf(" %8llu %10llu %8llu %8llu", (unsigned long long)s.stats.calls,
+                   (unsigned long long)s.stats.zerocopy_sends, (unsigned long long)s.stats.zerocopy_copied,
+                   (unsigned long long)s.stats.buffer_waits);
+        }
+        printf("\n");
+    }
+
+    close(listen_fd);
+    close(src_fd);
+    close(out_fd);
+    unlink(src_path);
+    unlink(out_path);
+    aes_buf_free(source);
+    return ok ? 0 : 1;
+}
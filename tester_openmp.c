@@ -1,5 +1,11 @@
 #include "aes.h"
 #include "openmp.h"
+#include "datagen.h"
+#include "verify.h"
+#include "dispatch.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
 
 int main() {
     uint8_t key[16] = {
@@ -12,20 +18,22 @@ int main() {
     omp_set_num_threads(NUM_THREADS);
     
     // Aligned memory allocation
-    uint8_t *input = (uint8_t*)aligned_alloc(64, NUM_BLOCKS * 16);
-    uint8_t *output_serial = (uint8_t*)aligned_alloc(64, NUM_BLOCKS * 16);
-    uint8_t *output_parallel = (uint8_t*)aligned_alloc(64, NUM_BLOCKS * 16);
+    // Serial and parallel results share one buffer and are compared by chunk digests
+    size_t num_chunks = AES_VERIFY_NUM_CHUNKS((size_t)NUM_BLOCKS * 16);
+    uint8_t *input = (uint8_t*)aes_buf_alloc(NUM_BLOCKS * 16, AES_BUF_PREFAULT);
+    uint8_t *output = (uint8_t*)aes_buf_alloc(NUM_BLOCKS * 16, AES_BUF_PREFAULT);
+    uint64_t *digests_serial = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
+    uint64_t *digests_parallel = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
     uint8_t *roundKey = (uint8_t*)aligned_alloc(64, 176); // 11 round keys
+    uint8_t first_block_serial[16];
     
-    if (!input || !output_serial || !output_parallel || !roundKey) {
+    if (!input || !output || !digests_serial || !digests_parallel || !roundKey) {
         printf("Memory allocation failed!\n");
         return 1;
     }
     
     // Initialize input
-    for(int i = 0; i < NUM_BLOCKS * 16; i++) {
-        input[i] = i & 0xFF;
-    }
+    aes_datagen_fill(input, (size_t)NUM_BLOCKS * 16, AES_DATAGEN_RANDOM, DATAGEN_SEED);
     
 
     ctr_block_t initial_ctr = {
@@ -40,24 +48,39 @@ int main() {
     
     setup_counter_block(temp_counter, initial_ctr.nonce, 0);
     for(int i = 0; i < 1000; i++) {
-        aesctr_enc1block_serial(temp_counter, input, roundKey, output_serial);
+        aesctr_enc1block_serial(temp_counter, input, roundKey, output);
     }
     
     // Serial encryption
     double start_time = omp_get_wtime();
     aes_keyexpansion_serial(key, roundKey);
-    aesctr_enc_serial(input, roundKey, output_serial, NUM_BLOCKS, &initial_ctr);
+    aesctr_enc_serial(input, roundKey, output, NUM_BLOCKS, &initial_ctr);
     double serial_time = omp_get_wtime() - start_time;
+    aes_digest_chunks(output, (size_t)NUM_BLOCKS * 16, digests_serial);
+    memcpy(first_block_serial, output, 16);
     
     // Parallel encryption
     start_time = omp_get_wtime();
     aes_keyexpansion_serial(key, roundKey);
-    aesctr_enc_openmp(input, roundKey, output_parallel, NUM_BLOCKS, &initial_ctr);
+    aesctr_enc_openmp(input, roundKey, output, NUM_BLOCKS, &initial_ctr);
     double parallel_time = omp_get_wtime() - start_time;
     
     // Verify results
+    aes_digest_chunks(output, (size_t)NUM_BLOCKS * 16, digests_parallel);
     printf("Results match: %s\n", 
-           compare_buffers(output_serial, output_parallel, NUM_BLOCKS * 16) ? "Yes" : "No");
+           aes_digest_compare(digests_serial, digests_parallel, num_chunks) < 0 ? "Yes" : "No");
+
+    // Same job with guided grain-sized chunks
+    aes_openmp_set_schedule(AES_OMP_GUIDED);
+    memset(output, 0, (size_t)NUM_BLOCKS * 16);
+    start_time = omp_get_wtime();
+    aesctr_enc_openmp(input, roundKey, output, NUM_BLOCKS, &initial_ctr);
+    double guided_time = omp_get_wtime() - start_time;
+    aes_openmp_set_schedule(AES_OMP_STATIC);
+
+    aes_digest_chunks(output, (size_t)NUM_BLOCKS * 16, digests_parallel);
+    printf("Guided results match: %s\n",
+           aes_digest_compare(digests_serial, digests_parallel, num_chunks) < 0 ? "Yes" : "No");
     
     // Calculate throughput
     double data_size_gb = (double)(NUM_BLOCKS * BLOCK_SIZE) / (1024 * 1024 * 1024);
@@ -68,6 +91,12 @@ int main() {
     printf("Parallel Time: %.4f seconds (%.2f GB/s)\n", 
            parallel_time, data_size_gb / parallel_time);
     printf("Speedup: %.2fx\n", serial_time / parallel_time);
+    printf("Guided Time (grain %zu blocks): %.4f seconds (%.2f GB/s)\n",
+           aes_openmp_get_grain(), guided_time, data_size_gb / guided_time);
+
+    const char* kernel_name;
+    aes_select_bulk_kernel(&kernel_name);
+    printf("Bulk kernel: %s\n", kernel_name);
     
     // Print number of threads used
     #pragma omp parallel
@@ -78,18 +107,19 @@ int main() {
     
     printf("\nFirst block comparison:\nSerial: ");
     for(int i = 0; i < 16; i++) {
-        printf("%02x ", output_serial[i]);
+        printf("%02x ", first_block_serial[i]);
     }
     printf("\nParallel: ");
     for(int i = 0; i < 16; i++) {
-        printf("%02x ", output_parallel[i]);
+        printf("%02x ", output[i]);
     }
     printf("\n");
     
     // Clean up
-    free(input);
-    free(output_serial);
-    free(output_parallel);
+    aes_buf_free(input);
+    aes_buf_free(output);
+    free(digests_serial);
+    free(digests_parallel);
     free(roundKey);
     
     return 0;
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "aes.h"
+#include "page.h"
+#include "openmp.h"
+#include "pool.h"
+#include "bench.h"
+#include "datagen.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define TEST_MB 64
+#define FILE_ID 0x0123456789ABCDEFULL  // same bytes as the testers' usual nonce
+#define MIN_SECONDS 0.3
+
+static const size_t page_sizes[] = { 4096, 8192, 16384 };
+
+#define NUM_PAGE_SIZES (sizeof(page_sizes) / sizeof(page_sizes[0]))
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+
+// Every other page of the file, in shuffled order, as a checkpoint would flush dirty pages
+static size_t dirty_batch(uint8_t* file, uint8_t* out, size_t num_pages, size_t page_size, aes_page_t* pages) {
+    size_t count = 0;
+    for (size_t p = 0; p < num_pages; p += 2) {
+        pages[count].page_no = p;
+        pages[count].src = file + p * page_size;
+        pages[count].dst = out ? out + count * page_size : file + p * page_size;
+        count++;
+    }
+    for (size_t i = count; i > 1; i--) {
+        size_t j = (size_t)rand() % i;
+        aes_page_t t = pages[i - 1];
+        pages[i - 1] = pages[j];
+        pages[j] = t;
+    }
+    return count;
+}
+
+static int check_batch(const aes_page_t* pages, size_t count, size_t page_size, const uint8_t* expected) {
+    for (size_t i = 0; i < count; i++) {
+        if (memcmp(pages[i].dst, expected + pages[i].page_no * page_size, page_size) != 0) {
+            printf("  page %llu mismatch\n", (unsigned long long)pages[i].page_no);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * usage: tester_page [mb]
+ *
+ * Encrypts a batch of non-adjacent, shuffled pages of a file for several page
+ * sizes and checks each page against CTR over the whole file with
+ * nonce = file id. Then compares page-at-a-time encryption, through
+ * aesctr_enc_openmp and through one-page aesctr_enc_pages calls, with
+ * aesctr_enc_pages and aesctr_enc_pages_pool on the whole batch.
+ */
+int main(int argc, char** argv) {
+    size_t bytes = (argc > 1 ? strtoul(argv[1], NULL, 10) : TEST_MB) * 1024 * 1024;
+    if (bytes == 0) {
+        printf("Size must be at least 1 MB\n");
+        return 1;
+    }
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+    ctr_block_t file_ctr;
+    aes_page_ctr(FILE_ID, 0, page_sizes[0], &file_ctr);
+
+    uint8_t* file = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* expected = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* out = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    aes_page_t* pages = (aes_page_t*)malloc((bytes / page_sizes[0]) * sizeof(aes_page_t));
+    if (!file || !expected || !out || !pages) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    aes_datagen_fill(file, bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+    aesctr_enc_openmp(file, roundKey, expected, bytes / BLOCK_SIZE, &file_ctr);
+
+    int ok = 1;
+    srand(3);
+    for (size_t s = 0; s < NUM_PAGE_SIZES; s++) {
+        size_t page_size = page_sizes[s];
+        size_t num_pages = bytes / page_size;
+        int match = 1;
+
+        size_t count = dirty_batch(file, out, num_pages, page_size, pages);
+        memset(out, 0, bytes);
+        aesctr_enc_pages(pages, count, page_size, FILE_ID, roundKey);
+        match = match && check_batch(pages, count, page_size, expected);
+
+        memset(out, 0, bytes);
+        aesctr_enc_pages_pool(NULL, pages, count, page_size, FILE_ID, roundKey);
+        match = match && check_batch(pages, count, page_size, expected);
+
+        // In place, then back again
+        count = dirty_batch(file, NULL, num_pages, page_size, pages);
+        aesctr_enc_pages_pool(NULL, pages, count, page_size, FILE_ID, roundKey);
+        match = match && check_batch(pages, count, page_size, expected);
+        aesctr_enc_pages(pages, count, page_size, FILE_ID, roundKey);
+
+        printf("%5zu KB pages, %zu of %zu pages shuffled: %s\n", page_size / 1024, count, num_pages,
+               match ? "Yes" : "No");
+        ok = ok && match;
+    }
+
+    errno = 0;
+    int rejected = aesctr_enc_pages(pages, 1, 4100, FILE_ID, roundKey) == -1 && errno == EINVAL;
+    printf("Page size not a multiple of 16 rejected: %s\n\n", rejected ? "Yes" : "No");
+    ok = ok && rejected;
+
+    printf("Batch of %zu MB, pool: %d workers\n", bytes >> 21, aes_pool_num_threads(aes_pool_default()));
+    printf("%-8s %12s %12s %12s %12s\n", "page", "openmp/page", "pages/page", "pages", "pages_pool");
+    for (size_t s = 0; s < NUM_PAGE_SIZES; s++) {
+        size_t page_size = page_sizes[s];
+        size_t count = dirty_batch(file, out, bytes / page_size, page_size, pages);
+        double gbs[4];
+
+        for (int mode = 0; mode < 4; mode++) {
+            size_t done = 0;
+            double start = bench_now(), elapsed;
+            do {
+                if (mode == 0) {
+                    ctr_block_t ctr;
+                    for (size_t i = 0; i < count; i++) {
+                        aes_page_ctr(FILE_ID, pages[i].page_no, page_size, &ctr);
+                        aesctr_enc_openmp((uint8_t*)pages[i].src, roundKey, pages[i].dst, page_size / BLOCK_SIZE,
+                                          &ctr);
+                    }
+                } else if (mode == 1) {
+                    for (size_t i = 0; i < count; i++) {
+                        aesctr_enc_pages(&pages[i], 1, page_size, FILE_ID, roundKey);
+                    }
+                } else if (mode == 2) {
+                    aesctr_enc_pages(pages, count, page_size, FILE_ID, roundKey);
+                } else {
+                    aesctr_enc_pages_pool(NULL, pages, count, page_size, FILE_ID, roundKey);
+                }
+                done += count * page_size;
+                elapsed = bench_now() - start;
+            } while (elapsed < MIN_SECONDS);
+            gbs[mode] = (double)done / elapsed / (1 << 30);
+        }
+        printf("%5zu KB %12.2f %12.2f %12.2f %12.2f\n", page_size / 1024, gbs[0], gbs[1], gbs[2], gbs[3]);
+    }
+    printf("(GB/s)\n");
+
+    aes_buf_free(file);
+    aes_buf_free(expected);
+    aes_buf_free(out);
+    free(pages);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/syscall.h>
+
+#include "aes.h"
+#include "fileenc.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "datagen.h"
+#include "verify.h"
+#include "bench.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define FILE_MB 128
+#define TAIL_BYTES 13   // not a whole block, to exercise the partial last block
+
+/**
+ * Fault injection: the pipeline reaches io_uring through syscall(), so this
+ * definition stands in for libc's. With enter_budget >= 0, that many more
+ * io_uring_enter calls go through and the next one fails with EIO.
+ */
+static int enter_budget = -1;
+
+long syscall(long number, ...) {
+    static long (*real_syscall)(long, ...);
+    long a[6];
+    va_list ap;
+
+    va_start(ap, number);
+    for (int i = 0; i < 6; i++) {
+        a[i] = va_arg(ap, long);
+    }
+    va_end(ap);
+
+    if (number == __NR_io_uring_enter && enter_budget >= 0 && enter_budget-- == 0) {
+        errno = EIO;
+        return -1;
+    }
+    if (!real_syscall) {
+        real_syscall = (long (*)(long, ...))dlsym(RTLD_NEXT, "syscall");
+    }
+    return real_syscall(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+static int write_file(const char* path, const uint8_t* buf, size_t len) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    for (size_t done = 0; done < len; ) {
+        ssize_t n = write(fd, buf + done, len - done);
+        if (n <= 0) { close(fd); return -1; }
+        done += n;
+    }
+    return close(fd);
+}
+
+static int read_file(const char* path, uint8_t* buf, size_t len) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    for (size_t done = 0; done < len; ) {
+        ssize_t n = read(fd, buf + done, len - done);
+        if (n <= 0) { close(fd); return -1; }
+        done += n;
+    }
+    return close(fd);
+}
+
+typedef struct {
+    const char* name;
+    aes_pipeline_io_t io;
+    int direct;
+} config_t;
+
+static const config_t configs[] = {
+    { "io_uring",          AES_PIPELINE_URING,   0 },
+    { "io_uring O_DIRECT", AES_PIPELINE_URING,   1 },
+    { "threads",           AES_PIPELINE_THREADS, 0 },
+    { "threads O_DIRECT",  AES_PIPELINE_THREADS, 1 },
+};
+
+/**
+ * usage: tester_pipeline [dir] [file_mb]
+ * dir should be on the device under test; tmpfs has no O_DIRECT and runs those rows buffered.
+ */
+int main(int argc, char** argv) {
+    const char* dir = argc > 1 ? argv[1] : "/tmp";
+    size_t len = (argc > 2 ? strtoul(argv[2], NULL, 10) : FILE_MB) * 1024 * 1024 + TAIL_BYTES;
+    double gb = len / (1024.0 * 1024.0 * 1024.0);
+    char plain_path[4096], cipher_path[4096], ref_path[4096];
+
+    snprintf(plain_path, sizeof(plain_path), "%s/aes_pipeline_plain.%d", dir, (int)getpid());
+    snprintf(cipher_path, sizeof(cipher_path), "%s/aes_pipeline_cipher.%d", dir, (int)getpid());
+    snprintf(ref_path, sizeof(ref_path), "%s/aes_pipeline_ref.%d", dir, (int)getpid());
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    uint8_t roundKey[176];
+    ctr_block_t initial_ctr = {
+        .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+        .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+    };
+    aes_keyexpansion_serial(key, roundKey);
+
+    size_t num_chunks = AES_VERIFY_NUM_CHUNKS(len);
+    uint8_t* plain = (uint8_t*)aes_buf_alloc((len + 63) / 64 * 64, AES_BUF_PREFAULT);
+    uint8_t* buf = (uint8_t*)aes_buf_alloc((len + 63) / 64 * 64, AES_BUF_PREFAULT);
+    uint64_t* digests_ref = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
+    uint64_t* digests = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
+    if (!plain || !buf || !digests_ref || !digests) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+
+    aes_datagen_fill(plain, len, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+    if (write_file(plain_path, plain, len) < 0) {
+        perror(plain_path);
+        return 1;
+    }
+
+    // Start the workers outside the timed runs
+    aes_pool_default();
+
+    // mmap path as the reference, itself checked against the serial reference
+    double start = bench_now();
+    int ok = aes_encrypt_file(plain_path, ref_path, roundKey, &initial_ctr) == (int64_t)len;
+    double mmap_time = bench_now() - start;
+    ok = ok && read_file(ref_path, buf, len) == 0;
+    size_t mismatch;
+    ok = ok && aes_verify_ctr(plain, buf, len / BLOCK_SIZE, roundKey, &initial_ctr, &mismatch);
+    aes_digest_chunks(buf, len, digests_ref);
+
+    printf("File size: %zu bytes, %d pool threads\n\n", len, aes_pool_num_threads(aes_pool_default()));
+    printf("%-20s %10s %8s %8s %8s %8s\n", "engine", "GB/s", "reads", "writes", "fixed", "match");
+    printf("%-20s %10.2f %8s %8s %8s %8s\n", "mmap", gb / mmap_time, "-", "-", "-", ok ? "Yes" : "No");
+
+    int all_match = ok;
+    for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+        aes_pipeline_opts_t opts = {0};
+        aes_pipeline_stats_t stats;
+
+        opts.io = configs[c].io;
+        opts.direct = configs[c].direct;
+
+        start = bench_now();
+        int64_t bytes = aes_encrypt_file_pipeline(plain_path, cipher_path, roundKey, &initial_ctr, &opts, &stats);
+        double seconds = bench_now() - start;
+
+        if (bytes < 0) {
+            printf("%-20s %10s  %s\n", configs[c].name, "-", strerror(errno));
+            if (configs[c].io != AES_PIPELINE_URING) all_match = 0;
+            continue;
+        }
+
+        int match = bytes == (int64_t)len && read_file(cipher_path, buf, len) == 0;
+        if (match) {
+            aes_digest_chunks(buf, len, digests);
+            match = aes_digest_compare(digests_ref, digests, num_chunks) < 0;
+        }
+        all_match &= match;
+
+        printf("%-20s %10.2f %8llu %8llu %8s %8s%s\n", configs[c].name, gb / seconds,
+               (unsigned long long)stats.reads, (unsigned long long)stats.writes,
+               stats.registered ? "yes" : "no", match ? "Yes" : "No",
+               configs[c].direct && !stats.direct ? "  (no O_DIRECT here, buffered)" : "");
+    }
+
+    /*
+     * I/O errors mid-file, with reads, encryptions and writes in flight: the
+     * call must fail with the error and hand every buffer back first, which
+     * the runs after it depend on.
+     */
+    int faults_ok = 1;
+    for (size_t c = 0; c < 3; c++) {
+        aes_pipeline_opts_t opts = {0};
+        int want = c < 2 ? ENOSPC : EIO;
+
+        opts.io = c == 1 ? AES_PIPELINE_THREADS : AES_PIPELINE_URING;
+        opts.buf_size = 64 * 1024;
+        opts.depth = 16;
+        if (c == 2) enter_budget = 8;
+        // /dev/full fails every write with ENOSPC
+        int64_t bytes = aes_encrypt_file_pipeline(plain_path, c < 2 ? "/dev/full" : cipher_path,
+                                                  roundKey, &initial_ctr, &opts, NULL);
+        int saved_errno = errno;
+        enter_budget = -1;
+        if (bytes < 0 && opts.io == AES_PIPELINE_URING && (saved_errno == ENOSYS || saved_errno == EPERM)) {
+            continue;   // no io_uring here
+        }
+        faults_ok &= bytes == -1 && saved_errno == want;
+    }
+    printf("\nI/O errors fail cleanly: %s\n", faults_ok ? "Yes" : "No");
+    all_match &= faults_ok;
+
+    // In place: decrypting the reference file must give back the plaintext
+    int64_t bytes = aes_encrypt_file_pipeline(ref_path, NULL, roundKey, &initial_ctr, NULL, NULL);
+    int roundtrip = bytes == (int64_t)len && read_file(ref_path, buf, len) == 0 && memcmp(buf, plain, len) == 0;
+    printf("In-place round trip matches: %s\n", roundtrip ? "Yes" : "No");
+    all_match &= roundtrip;
+
+    unlink(plain_path);
+    unlink(cipher_path);
+    unlink(ref_path);
+    aes_buf_free(plain);
+    aes_buf_free(buf);
+    free(digests_ref);
+    free(digests);
+
+    return all_match ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "aes.h"
+#include "pool.h"
+#include "dispatch.h"
+#include "bench.h"
+#include "datagen.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define BULK_MB 256
+#define PROBE_BYTES (64 * 1024)     // one latency-class request
+#define PROBES 1000
+#define PROBE_GAP_US 200            // think time between requests
+
+typedef enum {
+    BULK_NONE,
+    BULK_FIFO,          // aesctr_enc_pool: one range per worker, same queue as the probes
+    BULK_CLASS,         // aesctr_enc_pool_bulk on every worker
+    BULK_CAPPED         // aesctr_enc_pool_bulk on half of the workers
+} scenario_t;
+
+static const char* scenario_names[] = { "idle", "bulk, FIFO", "bulk class", "bulk class, half cap" };
+
+typedef struct {
+    aes_pool_t* pool;
+    scenario_t scenario;
+    uint8_t* in;
+    uint8_t* out;
+    size_t num_blocks;
+    _Atomic int stop;
+    uint64_t bytes;
+} bulk_t;
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+static ctr_block_t initial_ctr = {
+    .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+// The backup: whole-buffer jobs back to back until told to stop
+static void* bulk_main(void* arg) {
+    bulk_t* b = (bulk_t*)arg;
+    while (!atomic_load(&b->stop)) {
+        if (b->scenario == BULK_FIFO) {
+            aesctr_enc_pool(b->pool, b->in, roundKey, b->out, b->num_blocks, &initial_ctr);
+        } else {
+            aesctr_enc_pool_bulk(b->pool, b->in, roundKey, b->out, b->num_blocks, &initial_ctr);
+        }
+        b->bytes += b->num_blocks * BLOCK_SIZE;
+    }
+    return NULL;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * usage: tester_prio [bulk_mb]
+ *
+ * Checks aesctr_enc_pool_bulk against aesctr_enc_pool, then times 64 KB
+ * latency-class requests issued from this thread while a background thread
+ * keeps the pool busy with whole-buffer jobs: none, plain FIFO jobs, bulk
+ * class jobs and bulk class jobs capped to half of the workers. Reports
+ * request latency percentiles and the throughput left to the bulk job.
+ */
+int main(int argc, char** argv) {
+    size_t bytes = (argc > 1 ? strtoul(argv[1], NULL, 10) : BULK_MB) * 1024 * 1024;
+    size_t num_blocks = bytes / BLOCK_SIZE - 3;    // not a whole number of chunks
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+
+    aes_pool_t* pool = aes_pool_create(0);
+    uint8_t* in = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* out = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* expected = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* probe_out = (uint8_t*)malloc(PROBE_BYTES);
+    uint8_t probe_expected[PROBE_BYTES];
+    double* latency = (double*)malloc(PROBES * sizeof(double));
+    if (!pool || !in || !out || !expected || !probe_out || !latency) {
+        printf("Setup failed\n");
+        return 1;
+    }
+    aes_datagen_fill(in, bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+
+    aesctr_enc_pool(pool, in, roundKey, expected, num_blocks, &initial_ctr);
+    int ok = 1;
+    for (int cap = 0; cap <= 1; cap++) {
+        aes_pool_set_bulk_workers(pool, cap ? 1 : 0);
+        memset(out, 0, bytes);
+        aesctr_enc_pool_bulk(pool, in, roundKey, out, num_blocks, &initial_ctr);
+        int match = memcmp(out, expected, num_blocks * BLOCK_SIZE) == 0;
+        printf("aesctr_enc_pool_bulk matches aesctr_enc_pool (%s): %s\n", cap ? "one bulk worker" : "no cap",
+               match ? "Yes" : "No");
+        ok = ok && match;
+    }
+    ctr_block_t probe_ctr = initial_ctr;
+    aes_select_bulk_kernel(NULL)(in, roundKey, probe_expected, PROBE_BYTES / BLOCK_SIZE, &probe_ctr);
+
+    int threads = aes_pool_num_threads(pool);
+    printf("\n%d pool workers, %zu MB bulk jobs, %d requests of %d KB\n", threads, bytes >> 20, PROBES,
+           PROBE_BYTES >> 10);
+    printf("%-22s %10s %10s %10s %12s\n", "background", "p50 us", "p99 us", "max us", "bulk GB/s");
+    for (scenario_t sc = BULK_NONE; sc <= BULK_CAPPED; sc++) {
+        bulk_t b = { pool, sc, in, out, num_blocks, 0, 0 };
+        pthread_t thread;
+
+        aes_pool_set_bulk_workers(pool, sc == BULK_CAPPED ? (threads + 1) / 2 : 0);
+        if (sc != BULK_NONE) {
+            pthread_create(&thread, NULL, bulk_main, &b);
+            usleep(20000);      // let the first bulk job fill the queue
+        }
+        double start = bench_now();
+        int probe_ok = 1;
+        for (int i = 0; i < PROBES; i++) {
+            double t = bench_now();
+            aesctr_enc_pool(pool, in, roundKey, probe_out, PROBE_BYTES / BLOCK_SIZE, &initial_ctr);
+            latency[i] = bench_now() - t;
+            probe_ok = probe_ok && memcmp(probe_out, probe_expected, PROBE_BYTES) == 0;
+            usleep(PROBE_GAP_US);
+        }
+        double seconds = bench_now() - start;
+        if (sc != BULK_NONE) {
+            atomic_store(&b.stop, 1);
+            pthread_join(thread, NULL);
+        }
+
+        qsort(latency, PROBES, sizeof(double), cmp_double);
+        printf("%-22s %10.1f %10.1f %10.1f %12.2f%s\n", scenario_names[sc], latency[PROBES / 2] * 1e6,
+               latency[PROBES * 99 / 100] * 1e6, latency[PROBES - 1] * 1e6, b.bytes / seconds / (1 << 30),
+               probe_ok ? "" : "  (request output differs)");
+        ok = ok && probe_ok;
+    }
+
+    aes_pool_destroy(pool);
+    aes_buf_free(in);
+    aes_buf_free(out);
+    aes_buf_free(expected);
+    free(probe_out);
+    free(latency);
+    return ok ? 0 : 1;
+}
@@ -6,26 +6,33 @@
 #include <time.h>
 
 #include "aes.h"
-#include "pthread.h"
+#include "aes_pthread.h"
+#include "datagen.h"
+#include "verify.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
 
 int main() {
-    // Test parameters for 1GB
-    const size_t total_size = ONE_GB;
+    const size_t total_size = (size_t)NUM_BLOCKS * BLOCK_SIZE;
     printf("Benchmark parameters:\n");
-    printf("Total data size: 1 GB\n");
+    printf("Total data size: %d MB\n", MB_TO_TEST);
     printf("Block size: %d bytes\n", BLOCK_SIZE);
-    printf("Number of blocks: %zu\n", NUM_BLOCKS);
+    printf("Number of blocks: %zu\n", (size_t)NUM_BLOCKS);
     printf("Number of threads: %d\n\n", NUM_THREADS);
     
     // Allocate memory
     printf("Allocating memory...\n");
-    uint8_t* input = (uint8_t*)malloc(total_size);
-    uint8_t* output_serial = (uint8_t*)malloc(total_size);
-    uint8_t* output_parallel = (uint8_t*)malloc(total_size);
+    // Serial and parallel results share one buffer and are compared by chunk digests
+    const size_t num_chunks = AES_VERIFY_NUM_CHUNKS(total_size);
+    uint8_t* input = (uint8_t*)aes_buf_alloc(total_size, AES_BUF_PREFAULT);
+    uint8_t* output = (uint8_t*)aes_buf_alloc(total_size, AES_BUF_PREFAULT);
+    uint64_t* digests_serial = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
+    uint64_t* digests_parallel = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
     uint8_t *roundKey = (uint8_t*)aligned_alloc(64, 176); // 11 round keys
 
     
-    if (!input || !output_serial || !output_parallel) {
+    if (!input || !output || !digests_serial || !digests_parallel || !roundKey) {
         printf("Failed to allocate memory!\n");
         return 1;
     }
@@ -42,27 +49,25 @@ int main() {
     };
     
     // Initialize input with random data
-    printf("Initializing input data...\n");
-    srand(time(NULL));
-    for(size_t i = 0; i < total_size; i++) {
-        input[i] = rand() % 256;
-    }
+    printf("Initializing input data (seed %#llx)...\n", DATAGEN_SEED);
+    aes_datagen_fill(input, total_size, AES_DATAGEN_RANDOM, DATAGEN_SEED);
     
     // Run serial version
     printf("Running serial encryption...\n");
     struct timespec start, end;
     clock_gettime(CLOCK_MONOTONIC, &start);
     aes_keyexpansion_serial(key, roundKey);
-    aesctr_enc_serial(input, roundKey, output_serial, NUM_BLOCKS, initial_ctr);
+    aesctr_enc_serial(input, roundKey, output, NUM_BLOCKS, &initial_ctr);
     clock_gettime(CLOCK_MONOTONIC, &end);
     double serial_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
     printf("Serial time: %.3f seconds\n", serial_time);
+    aes_digest_chunks(output, total_size, digests_serial);
     
     // Run parallel version
     printf("Running parallel encryption...\n");
     clock_gettime(CLOCK_MONOTONIC, &start);
     aes_keyexpansion_serial(key, roundKey);
-    aesctr_enc_pthread(input, roundKey, output_parallel, NUM_BLOCKS, initial_ctr);
+    aesctr_enc_pthread(input, roundKey, output, NUM_BLOCKS, &initial_ctr);
     clock_gettime(CLOCK_MONOTONIC, &end);
     double parallel_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
     printf("Parallel time (%d threads): %.3f seconds\n", NUM_THREADS, parallel_time);
@@ -70,8 +75,8 @@ int main() {
     // Calculate speedup and throughput
     double speedup = serial_time / parallel_time;
     double efficiency = (speedup / NUM_THREADS) * 100;
-    double serial_throughput = (ONE_GB / (1024.0 * 1024.0 * 1024.0)) / serial_time;    // GB/s
-    double parallel_throughput = (ONE_GB / (1024.0 * 1024.0 * 1024.0)) / parallel_time; // GB/s
+    double serial_throughput = (total_size / (1024.0 * 1024.0 * 1024.0)) / serial_time;    // GB/s
+    double parallel_throughput = (total_size / (1024.0 * 1024.0 * 1024.0)) / parallel_time; // GB/s
     
     printf("\nPerformance metrics:\n");
     printf("Speedup: %.2fx\n", speedup);
@@ -81,24 +86,21 @@ int main() {
     
     // Verify results
     printf("\nVerifying results...\n");
-    int mismatch = 0;
-    for(size_t i = 0; i < total_size; i++) {
-        if(output_serial[i] != output_parallel[i]) {
-            printf("Mismatch at index %zu: serial=%02x, parallel=%02x\n", 
-                   i, output_serial[i], output_parallel[i]);
-            mismatch = 1;
-            break;
-        }
+    aes_digest_chunks(output, total_size, digests_parallel);
+    long mismatch = aes_digest_compare(digests_serial, digests_parallel, num_chunks);
+    if (mismatch >= 0) {
+        printf("Mismatch in bytes %zu..%zu\n",
+               (size_t)mismatch * AES_VERIFY_CHUNK, (size_t)(mismatch + 1) * AES_VERIFY_CHUNK - 1);
     }
-    printf("Results match: %s\n", mismatch ? "No" : "Yes");
+    printf("Results match: %s\n", mismatch >= 0 ? "No" : "Yes");
     
     // Clean up
     printf("Cleaning up...\n");
-    free(input);
-    free(output_serial);
-    free(output_parallel);
+    aes_buf_free(input);
+    aes_buf_free(output);
+    free(digests_serial);
+    free(digests_parallel);
     free(roundKey);
-    pthread_mutex_destroy(&key_mutex);
     
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "aes.h"
+#include "aesni.h"
+#include "vaes.h"
+#include "aes_pthread.h"
+#include "openmp.h"
+#include "pool.h"
+#include "bench.h"
+#include "datagen.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define MIN_SECONDS 0.1
+#define CEILING_RUNS 3
+
+typedef struct {
+    const char* name;
+    int threads;
+    int (*supported)();
+    void (*run)(uint8_t* input, uint8_t* output, size_t num_blocks);
+} backend_t;
+
+typedef struct {
+    const char* name;
+    size_t bytes;                // per buffer; input and output each take this much
+    bench_stream_t stream_1;     // single core
+    bench_stream_t stream_n;     // NUM_THREADS threads
+} level_t;
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+static __m128i key_schedule[11];
+static ctr_block_t initial_ctr = {
+    .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+static int always_supported() { return 1; }
+static int aesni_vaes_supported() { return check_aesni_support() && check_vaes_support(); }
+
+static void run_serial(uint8_t* input, uint8_t* output, size_t num_blocks) {
+    aesctr_enc_serial(input, roundKey, output, num_blocks, &initial_ctr);
+}
+
+static void run_aesni(uint8_t* input, uint8_t* output, size_t num_blocks) {
+    aesctr_enc_aesni(input, key_schedule, output, num_blocks, &initial_ctr);
+}
+
+static void run_vaes(uint8_t* input, uint8_t* output, size_t num_blocks) {
+    aesctr_enc_vaes(input, key_schedule, output, num_blocks, &initial_ctr);
+}
+
+static void run_pthread(uint8_t* input, uint8_t* output, size_t num_blocks) {
+    aesctr_enc_pthread(input, roundKey, output, num_blocks, &initial_ctr);
+}
+
+static void run_openmp(uint8_t* input, uint8_t* output, size_t num_blocks) {
+    aesctr_enc_openmp(input, roundKey, output, num_blocks, &initial_ctr);
+}
+
+static void run_vaes_pthread(uint8_t* input, uint8_t* output, size_t num_blocks) {
+    aesctr_enc_vaes_pthread(input, key_schedule, output, num_blocks, &initial_ctr);
+}
+
+static void run_pool(uint8_t* input, uint8_t* output, size_t num_blocks) {
+    aesctr_enc_pool(NULL, input, roundKey, output, num_blocks, &initial_ctr);
+}
+
+static const backend_t backends[] = {
+    { "serial",       1,           always_supported,     run_serial },
+    { "aesni",        1,           check_aesni_support,  run_aesni },
+    { "vaes",         1,           aesni_vaes_supported, run_vaes },
+    { "pthread",      NUM_THREADS, always_supported,     run_pthread },
+    { "openmp",       NUM_THREADS, always_supported,     run_openmp },
+    { "vaes+pthread", NUM_THREADS, aesni_vaes_supported, run_vaes_pthread },
+    { "pool",         NUM_THREADS, always_supported,     run_pool },
+};
+
+// Encrypted bytes per second in GB/s, repeating until min_seconds have passed
+static double measure_backend(const backend_t* backend, uint8_t* input, uint8_t* output,
+                              size_t bytes, double min_seconds) {
+    size_t num_blocks = bytes / BLOCK_SIZE;
+    size_t reps = 0;
+
+    backend->run(input, output, num_blocks);  // warm up
+
+    double start = bench_now();
+    double elapsed;
+    do {
+        backend->run(input, output, num_blocks);
+        reps++;
+        elapsed = bench_now() - start;
+    } while (elapsed < min_seconds);
+
+    return (double)bytes * reps / elapsed / (1024.0 * 1024.0 * 1024.0);
+}
+
+// Best single-core kernel on an L1-resident buffer: the per-core AES ceiling
+static double measure_aes_ceiling(uint8_t* input, uint8_t* output, size_t bytes, const char** kernel) {
+    const backend_t* best = &backends[0];
+    for(size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (backends[i].threads == 1 && backends[i].supported()) {
+            best = &backends[i];
+        }
+    }
+    *kernel = best->name;
+
+    double ceiling = 0;
+    for(int run = 0; run < CEILING_RUNS; run++) {
+        double gbs = measure_backend(best, input, output, bytes, MIN_SECONDS);
+        if (gbs > ceiling) {
+            ceiling = gbs;
+        }
+    }
+    return ceiling;
+}
+
+int main(int argc, char** argv) {
+    size_t dram_mb = argc > 1 ? strtoul(argv[1], NULL, 10) : MB_TO_TEST;
+    size_t l1, l2, llc;
+    int cpus = bench_num_cpus();
+
+    bench_cache_sizes(&l1, &l2, &llc);
+
+    // Input + output together fill half of each level; DRAM uses dram_mb per buffer
+    level_t levels[] = {
+        { .name = "L1",   .bytes = l1 / 4 },
+        { .name = "L2",   .bytes = l2 / 4 },
+        { .name = "LLC",  .bytes = llc / 4 },
+        { .name = "DRAM", .bytes = dram_mb * 1024 * 1024 },
+    };
+    int num_levels = sizeof(levels) / sizeof(levels[0]);
+    size_t max_bytes = 0;
+    for(int l = 0; l < num_levels; l++) {
+        if (levels[l].bytes > max_bytes) {
+            max_bytes = levels[l].bytes;
+        }
+    }
+
+    printf("Roofline parameters:\n");
+    printf("L1d: %zu KB, L2: %zu KB, LLC: %zu KB, DRAM buffer: %zu MB\n",
+           l1 / 1024, l2 / 1024, llc / 1024, dram_mb);
+    printf("Online CPUs: %d, threads for parallel backends: %d\n", cpus, NUM_THREADS);
+    if (levels[num_levels - 1].bytes < llc * 2) {
+        printf("Warning: DRAM buffer is smaller than 2x LLC, results may be cache-resident\n");
+    }
+
+    uint8_t* input = (uint8_t*)aes_buf_alloc(max_bytes, AES_BUF_PREFAULT);
+    uint8_t* output = (uint8_t*)aes_buf_alloc(max_bytes, AES_BUF_PREFAULT);
+    if (!input || !output) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    aes_datagen_fill(input, max_bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+    aes_datagen_fill(output, max_bytes, AES_DATAGEN_ZERO, 0);
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+    if (check_aesni_support()) {
+        aes_keyexpansion_aesni(key, key_schedule);
+    }
+
+    // Ceilings
+    const char* ceiling_kernel;
+    double aes_core_gbs = measure_aes_ceiling(input, output, levels[0].bytes, &ceiling_kernel);
+    int parallel_cores = NUM_THREADS < cpus ? NUM_THREADS : cpus;
+
+    printf("\nPer-core AES ceiling (%s, %zu KB in L1): %.2f GB/s\n",
+           ceiling_kernel, levels[0].bytes / 1024, aes_core_gbs);
+    printf("\nMemory ceilings (GB/s, copy counts read + write):\n");
+    printf("%-6s %10s | %8s %8s %8s | %8s %8s %8s\n",
+           "level", "buffer", "read1", "write1", "copy1", "readN", "writeN", "copyN");
+    for(int l = 0; l < num_levels; l++) {
+        bench_stream(input, output, levels[l].bytes, 1, MIN_SECONDS, &levels[l].stream_1);
+        bench_stream(input, output, levels[l].bytes, NUM_THREADS, MIN_SECONDS, &levels[l].stream_n);
+        printf("%-6s %8zuKB | %8.2f %8.2f %8.2f | %8.2f %8.2f %8.2f\n",
+               levels[l].name, levels[l].bytes / 1024,
+               levels[l].stream_1.read_gbs, levels[l].stream_1.write_gbs, levels[l].stream_1.copy_gbs,
+               levels[l].stream_n.read_gbs, levels[l].stream_n.write_gbs, levels[l].stream_n.copy_gbs);
+    }
+
+    // Every backend at every level. CTR reads and writes each byte once, so the
+    // memory roofline for encrypted bytes is half the copy bandwidth.
+    printf("\nBackend throughput as a fraction of the rooflines:\n");
+    printf("%-6s %-13s %8s %10s %10s %8s\n", "level", "backend", "GB/s", "%mem-roof", "%aes-roof", "bound");
+    for(int l = 0; l < num_levels; l++) {
+        for(size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+            const backend_t* backend = &backends[b];
+            if (!backend->supported()) {
+                continue;
+            }
+
+            const bench_stream_t* stream = backend->threads == 1 ? &levels[l].stream_1 : &levels[l].stream_n;
+            double mem_roof = stream->copy_gbs / 2;
+            double aes_roof = aes_core_gbs * (backend->threads == 1 ? 1 : parallel_cores);
+            double gbs = measure_backend(backend, input, output, levels[l].bytes, MIN_SECONDS);
+
+            printf("%-6s %-13s %8.2f %9.1f%% %9.1f%% %8s\n",
+                   levels[l].name, backend->name, gbs,
+                   100.0 * gbs / mem_roof, 100.0 * gbs / aes_roof,
+                   mem_roof < aes_roof ? "memory" : "compute");
+        }
+    }
+
+    aes_buf_free(input);
+    aes_buf_free(output);
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "aes.h"
+#include "aesni.h"
+#include "vaes.h"
+#include "aes_pthread.h"
+#include "openmp.h"
+#include "affinity.h"
+#include "bench.h"
+#include "datagen.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define STRONG_MB 64
+#define WEAK_MB_PER_THREAD 16
+
+typedef struct {
+    const char* name;
+    int (*supported)();
+    void (*run)(uint8_t* input, uint8_t* output, size_t num_blocks);
+} backend_t;
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+static __m128i key_schedule[11];
+static ctr_block_t initial_ctr = {
+    .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+static int always_supported() { return 1; }
+static int aesni_vaes_supported() { return check_aesni_support() && check_vaes_support(); }
+
+static void run_pthread(uint8_t* input, uint8_t* output, size_t num_blocks) {
+    aesctr_enc_pthread(input, roundKey, output, num_blocks, &initial_ctr);
+}
+
+static void run_openmp(uint8_t* input, uint8_t* output, size_t num_blocks) {
+    aesctr_enc_openmp(input, roundKey, output, num_blocks, &initial_ctr);
+}
+
+static void run_vaes_pthread(uint8_t* input, uint8_t* output, size_t num_blocks) {
+    aesctr_enc_vaes_pthread(input, key_schedule, output, num_blocks, &initial_ctr);
+}
+
+static const backend_t backends[] = {
+    { "pthread",      always_supported,     run_pthread },
+    { "openmp",       always_supported,     run_openmp },
+    { "vaes+pthread", aesni_vaes_supported, run_vaes_pthread },
+};
+
+static const aes_pin_policy_t policies[] = { AES_PIN_COMPACT, AES_PIN_SCATTER, AES_PIN_PHYSICAL };
+
+static double time_run(const backend_t* backend, uint8_t* input, uint8_t* output, size_t bytes) {
+    double start = bench_now();
+    backend->run(input, output, bytes / BLOCK_SIZE);
+    return bench_now() - start;
+}
+
+// Marks thread counts where the next thread lands on an SMT sibling or another socket
+static const char* boundary_note(const aes_topology_t* topo, int threads) {
+    if (threads == topo->num_cpus + 1) return "  <- oversubscribed";
+    if (topo->num_cpus > topo->num_cores && threads == topo->num_cores + 1) return "  <- SMT";
+    if (topo->num_packages > 1 && threads == topo->num_cores / topo->num_packages + 1) return "  <- 2nd socket";
+    return "";
+}
+
+/**
+ * usage: tester_scaling [max_threads] [strong_mb] [weak_mb_per_thread]
+ */
+int main(int argc, char** argv) {
+    aes_topology_t topo;
+    aes_get_topology(&topo);
+
+    int max_threads = argc > 1 ? atoi(argv[1]) : topo.num_cpus;
+    size_t strong_bytes = (argc > 2 ? strtoul(argv[2], NULL, 10) : STRONG_MB) * 1024 * 1024;
+    size_t weak_bytes = (argc > 3 ? strtoul(argv[3], NULL, 10) : WEAK_MB_PER_THREAD) * 1024 * 1024;
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > AES_MAX_THREADS) max_threads = AES_MAX_THREADS;
+
+    size_t max_bytes = weak_bytes * max_threads > strong_bytes ? weak_bytes * max_threads : strong_bytes;
+
+    printf("Scaling parameters:\n");
+    printf("CPUs: %d, physical cores: %d, sockets: %d\n", topo.num_cpus, topo.num_cores, topo.num_packages);
+    printf("Threads: 1..%d, strong: %zu MB total, weak: %zu MB per thread\n",
+           max_threads, strong_bytes >> 20, weak_bytes >> 20);
+
+    uint8_t* input = (uint8_t*)aes_buf_alloc(max_bytes, AES_BUF_PREFAULT);
+    uint8_t* output = (uint8_t*)aes_buf_alloc(max_bytes, AES_BUF_PREFAULT);
+    if (!input || !output) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    aes_datagen_fill(input, max_bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+    aes_datagen_fill(output, max_bytes, AES_DATAGEN_ZERO, 0);
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+    if (check_aesni_support()) {
+        aes_keyexpansion_aesni(key, key_schedule);
+    }
+
+    for(size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+        const backend_t* backend = &backends[b];
+        if (!backend->supported()) {
+            printf("\n%s: not supported on this CPU, skipped\n", backend->name);
+            continue;
+        }
+
+        for(size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+            double strong_base = 0, weak_base = 0;
+
+            aes_set_pin_policy(policies[p]);
+            printf("\n%s, pinning %s\n", backend->name, aes_pin_policy_name(policies[p]));
+            printf("%7s | %9s %8s %8s %10s | %9s %8s %10s\n",
+                   "threads", "strong s", "GB/s", "speedup", "efficiency",
+                   "weak s", "GB/s", "efficiency");
+
+            for(int n = 1; n <= max_threads; n++) {
+                aes_set_num_threads(n);
+                backend->run(input, output, 1024);  // warm up the thread count
+
+                // Strong: fixed total size, ideal time t1 / n
+                double strong_time = time_run(backend, input, output, strong_bytes);
+                // Weak: fixed size per thread, ideal time t1
+                double weak_time = time_run(backend, input, output, weak_bytes * n);
+                if (n == 1) {
+                    strong_base = strong_time;
+                    weak_base = weak_time;
+                }
+
+                double speedup = strong_base / strong_time;
+                printf("%7d | %9.3f %8.2f %7.2fx %9.1f%% | %9.3f %8.2f %9.1f%%%s\n",
+                       n, strong_time, strong_bytes / strong_time / (1024.0 * 1024.0 * 1024.0),
+                       speedup, 100.0 * speedup / n,
+                       weak_time, weak_bytes * n / weak_time / (1024.0 * 1024.0 * 1024.0),
+                       100.0 * weak_base / weak_time, boundary_note(&topo, n));
+            }
+        }
+    }
+
+    aes_buf_free(input);
+    aes_buf_free(output);
+
+    return 0;
+}
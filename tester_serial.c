@@ -1,4 +1,5 @@
 #include "aes.h"
+#include "buf.h"
 
 int main() {
     
@@ -14,8 +15,8 @@ int main() {
     };
     
     // Aligned memory allocation
-    uint8_t *input = (uint8_t*)aligned_alloc(16, NUM_BLOCKS * 16);
-    uint8_t *output_serial = (uint8_t*)aligned_alloc(16, NUM_BLOCKS * 16);
+    uint8_t *input = (uint8_t*)aes_buf_alloc(NUM_BLOCKS * 16, AES_BUF_PREFAULT);
+    uint8_t *output_serial = (uint8_t*)aes_buf_alloc(NUM_BLOCKS * 16, AES_BUF_PREFAULT);
     uint8_t *roundKey = (uint8_t*)aligned_alloc(16, 176);
     
     if (!input || !output_serial || !roundKey) {
@@ -24,7 +25,7 @@ int main() {
     }
     
     // Initialize input
-    for(int i = 0; i < NUM_BLOCKS * 16; i++) {
+    for(size_t i = 0; i < NUM_BLOCKS * 16; i++) {
         input[i] = i & 0xFF;
     }
     
@@ -49,8 +50,8 @@ int main() {
     printf("\n");
     
     // Clean up
-    free(input);
-    free(output_serial);
+    aes_buf_free(input);
+    aes_buf_free(output_serial);
     free(roundKey);
     
     return 0;
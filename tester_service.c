@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "aes.h"
+#include "service.h"
+#include "dispatch.h"
+#include "bench.h"
+#include "datagen.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define NUM_CLIENTS 4
+#define REGION_MB 16
+#define REQUEST_BYTES (1024 * 1024)     // throughput requests
+#define OUTSTANDING 8                   // requests each client keeps in flight
+#define MIN_SECONDS 1.0
+#define KEY_ID 7
+
+static const uint8_t key[16] = {
+    0x2b, 0x7e, 0x15, 0x16,
+    0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88,
+    0x09, 0xcf, 0x4f, 0x3c
+};
+static ctr_block_t initial_ctr = {
+    .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+// The daemon may still be starting; retry for a few seconds
+static aes_service_client_t* connect_retry(const char* path, size_t bytes) {
+    for (int attempt = 0; attempt < 500; attempt++) {
+        aes_service_client_t* client = aes_service_connect(path, bytes);
+        if (client || (errno != ENOENT && errno != ECONNREFUSED)) {
+            return client;
+        }
+        usleep(10000);
+    }
+    return NULL;
+}
+
+// Local reference for one request: whole blocks, then the padded tail
+static void local_ctr(uint8_t* data, size_t len, const uint8_t* roundKey, const ctr_block_t* ctr) {
+    aesctr_bulk_fn kernel = aes_select_bulk_kernel(NULL);
+    ctr_block_t c = *ctr;
+    size_t blocks = len / BLOCK_SIZE;
+
+    kernel(data, roundKey, data, blocks, &c);
+    if (len % BLOCK_SIZE) {
+        uint8_t block[BLOCK_SIZE] = {0};
+        memcpy(block, data + blocks * BLOCK_SIZE, len % BLOCK_SIZE);
+        ctr_block_advance(ctr, &c, blocks);
+        kernel(block, roundKey, block, 1, &c);
+        memcpy(data + blocks * BLOCK_SIZE, block, len % BLOCK_SIZE);
+    }
+}
+
+/**
+ * One client process: cuts its region into messages of assorted, odd
+ * lengths, each with its own counter, encrypts them through the daemon with
+ * several requests in flight and checks them against local CTR; checks that
+ * bad requests are refused; then streams REQUEST_BYTES requests for
+ * MIN_SECONDS.
+ * return: exit status
+ */
+static int run_client(const char* path, int id, size_t bytes) {
+    aes_service_client_t* client = connect_retry(path, bytes);
+    if (!client) {
+        printf("client %d: connect failed: %s\n", id, strerror(errno));
+        return 1;
+    }
+    uint8_t* region = aes_service_region(client, NULL);
+    uint8_t* expected = (uint8_t*)malloc(bytes);
+    uint8_t roundKey[176];
+    if (!expected) {
+        return 1;
+    }
+    aes_keyexpansion_serial((uint8_t*)key, roundKey);
+    aes_datagen_fill(region, bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED + id);
+    memcpy(expected, region, bytes);
+
+    // From one byte to a few MB, so requests split into chunks and share batches
+    static const size_t lens[] = { 1, 4096, 17, 1500, 3 * 1024 * 1024 + 5, 64, 65536 + 1, 777 };
+    size_t off = 0;
+    int inflight = 0, ok = 1;
+    for (uint64_t i = 0; off < bytes && ok; i++) {
+        size_t len = lens[i % (sizeof(lens) / sizeof(lens[0]))];
+        if (len > bytes - off) len = bytes - off;
+        ctr_block_t ctr;
+        ctr_block_advance(&initial_ctr, &ctr, i << 32);     // a fresh counter range per message
+        local_ctr(expected + off, len, roundKey, &ctr);
+
+        ok = aes_service_submit(client, KEY_ID, off, len, &ctr, i) == 0;
+        if (++inflight == OUTSTANDING) {
+            ok = ok && aes_service_wait(client, NULL) == 0;
+            inflight--;
+        }
+        off += len;
+    }
+    while (inflight-- > 0) {
+        ok = aes_service_wait(client, NULL) == 0 && ok;
+    }
+    ok = ok && memcmp(region, expected, bytes) == 0;
+
+    errno = 0;
+    int refused = aes_service_ctr(client, KEY_ID + 1, 0, 16, &initial_ctr) < 0 && errno == ENOKEY;
+    errno = 0;
+    refused = refused && aes_service_ctr(client, KEY_ID, bytes - 16, 32, &initial_ctr) < 0 && errno == EINVAL;
+
+    size_t done = 0;
+    uint64_t next = 0;
+    double start = bench_now(), elapsed;
+    inflight = 0;
+    do {
+        size_t req_off = (next++ * REQUEST_BYTES) % (bytes - bytes % REQUEST_BYTES);
+        aes_service_submit(client, KEY_ID, req_off, REQUEST_BYTES, &initial_ctr, next);
+        if (++inflight == OUTSTANDING) {
+            aes_service_wait(client, NULL);
+            inflight--;
+            done += REQUEST_BYTES;
+        }
+        elapsed = bench_now() - start;
+    } while (elapsed < MIN_SECONDS);
+    while (inflight-- > 0) {
+        aes_service_wait(client, NULL);
+        done += REQUEST_BYTES;
+    }
+    elapsed = bench_now() - start;
+
+    printf("client %d: assorted requests match local CTR: %s, bad key and range refused: %s, %.2f GB/s\n",
+           id, ok ? "Yes" : "No", refused ? "Yes" : "No", done / elapsed / (1 << 30));
+    fflush(stdout);
+    aes_service_disconnect(client);
+    free(expected);
+    return ok && refused ? 0 : 1;
+}
+
+/**
+ * usage: tester_service [clients] [region_mb]
+ *
+ * Starts the service in this process on a socket in /tmp and forks client
+ * processes against it. Each checks its results and measures its own
+ * throughput; the service reports how requests were batched.
+ */
+int main(int argc, char** argv) {
+    int num_clients = argc > 1 ? atoi(argv[1]) : NUM_CLIENTS;
+    size_t bytes = (argc > 2 ? strtoul(argv[2], NULL, 10) : REGION_MB) * 1024 * 1024;
+    if (num_clients < 1 || bytes < REQUEST_BYTES) {
+        printf("Need at least one client and a 1 MB region\n");
+        return 1;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/aesctr-service-%d.sock", (int)getpid());
+
+    // Fork before the service starts any threads
+    pid_t* pids = (pid_t*)malloc(num_clients * sizeof(pid_t));
+    for (int i = 0; i < num_clients; i++) {
+        fflush(stdout);
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            _exit(run_client(path, i, bytes));
+        }
+    }
+
+    aes_service_key_t service_key = { .key_id = KEY_ID };
+    aes_service_opts_t opts = { .keys = &service_key, .num_keys = 1 };
+    memcpy(service_key.key, key, sizeof(key));
+    aes_service_t* svc = aes_service_start(path, &opts);
+    if (!svc) {
+        printf("Service failed to start: %s\n", strerror(errno));
+        return 1;
+    }
+
+    int ok = 1;
+    for (int i = 0; i < num_clients; i++) {
+        int status;
+        waitpid(pids[i], &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    aes_service_stats_t stats;
+    aes_service_get_stats(svc, &stats);
+    aes_service_stop(svc);
+    printf("\nService: %llu clients, %llu requests in %llu batches (mean %.1f, max %llu), %.1f MB\n",
+           (unsigned long long)stats.clients, (unsigned long long)stats.requests,
+           (unsigned long long)stats.batches, stats.batches ? (double)stats.requests / stats.batches : 0.0,
+           (unsigned long long)stats.max_batch, stats.bytes / (1024.0 * 1024));
+    printf("All clients correct: %s\n", ok ? "Yes" : "No");
+    free(pids);
+    return ok ? 0 : 1;
+}
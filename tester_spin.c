@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "aes.h"
+#include "pool.h"
+#include "dispatch.h"
+#include "stats.h"
+#include "bench.h"
+#include "datagen.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define ROUNDS 5000
+#define IDLE_US 2000
+
+typedef struct {
+    aes_task_t task;
+    uint64_t started_ns;
+} probe_t;
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+static ctr_block_t initial_ctr = {
+    .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+static double samples[ROUNDS];
+
+static void probe_run(aes_task_t* task, int worker_idx) {
+    (void)worker_idx;
+    ((probe_t*)task)->started_ns = aes_stats_now_ns();
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Sorts samples; p50 and p99 in microseconds
+static void percentiles(int n, double* p50, double* p99) {
+    qsort(samples, n, sizeof(double), cmp_double);
+    *p50 = samples[n / 2] * 1e6;
+    *p99 = samples[n * 99 / 100] * 1e6;
+}
+
+// Submit to first instruction of an empty task, in seconds
+static void time_dispatch(aes_pool_t* pool) {
+    for (int i = 0; i < ROUNDS; i++) {
+        aes_taskgroup_t group;
+        probe_t probe = { .task = { .fn = probe_run, .group = &group } };
+        aes_taskgroup_init(&group);
+        uint64_t submit_ns = aes_stats_now_ns();
+        aes_pool_submit(pool, &probe.task);
+        aes_taskgroup_wait(&group);
+        aes_taskgroup_destroy(&group);
+        samples[i] = (probe.started_ns - submit_ns) * 1e-9;
+    }
+}
+
+static void time_messages(aes_pool_t* pool, uint8_t* in, uint8_t* out, size_t bytes) {
+    for (int i = 0; i < ROUNDS; i++) {
+        double start = bench_now();
+        aesctr_enc_pool(pool, in, roundKey, out, bytes / BLOCK_SIZE, &initial_ctr);
+        samples[i] = bench_now() - start;
+    }
+}
+
+/**
+ * usage: tester_spin [workers]
+ *
+ * Checks pool output with spinning workers against the bulk kernel and that
+ * spinners park after their idle timeout and resume after the next task.
+ * Then compares parked and spinning workers: latency from submit to the
+ * start of an empty task, and of 64 KB-1 MB aesctr_enc_pool calls. Spinning
+ * only pays off on cores nothing else needs; by default the pool gets one
+ * worker per CPU but one, leaving a core for this thread.
+ */
+int main(int argc, char** argv) {
+    int cpus = bench_num_cpus();
+    int workers = argc > 1 ? atoi(argv[1]) : (cpus > 1 ? cpus - 1 : 1);
+    static const size_t sizes[] = { 64 * 1024, 256 * 1024, 1024 * 1024 };
+    size_t max_bytes = 1024 * 1024 + 5 * BLOCK_SIZE;
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+
+    aes_pool_t* pool = aes_pool_create(workers);
+    uint8_t* in = (uint8_t*)aes_buf_alloc(max_bytes, AES_BUF_PREFAULT);
+    uint8_t* out = (uint8_t*)aes_buf_alloc(max_bytes, AES_BUF_PREFAULT);
+    uint8_t* expected = (uint8_t*)aes_buf_alloc(max_bytes, AES_BUF_PREFAULT);
+    if (!pool || !in || !out || !expected) {
+        printf("Setup failed\n");
+        return 1;
+    }
+    workers = aes_pool_num_threads(pool);
+    aes_datagen_fill(in, max_bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+    aes_pool_set_spin(pool, workers, IDLE_US);
+
+    int ok = 1;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t blocks = sizes[s] / BLOCK_SIZE + 5;
+        ctr_block_t ctr = initial_ctr;
+        aes_select_bulk_kernel(NULL)(in, roundKey, expected, blocks, &ctr);
+        for (int r = 0; r < 100; r++) {
+            memset(out, 0, blocks * BLOCK_SIZE);
+            if (r % 2) {
+                aesctr_enc_pool(pool, in, roundKey, out, blocks, &initial_ctr);
+            } else {
+                aesctr_enc_pool_bulk(pool, in, roundKey, out, blocks, &initial_ctr);
+            }
+            ok = ok && memcmp(out, expected, blocks * BLOCK_SIZE) == 0;
+        }
+    }
+    printf("Spinning pool output matches the bulk kernel: %s\n", ok ? "Yes" : "No");
+
+    usleep(IDLE_US * 10);
+    int parked = aes_pool_spinning(pool) == 0;
+    time_dispatch(pool);
+    usleep(1000);
+    int resumed = aes_pool_spinning(pool) > 0;
+    printf("Spinners park after %d us idle: %s, spin again after new work: %s\n", IDLE_US, parked ? "Yes" : "No",
+           resumed ? "Yes" : "No");
+    ok = ok && parked && resumed;
+
+    if (cpus <= workers) {
+        printf("\nNote: %d CPUs for %d spinning workers and this thread; latencies below are not representative\n",
+               cpus, workers);
+    }
+    printf("\n%d workers, %d rounds, p50 / p99 in us\n", workers, ROUNDS);
+    printf("%-22s %18s %18s\n", "", "parked", "spinning");
+    for (int row = -1; row < (int)(sizeof(sizes) / sizeof(sizes[0])); row++) {
+        double p50[2], p99[2];
+        for (int spin = 0; spin <= 1; spin++) {
+            aes_pool_set_spin(pool, spin ? workers : 0, IDLE_US);
+            usleep(1000);
+            if (row < 0) {
+                time_dispatch(pool);
+            } else {
+                time_messages(pool, in, out, sizes[row]);
+            }
+            percentiles(ROUNDS, &p50[spin], &p99[spin]);
+        }
+        char label[32];
+        if (row < 0) {
+            snprintf(label, sizeof(label), "dispatch");
+        } else {
+            snprintf(label, sizeof(label), "%zu KB message", sizes[row] >> 10);
+        }
+        printf("%-22s %8.2f / %7.2f %8.2f / %7.2f\n", label, p50[0], p99[0], p50[1], p99[1]);
+    }
+
+    aes_pool_destroy(pool);
+    aes_buf_free(in);
+    aes_buf_free(out);
+    aes_buf_free(expected);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "aes.h"
+#include "aesni.h"
+#include "vaes.h"
+#include "aes_pthread.h"
+#include "openmp.h"
+#include "stats.h"
+#include "buf.h"
+
+#define MAX_BYTES (16 * 1024 * 1024)
+#define CALLS_PER_SIZE 8
+#define RACE_CALLS 2000000
+
+static volatile int recorder_done;
+
+// One queued chunk around every record, as the pool drivers do
+static void* recorder_main(void* arg) {
+    (void)arg;
+    for(int i = 0; i < RACE_CALLS; i++) {
+        aes_stats_queue_add(1);
+        aes_stats_record(AES_BACKEND_POOL, 16, 100);
+        aes_stats_queue_add(-1);
+    }
+    recorder_done = 1;
+    return NULL;
+}
+
+/**
+ * Resets while another thread records must neither leave a phantom queue
+ * depth behind nor be undone, and counts after a reset start from zero.
+ */
+static int check_reset_race() {
+    pthread_t thread;
+    aes_stats_t stats;
+
+    pthread_create(&thread, NULL, recorder_main, NULL);
+    while (!recorder_done) {
+        aes_stats_reset();
+    }
+    pthread_join(thread, NULL);
+    aes_stats_snapshot(&stats);
+    int ok = stats.queue_depth == 0 && stats.calls[AES_BACKEND_POOL] <= RACE_CALLS;
+
+    aes_stats_reset();
+    for(int i = 0; i < 5; i++) {
+        aes_stats_record(AES_BACKEND_POOL, 16, 100);
+    }
+    aes_stats_snapshot(&stats);
+    return ok && stats.calls[AES_BACKEND_POOL] == 5 && stats.bytes[AES_BACKEND_POOL] == 80;
+}
+
+/**
+ * usage: tester_stats [metrics_file]
+ * Runs every backend at a few request sizes and prints the Prometheus text,
+ * or writes it to metrics_file (e.g. for node_exporter's textfile collector).
+ * Then checks aes_stats_reset against a thread that is recording, on stderr
+ * so the metrics text stays parseable.
+ */
+int main(int argc, char** argv) {
+    static const size_t sizes[] = { 4 * 1024, 64 * 1024, 1024 * 1024, MAX_BYTES };
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    ctr_block_t initial_ctr = {
+        .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+        .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+    };
+
+    uint8_t *input = (uint8_t*)aes_buf_alloc(MAX_BYTES, AES_BUF_PREFAULT);
+    uint8_t *output = (uint8_t*)aes_buf_alloc(MAX_BYTES, AES_BUF_PREFAULT);
+    uint8_t *roundKey = (uint8_t*)aligned_alloc(64, 176);
+    __m128i *key_schedule = (__m128i*)aligned_alloc(64, 176);
+    if (!input || !output || !roundKey || !key_schedule) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    memset(input, 0x5a, MAX_BYTES);
+
+    int have_aesni = check_aesni_support();
+    int have_vaes = have_aesni && check_vaes_support();
+    aes_keyexpansion_serial(key, roundKey);
+    if (have_aesni) {
+        aes_keyexpansion_aesni(key, key_schedule);
+    }
+
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t blocks = sizes[s] / BLOCK_SIZE;
+        for(int call = 0; call < CALLS_PER_SIZE; call++) {
+            // Serial is ~100x slower; keep it to the small sizes
+            if (sizes[s] <= 64 * 1024) {
+                aesctr_enc_serial(input, roundKey, output, blocks, &initial_ctr);
+            }
+            if (have_aesni) {
+                aesctr_enc_aesni(input, key_schedule, output, blocks, &initial_ctr);
+            }
+            if (have_vaes) {
+                aesctr_enc_vaes(input, key_schedule, output, blocks, &initial_ctr);
+                aesctr_enc_vaes_pthread(input, key_schedule, output, blocks, &initial_ctr);
+            }
+            if (sizes[s] <= 1024 * 1024) {
+                aesctr_enc_pthread(input, roundKey, output, blocks, &initial_ctr);
+                aesctr_enc_openmp(input, roundKey, output, blocks, &initial_ctr);
+            }
+        }
+    }
+
+    // Same text either way; the buffer variant is what a service's /metrics handler would use
+    char probe[1];
+    size_t needed = aes_stats_render_prometheus(probe, sizeof(probe));
+    char* text = (char*)malloc(needed + 1);
+    if (!text || aes_stats_render_prometheus(text, needed + 1) != needed) {
+        printf("Rendering metrics failed!\n");
+        return 1;
+    }
+
+    if (argc > 1) {
+        FILE* f = fopen(argv[1], "w");
+        if (!f || aes_stats_write_prometheus(f) != 0) {
+            printf("Failed to write %s\n", argv[1]);
+            return 1;
+        }
+        fclose(f);
+        printf("Wrote %zu bytes of metrics to %s\n", needed, argv[1]);
+    } else {
+        fputs(text, stdout);
+    }
+
+    int reset_ok = check_reset_race();
+    fprintf(stderr, "Reset while recording keeps queue depth and restarts counts: %s\n", reset_ok ? "Yes" : "No");
+
+    free(text);
+    aes_buf_free(input);
+    aes_buf_free(output);
+    free(roundKey);
+    free(key_schedule);
+
+    return reset_ok ? 0 : 1;
+}
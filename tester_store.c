@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "aes.h"
+#include "aesni.h"
+#include "vaes.h"
+#include "openmp.h"
+#include "pool.h"
+#include "store.h"
+#include "dispatch.h"
+#include "bench.h"
+#include "datagen.h"
+#include "verify.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define TEST_MB 512
+#define REPEATS 3
+
+typedef struct {
+    const char* name;
+    int (*supported)();
+    void (*run)(uint8_t* input, uint8_t* output, size_t num_blocks, ctr_block_t* ctr);
+} backend_t;
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+static __m128i key_schedule[11];
+static ctr_block_t initial_ctr = {
+    .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+static int always_supported() { return 1; }
+static int vaes_supported() { return check_aesni_support() && check_vaes_support(); }
+
+static void run_aesni(uint8_t* input, uint8_t* output, size_t num_blocks, ctr_block_t* ctr) {
+    aesctr_enc_aesni(input, key_schedule, output, num_blocks, ctr);
+}
+
+static void run_vaes(uint8_t* input, uint8_t* output, size_t num_blocks, ctr_block_t* ctr) {
+    aesctr_enc_vaes(input, key_schedule, output, num_blocks, ctr);
+}
+
+static void run_openmp(uint8_t* input, uint8_t* output, size_t num_blocks, ctr_block_t* ctr) {
+    aesctr_enc_openmp(input, roundKey, output, num_blocks, ctr);
+}
+
+static void run_pool(uint8_t* input, uint8_t* output, size_t num_blocks, ctr_block_t* ctr) {
+    aesctr_enc_pool(NULL, input, roundKey, output, num_blocks, ctr);
+}
+
+static const backend_t backends[] = {
+    { "aesni",  check_aesni_support, run_aesni },
+    { "vaes",   vaes_supported,      run_vaes },
+    { "openmp", always_supported,    run_openmp },
+    { "pool",   always_supported,    run_pool },
+};
+
+#define NUM_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+// Best of REPEATS runs, in seconds
+static double time_backend(const backend_t* backend, uint8_t* input, uint8_t* output, size_t num_blocks) {
+    double best = 0;
+    for (int r = 0; r < REPEATS; r++) {
+        double start = bench_now();
+        backend->run(input, output, num_blocks, &initial_ctr);
+        double elapsed = bench_now() - start;
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+static void print_decision(const char* what, const void* input, const void* output, size_t bytes) {
+    const char* name;
+    aes_select_bulk_kernel_for(input, output, bytes, &name);
+    printf("  %-26s %8zu MB  %-9s %s\n", what, bytes >> 20,
+           aes_streaming_stores(input, output, bytes) ? "streaming" : "regular", name);
+}
+
+/**
+ * usage: tester_store [mb]
+ *
+ * Runs each bulk backend with regular and with streaming (non-temporal)
+ * stores on the same out-of-place buffers, checks that both produce the same
+ * ciphertext, including from an output that is only 16-byte aligned, and shows
+ * what AES_STORE_AUTO picks for a few job shapes.
+ */
+int main(int argc, char** argv) {
+    size_t bytes = (argc > 1 ? strtoul(argv[1], NULL, 10) : TEST_MB) * 1024 * 1024;
+    size_t num_blocks = bytes / BLOCK_SIZE;
+    if (num_blocks == 0) {
+        printf("Size must be at least 1 MB\n");
+        return 1;
+    }
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+    if (check_aesni_support()) {
+        aes_keyexpansion_aesni(key, key_schedule);
+    }
+
+    size_t num_chunks = AES_VERIFY_NUM_CHUNKS(bytes);
+    uint8_t* input = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    // One extra block so the output can also start 16 bytes past a cache line
+    uint8_t* output_base = (uint8_t*)aes_buf_alloc(bytes + 64, AES_BUF_PREFAULT);
+    uint64_t* digests_ref = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
+    uint64_t* digests = (uint64_t*)malloc(num_chunks * sizeof(uint64_t));
+    if (!input || !output_base || !digests_ref || !digests) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    aes_datagen_fill(input, bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+    memset(output_base, 0, bytes + 64);
+
+    size_t l1, l2, llc;
+    bench_cache_sizes(&l1, &l2, &llc);
+    printf("Buffer: %zu MB, LLC: %zu KB, streaming threshold: %zu MB\n\n",
+           bytes >> 20, llc >> 10, aes_get_streaming_threshold() >> 20);
+
+    printf("AES_STORE_AUTO decisions:\n");
+    print_decision("out of place", input, output_base, bytes);
+    print_decision("out of place, LLC/2 total", input, output_base, llc / 4 > 0 ? llc / 4 : 16);
+    print_decision("in place", input, input, bytes);
+    printf("\n");
+
+    int ok = 1;
+    int have_ref = 0;
+    printf("%-8s %10s %10s %8s %8s %10s\n", "backend", "reg GB/s", "nt GB/s", "speedup", "match", "unaligned");
+
+    for (size_t b = 0; b < NUM_BACKENDS; b++) {
+        if (!backends[b].supported()) {
+            printf("%-8s %10s %10s %8s %8s %10s\n", backends[b].name, "-", "-", "-", "n/a", "n/a");
+            continue;
+        }
+
+        aes_set_store_policy(AES_STORE_REGULAR);
+        double regular = time_backend(&backends[b], input, output_base, num_blocks);
+        aes_digest_chunks(output_base, bytes, digests);
+        if (!have_ref) {
+            size_t mismatch;
+            if (!aes_verify_ctr(input, output_base, num_blocks, roundKey, &initial_ctr, &mismatch)) {
+                printf("%s regular output wrong at block %zu\n", backends[b].name, mismatch);
+                return 1;
+            }
+            memcpy(digests_ref, digests, num_chunks * sizeof(uint64_t));
+            have_ref = 1;
+        }
+        int match = aes_digest_compare(digests_ref, digests, num_chunks) < 0;
+
+        aes_set_store_policy(AES_STORE_STREAMING);
+        memset(output_base, 0, bytes);
+        double stream = time_backend(&backends[b], input, output_base, num_blocks);
+        aes_digest_chunks(output_base, bytes, digests);
+        match = match && aes_digest_compare(digests_ref, digests, num_chunks) < 0;
+
+        // 16 bytes off a cache line: VAES peels blocks up to the next line, AES-NI streams as is
+        backends[b].run(input, output_base + 16, num_blocks, &initial_ctr);
+        aes_digest_chunks(output_base + 16, bytes, digests);
+        int unaligned = aes_digest_compare(digests_ref, digests, num_chunks) < 0;
+
+        double gb = (double)bytes / (1 << 30);
+        printf("%-8s %10.2f %10.2f %7.2fx %8s %10s\n", backends[b].name, gb / regular, gb / stream,
+               regular / stream, match ? "Yes" : "No", unaligned ? "Yes" : "No");
+        ok = ok && match && unaligned;
+    }
+    aes_set_store_policy(AES_STORE_AUTO);
+
+    aes_buf_free(input);
+    aes_buf_free(output_base);
+    free(digests_ref);
+    free(digests);
+    return ok ? 0 : 1;
+}
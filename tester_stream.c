@@ -0,0 +1,210 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "aes.h"
+#include "openmp.h"
+#include "stream.h"
+#include "affinity.h"
+#include "bench.h"
+#include "datagen.h"
+#include "verify.h"
+#include "buf.h"
+
+#define DATAGEN_SEED 0x5eedULL
+#define TEST_MB 256
+#define PIPE_BYTES (1024 * 1024)
+#define COPY_CHUNK (1024 * 1024)
+
+typedef struct {
+    int fd;
+    uint8_t* buf;
+    size_t len;
+    size_t done;
+} pipe_end_t;
+
+typedef struct {
+    const char* name;
+    size_t slot_size;
+    int slots;
+    size_t trim;                // bytes cut off the end to get a partial slot and block
+} config_t;
+
+static const config_t configs[] = {
+    { "default",            0,            0, 0 },
+    { "64K slots x 4",      64 * 1024,    4, 0 },
+    { "odd length",         256 * 1024,   0, 4099 },
+    { "tiny slots",         4096 + 16,    6, 7 },
+};
+
+#define NUM_CONFIGS (sizeof(configs) / sizeof(configs[0]))
+
+static uint8_t roundKey[176] __attribute__((aligned(64)));
+static ctr_block_t initial_ctr = {
+    .nonce = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF},
+    .counter = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0}
+};
+
+static void* producer(void* arg) {
+    pipe_end_t* end = (pipe_end_t*)arg;
+    while (end->done < end->len) {
+        ssize_t n = write(end->fd, end->buf + end->done, end->len - end->done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        end->done += n;
+    }
+    close(end->fd);
+    return NULL;
+}
+
+static void* consumer(void* arg) {
+    pipe_end_t* end = (pipe_end_t*)arg;
+    for (;;) {
+        ssize_t n = read(end->fd, end->buf + end->done, end->len + 1 - end->done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (n == 0) break;
+        end->done += n;
+    }
+    return NULL;
+}
+
+// Single-threaded read/write loop: the pipe bandwidth a filter can hope for
+static int64_t copy_stream(int in_fd, int out_fd) {
+    static uint8_t chunk[COPY_CHUNK];
+    int64_t total = 0;
+    ssize_t n;
+    while ((n = read(in_fd, chunk, sizeof(chunk))) > 0) {
+        if (write(out_fd, chunk, n) != n) {
+            return -1;
+        }
+        total += n;
+    }
+    return n < 0 ? -1 : total;
+}
+
+/**
+ * Pushes len bytes of input through in_pipe, runs the filter between the
+ * pipes on this thread and collects what comes out into output.
+ * config: NULL for the plain copy loop
+ * return: seconds, or a negative value on error
+ */
+static double run_through_pipes(const config_t* config, uint8_t* input, uint8_t* output, size_t len,
+                                aes_stream_stats_t* stats, size_t* received) {
+    int in_pipe[2], out_pipe[2];
+    pthread_t prod, cons;
+
+    if (pipe(in_pipe) < 0 || pipe(out_pipe) < 0) {
+        return -1;
+    }
+    fcntl(in_pipe[1], F_SETPIPE_SZ, PIPE_BYTES);
+    fcntl(out_pipe[1], F_SETPIPE_SZ, PIPE_BYTES);
+
+    pipe_end_t prod_end = { in_pipe[1], input, len, 0 };
+    pipe_end_t cons_end = { out_pipe[0], output, len, 0 };
+    pthread_create(&prod, NULL, producer, &prod_end);
+    pthread_create(&cons, NULL, consumer, &cons_end);
+
+    double start = bench_now();
+    int64_t bytes;
+    if (config) {
+        aes_stream_opts_t opts = { config->slot_size, config->slots, 0 };
+        bytes = aes_encrypt_stream(in_pipe[0], out_pipe[1], roundKey, &initial_ctr, &opts, stats);
+    } else {
+        bytes = copy_stream(in_pipe[0], out_pipe[1]);
+    }
+    close(out_pipe[1]);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+    double seconds = bench_now() - start;
+
+    close(in_pipe[0]);
+    close(out_pipe[0]);
+    *received = cons_end.done;
+    return bytes == (int64_t)len ? seconds : -1;
+}
+
+/**
+ * usage: tester_stream [mb]
+ *
+ * Streams data through pipe -> aes_encrypt_stream -> pipe with producer and
+ * consumer threads on the far ends, for several slot layouts, and checks the
+ * output against the OpenMP driver on the whole buffer. A plain read/write
+ * loop between the same pipes gives the copy speed to compare against.
+ */
+int main(int argc, char** argv) {
+    size_t bytes = (argc > 1 ? strtoul(argv[1], NULL, 10) : TEST_MB) * 1024 * 1024;
+    size_t num_blocks = bytes / BLOCK_SIZE;
+    if (num_blocks == 0) {
+        printf("Size must be at least 1 MB\n");
+        return 1;
+    }
+
+    uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16,
+        0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88,
+        0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_keyexpansion_serial(key, roundKey);
+
+    // The consumer reads one byte past len to see that nothing extra arrives
+    uint8_t* input = (uint8_t*)aes_buf_alloc(bytes, AES_BUF_PREFAULT);
+    uint8_t* expected = (uint8_t*)aes_buf_alloc(bytes + BLOCK_SIZE, AES_BUF_PREFAULT);
+    uint8_t* output = (uint8_t*)aes_buf_alloc(bytes + 1, AES_BUF_PREFAULT);
+    if (!input || !expected || !output) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    aes_datagen_fill(input, bytes, AES_DATAGEN_RANDOM, DATAGEN_SEED);
+
+    // Reference over whole blocks plus one, so every trimmed length is a prefix of it
+    uint8_t* padded = (uint8_t*)aes_buf_alloc(bytes + BLOCK_SIZE, 0);
+    if (!padded) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    memcpy(padded, input, bytes);
+    aesctr_enc_openmp(padded, roundKey, expected, num_blocks + 1, &initial_ctr);
+    aes_buf_free(padded);
+
+    size_t received;
+    double copy = run_through_pipes(NULL, input, output, bytes, NULL, &received);
+    double gb = (double)bytes / (1 << 30);
+    printf("Stream: %zu MB through pipes, %d workers\n\n", bytes >> 20, aes_get_num_threads());
+    printf("%-16s %8s %10s %8s %8s %8s %8s %8s\n",
+           "config", "GB/s", "vs copy", "slots", "r-wait", "w-wait", "o-wait", "match");
+    printf("%-16s %8.2f %10s %8s %8s %8s %8s %8s\n", "copy loop", copy > 0 ? gb / copy : 0, "1.00x",
+           "-", "-", "-", "-", copy > 0 && received == bytes && memcmp(input, output, bytes) == 0 ? "Yes" : "No");
+
+    int ok = copy > 0;
+    for (size_t c = 0; c < NUM_CONFIGS; c++) {
+        aes_stream_stats_t stats = {0};
+        size_t len = bytes - (configs[c].trim < bytes ? configs[c].trim : 0);
+        double seconds = run_through_pipes(&configs[c], input, output, len, &stats, &received);
+        int match = seconds > 0 && received == len && memcmp(expected, output, len) == 0;
+        ok = ok && match;
+
+        double len_gb = (double)len / (1 << 30);
+        printf("%-16s %8.2f %9.2fx %8llu %8llu %8llu %8llu %8s\n", configs[c].name,
+               seconds > 0 ? len_gb / seconds : 0, seconds > 0 && copy > 0 ? copy / seconds * len / bytes : 0,
+               (unsigned long long)stats.slots, (unsigned long long)stats.reader_waits,
+               (unsigned long long)stats.worker_waits, (unsigned long long)stats.writer_waits,
+               match ? "Yes" : "No");
+    }
+
+    aes_buf_free(input);
+    aes_buf_free(expected);
+    aes_buf_free(output);
+    return ok ? 0 : 1;
+}